@@ -267,6 +267,9 @@ bool LaserClient::callThriftServer(uint32_t shard_id, int64_t partition_hash, bo
   apache::thrift::RpcOptions rpc_options;
   service_router::ThriftRetryOption retry_option;
   rpc_options.setTimeout(std::chrono::milliseconds(options.getReceiveTimeoutMs()));
+  if (!options.getClientId().empty()) {
+    rpc_options.setWriteHeader(LASER_CLIENT_ID_HEADER, options.getClientId());
+  }
   LaserClient::getRetryOption(&retry_option, options);
 
   bool ret = service_router::thriftServiceCall<laser::LaserServiceAsyncClient>(
@@ -291,6 +294,9 @@ bool LaserClient::callThriftServer(std::shared_ptr<service_router::ServerAddress
   apache::thrift::RpcOptions rpc_options;
   service_router::ThriftRetryOption retry_option;
   rpc_options.setTimeout(std::chrono::milliseconds(options.getReceiveTimeoutMs()));
+  if (!options.getClientId().empty()) {
+    rpc_options.setWriteHeader(LASER_CLIENT_ID_HEADER, options.getClientId());
+  }
   LaserClient::getRetryOption(&retry_option, options);
 
   bool ret = service_router::thriftServiceCall<laser::LaserServiceAsyncClient>(
@@ -385,7 +391,8 @@ bool LaserClient::getRouteInfo(uint32_t* shard_id, int64_t* partition_hash, bool
     return false;
   }
   *route_to_edge_node = false;
-  if (options.getReadMode() != ClientRequestReadMode::LEADER_READ) {
+  // 边缘节点不上报同步延迟，限制读取延迟时不路由到边缘节点
+  if (options.getReadMode() != ClientRequestReadMode::LEADER_READ && options.getMaxStalenessMs() <= 0) {
     if (!table_schema.value()->getBindEdgeNodes().empty()) {
       uint32_t random_value = folly::Random::rand32(0, 100);
       if (random_value < table_schema.value()->getEdgeFlowRatio()) {
@@ -428,6 +435,7 @@ std::shared_ptr<service_router::ClientOption> LaserClient::getClientOption(const
   option->setLocalFirstConfig(options.getLocalFirstConfig());
   option->setThriftCompressionMethod(options.getThriftCompressionMethod());
   option->setMaxConnPerServer(FLAGS_laser_client_max_conn_per_server);
+  option->setMaxStalenessMs(options.getMaxStalenessMs());
 
   // 仅对单个操作的请求作用，mget mset 不会生效
   auto target_addr = options.getTargetServerAddress();
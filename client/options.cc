@@ -101,7 +101,9 @@ void ClientOption::describe(std::ostream& os) const {
      << "ReceiveTimeoutMs=" << receive_timeout_ms_ << ", "
      << "ThriftCompressionMethod=" << thrift_compression_method_ << ", "
      << "TargetServerAddress=" << target_server_address_ << ", "
-     << "ReadMode=" << read_mode_ << "}";
+     << "ReadMode=" << read_mode_ << ", "
+     << "MaxStalenessMs=" << max_staleness_ms_ << ", "
+     << "ClientId=" << client_id_ << "}";
 }
 
 std::ostream& operator<<(std::ostream& os, const ClientOption& value) {
@@ -124,6 +126,8 @@ const folly::dynamic ClientOption::serialize() const {
   result.insert("ThriftCompressionMethod", thrift_compression_method_);
   folly::dynamic read_mode = serializeClientRequestReadMode(read_mode_);
   result.insert("ReadMode", read_mode);
+  result.insert("MaxStalenessMs", max_staleness_ms_);
+  result.insert("ClientId", client_id_);
 
   return result;
 }
@@ -178,6 +182,15 @@ bool ClientOption::deserialize(const folly::dynamic& data) {
     return false;
   }
   setReadMode(itemread_mode);
+  // 旧版本的配置中没有该字段，不限制读取延迟
+  auto* max_staleness_ms = data.get_ptr("MaxStalenessMs");
+  if (max_staleness_ms != nullptr && max_staleness_ms->isInt()) {
+    setMaxStalenessMs(max_staleness_ms->asInt());
+  }
+  auto* client_id = data.get_ptr("ClientId");
+  if (client_id != nullptr && client_id->isString()) {
+    setClientId(client_id->asString());
+  }
 
   return true;
 }
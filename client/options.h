@@ -76,6 +76,16 @@ class ClientOption {
 
   void setReadMode(const ClientRequestReadMode& read_mode) { read_mode_ = read_mode; }
 
+  // 读取 follower 时允许的最大数据延迟，超过时读取 leader，0 表示不限制
+  int64_t getMaxStalenessMs() const { return max_staleness_ms_; }
+
+  void setMaxStalenessMs(int64_t max_staleness_ms) { max_staleness_ms_ = max_staleness_ms; }
+
+  // 服务端按 client id 匹配表上配置的令牌桶，为空时只受不区分客户端的令牌桶限制
+  const std::string& getClientId() const { return client_id_; }
+
+  void setClientId(const std::string& client_id) { client_id_ = client_id; }
+
   const service_router::ServerAddress& getTargetServerAddress() const {
     return target_server_address_;
   }
@@ -98,6 +108,8 @@ class ClientOption {
   uint32_t receive_timeout_ms_{0};
   uint16_t thrift_compression_method_{3};
   ClientRequestReadMode read_mode_{ClientRequestReadMode::MIXED_READ};
+  int64_t max_staleness_ms_{0};
+  std::string client_id_;
   service_router::ServerAddress target_server_address_;
 };
 
@@ -49,16 +49,16 @@ void ConfigManager::updateConfig(const std::unordered_map<std::string, std::stri
   initOverwriteConfig(configs, group_name, node_id, config_from_service_router);
 
   if (notify_rocksdb_config_update_) {
+    auto table_schemas = table_schemas_.load();
     folly::synchronized(
-        [&](auto node_config, auto table_config_list, auto table_schemas) {
+        [&](auto node_config, auto table_config_list) {
           notify_rocksdb_config_update_(*node_config, **table_config_list, *table_schemas);
         },
-        folly::rlock(node_config_), folly::rlock(table_config_list_), folly::rlock(table_schemas_));
+        folly::rlock(node_config_), folly::rlock(table_config_list_));
   }
 
   if (notify_traffic_restriction_update_) {
-    traffic_restriction_config_.withRLock(
-        [this](auto& traffic_restriction_config) { notify_traffic_restriction_update_(traffic_restriction_config); });
+    notify_traffic_restriction_update_(*traffic_restriction_config_.load());
   }
   upateDatabaseAndCluster();
 }
@@ -101,49 +101,37 @@ void ConfigManager::initOverwriteConfig(const std::unordered_map<std::string, st
 
 folly::Optional<std::shared_ptr<TableSchema>> ConfigManager::getTableSchema(const std::string& database_name,
                                                                             const std::string& table_name) {
-  std::shared_ptr<TableSchema> table_schema;
-  bool has_table = table_schemas_.withRLock([this, &table_name, &database_name, &table_schema](auto& table_schemas) {
-    uint64_t key = getTableSchemaHash(database_name, table_name);
-    if (table_schemas.find(key) != table_schemas.end()) {
-      table_schema = table_schemas.at(key);
-      return true;
-    }
-    return false;
-  });
-
-  if (has_table) {
-    return table_schema;
+  auto table_schemas = table_schemas_.load();
+  auto found = table_schemas->find(getTableSchemaHash(database_name, table_name));
+  if (found != table_schemas->end()) {
+    return found->second;
   }
   return folly::none;
 }
 
 std::shared_ptr<TableSchemasMap> ConfigManager::getTableSchemas() const {
-  std::shared_ptr<TableSchemasMap> new_table_schemas = nullptr;
-  table_schemas_.withRLock([this, &new_table_schemas](auto& table_schemas) {
-    if (table_schemas.empty()) {
-      return;
-    }
-    new_table_schemas = std::make_shared<TableSchemasMap>();
-    for (auto& schema : table_schemas) {
-      auto new_schema = std::make_shared<TableSchema>(*schema.second);
-      new_table_schemas->insert(std::make_pair(schema.first, new_schema));
-    }
-  });
+  auto table_schemas = table_schemas_.load();
+  if (table_schemas->empty()) {
+    return nullptr;
+  }
+  auto new_table_schemas = std::make_shared<TableSchemasMap>();
+  for (auto& schema : *table_schemas) {
+    auto new_schema = std::make_shared<TableSchema>(*schema.second);
+    new_table_schemas->insert(std::make_pair(schema.first, new_schema));
+  }
   return new_table_schemas;
 }
 
 std::shared_ptr<TableTrafficRestrictionMap> ConfigManager::getTrafficRestrictionConfig() {
-  std::shared_ptr<TableTrafficRestrictionMap> temp_restriction = nullptr;
-  traffic_restriction_config_.withRLock([&temp_restriction](auto& traffic_restriction) {
-    if (traffic_restriction.empty()) {
-      return;
-    }
-    temp_restriction = std::make_shared<TableTrafficRestrictionMap>();
-    for (auto& iter : traffic_restriction) {
-      auto table_traffic_restriction = std::make_shared<TableTrafficRestrictionConfig>(*iter.second);
-      temp_restriction->insert(std::make_pair(iter.first, table_traffic_restriction));
-    }
-  });
+  auto traffic_restriction = traffic_restriction_config_.load();
+  if (traffic_restriction->empty()) {
+    return nullptr;
+  }
+  auto temp_restriction = std::make_shared<TableTrafficRestrictionMap>();
+  for (auto& iter : *traffic_restriction) {
+    auto table_traffic_restriction = std::make_shared<TableTrafficRestrictionConfig>(*iter.second);
+    temp_restriction->insert(std::make_pair(iter.first, table_traffic_restriction));
+  }
   return temp_restriction;
 }
 
@@ -191,19 +179,18 @@ void ConfigManager::updateDatabase(const std::string& value) {
     database_schemas.push_back(database_schema);
   }
 
-  table_schemas_.withWLock([&database_schemas, this](auto& table_schemas) {
-    // node 或者 group 级别会覆盖所有的表信息
-    table_schemas.clear();
-    for (auto& database : database_schemas) {
-      auto tables = database.getTables();
-      for (auto& table : tables) {
-        uint64_t key = getTableSchemaHash(database.getDatabaseName(), table.getTableName());
-        VLOG(5) << "Add database:" << database.getDatabaseName() << " table:" << table.getTableName();
-        table.setDatabaseName(database.getDatabaseName());
-        table_schemas[key] = std::make_shared<TableSchema>(table);
-      }
+  // node 或者 group 级别会覆盖所有的表信息，构建新版本后整体替换
+  auto table_schemas = std::make_shared<TableSchemasMap>();
+  for (auto& database : database_schemas) {
+    auto tables = database.getTables();
+    for (auto& table : tables) {
+      uint64_t key = getTableSchemaHash(database.getDatabaseName(), table.getTableName());
+      VLOG(5) << "Add database:" << database.getDatabaseName() << " table:" << table.getTableName();
+      table.setDatabaseName(database.getDatabaseName());
+      (*table_schemas)[key] = std::make_shared<TableSchema>(table);
     }
-  });
+  }
+  table_schemas_.store(table_schemas);
 }
 
 void ConfigManager::updateClusterInfo(const std::string& value, const std::string& group_name, const uint32_t node_id) {
@@ -325,16 +312,15 @@ void ConfigManager::updateTrafficRestrictionConfig(const std::string& traffic_re
     db_traffic_restrictions.emplace_back(db_restriction_config);
   }
 
-  traffic_restriction_config_.withWLock([&db_traffic_restrictions, this](auto& traffic_restrictions) {
-    traffic_restrictions.clear();
-    for (auto& db_restriction : db_traffic_restrictions) {
-      auto table_restrictions = db_restriction.getTables();
-      for (auto& table_restriction : table_restrictions) {
-        uint64_t key = getTableSchemaHash(db_restriction.getDatabaseName(), table_restriction.getTableName());
-        traffic_restrictions[key] = std::make_shared<TableTrafficRestrictionConfig>(table_restriction);
-      }
+  auto traffic_restrictions = std::make_shared<TableTrafficRestrictionMap>();
+  for (auto& db_restriction : db_traffic_restrictions) {
+    auto table_restrictions = db_restriction.getTables();
+    for (auto& table_restriction : table_restrictions) {
+      uint64_t key = getTableSchemaHash(db_restriction.getDatabaseName(), table_restriction.getTableName());
+      (*traffic_restrictions)[key] = std::make_shared<TableTrafficRestrictionConfig>(table_restriction);
     }
-  });
+  }
+  traffic_restriction_config_.store(traffic_restrictions);
 }
 
 uint64_t ConfigManager::getTableSchemaHash(const std::string& database_name, const std::string& table_name) {
@@ -347,9 +333,8 @@ uint64_t ConfigManager::getNodeListHash(const std::string& group_name, uint32_t
 }
 
 void ConfigManager::upateDatabaseAndCluster() {
-  auto ret = folly::acquireLocked(table_schemas_, update_subscribers_);
-  auto& table_schemas = std::get<0>(ret);
-  auto& subscribes = std::get<1>(ret);
+  auto table_schemas = table_schemas_.load();
+  auto subscribes = update_subscribers_.wlock();
 
   if (!cluster_info_) {
     LOG(ERROR) << "Cluster info not exists, need wait sync cluster info.";
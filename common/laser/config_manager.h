@@ -22,10 +22,14 @@
 
 #include "common/service_router/router.h"
 #include "folly/Synchronized.h"
+#include "folly/concurrency/AtomicSharedPtr.h"
 #include "laser_entity.h"
 
 namespace laser {
 
+// 客户端通过 thrift header 携带 client id，服务端按 client id 匹配表上的令牌桶
+constexpr char LASER_CLIENT_ID_HEADER[] = "laser_client_id";
+
 using TableSchemasMap = std::unordered_map<uint64_t, std::shared_ptr<TableSchema>>;
 using TableTrafficRestrictionMap = std::unordered_map<uint64_t, std::shared_ptr<TableTrafficRestrictionConfig>>;
 using NotifyDatabaseAndClusterUpdate =
@@ -38,8 +42,10 @@ class ConfigManager {
  public:
   explicit ConfigManager(const std::shared_ptr<service_router::Router> router)
       : router_(router),
+        table_schemas_(std::make_shared<TableSchemasMap>()),
         node_config_(nullptr),
         table_config_list_(std::make_shared<TableConfigList>()),
+        traffic_restriction_config_(std::make_shared<TableTrafficRestrictionMap>()),
         use_manually_set_config_(false),
         is_edge_node_(false) {}
   virtual ~ConfigManager() = default;
@@ -51,11 +57,6 @@ class ConfigManager {
 
   virtual folly::Optional<NodeShardList> getNodeShardList(const std::string& group_name, uint32_t node_id);
 
-  // deprecated, use getTableSchemas instead
-  virtual inline folly::Synchronized<std::unordered_map<uint64_t, std::shared_ptr<TableSchema>>> getAllTableSchemas() {
-    return table_schemas_;
-  }
-
   virtual inline folly::Optional<uint32_t> getShardNumber() {
     if (cluster_info_) {
       return cluster_info_->getShardNumber();
@@ -112,12 +113,13 @@ class ConfigManager {
 
  private:
   std::weak_ptr<service_router::Router> router_;
-  folly::Synchronized<TableSchemasMap> table_schemas_;
+  // 表信息和限流配置按版本整体发布，读取时不加锁，发布后的 map 不再修改
+  folly::atomic_shared_ptr<TableSchemasMap> table_schemas_;
   std::shared_ptr<ClusterInfo> cluster_info_;
   folly::Synchronized<std::unordered_map<uint64_t, NodeShardList>> node_shard_lists_;
   folly::Synchronized<std::shared_ptr<NodeConfig>> node_config_;
   folly::Synchronized<std::shared_ptr<TableConfigList>> table_config_list_;
-  folly::Synchronized<TableTrafficRestrictionMap> traffic_restriction_config_;
+  folly::atomic_shared_ptr<TableTrafficRestrictionMap> traffic_restriction_config_;
   folly::Synchronized<std::unordered_map<std::string, DataCenter>> dcs_;
   std::atomic_bool use_manually_set_config_;
   std::atomic_bool is_edge_node_;
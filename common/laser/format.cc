@@ -43,6 +43,12 @@ static const KeyType intToKeyType(uint8_t type) {
   switch (type) {
     case 2:
       return KeyType::COMPOSITE;
+    case 3:
+      return KeyType::TTL_SORT;
+    case 4:
+      return KeyType::ZSET_MEMBER;
+    case 5:
+      return KeyType::DEAD_VERSION;
     default:
       return KeyType::DEFAULT;
   }
@@ -91,6 +97,15 @@ bool LaserSerializer::unpackString(std::string* result) {
 
 void LaserKeyFormatBase::encode() {
   clear();
+  // 预先计算编码长度，一次分配好 buffer
+  size_t encoded_size = sizeof(uint8_t) + sizeof(uint32_t) * 2;
+  for (auto& t : primary_keys_) {
+    encoded_size += sizeof(uint32_t) + t.size();
+  }
+  for (auto& t : columns_) {
+    encoded_size += sizeof(uint32_t) + t.size();
+  }
+  getRawBuffer()->reserve(encoded_size);
   packInt<uint8_t>(static_cast<uint8_t>(key_type_));
   packInt<uint32_t>(static_cast<uint32_t>(primary_keys_.size()));
   for (auto& t : primary_keys_) {
@@ -138,7 +153,7 @@ bool LaserKeyFormatBase::decode() {
 void LaserKeyFormatTtl::encode() {
   clear();
   packInt<uint8_t>(static_cast<uint8_t>(key_type_));
-  packString(folly::to<std::string>(timestamp_));
+  packInt<uint64_t>(timestamp_, false);
   packString(key_.data(), key_.length());
 }
 
@@ -149,18 +164,10 @@ bool LaserKeyFormatTtl::decode() {
     return false;
   }
 
-  std::string timestamp_str;
-  if (!unpackString(&timestamp_str)) {
+  if (!unpackInt<uint64_t>(&timestamp_, false)) {
     return false;
   }
 
-  if (!timestamp_str.empty()) {
-    auto timestamp_opt = folly::tryTo<uint64_t>(timestamp_str);
-    if (timestamp_opt.hasValue()) {
-      timestamp_ = timestamp_opt.value();
-    }
-  }
-
   std::string key;
   if (!unpackString(&key)) {
     return false;
@@ -180,8 +187,14 @@ LaserValueFormatBase::LaserValueFormatBase(const ValueType& type, uint64_t times
 
 void LaserValueFormatBase::encode() {
   clear();
-  packInt<uint8_t>(static_cast<uint8_t>(type_));
+  if (version_ == 0) {
+    packInt<uint8_t>(static_cast<uint8_t>(type_));
+    packInt<uint64_t>(timestamp_);
+    return;
+  }
+  packInt<uint8_t>(static_cast<uint8_t>(type_) | VALUE_VERSION_FLAG);
   packInt<uint64_t>(timestamp_);
+  packInt<uint64_t>(version_);
 }
 
 bool LaserValueFormatBase::decode() {
@@ -190,10 +203,14 @@ bool LaserValueFormatBase::decode() {
   if (!unpackInt<uint8_t>(&int_type)) {
     return false;
   }
-  type_ = intToValueType(int_type);
+  type_ = intToValueType(int_type & ~VALUE_VERSION_FLAG);
   if (!unpackInt<uint64_t>(&timestamp_)) {
     return false;
   }
+  version_ = 0;
+  if ((int_type & VALUE_VERSION_FLAG) && !unpackInt<uint64_t>(&version_)) {
+    return false;
+  }
   return true;
 }
 
@@ -219,4 +236,45 @@ bool LaserValueRawString::decode() {
   return true;
 }
 
+void LaserMergeOperand::encode() {
+  clear();
+  packInt<uint8_t>(static_cast<uint8_t>(type_));
+  packInt<uint64_t>(write_time_);
+  packInt<uint64_t>(timestamp_);
+  if (type_ == MergeOperandType::COUNTER_ADD) {
+    packInt<int64_t>(step_);
+  } else {
+    packString(data_);
+  }
+}
+
+bool LaserMergeOperand::decode() {
+  resetOffset();
+  uint8_t type_int = 0;
+  if (!unpackInt<uint8_t>(&type_int)) {
+    return false;
+  }
+  if (type_int == static_cast<uint8_t>(MergeOperandType::COUNTER_ADD)) {
+    type_ = MergeOperandType::COUNTER_ADD;
+  } else if (type_int == static_cast<uint8_t>(MergeOperandType::APPEND)) {
+    type_ = MergeOperandType::APPEND;
+  } else {
+    return false;
+  }
+
+  if (!unpackInt<uint64_t>(&write_time_) || !unpackInt<uint64_t>(&timestamp_)) {
+    return false;
+  }
+  if (type_ == MergeOperandType::COUNTER_ADD) {
+    return unpackInt<int64_t>(&step_);
+  }
+
+  // 空字符串不会写入长度
+  data_.clear();
+  if (getOffset() == length()) {
+    return true;
+  }
+  return unpackString(&data_);
+}
+
 }  // namespace laser
@@ -29,6 +29,9 @@ enum class KeyType {
   DEFAULT = 1,
   COMPOSITE = 2,
   TTL_SORT = 3,
+  ZSET_MEMBER = 4,
+  // 已删除的复合类型 meta 的版本号，data 行回收完成前重新创建 key 时新版本号从这里递增
+  DEAD_VERSION = 5,
 };
 
 class LaserSerializer {
@@ -42,6 +45,7 @@ class LaserSerializer {
   inline size_t length() const { return raw_data_.length(); }
   virtual inline void clear() { raw_data_.clear(); }
   virtual inline void resetOffset() { offset_ = 0; }
+  inline uint32_t getOffset() const { return offset_; }
   virtual inline void reset() {
     clear();
     resetOffset();
@@ -106,6 +110,9 @@ class LaserKeyFormatBase : public LaserSerializer {
   LaserKeyFormatBase(const std::vector<std::string>& primary_keys, const std::vector<std::string>& columns,
                      const KeyType& key_type)
       : primary_keys_(primary_keys), columns_(columns), key_type_(key_type) {}
+  LaserKeyFormatBase(std::vector<std::string>&& primary_keys, std::vector<std::string>&& columns,
+                     const KeyType& key_type)
+      : primary_keys_(std::move(primary_keys)), columns_(std::move(columns)), key_type_(key_type) {}
   LaserKeyFormatBase(const LaserKeyFormatBase& key, const KeyType& key_type)
       : primary_keys_(key.getPrimaryKeys()), columns_(key.getColumnFamilies()), key_type_(key_type) {}
 
@@ -137,6 +144,11 @@ class LaserKeyFormat : public LaserKeyFormatBase {
       : LaserKeyFormatBase(primary_keys, columns, KeyType::DEFAULT) {
     encode();
   }
+  // 请求对象由调用方持有时直接接管 key 的内容，避免逐个复制字符串
+  LaserKeyFormat(std::vector<std::string>&& primary_keys, std::vector<std::string>&& columns)
+      : LaserKeyFormatBase(std::move(primary_keys), std::move(columns), KeyType::DEFAULT) {
+    encode();
+  }
   LaserKeyFormat(const LaserKeyFormatBase& key, const KeyType& type) : LaserKeyFormatBase(key, type) { encode(); }
   ~LaserKeyFormat() = default;
 };
@@ -207,13 +219,43 @@ class LaserKeyFormatZSetData : public LaserKeyFormatBase {
   folly::Optional<int64_t> score_{0};
 };
 
+// zset member -> score 的反查索引，与 score 数据 key 使用不同的 key type，避免混入按 score 的范围扫描
+class LaserKeyFormatZSetMember : public LaserKeyFormatBase {
+ public:
+  LaserKeyFormatZSetMember() {}
+  LaserKeyFormatZSetMember(const char* buffer, size_t length) : LaserKeyFormatBase(buffer, length) {}
+  LaserKeyFormatZSetMember(const LaserKeyFormatBase& key, const std::string& member)
+      : LaserKeyFormatBase(key, KeyType::ZSET_MEMBER), member_(member) {
+    encode();
+  }
+  explicit LaserKeyFormatZSetMember(const LaserKeyFormatBase& key) : LaserKeyFormatZSetMember(key, "") {}
+
+  ~LaserKeyFormatZSetMember() = default;
+  inline bool decode() override {
+    if (!LaserKeyFormatBase::decode()) {
+      return false;
+    }
+    unpackString(&member_);
+    return true;
+  }
+  inline void encode() override {
+    LaserKeyFormatBase::encode();
+    packString(member_);
+  }
+  inline const std::string& getMember() const { return member_; }
+
+ private:
+  std::string member_;
+};
+
+// 过期时间索引，timestamp 使用大端编码保证按过期时间有序，key 为空时可以作为扫描的边界
 class LaserKeyFormatTtl : public LaserSerializer {
  public:
   LaserKeyFormatTtl() {}
   LaserKeyFormatTtl(const char* buffer, size_t length) : LaserSerializer(buffer, length) {}
   LaserKeyFormatTtl(const LaserKeyFormat& key, uint64_t timestamp) : key_(key), timestamp_(timestamp) { encode(); }
 
-  inline const LaserKeyFormatBase& getKey() const { return key_; }
+  inline const LaserKeyFormat& getKey() const { return key_; }
   inline uint64_t getTimestamp() const { return timestamp_; }
   virtual bool decode();
   virtual void encode();
@@ -298,6 +340,9 @@ enum class ValueType {
   ZSET = 6
 };
 
+// type 字节的最高位表示 value 中带有复合类型的数据版本号，没有该标记的历史数据版本号为 0
+constexpr uint8_t VALUE_VERSION_FLAG = 0x80;
+
 class LaserValueFormatBase : public LaserSerializer {
  public:
   LaserValueFormatBase() {}
@@ -306,6 +351,9 @@ class LaserValueFormatBase : public LaserSerializer {
   inline const ValueType& getType() const { return type_; }
   inline uint64_t getTimestamp() const { return timestamp_; }
   inline void setTimestamp(uint64_t timestamp) { timestamp_ = timestamp; }
+  // 复合类型 meta 的版本号，data 行只有版本号与 meta 一致时才有效
+  inline uint64_t getVersion() const { return version_; }
+  inline void setVersion(uint64_t version) { version_ = version; }
   virtual ~LaserValueFormatBase() = default;
   virtual bool decode();
   virtual void encode();
@@ -315,6 +363,7 @@ class LaserValueFormatBase : public LaserSerializer {
  private:
   ValueType type_;
   uint64_t timestamp_;
+  uint64_t version_{0};
 };
 
 class LaserValueRawString : public LaserValueFormatBase {
@@ -415,6 +464,35 @@ class LaserValueZSet : public LaserValueFormatBase {
   std::vector<std::string> members_;
 };
 
+class LaserValueZSetScore : public LaserValueFormatBase {
+ public:
+  LaserValueZSetScore() : LaserValueFormatBase(ValueType::ZSET) {}
+  LaserValueZSetScore(const char* buffer, size_t length) : LaserValueFormatBase(buffer, length) {}
+  explicit LaserValueZSetScore(int64_t score) : LaserValueFormatBase(ValueType::ZSET), score_(score) { encode(); }
+  inline int64_t getScore() const { return score_; }
+
+  inline bool decode() override {
+    if (!LaserValueFormatBase::decode()) {
+      return false;
+    }
+    if (getType() != ValueType::ZSET) {
+      return false;
+    }
+    if (!unpackInt<int64_t>(&score_)) {
+      return false;
+    }
+    return true;
+  }
+
+  inline void encode() override {
+    LaserValueFormatBase::encode();
+    packInt<int64_t>(score_);
+  }
+
+ private:
+  int64_t score_{0};
+};
+
 class LaserValueMapMeta : public LaserValueFormatBase {
  public:
   LaserValueMapMeta() : LaserValueFormatBase(ValueType::MAP) {}
@@ -543,6 +621,7 @@ class LaserValueZSetMeta : public LaserValueFormatBase {
   LaserValueZSetMeta(const char* buffer, size_t length) : LaserValueFormatBase(buffer, length) {}
   explicit LaserValueZSetMeta(uint32_t size) : LaserValueFormatBase(ValueType::ZSET), size_(size) { encode(); }
   inline uint32_t getSize() const { return size_; }
+  inline void setSize(uint32_t size) { size_ = size; }
   inline void incrSize() { size_++; }
   inline void decrSize() { size_--; }
 
@@ -569,4 +648,41 @@ class LaserValueZSetMeta : public LaserValueFormatBase {
   uint32_t size_{0};
 };
 
+enum class MergeOperandType {
+  COUNTER_ADD = 1,
+  APPEND = 2,
+};
+
+// merge 写入的操作数，write_time 为写入时间，用于判断合并时原有的值是否已经过期，
+// timestamp 为合并后 value 的过期时间
+class LaserMergeOperand : public LaserSerializer {
+ public:
+  LaserMergeOperand() {}
+  LaserMergeOperand(const char* buffer, size_t length) : LaserSerializer(buffer, length) {}
+  LaserMergeOperand(int64_t step, uint64_t write_time, uint64_t timestamp)
+      : type_(MergeOperandType::COUNTER_ADD), write_time_(write_time), timestamp_(timestamp), step_(step) {
+    encode();
+  }
+  LaserMergeOperand(const std::string& data, uint64_t write_time, uint64_t timestamp)
+      : type_(MergeOperandType::APPEND), write_time_(write_time), timestamp_(timestamp), data_(data) {
+    encode();
+  }
+  virtual ~LaserMergeOperand() = default;
+
+  inline const MergeOperandType& getType() const { return type_; }
+  inline uint64_t getWriteTime() const { return write_time_; }
+  inline uint64_t getTimestamp() const { return timestamp_; }
+  inline int64_t getStep() const { return step_; }
+  inline const std::string& getData() const { return data_; }
+  virtual bool decode();
+  virtual void encode();
+
+ private:
+  MergeOperandType type_{MergeOperandType::COUNTER_ADD};
+  uint64_t write_time_{0};
+  uint64_t timestamp_{0};
+  int64_t step_{0};
+  std::string data_;
+};
+
 }  // namespace laser
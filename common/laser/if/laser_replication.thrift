@@ -26,6 +26,12 @@ enum ReplicateType {
   REVERSE = 1,
 }
 
+enum ReplicateCompressionType {
+  NONE = 0,
+  LZ4 = 1,
+  ZSTD = 2,
+}
+
 struct ReplicateRequest {
   # 当前本地最大的 seq 号，将要同步更新 seq_no + 1 以后的数据
   1: required i64 seq_no,
@@ -54,6 +60,15 @@ struct ReplicateRequest {
 
   9: required ReplicateType type, 
   10:required i64 timestamp,
+
+  # 流式同步时 follower 给出的额度，leader 最多推送这么多个 response 后结束 stream
+  11: optional i32 stream_credits,
+
+  # follower 可以接受的压缩方式，不设置表示不压缩
+  12: optional ReplicateCompressionType compression,
+
+  # follower 已经写入的最大 seq 号，提前发起的 pull 中 seq_no 可能还没有写入，leader 据此确认半同步写入
+  13: optional i64 ack_seq_no,
 }
 
 typedef binary (cpp.type = "folly::IOBuf") IOBuf
@@ -72,6 +87,41 @@ struct ReplicateResponse {
   # 下次 pull 应该起始的 seq no
   4: required i64 next_seq_no,
   5: optional i64 timestamp,
+
+  # 设置了压缩方式时 updates 为空，所有 update 压缩后放在 compressed_updates 中
+  6: optional ReplicateCompressionType compression,
+  7: optional IOBuf compressed_updates,
+  8: optional i64 uncompressed_size,
+
+  # leader 上有等待半同步确认的写入，流式同步的 follower 写入后需要通过 replicateAck 上报进度
+  9: optional bool need_ack,
+}
+
+# 同一对节点之间所有 partition 的同步请求合并为一个 RPC
+struct BatchReplicateRequest {
+  1: required list<ReplicateRequest> requests,
+
+  # 所有 partition 都没有更新时最多等待的时间
+  2: required i32 max_wait_ms,
+
+  # 所有 partition 的更新总大小上限，如果为 0 表示不限制
+  3: required i64 max_size,
+  4: required i64 timestamp,
+}
+
+# 没有更新的 partition 在 leader 上的状态，follower 据此刷新同步延迟
+struct IdleReplicateState {
+  1: required i64 max_seq_no,
+  # leader 确认没有更新时的时间
+  2: required i64 timestamp,
+}
+
+struct BatchReplicateResponse {
+  # 只包含有更新的 partition，key 为 db_hash
+  1: required map<i64, ReplicateResponse> responses,
+  2: required map<i64, laser.LaserException> exceptions,
+  # 已经检查过没有更新的 partition，key 为 db_hash
+  3: optional map<i64, IdleReplicateState> idle_states,
 }
 
 struct ReplicateWdtRequest {
@@ -90,4 +140,11 @@ service Replicator {
       throws (1:laser.LaserException e)
   ReplicateWdtResponse replicateWdt(1:ReplicateWdtRequest request)
       throws (1:laser.LaserException e)
+  BatchReplicateResponse replicateBatch(1:BatchReplicateRequest request)
+      throws (1:laser.LaserException e)
+  # leader 在有新的写入时主动推送更新，follower 处理完才会补充传输层的 credit
+  stream<ReplicateResponse throws (1:laser.LaserException e)> replicateStream(1:ReplicateRequest request)
+      throws (1:laser.LaserException e)
+  # 流式同步过程中 follower 上报已经写入的 ack_seq_no
+  oneway void replicateAck(1:ReplicateRequest request)
 }
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#include <cstring>
+
+#include "folly/lang/Bits.h"
+
+#include "format.h"
+#include "key_prefix_extractor.h"
+
+namespace laser {
+
+namespace {
+
+bool readUint32(uint32_t* value, size_t* offset, const rocksdb::Slice& key) {
+  if (key.size() < *offset + sizeof(uint32_t)) {
+    return false;
+  }
+  uint32_t result = 0;
+  memcpy(&result, key.data() + *offset, sizeof(uint32_t));
+  *value = folly::Endian::little(result);
+  *offset += sizeof(uint32_t);
+  return true;
+}
+
+bool skipStrings(size_t* offset, const rocksdb::Slice& key) {
+  uint32_t number = 0;
+  if (!readUint32(&number, offset, key)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < number; i++) {
+    uint32_t size = 0;
+    if (!readUint32(&size, offset, key) || key.size() < *offset + size) {
+      return false;
+    }
+    *offset += size;
+  }
+  return true;
+}
+
+}  // namespace
+
+const char* LaserKeyPrefixExtractor::Name() const { return "laser.KeyPrefixExtractor"; }
+
+size_t LaserKeyPrefixExtractor::getPrefixLength(const rocksdb::Slice& key) {
+  if (key.empty()) {
+    return 0;
+  }
+  // 与 LaserKeyFormatBase::encode 的格式保持一致
+  uint8_t type = static_cast<uint8_t>(key[0]);
+  if (type != static_cast<uint8_t>(KeyType::DEFAULT) && type != static_cast<uint8_t>(KeyType::COMPOSITE) &&
+      type != static_cast<uint8_t>(KeyType::ZSET_MEMBER)) {
+    return 0;
+  }
+
+  size_t offset = sizeof(uint8_t);
+  if (!skipStrings(&offset, key) || !skipStrings(&offset, key)) {
+    return 0;
+  }
+  return offset;
+}
+
+rocksdb::Slice LaserKeyPrefixExtractor::Transform(const rocksdb::Slice& key) const {
+  size_t length = getPrefixLength(key);
+  if (length == 0) {
+    return key;
+  }
+  return rocksdb::Slice(key.data(), length);
+}
+
+bool LaserKeyPrefixExtractor::InDomain(const rocksdb::Slice& key) const { return getPrefixLength(key) != 0; }
+
+}  // namespace laser
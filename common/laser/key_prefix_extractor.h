@@ -0,0 +1,42 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#pragma once
+
+#include "rocksdb/slice.h"
+#include "rocksdb/slice_transform.h"
+
+namespace laser {
+
+// 提取 key 中 [类型 + primary keys + columns] 部分作为前缀。前缀包含 key 类型，meta 行 (DEFAULT) 和 data 行
+// (COMPOSITE、ZSET_MEMBER) 的前缀不同；同一个复合 key 的同类 data 行共享一个前缀，遍历 data 行时配合 prefix bloom
+// 可以跳过不包含该 key 的 sst。TTL 索引等需要跨前缀有序扫描的 key 不在前缀域内
+class LaserKeyPrefixExtractor : public rocksdb::SliceTransform {
+ public:
+  LaserKeyPrefixExtractor() = default;
+  ~LaserKeyPrefixExtractor() = default;
+
+  const char* Name() const override;
+  rocksdb::Slice Transform(const rocksdb::Slice& key) const override;
+  bool InDomain(const rocksdb::Slice& key) const override;
+
+  // 返回 key 中前缀的长度，key 无法解析时返回 0
+  static size_t getPrefixLength(const rocksdb::Slice& key);
+};
+
+}  // namespace laser
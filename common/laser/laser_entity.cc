@@ -319,6 +319,9 @@ void TableConfig::describe(std::ostream& os) const {
   }
   os << "}"
      << ", " << "Version=" << version_
+     << ", " << "RowCacheCapacity=" << row_cache_capacity_
+     << ", " << "PrefixExtractor=" << prefix_extractor_
+     << ", " << "SyncReplicas=" << sync_replicas_
      << "}";
 }
 
@@ -346,6 +349,9 @@ const folly::dynamic TableConfig::serialize() const {
   }
   result.insert("TableOptions", table_options);
   result.insert("Version", version_);
+  result.insert("RowCacheCapacity", row_cache_capacity_);
+  result.insert("PrefixExtractor", prefix_extractor_);
+  result.insert("SyncReplicas", sync_replicas_);
 
   return result;
 }
@@ -411,6 +417,18 @@ bool TableConfig::deserialize(const folly::dynamic& data) {
     return false;
   }
   setVersion(version->asInt());
+  auto* row_cache_capacity = data.get_ptr("RowCacheCapacity");
+  if (row_cache_capacity && row_cache_capacity->isInt()) {
+    setRowCacheCapacity(row_cache_capacity->asInt());
+  }
+  auto* prefix_extractor = data.get_ptr("PrefixExtractor");
+  if (prefix_extractor && prefix_extractor->isBool()) {
+    setPrefixExtractor(prefix_extractor->asBool());
+  }
+  auto* sync_replicas = data.get_ptr("SyncReplicas");
+  if (sync_replicas && sync_replicas->isInt()) {
+    setSyncReplicas(sync_replicas->asInt());
+  }
 
   return true;
 }
@@ -888,6 +906,105 @@ bool TrafficRestrictionLimitItem::deserialize(const folly::dynamic& data) {
   return true;
 }
 
+std::ostream& operator<<(std::ostream& os, const TrafficOperationType& value) {
+  os << static_cast<int>(value);
+  return os;
+}
+
+folly::dynamic serializeTrafficOperationType(const TrafficOperationType& value) {
+  folly::dynamic result = static_cast<int>(value);
+  return result;
+}
+
+bool deserializeTrafficOperationType(const folly::dynamic& data, TrafficOperationType* result) {
+  if (!data.isInt()) {
+    return false;
+  }
+
+  int value = data.asInt();
+  switch(value) {
+    case 0:
+      *result = TrafficOperationType::READ;
+      break;
+    case 1:
+      *result = TrafficOperationType::WRITE;
+      break;
+    default:
+      return false;
+  }
+
+  return true;
+}
+
+void TrafficTokenBucketConfig::describe(std::ostream& os) const {
+  os << "TrafficTokenBucketConfig{"
+     << "OperationType=" << operation_type_
+     << ", " << "ClientId='" << client_id_ << "'"
+     << ", " << "KeysPerSecond=" << keys_per_second_
+     << ", " << "KeysBurst=" << keys_burst_
+     << ", " << "BytesPerSecond=" << bytes_per_second_
+     << ", " << "BytesBurst=" << bytes_burst_
+     << "}";
+}
+
+std::ostream& operator<<(std::ostream& os, const TrafficTokenBucketConfig& value) {
+  value.describe(os);
+  return os;
+}
+
+const folly::dynamic TrafficTokenBucketConfig::serialize() const {
+  folly::dynamic result = folly::dynamic::object;
+
+  folly::dynamic operation_type = serializeTrafficOperationType(operation_type_);
+  result.insert("OperationType", operation_type);
+  result.insert("ClientId", client_id_);
+  result.insert("KeysPerSecond", keys_per_second_);
+  result.insert("KeysBurst", keys_burst_);
+  result.insert("BytesPerSecond", bytes_per_second_);
+  result.insert("BytesBurst", bytes_burst_);
+
+  return result;
+}
+
+bool TrafficTokenBucketConfig::deserialize(const folly::dynamic& data) {
+  if (!data.isObject()) {
+    return false;
+  }
+
+  auto* operation_type = data.get_ptr("OperationType");
+  if (operation_type == nullptr) {
+    return false;
+  }
+
+  TrafficOperationType itemoperation_type;
+  if (!deserializeTrafficOperationType(*operation_type, &itemoperation_type)) {
+    return false;
+  }
+  setOperationType(itemoperation_type);
+  auto* client_id = data.get_ptr("ClientId");
+  if (client_id && client_id->isString()) {
+    setClientId(client_id->asString());
+  }
+  auto* keys_per_second = data.get_ptr("KeysPerSecond");
+  if (keys_per_second && keys_per_second->isInt()) {
+    setKeysPerSecond(keys_per_second->asInt());
+  }
+  auto* keys_burst = data.get_ptr("KeysBurst");
+  if (keys_burst && keys_burst->isInt()) {
+    setKeysBurst(keys_burst->asInt());
+  }
+  auto* bytes_per_second = data.get_ptr("BytesPerSecond");
+  if (bytes_per_second && bytes_per_second->isInt()) {
+    setBytesPerSecond(bytes_per_second->asInt());
+  }
+  auto* bytes_burst = data.get_ptr("BytesBurst");
+  if (bytes_burst && bytes_burst->isInt()) {
+    setBytesBurst(bytes_burst->asInt());
+  }
+
+  return true;
+}
+
 void TableTrafficRestrictionConfig::describe(std::ostream& os) const {
   os << "TableTrafficRestrictionConfig{"
      << "TableName='" << table_name_ << "'"
@@ -902,6 +1019,11 @@ void TableTrafficRestrictionConfig::describe(std::ostream& os) const {
     os << t.first << "=" << t.second << ",";
   }
   os << "}"
+     << ", " << "TokenBuckets=[";
+  for (auto& t : token_buckets_) {
+    os << t << ",";
+  }
+  os << "]"
      << "}";
 }
 
@@ -927,6 +1049,13 @@ const folly::dynamic TableTrafficRestrictionConfig::serialize() const {
     multiple_operation_limits.insert(t.first, map_multiple_operation_limits);
   }
   result.insert("MultipleOperationLimits", multiple_operation_limits);
+  folly::dynamic token_buckets = folly::dynamic::array;
+  for (auto& t : token_buckets_) {
+    folly::dynamic vec_token_buckets = folly::dynamic::object;
+    vec_token_buckets = t.serialize();
+    token_buckets.push_back(vec_token_buckets);
+  }
+  result.insert("TokenBuckets", token_buckets);
 
   return result;
 }
@@ -984,6 +1113,18 @@ bool TableTrafficRestrictionConfig::deserialize(const folly::dynamic& data) {
     map_multiple_operation_limits.insert({iter->asString(), obj_multiple_operation_limits});
   }
   setMultipleOperationLimits(map_multiple_operation_limits);
+  auto* token_buckets = data.get_ptr("TokenBuckets");
+  if (token_buckets && token_buckets->isArray()) {
+    std::vector<TrafficTokenBucketConfig> vec_token_buckets;
+    for (size_t i = 0; i < token_buckets->size(); i++) {
+      TrafficTokenBucketConfig obj_token_buckets;
+      if (!obj_token_buckets.deserialize(token_buckets->at(i))) {
+        return false;
+      }
+      vec_token_buckets.push_back(obj_token_buckets);
+    }
+    setTokenBuckets(vec_token_buckets);
+  }
 
   return true;
 }
@@ -1347,6 +1488,7 @@ void TableSchema::describe(std::ostream& os) const {
   }
   os << "]"
      << ", " << "EdgeFlowRatio=" << edge_flow_ratio_
+     << ", " << "BlindMerge=" << blind_merge_
      << "}";
 }
 
@@ -1369,6 +1511,7 @@ const folly::dynamic TableSchema::serialize() const {
   }
   result.insert("BindEdgeNodes", bind_edge_nodes);
   result.insert("EdgeFlowRatio", edge_flow_ratio_);
+  result.insert("BlindMerge", blind_merge_);
 
   return result;
 }
@@ -1415,6 +1558,10 @@ bool TableSchema::deserialize(const folly::dynamic& data) {
   if (edge_flow_ratio && edge_flow_ratio->isInt()) {
     setEdgeFlowRatio(edge_flow_ratio->asInt());
   }
+  auto* blind_merge = data.get_ptr("BlindMerge");
+  if (blind_merge && blind_merge->isBool()) {
+    setBlindMerge(blind_merge->asBool());
+  }
 
   return true;
 }
@@ -1766,6 +1913,7 @@ void ReplicationDbMetaInfo::describe(std::ostream& os) const {
   os << "ReplicationDbMetaInfo{"
      << "SeqNo=" << seq_no_
      << ", " << "ReplicateLag=" << replicate_lag_
+     << ", " << "ReplicateLagMs=" << replicate_lag_ms_
      << "}";
 }
 
@@ -1779,6 +1927,7 @@ const folly::dynamic ReplicationDbMetaInfo::serialize() const {
 
   result.insert("SeqNo", seq_no_);
   result.insert("ReplicateLag", replicate_lag_);
+  result.insert("ReplicateLagMs", replicate_lag_ms_);
 
   return result;
 }
@@ -1798,6 +1947,11 @@ bool ReplicationDbMetaInfo::deserialize(const folly::dynamic& data) {
     return false;
   }
   setReplicateLag(replicate_lag->asInt());
+  auto* replicate_lag_ms = data.get_ptr("ReplicateLagMs");
+  if (replicate_lag_ms == nullptr || !replicate_lag_ms->isInt()) {
+    return false;
+  }
+  setReplicateLagMs(replicate_lag_ms->asInt());
 
   return true;
 }
@@ -185,6 +185,18 @@ class TableConfig {
 
   void setVersion(uint32_t version) { version_ = version; } 
 
+  uint64_t getRowCacheCapacity() const { return row_cache_capacity_; }
+
+  void setRowCacheCapacity(uint64_t row_cache_capacity) { row_cache_capacity_ = row_cache_capacity; }
+
+  bool getPrefixExtractor() const { return prefix_extractor_; }
+
+  void setPrefixExtractor(bool prefix_extractor) { prefix_extractor_ = prefix_extractor; }
+
+  uint32_t getSyncReplicas() const { return sync_replicas_; }
+
+  void setSyncReplicas(uint32_t sync_replicas) { sync_replicas_ = sync_replicas; }
+
   void describe(std::ostream& os) const;
 
   const folly::dynamic serialize() const;
@@ -196,6 +208,12 @@ class TableConfig {
   std::unordered_map<std::string, std::string> cf_options_;
   std::unordered_map<std::string, std::string> table_options_;
   uint32_t version_;
+  // 每个 partition 点查缓存的字节数，为 0 时不开启
+  uint64_t row_cache_capacity_{0};
+  // 是否按 primary keys + columns 提取前缀，开启后复合类型的 seek 可以使用 prefix bloom
+  bool prefix_extractor_{false};
+  // leader 写入后等待多少个 follower 确认再返回，为 0 时异步同步
+  uint32_t sync_replicas_{0};
 };
 
 std::ostream& operator<<(std::ostream& os, const TableConfig& value);
@@ -410,6 +428,64 @@ class TrafficRestrictionLimitItem {
 
 std::ostream& operator<<(std::ostream& os, const TrafficRestrictionLimitItem& value);
 
+enum class TrafficOperationType {
+  READ,
+  WRITE
+};
+
+folly::dynamic serializeTrafficOperationType(const TrafficOperationType& value);
+
+bool deserializeTrafficOperationType(const folly::dynamic& data, TrafficOperationType* value);
+
+std::ostream& operator<<(std::ostream& os, const TrafficOperationType& value);
+
+
+class TrafficTokenBucketConfig {
+ public:
+  TrafficTokenBucketConfig() = default;
+  ~TrafficTokenBucketConfig() = default;
+
+  const TrafficOperationType& getOperationType() const { return operation_type_; } 
+
+  void setOperationType(const TrafficOperationType& operation_type) { operation_type_ = operation_type; } 
+
+  const std::string& getClientId() const { return client_id_; } 
+
+  void setClientId(const std::string& client_id) { client_id_ = client_id; } 
+
+  uint32_t getKeysPerSecond() const { return keys_per_second_; } 
+
+  void setKeysPerSecond(uint32_t keys_per_second) { keys_per_second_ = keys_per_second; } 
+
+  uint32_t getKeysBurst() const { return keys_burst_; } 
+
+  void setKeysBurst(uint32_t keys_burst) { keys_burst_ = keys_burst; } 
+
+  uint64_t getBytesPerSecond() const { return bytes_per_second_; } 
+
+  void setBytesPerSecond(uint64_t bytes_per_second) { bytes_per_second_ = bytes_per_second; } 
+
+  uint64_t getBytesBurst() const { return bytes_burst_; } 
+
+  void setBytesBurst(uint64_t bytes_burst) { bytes_burst_ = bytes_burst; } 
+
+  void describe(std::ostream& os) const;
+
+  const folly::dynamic serialize() const;
+
+  bool deserialize(const folly::dynamic& data);
+
+ private:
+  TrafficOperationType operation_type_{TrafficOperationType::READ};
+  std::string client_id_{""};
+  uint32_t keys_per_second_{0};
+  uint32_t keys_burst_{0};
+  uint64_t bytes_per_second_{0};
+  uint64_t bytes_burst_{0};
+};
+
+std::ostream& operator<<(std::ostream& os, const TrafficTokenBucketConfig& value);
+
 class TableTrafficRestrictionConfig {
  public:
   TableTrafficRestrictionConfig() = default;
@@ -431,6 +507,10 @@ class TableTrafficRestrictionConfig {
 
   void setMultipleOperationLimits(const std::unordered_map<std::string, TrafficRestrictionLimitItem>& multiple_operation_limits) { multiple_operation_limits_ = multiple_operation_limits; } 
 
+  const std::vector<TrafficTokenBucketConfig>& getTokenBuckets() const { return token_buckets_; } 
+
+  void setTokenBuckets(const std::vector<TrafficTokenBucketConfig>& token_buckets) { token_buckets_ = token_buckets; } 
+
   void describe(std::ostream& os) const;
 
   const folly::dynamic serialize() const;
@@ -442,6 +522,7 @@ class TableTrafficRestrictionConfig {
   bool deny_all_{false};
   std::unordered_map<std::string, uint32_t> single_operation_limits_;
   std::unordered_map<std::string, TrafficRestrictionLimitItem> multiple_operation_limits_;
+  std::vector<TrafficTokenBucketConfig> token_buckets_;
 };
 
 std::ostream& operator<<(std::ostream& os, const TableTrafficRestrictionConfig& value);
@@ -583,6 +664,10 @@ class TableSchema {
 
   void setEdgeFlowRatio(int edge_flow_ratio) { edge_flow_ratio_ = edge_flow_ratio; } 
 
+  bool getBlindMerge() const { return blind_merge_; }
+
+  void setBlindMerge(bool blind_merge) { blind_merge_ = blind_merge; }
+
   void describe(std::ostream& os) const;
 
   const folly::dynamic serialize() const;
@@ -605,6 +690,8 @@ class TableSchema {
   std::string config_name_;
   std::vector<std::string> bind_edge_nodes_;
   int edge_flow_ratio_{0};
+  // counter 和 append 不加锁直接写入 merge 操作数
+  bool blind_merge_{false};
   std::string dc_{"default"};
   std::string dist_dc_{"default"};
 };
@@ -785,6 +872,10 @@ class ReplicationDbMetaInfo {
 
   void setReplicateLag(int64_t replicate_lag) { replicate_lag_ = replicate_lag; } 
 
+  int64_t getReplicateLagMs() const { return replicate_lag_ms_; } 
+
+  void setReplicateLagMs(int64_t replicate_lag_ms) { replicate_lag_ms_ = replicate_lag_ms; } 
+
   void describe(std::ostream& os) const;
 
   const folly::dynamic serialize() const;
@@ -794,6 +885,7 @@ class ReplicationDbMetaInfo {
  private:
   uint64_t seq_no_{0};
   int64_t replicate_lag_{0};
+  int64_t replicate_lag_ms_{0};
 };
 
 std::ostream& operator<<(std::ostream& os, const ReplicationDbMetaInfo& value);
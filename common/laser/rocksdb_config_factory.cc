@@ -19,6 +19,7 @@
  */
 
 #include "rocksdb_config_factory.h"
+#include "key_prefix_extractor.h"
 #include "common/metrics/metrics.h"
 #include "rocksdb/sst_file_manager.h"
 #include "rocksdb/rate_limiter.h"
@@ -308,6 +309,8 @@ bool RocksDbConfigFactory::initOption(const TableConfigList& config_list, const
 
     auto versioned_options =
         std::make_shared<VersionedOptions>(option, config_iter->first, config_iter->second.getVersion());
+    versioned_options->setRowCacheCapacity(config_iter->second.getRowCacheCapacity());
+    versioned_options->setSyncReplicas(config_iter->second.getSyncReplicas());
     new_table_options[key] = versioned_options;
   }
   table_options_ = new_table_options;
@@ -325,6 +328,8 @@ bool RocksDbConfigFactory::initOption(const TableConfigList& config_list, const
   }
   default_options_ =
       std::make_shared<VersionedOptions>(option, default_config_iter->first, default_config_iter->second.getVersion());
+  default_options_->setRowCacheCapacity(default_config_iter->second.getRowCacheCapacity());
+  default_options_->setSyncReplicas(default_config_iter->second.getSyncReplicas());
   return true;
 }
 
@@ -354,6 +359,10 @@ bool RocksDbConfigFactory::getOptionFromTableConfig(const TableConfig& config,
   }
 
   table_options.block_cache = cache_;
+  // 需要同时在 TableOptions 中配置 filter_policy，bloom filter 才会按前缀生成
+  if (config.getPrefixExtractor()) {
+    option->prefix_extractor = std::make_shared<LaserKeyPrefixExtractor>();
+  }
   option->table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_options));
   option->write_buffer_manager = write_buffer_manager_;
   option->statistics = statistics_->getStatistics();
@@ -46,6 +46,7 @@ StatusMetaInfo StatusInfo::meta_info_list[] = {
     {Status::RS_PART_FAILED, "RS_PART_FAILED", "mset/mget/mdel keys part failed"},
     {Status::RS_TRAFFIC_RESTRICTION, "RS_TRAFFIC_RESTRICTION", "trigger service traffic restriction"},
     {Status::RS_OPERATION_DENIED, "RS_OPERATION_DENIED", "request is denied cause has no access to this operation"},
+    {Status::RS_THROTTLED, "RS_THROTTLED", "request is throttled by table token bucket, retry later"},
     {Status::SERVICE_NOT_EXISTS_PARTITION, "SERVICE_NOT_EXISTS_PARTITION", "service not exists partition db."},
     {Status::SERVICE_UNION_DATA_TYPE_INVALID, "SERVICE_UNION_DATA_TYPE_INVALID",
      "service response union data type invalid."},
@@ -95,6 +95,19 @@ TEST_F(ConfigManagerTest, updateDatabase) {
   EXPECT_FALSE(table_none.hasValue());
 }
 
+// 配置更新发布新版本的表信息，已经取出的表信息不受影响
+TEST_F(ConfigManagerTest, updateDatabaseSnapshot) {
+  triggerUpdate(origin_configs_, group_name_, node_id_);
+  auto table = config_->getTableSchema("test", "test_string_set");
+  ASSERT_TRUE(table.hasValue());
+
+  config_->updateDatabase("[]");
+  EXPECT_FALSE(config_->getTableSchema("test", "test_string_set").hasValue());
+  EXPECT_EQ(nullptr, config_->getTableSchemas());
+  EXPECT_EQ("test_string_set", table.value()->getTableName());
+  EXPECT_EQ(10, table.value()->getPartitionNumber());
+}
+
 TEST_F(ConfigManagerTest, updateClusterInfo) {
   triggerUpdate(origin_configs_, group_name_, node_id_);
 
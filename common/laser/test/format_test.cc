@@ -19,6 +19,7 @@
 #include "gtest/gtest.h"
 
 #include "common/laser/format.h"
+#include "common/laser/key_prefix_extractor.h"
 
 TEST(LaserKeyFormat, packTest) {
   std::vector<std::string> primary_keys({"uid", "page"});
@@ -39,6 +40,17 @@ TEST(LaserKeyFormat, packTest) {
   EXPECT_EQ(laser::KeyType::DEFAULT, from_buffer.getKeyType());
 }
 
+TEST(LaserKeyFormat, moveKeysTest) {
+  std::vector<std::string> primary_keys({"uid", "page"});
+  std::vector<std::string> column_families({"age", "count"});
+  laser::LaserKeyFormat copy_buffer(primary_keys, column_families);
+  laser::LaserKeyFormat move_buffer(std::move(primary_keys), std::move(column_families));
+  EXPECT_EQ(std::string(copy_buffer.data(), copy_buffer.length()),
+            std::string(move_buffer.data(), move_buffer.length()));
+  EXPECT_EQ(copy_buffer.getKeyHash(), move_buffer.getKeyHash());
+  EXPECT_EQ("page", move_buffer.getPrimaryKeys()[1]);
+}
+
 TEST(LaserValueRawString, packTest) {
   laser::LaserValueRawString to_buffer("test");
   EXPECT_EQ(17, to_buffer.length());
@@ -74,6 +86,27 @@ TEST(LaserValueCounter, packTestError) {
   EXPECT_FALSE(from_buffer.decode());
 }
 
+TEST(LaserValueMapMeta, versionPackTest) {
+  laser::LaserValueMapMeta to_buffer(3);
+  to_buffer.setTimestamp(100);
+  to_buffer.setVersion(12345);
+  to_buffer.encode();
+
+  laser::LaserValueMapMeta from_buffer(to_buffer.data(), to_buffer.length());
+  EXPECT_TRUE(from_buffer.decode());
+  EXPECT_EQ(laser::ValueType::MAP, from_buffer.getType());
+  EXPECT_EQ(100, from_buffer.getTimestamp());
+  EXPECT_EQ(12345, from_buffer.getVersion());
+  EXPECT_EQ(3, from_buffer.getSize());
+
+  // 没有版本号的历史数据
+  laser::LaserValueMapMeta old_buffer(3);
+  laser::LaserValueMapMeta old_from_buffer(old_buffer.data(), old_buffer.length());
+  EXPECT_TRUE(old_from_buffer.decode());
+  EXPECT_EQ(0, old_from_buffer.getVersion());
+  EXPECT_EQ(3, old_from_buffer.getSize());
+}
+
 TEST(LaserValueZSet, packTest) {
   std::vector<std::string> zset_members({"member1", "member2"});
   laser::LaserValueZSet to_buffer(zset_members);
@@ -127,6 +160,25 @@ TEST(LaserKeyFormatZSetData, packTest) {
   EXPECT_EQ(laser::KeyType::COMPOSITE, from_buffer.getKeyType());
 }
 
+TEST(LaserKeyFormatTtl, packTest) {
+  std::vector<std::string> primary_keys({"uid", "page"});
+  std::vector<std::string> column_families({"age", "count"});
+  laser::LaserKeyFormat key(primary_keys, column_families);
+  laser::LaserKeyFormatTtl to_buffer(key, 256);
+
+  laser::LaserKeyFormatTtl from_buffer(to_buffer.data(), to_buffer.length());
+  EXPECT_TRUE(from_buffer.decode());
+  EXPECT_EQ(256, from_buffer.getTimestamp());
+  EXPECT_EQ(std::string(key.data(), key.length()),
+            std::string(from_buffer.getKey().data(), from_buffer.getKey().length()));
+
+  // 按过期时间有序
+  laser::LaserKeyFormatTtl earlier(key, 1);
+  laser::LaserKeyFormatTtl bound(laser::LaserKeyFormat(), 256);
+  EXPECT_LT(std::string(earlier.data(), earlier.length()), std::string(bound.data(), bound.length()));
+  EXPECT_LT(std::string(bound.data(), bound.length()), std::string(to_buffer.data(), to_buffer.length()));
+}
+
 TEST(LaserKeyFormatSetData, packTest) {
   std::vector<std::string> primary_keys({"uid", "page"});
   std::vector<std::string> column_families({"age", "count"});
@@ -147,3 +199,50 @@ TEST(LaserKeyFormatSetData, packTest) {
   EXPECT_EQ(laser::KeyType::COMPOSITE, from_buffer.getKeyType());
   EXPECT_EQ("member1", from_buffer.getData());
 }
+
+TEST(LaserMergeOperand, packTest) {
+  laser::LaserMergeOperand counter(-3, 100, 200);
+  laser::LaserMergeOperand from_counter(counter.data(), counter.length());
+  EXPECT_TRUE(from_counter.decode());
+  EXPECT_EQ(laser::MergeOperandType::COUNTER_ADD, from_counter.getType());
+  EXPECT_EQ(-3, from_counter.getStep());
+  EXPECT_EQ(100, from_counter.getWriteTime());
+  EXPECT_EQ(200, from_counter.getTimestamp());
+
+  laser::LaserMergeOperand append(std::string("data"), 100, 0);
+  laser::LaserMergeOperand from_append(append.data(), append.length());
+  EXPECT_TRUE(from_append.decode());
+  EXPECT_EQ(laser::MergeOperandType::APPEND, from_append.getType());
+  EXPECT_EQ("data", from_append.getData());
+  EXPECT_EQ(0, from_append.getTimestamp());
+
+  laser::LaserMergeOperand empty_append(std::string(""), 100, 0);
+  laser::LaserMergeOperand from_empty_append(empty_append.data(), empty_append.length());
+  EXPECT_TRUE(from_empty_append.decode());
+  EXPECT_EQ("", from_empty_append.getData());
+}
+
+TEST(LaserKeyPrefixExtractor, transform) {
+  std::vector<std::string> primary_keys({"uid", "page"});
+  std::vector<std::string> column_families({"age", "count"});
+  laser::LaserKeyFormat key(primary_keys, column_families);
+  laser::LaserKeyFormat composite_key(key, laser::KeyType::COMPOSITE);
+  laser::LaserKeyPrefixExtractor extractor;
+
+  // meta key 和 data key 使用各自类型的前缀，同一个集合的 data key 前缀相同
+  rocksdb::Slice slice_key(key.data(), key.length());
+  EXPECT_TRUE(extractor.InDomain(slice_key));
+  EXPECT_EQ(slice_key.ToString(), extractor.Transform(slice_key).ToString());
+  laser::LaserKeyFormatMapData map_data(key, "field");
+  laser::LaserKeyFormatZSetData zset_data(key, 1);
+  std::string prefix(composite_key.data(), composite_key.length());
+  EXPECT_EQ(prefix, extractor.Transform(rocksdb::Slice(map_data.data(), map_data.length())).ToString());
+  EXPECT_EQ(prefix, extractor.Transform(rocksdb::Slice(zset_data.data(), zset_data.length())).ToString());
+
+  // TTL 索引和被截断的 key 不在前缀域内
+  laser::LaserKeyFormatTtl ttl_key(key, 256);
+  EXPECT_FALSE(extractor.InDomain(rocksdb::Slice(ttl_key.data(), ttl_key.length())));
+  EXPECT_FALSE(extractor.InDomain(rocksdb::Slice(key.data(), key.length() - 1)));
+  laser::LaserKeyFormatTypePrefix type_prefix(laser::KeyType::DEFAULT);
+  EXPECT_FALSE(extractor.InDomain(rocksdb::Slice(type_prefix.data(), type_prefix.length())));
+}
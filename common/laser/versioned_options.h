@@ -34,12 +34,17 @@ class VersionedOptions {
   ~VersionedOptions() {}
 
   VersionedOptions(const VersionedOptions& other)
-      : options_(std::make_shared<rocksdb::Options>(*other.options_)), version_hash_(other.version_hash_) {}
+      : options_(std::make_shared<rocksdb::Options>(*other.options_)),
+        version_hash_(other.version_hash_),
+        row_cache_capacity_(other.row_cache_capacity_),
+        sync_replicas_(other.sync_replicas_) {}
 
   VersionedOptions& operator=(const VersionedOptions& other) {
     if (this != &other) {
       options_ = std::make_shared<rocksdb::Options>(*other.options_);
       version_hash_ = other.version_hash_;
+      row_cache_capacity_ = other.row_cache_capacity_;
+      sync_replicas_ = other.sync_replicas_;
     }
     return *this;
   }
@@ -50,8 +55,12 @@ class VersionedOptions {
     if (this != &other) {
       options_ = other.options_;
       version_hash_ = other.version_hash_;
+      row_cache_capacity_ = other.row_cache_capacity_;
+      sync_replicas_ = other.sync_replicas_;
       other.options_ = nullptr;
       other.version_hash_ = 0;
+      other.row_cache_capacity_ = 0;
+      other.sync_replicas_ = 0;
     }
     return *this;
   }
@@ -62,6 +71,14 @@ class VersionedOptions {
 
   uint64_t getVersionHash() const { return version_hash_; }
 
+  uint64_t getRowCacheCapacity() const { return row_cache_capacity_; }
+
+  void setRowCacheCapacity(uint64_t row_cache_capacity) { row_cache_capacity_ = row_cache_capacity; }
+
+  uint32_t getSyncReplicas() const { return sync_replicas_; }
+
+  void setSyncReplicas(uint32_t sync_replicas) { sync_replicas_ = sync_replicas; }
+
   void updateVersionHash(const std::string& config_name, uint32_t config_version) {
     version_hash_ = CityHash64WithSeed(config_name.c_str(), config_name.length(), config_version);
   }
@@ -69,5 +86,7 @@ class VersionedOptions {
  private:
   std::shared_ptr<rocksdb::Options> options_;
   uint64_t version_hash_;
+  uint64_t row_cache_capacity_{0};
+  uint32_t sync_replicas_{0};
 };
 }  // namespace laser
@@ -21,6 +21,7 @@
 #include "router.h"
 
 #include "city.h"
+#include "folly/json.h"
 #include "common/util.h"
 #include "service_info_puller.h"
 
@@ -42,8 +43,21 @@ constexpr char ROUTER_METRICS_SELECT_ADDRESS[] = "select_address";
 constexpr char ROUTER_METRICS_DISCOVER_TIMERS[] = "discover";
 constexpr char ROUTER_METRICS_SELECT_ADDRESS_TAGS_ADDR[] = "addr";
 constexpr char ROUTER_METRICS_SELECT_ADDRESS_TAGS_ADDR_VAL_NONE[] = "none";
+constexpr char ROUTER_METRICS_STALE_FALLBACK[] = "stale_fallback";
 constexpr uint32_t ROUTER_DEFAULT_SHARD_ID = 4294967295;  // 对于没有分片的服务默认传递 UINT32_MAX
 
+bool ServerLag::isFresh(int64_t now_ms, int64_t max_staleness_ms) const {
+  if (is_leader) {
+    return true;
+  }
+  if (report_ms <= 0) {
+    return false;
+  }
+  // 上报之后延迟可能继续增加，按上报时间到现在的间隔补偿
+  int64_t report_age = std::max<int64_t>(now_ms - report_ms, 0);
+  return lag_ms <= max_staleness_ms - report_age;
+}
+
 ServerList::ServerList(const std::vector<Server>& server_list) : servers_(server_list) {
   for (auto& server : server_list) {
     std::string hash_str = folly::to<std::string>(server.getHost(), server.getPort());
@@ -51,6 +65,11 @@ ServerList::ServerList(const std::vector<Server>& server_list) : servers_(server
   }
 }
 
+ServerList::ServerList(const std::vector<Server>& server_list, const std::vector<ServerLag>& lags)
+    : ServerList(server_list) {
+  lags_ = lags;
+}
+
 folly::Optional<Server> ServerList::selectServers(const std::shared_ptr<LoadBalanceInterface>& load) const {
   Server server;
   if (load->select(&server, servers_)) {
@@ -60,6 +79,27 @@ folly::Optional<Server> ServerList::selectServers(const std::shared_ptr<LoadBala
   return folly::none;
 }
 
+folly::Optional<Server> ServerList::selectServers(const std::shared_ptr<LoadBalanceInterface>& load,
+                                                  int64_t max_staleness_ms) const {
+  if (max_staleness_ms <= 0 || lags_.size() != servers_.size()) {
+    return selectServers(load);
+  }
+
+  int64_t now_ms = static_cast<int64_t>(common::currentTimeInMs());
+  std::vector<Server> fresh_servers;
+  fresh_servers.reserve(servers_.size());
+  for (size_t i = 0; i < servers_.size(); i++) {
+    if (lags_[i].isFresh(now_ms, max_staleness_ms)) {
+      fresh_servers.push_back(servers_[i]);
+    }
+  }
+  Server server;
+  if (!fresh_servers.empty() && load->select(&server, fresh_servers)) {
+    return server;
+  }
+  return folly::none;
+}
+
 const std::vector<Server> ServerList::getServers() { return servers_; }
 
 ServiceRegistry::ServiceRegistry(const std::unordered_map<int64_t, std::shared_ptr<ServerList>>& services)
@@ -75,6 +115,35 @@ folly::Optional<std::shared_ptr<ServerList>> ServiceRegistry::selectServers(int6
 
 const std::unordered_map<int64_t, std::shared_ptr<ServerList>> ServiceRegistry::getServices() { return services_; }
 
+bool parseFollowerLag(int64_t* report_ms, std::unordered_map<uint32_t, int64_t>* lags, const Server& server) {
+  auto& other_settings = server.getOtherSettings();
+  auto setting = other_settings.find(FOLLOWER_LAG_SETTING_KEY);
+  if (setting == other_settings.end()) {
+    return false;
+  }
+
+  try {
+    folly::dynamic data = folly::parseJson(setting->second);
+    auto* timestamp = data.get_ptr("Timestamp");
+    auto* shards = data.get_ptr("Shards");
+    if (timestamp == nullptr || !timestamp->isInt() || shards == nullptr || !shards->isObject()) {
+      return false;
+    }
+    *report_ms = timestamp->asInt();
+    for (auto& shard : shards->items()) {
+      if (!shard.second.isInt()) {
+        continue;
+      }
+      (*lags)[folly::to<uint32_t>(shard.first.asString())] = shard.second.asInt();
+    }
+  } catch (const std::exception& ex) {
+    FB_LOG_EVERY_MS(ERROR, 1000) << "Parse follower lag of server " << server.getHost() << ":" << server.getPort()
+                                 << " fail, " << ex.what();
+    return false;
+  }
+  return true;
+}
+
 RouterDb::RouterDb() {
   auto metrics = metrics::Metrics::getInstance();
   timers_ = metrics->buildTimers(ROUTER_METRICS_MODULE_NAME, ROUTER_METRICS_DISCOVER_TIMERS, 1, 0, 1000);
@@ -147,6 +216,7 @@ void RouterDb::updateServers(const std::string& service_name, const std::vector<
 
   std::vector<Server> pick_result = pickServers(service_name, list);
   std::unordered_map<int64_t, std::vector<Server>> shard_servers;
+  std::unordered_map<int64_t, std::vector<ServerLag>> shard_lags;
   std::unordered_map<int64_t, std::vector<Server>> partition_servers;
   for (auto& t : pick_result) {
     t.setHostLong(common::ipToInt(t.getHost()));
@@ -169,35 +239,37 @@ void RouterDb::updateServers(const std::string& service_name, const std::vector<
     if (t.getShardList().empty() && t.getFollowerShardList().empty()) {  // 按照不分区处理
       available_shard_list.push_back(ROUTER_DEFAULT_SHARD_ID);
     }
+    // 与 shard_servers 一一对应，记录节点上该 shard 的数据延迟
+    auto add_shard_server = [&shard_servers, &shard_lags, &t](int64_t key, const ServerLag& lag) {
+      shard_servers[key].push_back(t);
+      shard_lags[key].push_back(lag);
+    };
     for (auto shard_id : available_shard_list) {
       int64_t key = getServiceKey(service_name, t.getProtocol(), shard_id, ShardType::LEADER, t.getDc());
-      if (shard_servers.find(key) != shard_servers.end()) {
-        shard_servers[key].push_back(t);
-      } else {
-        shard_servers[key] = {t};
-      }
+      add_shard_server(key, ServerLag());
 
       // ShardType::ALL 代表 leader follower 混合返回, 对于读操作很适合，更加有效的降低热点请求
       key = getServiceKey(service_name, t.getProtocol(), shard_id, ShardType::ALL, t.getDc());
-      if (shard_servers.find(key) != shard_servers.end()) {
-        shard_servers[key].push_back(t);
-      } else {
-        shard_servers[key] = {t};
-      }
+      add_shard_server(key, ServerLag());
+    }
+    int64_t report_ms = 0;
+    std::unordered_map<uint32_t, int64_t> follower_lags;
+    if (!follower_available_shard_list.empty()) {
+      parseFollowerLag(&report_ms, &follower_lags, t);
     }
     for (auto shard_id : follower_available_shard_list) {
-      int64_t key = getServiceKey(service_name, t.getProtocol(), shard_id, ShardType::FOLLOWER, t.getDc());
-      if (shard_servers.find(key) != shard_servers.end()) {
-        shard_servers[key].push_back(t);
-      } else {
-        shard_servers[key] = {t};
+      // 没有上报延迟的 follower 视为延迟未知，限制读取延迟时不会被选择
+      ServerLag lag;
+      lag.is_leader = false;
+      auto follower_lag = follower_lags.find(shard_id);
+      if (follower_lag != follower_lags.end()) {
+        lag.lag_ms = follower_lag->second;
+        lag.report_ms = report_ms;
       }
+      int64_t key = getServiceKey(service_name, t.getProtocol(), shard_id, ShardType::FOLLOWER, t.getDc());
+      add_shard_server(key, lag);
       key = getServiceKey(service_name, t.getProtocol(), shard_id, ShardType::ALL, t.getDc());
-      if (shard_servers.find(key) != shard_servers.end()) {
-        shard_servers[key].push_back(t);
-      } else {
-        shard_servers[key] = {t};
-      }
+      add_shard_server(key, lag);
     }
   }
 
@@ -218,7 +290,7 @@ void RouterDb::updateServers(const std::string& service_name, const std::vector<
   });
 
   for (auto& t : shard_servers) {
-    currentServices[t.first] = std::make_shared<ServerList>(t.second);
+    currentServices[t.first] = std::make_shared<ServerList>(t.second, shard_lags[t.first]);
   }
 
   last_partition_keys_.withWLock([&partition_servers, &currentServices, &service_name](auto& partition_keys) {
@@ -288,6 +360,8 @@ Router::Router() {
   evb_ = router_thread_->getEventBase();
   callback_thread_pool_ = std::make_shared<folly::CPUThreadPoolExecutor>(
       FLAGS_router_callback_threads, std::make_shared<folly::NamedThreadFactory>("RouterCallback"));
+  stale_fallback_meter_ =
+      metrics::Metrics::getInstance()->buildMeter(ROUTER_METRICS_MODULE_NAME, ROUTER_METRICS_STALE_FALLBACK);
 }
 
 void Router::createServiceRegistry(const std::string& service_name, RegistryType type, const std::string& address) {
@@ -506,6 +580,9 @@ folly::Optional<Server> Router::discover(const ClientOption& option) {
     return folly::none;
   }
 
+  if (option.getMaxStalenessMs() > 0 && option.getShardType() != ShardType::LEADER) {
+    return selectFreshServer(option, *server_list, option.getShardId());
+  }
   return (*server_list)->selectServers(getOrCreateBalance(option));
 }
 
@@ -525,9 +602,13 @@ std::unordered_map<int64_t, folly::Optional<Server>> Router::batchDiscover(const
       getServerList(option.getServiceName(), option.getProtocol(), route_ids, option.getShardType(), option.getDc());
   std::unordered_map<int64_t, folly::Optional<Server>> result;
   std::unordered_map<uint64_t, folly::Optional<Server>> select_servers;
+  bool check_staleness = option.getMaxStalenessMs() > 0 && option.getShardType() != ShardType::LEADER;
   for (auto& route_id : route_ids) {
     if (server_lists.find(route_id) == server_lists.end()) {
       result[route_id] = folly::none;
+    } else if (check_staleness) {
+      // 相同节点列表上不同 shard 的延迟不同，不能复用选择结果
+      result[route_id] = selectFreshServer(option, server_lists[route_id], route_id);
     } else {
       auto& server_list = server_lists[route_id];
       uint64_t hash_code = server_list->getHashCode();
@@ -540,6 +621,23 @@ std::unordered_map<int64_t, folly::Optional<Server>> Router::batchDiscover(const
   return result;
 }
 
+folly::Optional<Server> Router::selectFreshServer(const ClientOption& option,
+                                                  const std::shared_ptr<ServerList>& server_list, int64_t route_id) {
+  auto balance = getOrCreateBalance(option);
+  auto server = server_list->selectServers(balance, option.getMaxStalenessMs());
+  if (server) {
+    return server;
+  }
+
+  stale_fallback_meter_->mark();
+  auto leader_list = getServerList(option.getServiceName(), option.getProtocol(), route_id, ShardType::LEADER,
+                                   option.getDc());
+  if (!leader_list) {
+    return folly::none;
+  }
+  return (*leader_list)->selectServers(balance);
+}
+
 folly::Optional<std::shared_ptr<ServerList>> Router::getServerList(const std::string& service_name,
                                                                    const ServerProtocol& protocol, int64_t route_id,
                                                                    const ShardType& type, const std::string& dc) {
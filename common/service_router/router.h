@@ -43,6 +43,9 @@ DECLARE_int32(thrift_timeout_retry);
 DECLARE_int32(thrift_connection_retry);
 
 constexpr char DEFAULT_DC[] = "default";
+// follower 通过 other settings 上报各个 shard 的同步延迟，
+// 格式为 {"Timestamp": 上报时的毫秒时间戳, "Shards": {"shard_id": 延迟毫秒}}
+constexpr char FOLLOWER_LAG_SETTING_KEY[] = "follower_lag";
 
 class Router;
 template <typename Type>
@@ -51,20 +54,37 @@ class ServiceConfigPull;
 class ServiceDiscoverPull;
 class ServerWithHeartbeat;
 
+// 节点上某个 shard 的数据延迟，leader 没有延迟
+struct ServerLag {
+  bool is_leader{true};
+  int64_t lag_ms{0};
+  int64_t report_ms{0};
+
+  bool isFresh(int64_t now_ms, int64_t max_staleness_ms) const;
+};
+
 class ServerList {
  public:
   explicit ServerList(const std::vector<Server>& server_list);
+  ServerList(const std::vector<Server>& server_list, const std::vector<ServerLag>& lags);
   ServerList() = default;
   ~ServerList() = default;
   folly::Optional<Server> selectServers(const std::shared_ptr<LoadBalanceInterface>& load) const;
+  // 只在延迟不超过 max_staleness_ms 的节点中选择，没有满足条件的节点时返回 none
+  folly::Optional<Server> selectServers(const std::shared_ptr<LoadBalanceInterface>& load,
+                                        int64_t max_staleness_ms) const;
   const std::vector<Server> getServers();
   inline uint64_t getHashCode() { return hash_code_; }
 
  private:
   std::vector<Server> servers_;
+  std::vector<ServerLag> lags_;
   uint64_t hash_code_{0};
 };
 
+// 解析 follower 上报的延迟，返回 shard id 到延迟的映射
+bool parseFollowerLag(int64_t* report_ms, std::unordered_map<uint32_t, int64_t>* lags, const Server& server);
+
 class ServiceRegistry {
  public:
   ServiceRegistry() = default;
@@ -246,8 +266,12 @@ class Router {
   folly::Synchronized<std::unordered_map<std::string, ServiceConfigInfoPullerPtr>> config_pullers_;
   folly::Synchronized<std::unordered_map<std::string, ServiceDiscoverPullerPtr>> discover_pullers_;
   folly::Synchronized<std::unordered_map<uint64_t, std::shared_ptr<LoadBalanceInterface>>> balancers_;
+  std::shared_ptr<metrics::Meter> stale_fallback_meter_;
 
   const std::string getServerKey(const Server& server);
+  // 限制了读取延迟时只选择满足要求的节点，没有满足条件的 follower 时回退到 leader
+  folly::Optional<Server> selectFreshServer(const ClientOption& option, const std::shared_ptr<ServerList>& server_list,
+                                            int64_t route_id);
   std::shared_ptr<ServiceInfoPuller<ServiceConfigPull>> getOrCreateConfigPuller(const std::string& service_name);
   std::shared_ptr<ServiceInfoPuller<ServiceDiscoverPull>> getOrCreateDiscoverPuller(const std::string& service_name);
   std::shared_ptr<LoadBalanceInterface> getOrCreateBalance(const ClientOption& option);
@@ -551,6 +551,7 @@ void ClientOption::describe(std::ostream& os) const {
      << ", " << "ThriftCompressionMethod=" << thrift_compression_method_
      << ", " << "Idc='" << idc_ << "'"
      << ", " << "Dc='" << dc_ << "'"
+     << ", " << "MaxStalenessMs=" << max_staleness_ms_
      << "}";
 }
 
@@ -584,6 +585,7 @@ const folly::dynamic ClientOption::serialize() const {
   result.insert("ThriftCompressionMethod", thrift_compression_method_);
   result.insert("Idc", idc_);
   result.insert("Dc", dc_);
+  result.insert("MaxStalenessMs", max_staleness_ms_);
 
   return result;
 }
@@ -693,6 +695,11 @@ bool ClientOption::deserialize(const folly::dynamic& data) {
     return false;
   }
   setDc(dc->asString());
+  auto* max_staleness_ms = data.get_ptr("MaxStalenessMs");
+  if (max_staleness_ms == nullptr || !max_staleness_ms->isInt()) {
+    return false;
+  }
+  setMaxStalenessMs(max_staleness_ms->asInt());
 
   return true;
 }
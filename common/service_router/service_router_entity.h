@@ -243,6 +243,10 @@ class ClientOption {
 
   void setDc(const std::string& dc) { dc_ = dc; } 
 
+  int64_t getMaxStalenessMs() const { return max_staleness_ms_; } 
+
+  void setMaxStalenessMs(int64_t max_staleness_ms) { max_staleness_ms_ = max_staleness_ms; } 
+
   void describe(std::ostream& os) const;
 
   const folly::dynamic serialize() const;
@@ -265,6 +269,7 @@ class ClientOption {
   uint16_t thrift_compression_method_{3};
   std::string idc_;
   std::string dc_{"default"};
+  int64_t max_staleness_ms_{0};
 };
 
 std::ostream& operator<<(std::ostream& os, const ClientOption& value);
@@ -80,6 +80,7 @@ enum Status {
   RS_PART_FAILED = 20,
   RS_TRAFFIC_RESTRICTION = 21,
   RS_OPERATION_DENIED = 22,
+  RS_THROTTLED = 23,
 
   SERVICE_NOT_EXISTS_PARTITION = 101,
   SERVICE_UNION_DATA_TYPE_INVALID = 102,
@@ -46,6 +46,7 @@ const (
 	Status_RS_PART_FAILED                  Status = 20
 	Status_RS_TRAFFIC_RESTRICTION          Status = 21
 	Status_RS_OPERATION_DENIED             Status = 22
+	Status_RS_THROTTLED                    Status = 23
 	Status_SERVICE_NOT_EXISTS_PARTITION    Status = 101
 	Status_SERVICE_UNION_DATA_TYPE_INVALID Status = 102
 	Status_CLIENT_THRIFT_CALL_ERROR        Status = 200
@@ -93,6 +94,7 @@ var StatusToName = map[Status]string{
 	Status_RS_PART_FAILED:                  "RS_PART_FAILED",
 	Status_RS_TRAFFIC_RESTRICTION:          "RS_TRAFFIC_RESTRICTION",
 	Status_RS_OPERATION_DENIED:             "RS_OPERATION_DENIED",
+	Status_RS_THROTTLED:                    "RS_THROTTLED",
 	Status_SERVICE_NOT_EXISTS_PARTITION:    "SERVICE_NOT_EXISTS_PARTITION",
 	Status_SERVICE_UNION_DATA_TYPE_INVALID: "SERVICE_UNION_DATA_TYPE_INVALID",
 	Status_CLIENT_THRIFT_CALL_ERROR:        "CLIENT_THRIFT_CALL_ERROR",
@@ -140,6 +142,7 @@ var StatusToValue = map[string]Status{
 	"RS_PART_FAILED":                  Status_RS_PART_FAILED,
 	"RS_TRAFFIC_RESTRICTION":          Status_RS_TRAFFIC_RESTRICTION,
 	"RS_OPERATION_DENIED":             Status_RS_OPERATION_DENIED,
+	"RS_THROTTLED":                    Status_RS_THROTTLED,
 	"SERVICE_NOT_EXISTS_PARTITION":    Status_SERVICE_NOT_EXISTS_PARTITION,
 	"SERVICE_UNION_DATA_TYPE_INVALID": Status_SERVICE_UNION_DATA_TYPE_INVALID,
 	"CLIENT_THRIFT_CALL_ERROR":        Status_CLIENT_THRIFT_CALL_ERROR,
@@ -21,6 +21,8 @@
 #include "database_manager.h"
 #include "engine/rocksdb.h"
 
+#include "folly/json.h"
+
 #include "common/service_router/router.h"
 
 namespace laser {
@@ -28,6 +30,11 @@ namespace laser {
 DEFINE_int32(hdfs_monitor_sync_thread_nums, 16, "Laser sync hdfs file thread nums");
 DEFINE_int32(wdt_replicator_manager_thread_nums, 16, "Laser wdt replicator manager thread nums");
 DEFINE_int32(delay_set_available_seconds, 20, "Delay seconds to set service available after loading database");
+DEFINE_int32(ttl_sweep_interval_ms, 1000, "Interval of sweeping expired keys by ttl index");
+DEFINE_int64(ttl_sweep_rate_bytes_per_sec, 8 * 1024 * 1024, "Rate limit of deleting expired keys");
+DEFINE_int32(ttl_sweep_thread_nums, 4, "Thread nums of sweeping expired keys, partitions are swept in parallel");
+DEFINE_int32(follower_lag_report_interval_ms, 1000,
+             "Interval of reporting follower replication lag to service router, 0 means disabled");
 
 constexpr static char WDT_REPLICATOR_NAME[] = "laser_base_data_replicator";
 constexpr static char LASER_METRICS_MODULE_NAME_FOR_ROCKSDB_TABLE[] = "rocksdb_table";
@@ -69,10 +76,42 @@ void DatabaseManager::init(uint32_t loader_thread_nums, const std::string& repli
   // init wdt replicator
   wdt_manager_ = createWdtReplicatorManager(FLAGS_wdt_replicator_manager_thread_nums);
 
+  // init ttl sweeper
+  ttl_sweep_rate_limiter_ =
+      std::shared_ptr<rocksdb::RateLimiter>(rocksdb::NewGenericRateLimiter(FLAGS_ttl_sweep_rate_bytes_per_sec));
+  ttl_sweep_thread_pool_ = std::make_shared<folly::CPUThreadPoolExecutor>(
+      FLAGS_ttl_sweep_thread_nums, std::make_shared<folly::NamedThreadFactory>("TtlSweepPool"));
+  timer_thread_->getEventBase()->runInEventBaseThreadAndWait([this]() {
+    ttl_sweep_timeout_ = folly::AsyncTimeout::make(*timer_thread_->getEventBase(), [this]() noexcept {
+      sweepExpiredKeys();
+      ttl_sweep_timeout_->scheduleTimeout(std::chrono::milliseconds(FLAGS_ttl_sweep_interval_ms));
+    });
+    ttl_sweep_timeout_->scheduleTimeout(std::chrono::milliseconds(FLAGS_ttl_sweep_interval_ms));
+  });
+
+  if (FLAGS_follower_lag_report_interval_ms > 0) {
+    timer_thread_->getEventBase()->runInEventBaseThreadAndWait([this]() {
+      follower_lag_timeout_ = folly::AsyncTimeout::make(*timer_thread_->getEventBase(), [this]() noexcept {
+        reportFollowerLag();
+        follower_lag_timeout_->scheduleTimeout(std::chrono::milliseconds(FLAGS_follower_lag_report_interval_ms));
+      });
+      follower_lag_timeout_->scheduleTimeout(std::chrono::milliseconds(FLAGS_follower_lag_report_interval_ms));
+    });
+  }
+
   setShardMetrics();
 }
 
 DatabaseManager::~DatabaseManager() {
+  if (timer_thread_ && follower_lag_timeout_) {
+    timer_thread_->getEventBase()->runInEventBaseThreadAndWait([this]() { follower_lag_timeout_.reset(); });
+  }
+  if (timer_thread_ && ttl_sweep_timeout_) {
+    timer_thread_->getEventBase()->runInEventBaseThreadAndWait([this]() { ttl_sweep_timeout_.reset(); });
+  }
+  if (ttl_sweep_thread_pool_) {
+    ttl_sweep_thread_pool_->stop();
+  }
   if (loader_thread_pool_) {
     loader_thread_pool_->stop();
   }
@@ -154,6 +193,8 @@ void DatabaseManager::updatePartitions(const PartitionPtrSet& mount_partitions,
     monitor->removePartition(partition->getPartitionId());
     removePartitionHandler(partition);
   }
+
+  rebuildTableRoutes();
 }
 
 void DatabaseManager::updateServerShard() {
@@ -279,22 +320,30 @@ std::shared_ptr<PartitionHandler> DatabaseManager::getOrCreatePartitionHandler(
     }
 
     auto wlock = ulock.moveFromUpgradeToWrite();
-    auto table = config_manager_->getTableSchema(partition->getDatabaseName(), partition->getTableName());
-    uint64_t ttl = 0;
-    if (table) {
-      ttl = table.value()->getTtl();
-    }
-    auto engine_options = std::make_shared<RocksDbEngineOptions>();
-    engine_options->ttl = ttl;
-    auto handler = std::make_shared<PartitionHandler>(
-        partition, this, database_meta_info_.get(), replicator_manager_.get(), wdt_manager_,
-        timer_thread_->getEventBase(), engine_options, self_hold_metrics_thread_->getEventBase());
-    handler->init();
-    (*wlock)[hash_key] = handler;
+    (*wlock)[hash_key] = createPartitionHandler(partition);
     return wlock->at(hash_key);
   });
 }
 
+std::shared_ptr<PartitionHandler> DatabaseManager::createPartitionHandler(const std::shared_ptr<Partition>& partition) {
+  auto table = config_manager_->getTableSchema(partition->getDatabaseName(), partition->getTableName());
+  uint64_t ttl = 0;
+  bool blind_merge = false;
+  if (table) {
+    ttl = table.value()->getTtl();
+    blind_merge = table.value()->getBlindMerge();
+  }
+  auto engine_options = std::make_shared<RocksDbEngineOptions>();
+  engine_options->ttl = ttl;
+  engine_options->sweep_rate_limiter = ttl_sweep_rate_limiter_;
+  engine_options->blind_merge = blind_merge;
+  auto handler = std::make_shared<PartitionHandler>(
+      partition, this, database_meta_info_.get(), replicator_manager_.get(), wdt_manager_,
+      timer_thread_->getEventBase(), engine_options, self_hold_metrics_thread_->getEventBase());
+  handler->init();
+  return handler;
+}
+
 folly::Optional<std::shared_ptr<PartitionHandler>> DatabaseManager::getPartitionHandler(
     const std::shared_ptr<Partition>& partition) {
   return partition_handlers_.withRLock(
@@ -317,6 +366,37 @@ void DatabaseManager::removePartitionHandler(const std::shared_ptr<Partition>& p
   });
 }
 
+void DatabaseManager::rebuildTableRoutes() {
+  // 串行重建，避免并发的 partition 变更发布旧的路由
+  std::lock_guard<std::mutex> guard(table_routes_mutex_);
+  auto routes = std::make_shared<TableRouteMap>();
+  auto table_schemas = config_manager_->getTableSchemas();
+  if (table_schemas) {
+    for (auto& table : *table_schemas) {
+      uint32_t partition_number = table.second->getPartitionNumber();
+      if (partition_number == 0) {
+        continue;
+      }
+      auto& route = (*routes)[table.first];
+      route.partition_number = partition_number;
+      route.handlers.resize(partition_number);
+    }
+  }
+
+  partition_handlers_.withRLock([&routes, this](auto& handlers) {
+    for (auto& handler : handlers) {
+      auto partition = handler.second->getPartition();
+      auto route =
+          routes->find(config_manager_->getTableSchemaHash(partition->getDatabaseName(), partition->getTableName()));
+      if (route == routes->end() || partition->getPartitionId() >= route->second.partition_number) {
+        continue;
+      }
+      route->second.handlers[partition->getPartitionId()] = handler.second;
+    }
+  });
+  table_routes_.store(routes);
+}
+
 folly::Optional<std::weak_ptr<RocksDbEngine>> DatabaseManager::getDatabaseHandler(
     const std::shared_ptr<Partition>& partition) {
   auto partition_handler = getPartitionHandler(partition);
@@ -630,4 +710,48 @@ void DatabaseManager::delaySetAvailable() {
   });
 }
 
+void DatabaseManager::sweepExpiredKeys() {
+  std::vector<std::shared_ptr<PartitionHandler>> handlers;
+  partition_handlers_.withRLock([&handlers](auto& partition_handlers) {
+    for (auto& handler : partition_handlers) {
+      handlers.push_back(handler.second);
+    }
+  });
+
+  // 每个 partition 一个清理任务，限速等待只阻塞清理线程池
+  for (auto& handler : handlers) {
+    handler->scheduleSweepExpiredKeys(ttl_sweep_thread_pool_.get());
+  }
+}
+
+void DatabaseManager::reportFollowerLag() {
+  if (!has_api_server_) {
+    return;
+  }
+
+  std::unordered_map<int64_t, std::shared_ptr<PartitionHandler>> partitions;
+  partition_handlers_.withRLock([&partitions](auto& handlers) { partitions = handlers; });
+  // shard 的延迟取其中所有 follower partition 延迟的最大值
+  std::unordered_map<uint32_t, int64_t> shard_lags;
+  for (auto& partition : partitions) {
+    auto partition_entity = partition.second->getPartition();
+    if (partition_entity->getRole() != DBRole::FOLLOWER) {
+      continue;
+    }
+    int64_t lag_ms = partition.second->getReplicateLagMs();
+    auto& shard_lag = shard_lags[partition_entity->getShardId()];
+    shard_lag = std::max(shard_lag, lag_ms);
+  }
+
+  folly::dynamic shards = folly::dynamic::object;
+  for (auto& shard_lag : shard_lags) {
+    shards.insert(folly::to<std::string>(shard_lag.first), shard_lag.second);
+  }
+  folly::dynamic data = folly::dynamic::object;
+  data.insert("Timestamp", static_cast<int64_t>(common::currentTimeInMs()));
+  data.insert("Shards", shards);
+  config_manager_->getRouter()->setOtherSettings(api_server_, service_router::FOLLOWER_LAG_SETTING_KEY,
+                                                 folly::toJson(data));
+}
+
 }  // namespace laser
@@ -21,8 +21,11 @@
 #pragma once
 
 #include "folly/Synchronized.h"
+#include "folly/concurrency/AtomicSharedPtr.h"
 #include "folly/executors/CPUThreadPoolExecutor.h"
 #include "folly/io/async/AsyncTimeout.h"
+#include "folly/io/async/ScopedEventBaseThread.h"
+#include "rocksdb/rate_limiter.h"
 
 #include "common/laser/partition.h"
 #include "common/laser/rocksdb_config_factory.h"
@@ -44,12 +47,24 @@ class DatabaseManagerTimerThread : public folly::ScopedEventBaseThread {
   ~DatabaseManagerTimerThread() { VLOG(5) << "Database manager timer thread delete."; }
 };
 
+// 按表预先计算的路由信息，handlers 的下标为 partition id，本节点未挂载的 partition 为空
+struct TableRoute {
+  uint32_t partition_number{0};
+  std::vector<std::shared_ptr<PartitionHandler>> handlers;
+};
+// key 为 ConfigManager::getTableSchemaHash
+using TableRouteMap = std::unordered_map<uint64_t, TableRoute>;
+
 // 一定要在 config manager 之前初始化, 进行设置订阅配置变更回调
 class DatabaseManager : public std::enable_shared_from_this<DatabaseManager> {
  public:
   DatabaseManager(std::shared_ptr<ConfigManager> config_manager, const std::string& group_name, uint32_t node_id,
                   const std::string& node_dc)
-      : config_manager_(config_manager), group_name_(group_name), node_id_(node_id), node_dc_(node_dc) {}
+      : config_manager_(config_manager),
+        group_name_(group_name),
+        node_id_(node_id),
+        node_dc_(node_dc),
+        table_routes_(std::make_shared<TableRouteMap>()) {}
   virtual ~DatabaseManager();
   virtual void init(uint32_t loader_thread_nums, const std::string& replicator_service_name,
                     const std::string& replicator_host, uint32_t replicator_port);
@@ -66,6 +81,8 @@ class DatabaseManager : public std::enable_shared_from_this<DatabaseManager> {
   virtual inline uint32_t getNodeId() const { return node_id_; }
   virtual void updatePartitions(const PartitionPtrSet& mount_partitions, const PartitionPtrSet& unmount_partitions);
   virtual folly::Optional<std::weak_ptr<RocksDbEngine>> getDatabaseHandler(const std::shared_ptr<Partition>& partition);
+  // 请求路径上使用的路由快照，每次配置或 partition 变更后整体重建
+  virtual std::shared_ptr<const TableRouteMap> getTableRoutes() { return table_routes_.load(); }
   virtual std::shared_ptr<RocksDbConfigFactory> getRocksdbConfigFactory() { return rocksdb_config_factory_; }
   virtual void triggerBase(const std::string& database_name, const std::string& table_name, const std::string& version);
   virtual void triggerDelta(const std::string& database_name, const std::string& table_name,
@@ -105,9 +122,17 @@ class DatabaseManager : public std::enable_shared_from_this<DatabaseManager> {
   std::unique_ptr<DatabaseManagerTimerThread> timer_thread_;
   std::unique_ptr<metrics::MetricsThread> self_hold_metrics_thread_;
   std::unique_ptr<folly::AsyncTimeout> expire_timer_;
+  // timer 线程定时为每个 partition 提交清理任务，清理在线程池中执行，避免限速等待阻塞 timer 线程
+  std::shared_ptr<folly::CPUThreadPoolExecutor> ttl_sweep_thread_pool_;
+  std::unique_ptr<folly::AsyncTimeout> ttl_sweep_timeout_;
+  std::shared_ptr<rocksdb::RateLimiter> ttl_sweep_rate_limiter_;
+  std::unique_ptr<folly::AsyncTimeout> follower_lag_timeout_;
   folly::Synchronized<std::unordered_map<uint64_t, std::shared_ptr<TableMonitor>>> table_monitors_;
   folly::Synchronized<std::unordered_map<int64_t, std::shared_ptr<PartitionHandler>>> partition_handlers_;
   folly::Synchronized<std::vector<uint32_t>> unavailable_shards_;
+  // 路由按版本整体发布，请求路径读取时不加锁，重建过程由 table_routes_mutex_ 串行化
+  folly::atomic_shared_ptr<TableRouteMap> table_routes_;
+  std::mutex table_routes_mutex_;
 
   virtual std::shared_ptr<folly::CPUThreadPoolExecutor> createLoaderThreadPool(uint32_t thread_nums);
   virtual std::shared_ptr<PartitionManager> createPartitionManager();
@@ -121,9 +146,11 @@ class DatabaseManager : public std::enable_shared_from_this<DatabaseManager> {
   virtual std::shared_ptr<TableMonitor> getOrCreateTableMonitor(const std::string& database_name,
                                                                 const std::string& table_name);
   virtual std::shared_ptr<PartitionHandler> getOrCreatePartitionHandler(const std::shared_ptr<Partition>& partition);
+  virtual std::shared_ptr<PartitionHandler> createPartitionHandler(const std::shared_ptr<Partition>& partition);
   virtual folly::Optional<std::shared_ptr<PartitionHandler>> getPartitionHandler(
       const std::shared_ptr<Partition>& partition);
   void removePartitionHandler(const std::shared_ptr<Partition>& partition);
+  void rebuildTableRoutes();
 
   virtual void updateServerShard();
   virtual int64_t getShardUniqueId(uint32_t shard_id, const DBRole& role);
@@ -135,6 +162,9 @@ class DatabaseManager : public std::enable_shared_from_this<DatabaseManager> {
   virtual double getTableMountedPartitionNumberByRole(const std::string& database_name, const std::string& table_name,
                                                       const DBRole& role);
   virtual void delaySetAvailable();
+  virtual void sweepExpiredKeys();
+  // 按 shard 汇总 follower 的数据延迟，通过服务注册的 other settings 上报给客户端
+  virtual void reportFollowerLag();
 };
 
 }  // namespace laser
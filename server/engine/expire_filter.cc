@@ -26,6 +26,10 @@
 
 namespace laser {
 
+DECLARE_bool(rocksdb_engine_merge_write);
+DEFINE_int64(expire_filter_merge_grace_ms, 86400000,
+             "Expired counter values are kept for this time so that pending merge operands can apply");
+
 constexpr char LASER_ROCKSDB_ENGINE_DELETE_EXPIRE[] = "expire_delete";
 
 ExpireFilter::ExpireFilter() {
@@ -41,7 +45,22 @@ bool ExpireFilter::Filter(int level, const rocksdb::Slice& key, const rocksdb::S
   if (!val.decode()) {
     return false;
   }
-  if (val.getTimestamp() > current_time || val.getTimestamp() == 0) {
+  uint64_t expire_time = val.getTimestamp();
+  if (expire_time == 0) {
+    return false;
+  }
+  // meta 中的版本号是重新创建 key 时版本号的下界，删除 meta 需要同时回收 data 行，交给 TTL 清理
+  bool is_meta = !key.empty() && static_cast<uint8_t>(key[0]) == static_cast<uint8_t>(KeyType::DEFAULT);
+  if (is_meta && val.getVersion() != 0 &&
+      (val.getType() == ValueType::MAP || val.getType() == ValueType::LIST || val.getType() == ValueType::SET ||
+       val.getType() == ValueType::ZSET)) {
+    return false;
+  }
+  // 尚未合并的 counter 操作数可能写入在过期之前，需要保留原有的值直到操作数合并
+  if (FLAGS_rocksdb_engine_merge_write && val.getType() == ValueType::COUNTER) {
+    expire_time += static_cast<uint64_t>(FLAGS_expire_filter_merge_grace_ms);
+  }
+  if (expire_time > current_time) {
     return false;
   }
   delete_meter_->mark();
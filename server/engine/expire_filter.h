@@ -18,11 +18,15 @@
 
 #pragma once
 
+#include <memory>
+
 #include "rocksdb/compaction_filter.h"
 #include "rocksdb/slice.h"
 #include "common/metrics/metrics.h"
 
 namespace laser {
+
+// 只回收自身带有过期时间的行。带版本号的复合类型 meta 过期后保留，由 TTL 清理删除 meta 并回收旧版本的 data 行
 class ExpireFilter : public rocksdb::CompactionFilter {
  public:
   ExpireFilter();
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#include "merge_operator.h"
+#include "rocksdb.h"
+
+namespace laser {
+
+constexpr char LASER_ROCKSDB_ENGINE_MERGE_IGNORE[] = "merge_operand_ignore";
+
+LaserMergeOperator::LaserMergeOperator() {
+  std::unordered_map<std::string, std::string> tags;
+  ignore_meter_ = metrics::Metrics::getInstance()->buildMeter(LASER_ROCKSDB_ENGINE_MODULE_NAME,
+                                                              LASER_ROCKSDB_ENGINE_MERGE_IGNORE, tags);
+}
+
+bool LaserMergeOperator::FullMergeV2(const MergeOperationInput& merge_in, MergeOperationOutput* merge_out) const {
+  bool exists = false;
+  ValueType type = ValueType::RAW_STRING;
+  uint64_t timestamp = 0;
+  int64_t counter = 0;
+  std::string data;
+
+  if (merge_in.existing_value) {
+    const rocksdb::Slice& existing = *merge_in.existing_value;
+    LaserValueFormatBase base(existing.data(), existing.size());
+    if (!base.decode()) {
+      return false;
+    }
+    // 复合类型的 meta 不参与合并
+    if (base.getType() != ValueType::COUNTER && base.getType() != ValueType::RAW_STRING) {
+      ignore_meter_->mark(static_cast<double>(merge_in.operand_list.size()));
+      merge_out->existing_operand = existing;
+      return true;
+    }
+
+    exists = true;
+    type = base.getType();
+    timestamp = base.getTimestamp();
+    if (type == ValueType::COUNTER) {
+      LaserValueCounter value(existing.data(), existing.size());
+      if (!value.decode()) {
+        return false;
+      }
+      counter = value.getValue();
+    } else {
+      LaserValueRawString value(existing.data(), existing.size());
+      // 空字符串没有写入长度，decode 会失败
+      if (value.decode()) {
+        data = value.getValue();
+      }
+    }
+  }
+
+  for (auto& operand_slice : merge_in.operand_list) {
+    LaserMergeOperand operand(operand_slice.data(), operand_slice.size());
+    if (!operand.decode()) {
+      return false;
+    }
+    ValueType operand_type =
+        (operand.getType() == MergeOperandType::COUNTER_ADD) ? ValueType::COUNTER : ValueType::RAW_STRING;
+    bool expired = exists && timestamp != 0 && timestamp < operand.getWriteTime();
+    if (!exists || expired) {
+      exists = true;
+      type = operand_type;
+      counter = 0;
+      data.clear();
+    } else if (type != operand_type) {
+      ignore_meter_->mark();
+      continue;
+    }
+
+    if (type == ValueType::COUNTER) {
+      counter += operand.getStep();
+    } else {
+      data.append(operand.getData());
+    }
+    timestamp = operand.getTimestamp();
+  }
+
+  if (type == ValueType::COUNTER) {
+    LaserValueCounter value(counter);
+    value.setTimestamp(timestamp);
+    value.encode();
+    merge_out->new_value.assign(value.data(), value.length());
+  } else {
+    LaserValueRawString value(data);
+    value.setTimestamp(timestamp);
+    value.encode();
+    merge_out->new_value.assign(value.data(), value.length());
+  }
+  return true;
+}
+
+const char* LaserMergeOperator::Name() const { return "LaserMergeOperator"; }
+
+}  // namespace laser
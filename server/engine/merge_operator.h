@@ -0,0 +1,41 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#pragma once
+
+#include "rocksdb/merge_operator.h"
+#include "rocksdb/slice.h"
+#include "common/laser/format.h"
+#include "common/metrics/metrics.h"
+
+namespace laser {
+
+// 合并 counter 的增量和 string 的 append 操作数，原有的值在操作数写入时已经过期则从空值开始，
+// 原有的值类型不一致时忽略操作数，保持原有的值不变
+class LaserMergeOperator : public rocksdb::MergeOperator {
+ public:
+  LaserMergeOperator();
+  ~LaserMergeOperator() = default;
+  bool FullMergeV2(const MergeOperationInput& merge_in, MergeOperationOutput* merge_out) const override;
+  const char* Name() const override;
+
+ private:
+  std::shared_ptr<metrics::Meter> ignore_meter_;
+};
+
+}  // namespace laser
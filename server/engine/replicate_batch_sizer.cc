@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#include "replicate_batch_sizer.h"
+
+#include <algorithm>
+
+namespace laser {
+
+ReplicateBatchSizer::ReplicateBatchSizer(int64_t min_size, int64_t max_size, int64_t initial_size,
+                                         int64_t target_latency_ms)
+    : min_size_(std::max<int64_t>(min_size, 1)),
+      max_size_limit_(std::max(max_size, min_size_)),
+      target_latency_ms_(std::max<int64_t>(target_latency_ms, 1)) {
+  max_size_.store(clamp(initial_size), std::memory_order_relaxed);
+}
+
+void ReplicateBatchSizer::update(int64_t lag, int64_t response_size, int64_t latency_ms) {
+  int64_t size = max_size_.load(std::memory_order_relaxed);
+  if (lag <= 0) {
+    // 已经追上 leader，每次缩小四分之一
+    size -= size / 4;
+  } else if (latency_ms > target_latency_ms_) {
+    size /= 2;
+  } else if (response_size * 2 >= size) {
+    // response 受大小限制时按写入速度估算目标耗时内能处理的数据量，每次最多翻倍
+    int64_t estimate = response_size * target_latency_ms_ / std::max<int64_t>(latency_ms, 1);
+    size = std::max(size, std::min(size * 2, estimate));
+  }
+  max_size_.store(clamp(size), std::memory_order_relaxed);
+}
+
+int64_t ReplicateBatchSizer::clamp(int64_t size) const { return std::min(std::max(size, min_size_), max_size_limit_); }
+
+}  // namespace laser
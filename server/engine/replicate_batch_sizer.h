@@ -0,0 +1,46 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace laser {
+
+// follower 根据落后的 sequence 数量、一次 pull 从发起到写入完成的耗时以及写入速度调整每次 pull 的大小，
+// 落后时在耗时不超过目标的前提下尽快增大，追上后逐渐缩小，避免空闲的 follower 占用大块的 response 缓存
+class ReplicateBatchSizer {
+ public:
+  ReplicateBatchSizer(int64_t min_size, int64_t max_size, int64_t initial_size, int64_t target_latency_ms);
+  ~ReplicateBatchSizer() = default;
+
+  int64_t getMaxSize() const { return max_size_.load(std::memory_order_relaxed); }
+  // lag 为 response 之后 leader 还未同步的 sequence 数量，latency_ms 包含 rpc 和写入的耗时
+  void update(int64_t lag, int64_t response_size, int64_t latency_ms);
+
+ private:
+  int64_t min_size_;
+  int64_t max_size_limit_;
+  int64_t target_latency_ms_;
+  std::atomic<int64_t> max_size_{0};
+
+  int64_t clamp(int64_t size) const;
+};
+
+}  // namespace laser
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+
+#include "common/laser/status.h"
+#include "common/util.h"
+
+#include "replicate_batcher.h"
+
+namespace laser {
+
+DECLARE_int32(replicator_max_server_wait_time_ms);
+DECLARE_int32(replicator_client_server_timeout_difference_ms);
+
+DEFINE_int32(replicator_max_size_per_batch, 4 * 1024 * 1024,
+             "Max size of RocksDB updates a batch replicate response can contain");
+
+bool ReplicateBatcher::addRequest(const service_router::ClientOption& option, const ReplicateRequest& request,
+                                  std::weak_ptr<ReplicationDB> db, ReplicateCallback callback) {
+  service_router::ServerAddress server_address;
+  if (!service_router::serviceClient(&server_address, option)) {
+    return false;
+  }
+
+  std::string address = folly::to<std::string>(server_address.getHost(), ":", server_address.getPort());
+  bool need_send = upstreams_.withWLock([&](auto& upstreams) {
+    auto& upstream = upstreams[address];
+    upstream.option = option;
+    upstream.pending[request.db_hash] = PendingRequest{request, std::move(db), std::move(callback)};
+    if (upstream.in_flight) {
+      return false;
+    }
+    upstream.in_flight = true;
+    return true;
+  });
+  if (need_send) {
+    sendBatch(address);
+  }
+  return true;
+}
+
+void ReplicateBatcher::removeRequest(int64_t db_hash) {
+  upstreams_.withWLock([db_hash](auto& upstreams) {
+    for (auto& upstream : upstreams) {
+      upstream.second.pending.erase(db_hash);
+    }
+  });
+}
+
+void ReplicateBatcher::sendBatch(const std::string& address) {
+  auto requests = std::make_shared<PendingRequests>();
+  service_router::ClientOption option;
+  upstreams_.withWLock([&](auto& upstreams) {
+    auto& upstream = upstreams[address];
+    for (auto& pending : upstream.pending) {
+      requests->push_back(std::move(pending.second));
+    }
+    upstream.pending.clear();
+    upstream.in_flight = !requests->empty();
+    option = upstream.option;
+  });
+  if (requests->empty()) {
+    return;
+  }
+
+  BatchReplicateRequest batch_request;
+  for (auto& pending : *requests) {
+    batch_request.requests.push_back(pending.request);
+  }
+  batch_request.max_wait_ms = FLAGS_replicator_max_server_wait_time_ms;
+  batch_request.max_size = static_cast<int64_t>(FLAGS_replicator_max_size_per_batch);
+  batch_request.timestamp = static_cast<int64_t>(common::currentTimeInMs());
+  apache::thrift::RpcOptions rpc_options;
+  rpc_options.setTimeout(std::chrono::milliseconds(FLAGS_replicator_max_server_wait_time_ms +
+                                                   FLAGS_replicator_client_server_timeout_difference_ms));
+  VLOG(5) << "Start batch pull updates from " << address << " partitions:" << requests->size();
+
+  std::weak_ptr<ReplicateBatcher> weak_batcher = shared_from_this();
+  auto send_request = [&rpc_options, &batch_request, &address, &requests, weak_batcher, this](auto client) {
+    client->future_replicateBatch(rpc_options, batch_request)
+        .via(executor_.get())
+        .then([weak_batcher, address, requests](folly::Try<BatchReplicateResponse>&& t) {
+          auto batcher = weak_batcher.lock();
+          if (batcher == nullptr) {
+            return;
+          }
+          batcher->processBatchResponse(address, requests, std::move(t));
+        });
+  };
+
+  bool ret = service_router::thriftServiceCall<ReplicatorAsyncClient>(option, std::move(send_request));
+  if (!ret) {
+    auto ex = createLaserException(Status::RP_SOURCE_NOT_FOUND,
+                                   folly::to<std::string>("Send batch replicate request to ", address, " fail"));
+    processBatchResponse(address, requests, folly::Try<BatchReplicateResponse>(folly::exception_wrapper(ex)));
+  }
+}
+
+void ReplicateBatcher::processBatchResponse(const std::string& address, std::shared_ptr<PendingRequests> requests,
+                                            folly::Try<BatchReplicateResponse>&& try_response) {
+  // 回调中 follower 会立即发起下一次同步请求，这些请求都在 in_flight 期间加入，处理完后一起发送
+  PendingRequests idle_requests;
+  for (auto& pending : *requests) {
+    if (try_response.hasException()) {
+      pending.callback(folly::Try<ReplicateResponse>(try_response.exception()));
+      continue;
+    }
+
+    int64_t db_hash = pending.request.db_hash;
+    auto& response = try_response.value();
+    auto found = response.responses.find(db_hash);
+    if (found != response.responses.end()) {
+      pending.callback(folly::Try<ReplicateResponse>(std::move(found->second)));
+      continue;
+    }
+    auto found_ex = response.exceptions.find(db_hash);
+    if (found_ex != response.exceptions.end()) {
+      pending.callback(folly::Try<ReplicateResponse>(folly::exception_wrapper(std::move(found_ex->second))));
+      continue;
+    }
+    // 没有更新的 partition 不需要回调，用 leader 返回的进度刷新同步延迟后原样放回下一轮
+    auto db = pending.db.lock();
+    if (!db) {
+      continue;
+    }
+    auto idle_states = response.get_idle_states();
+    if (idle_states) {
+      auto found_state = idle_states->find(db_hash);
+      if (found_state != idle_states->end()) {
+        db->applyIdleReplicateState(found_state->second);
+      }
+    }
+    idle_requests.push_back(std::move(pending));
+  }
+
+  upstreams_.withWLock([&address, &idle_requests](auto& upstreams) {
+    auto& upstream = upstreams[address];
+    for (auto& pending : idle_requests) {
+      upstream.pending.emplace(pending.request.db_hash, std::move(pending));
+    }
+  });
+  sendBatch(address);
+}
+
+}  // namespace laser
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+
+#pragma once
+
+#include <unordered_map>
+
+#include "folly/Function.h"
+#include "folly/Synchronized.h"
+#include "folly/executors/IOExecutor.h"
+
+#include "common/laser/if/gen-cpp2/Replicator.h"
+#include "common/service_router/router.h"
+
+namespace laser {
+
+class ReplicationDB;
+
+using ReplicateCallback = folly::Function<void(folly::Try<ReplicateResponse>&&)>;
+
+// follower 端将发往同一个 leader 节点的同步请求合并为一个 replicateBatch RPC，
+// 每个 leader 节点同时只有一个请求在途，在途期间到达的请求在下一轮一起发送
+class ReplicateBatcher : public std::enable_shared_from_this<ReplicateBatcher> {
+ public:
+  explicit ReplicateBatcher(std::shared_ptr<folly::IOExecutor> executor) : executor_(executor) {}
+  virtual ~ReplicateBatcher() = default;
+
+  // 找不到 leader 节点时返回 false
+  virtual bool addRequest(const service_router::ClientOption& option, const ReplicateRequest& request,
+                          std::weak_ptr<ReplicationDB> db, ReplicateCallback callback);
+  virtual void removeRequest(int64_t db_hash);
+
+ private:
+  struct PendingRequest {
+    ReplicateRequest request;
+    std::weak_ptr<ReplicationDB> db;
+    ReplicateCallback callback;
+  };
+  struct Upstream {
+    service_router::ClientOption option;
+    bool in_flight{false};
+    std::unordered_map<int64_t, PendingRequest> pending;
+  };
+  using PendingRequests = std::vector<PendingRequest>;
+
+  std::shared_ptr<folly::IOExecutor> executor_;
+  folly::Synchronized<std::unordered_map<std::string, Upstream>> upstreams_;
+
+  void sendBatch(const std::string& address);
+  void processBatchResponse(const std::string& address, std::shared_ptr<PendingRequests> requests,
+                            folly::Try<BatchReplicateResponse>&& try_response);
+};
+
+}  // namespace laser
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+
+#include <cstring>
+#include <limits>
+
+#include "lz4.h"
+#include "zstd.h"
+
+#include "folly/io/Cursor.h"
+
+#include "replicate_compression.h"
+
+namespace laser {
+
+DEFINE_int32(replicator_compression_zstd_level, 1, "Zstd level used to compress replicate responses");
+
+DEFINE_int32(replicator_compression_pool_max_bytes, 16 * 1024 * 1024,
+             "Max size of the per thread buffer reused by replicate compression");
+
+// 每个 update 的头部，8 字节 timestamp + 4 字节长度
+constexpr size_t COMPRESSED_UPDATE_HEADER_SIZE = sizeof(int64_t) + sizeof(uint32_t);
+
+namespace {
+
+struct ZstdContextDeleter {
+  void operator()(ZSTD_CCtx* ctx) const { ZSTD_freeCCtx(ctx); }
+  void operator()(ZSTD_DCtx* ctx) const { ZSTD_freeDCtx(ctx); }
+};
+
+// 线程内复用的缓冲区，超过上限时在下次使用前释放
+class PooledBuffer {
+ public:
+  char* get(size_t size) {
+    if (buffer_.size() > static_cast<size_t>(FLAGS_replicator_compression_pool_max_bytes)) {
+      std::string().swap(buffer_);
+    }
+    if (buffer_.size() < size) {
+      buffer_.resize(size);
+    }
+    return &buffer_[0];
+  }
+ private:
+  std::string buffer_;
+};
+
+thread_local PooledBuffer compress_input_buffer;
+thread_local PooledBuffer decompress_output_buffer;
+thread_local std::unique_ptr<ZSTD_CCtx, ZstdContextDeleter> zstd_compress_context;
+thread_local std::unique_ptr<ZSTD_DCtx, ZstdContextDeleter> zstd_decompress_context;
+
+}  // namespace
+
+folly::Optional<ReplicateCompressionType> stringToReplicateCompressionType(const std::string& name) {
+  if (name == "none") {
+    return ReplicateCompressionType::NONE;
+  }
+  if (name == "lz4") {
+    return ReplicateCompressionType::LZ4;
+  }
+  if (name == "zstd") {
+    return ReplicateCompressionType::ZSTD;
+  }
+
+  return folly::none;
+}
+
+bool compressUpdates(folly::IOBuf* output, int64_t* uncompressed_size, const ReplicateCompressionType& type,
+                     const std::vector<Update>& updates) {
+  size_t input_size = 0;
+  for (auto& update : updates) {
+    input_size += COMPRESSED_UPDATE_HEADER_SIZE + update.raw_data.computeChainDataLength();
+  }
+  if (input_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    return false;
+  }
+
+  char* input = compress_input_buffer.get(input_size);
+  size_t offset = 0;
+  for (auto& update : updates) {
+    uint32_t length = static_cast<uint32_t>(update.raw_data.computeChainDataLength());
+    int64_t timestamp = folly::Endian::little(update.timestamp);
+    memcpy(input + offset, &timestamp, sizeof(timestamp));
+    uint32_t encoded_length = folly::Endian::little(length);
+    memcpy(input + offset + sizeof(timestamp), &encoded_length, sizeof(encoded_length));
+    offset += COMPRESSED_UPDATE_HEADER_SIZE;
+    folly::io::Cursor cursor(&update.raw_data);
+    cursor.pull(input + offset, length);
+    offset += length;
+  }
+
+  size_t compressed_size = 0;
+  std::unique_ptr<folly::IOBuf> compressed;
+  if (type == ReplicateCompressionType::LZ4) {
+    int bound = LZ4_compressBound(static_cast<int>(input_size));
+    compressed = folly::IOBuf::create(bound);
+    int ret = LZ4_compress_default(input, reinterpret_cast<char*>(compressed->writableData()),
+                                   static_cast<int>(input_size), bound);
+    if (ret <= 0) {
+      return false;
+    }
+    compressed_size = static_cast<size_t>(ret);
+  } else if (type == ReplicateCompressionType::ZSTD) {
+    if (!zstd_compress_context) {
+      zstd_compress_context.reset(ZSTD_createCCtx());
+    }
+    size_t bound = ZSTD_compressBound(input_size);
+    compressed = folly::IOBuf::create(bound);
+    size_t ret = ZSTD_compressCCtx(zstd_compress_context.get(), compressed->writableData(), bound, input,
+                                   input_size, FLAGS_replicator_compression_zstd_level);
+    if (ZSTD_isError(ret)) {
+      return false;
+    }
+    compressed_size = ret;
+  } else {
+    return false;
+  }
+
+  compressed->append(compressed_size);
+  *output = std::move(*compressed);
+  *uncompressed_size = static_cast<int64_t>(input_size);
+  return true;
+}
+
+bool decompressUpdates(std::vector<Update>* updates, const ReplicateCompressionType& type,
+                       const folly::IOBuf& input, int64_t uncompressed_size) {
+  if (uncompressed_size < 0 || uncompressed_size > std::numeric_limits<int>::max()) {
+    return false;
+  }
+
+  size_t output_size = static_cast<size_t>(uncompressed_size);
+  char* output = decompress_output_buffer.get(output_size);
+  // 接收到的数据可能是多个 IOBuf 组成的链，解压前需要连续的内存
+  folly::IOBuf contiguous = input.isChained() ? input.cloneCoalescedAsValue() : input.cloneAsValue();
+  folly::ByteRange compressed = contiguous.coalesce();
+  if (type == ReplicateCompressionType::LZ4) {
+    int ret = LZ4_decompress_safe(reinterpret_cast<const char*>(compressed.data()), output,
+                                  static_cast<int>(compressed.size()), static_cast<int>(output_size));
+    if (ret < 0 || static_cast<size_t>(ret) != output_size) {
+      return false;
+    }
+  } else if (type == ReplicateCompressionType::ZSTD) {
+    if (!zstd_decompress_context) {
+      zstd_decompress_context.reset(ZSTD_createDCtx());
+    }
+    size_t ret = ZSTD_decompressDCtx(zstd_decompress_context.get(), output, output_size, compressed.data(),
+                                     compressed.size());
+    if (ZSTD_isError(ret) || ret != output_size) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+
+  size_t offset = 0;
+  while (offset < output_size) {
+    if (output_size - offset < COMPRESSED_UPDATE_HEADER_SIZE) {
+      return false;
+    }
+    int64_t timestamp;
+    memcpy(&timestamp, output + offset, sizeof(timestamp));
+    uint32_t length;
+    memcpy(&length, output + offset + sizeof(timestamp), sizeof(length));
+    length = folly::Endian::little(length);
+    offset += COMPRESSED_UPDATE_HEADER_SIZE;
+    if (output_size - offset < length) {
+      return false;
+    }
+    Update update;
+    update.timestamp = folly::Endian::little(timestamp);
+    update.raw_data = folly::IOBuf::wrapBufferAsValue(output + offset, length);
+    updates->emplace_back(std::move(update));
+    offset += length;
+  }
+  return true;
+}
+
+}  // namespace laser
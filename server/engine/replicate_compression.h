@@ -0,0 +1,41 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include "folly/Optional.h"
+#include "folly/io/IOBuf.h"
+
+#include "common/laser/if/gen-cpp2/laser_replication_types.h"
+
+namespace laser {
+
+folly::Optional<ReplicateCompressionType> stringToReplicateCompressionType(const std::string& name);
+
+// 压缩前先将所有 update 按 (8 字节 timestamp, 4 字节长度, WriteBatch 数据) 的格式拼接，再整体压缩
+bool compressUpdates(folly::IOBuf* output, int64_t* uncompressed_size, const ReplicateCompressionType& type,
+                     const std::vector<Update>& updates);
+
+// 解压到线程内复用的缓冲区，返回的 update 引用该缓冲区，只能在当前线程下一次解压之前使用
+bool decompressUpdates(std::vector<Update>* updates, const ReplicateCompressionType& type,
+                       const folly::IOBuf& input, int64_t uncompressed_size);
+
+}  // namespace laser
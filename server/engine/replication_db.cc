@@ -18,17 +18,29 @@
  * @author liubang <it.liubang@gmail.com>
  */
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+
 #include "boost/filesystem.hpp"
 #include "folly/ExceptionWrapper.h"
 #include "folly/ScopeGuard.h"
+#include "folly/io/Cursor.h"
+#include "folly/lang/Bits.h"
 
 #include "common/laser/if/gen-cpp2/ReplicatorAsyncClient.h"
 #include "common/laser/status.h"
 #include "common/util.h"
 
 #include "expire_filter.h"
+#include "merge_operator.h"
+#include "replicate_batch_sizer.h"
+#include "replicate_batcher.h"
+#include "replicate_compression.h"
 #include "replication_db.h"
+#include "row_cache.h"
 #include "scoped_key_lock.h"
+#include "wal_tail_ring.h"
 
 namespace laser {
 
@@ -62,6 +74,52 @@ DEFINE_int32(repliction_max_seq_no_diff_time_window_seconds, 5 * 60,
 
 DEFINE_int32(replication_max_seq_no_diff_minute_level, 1, "Max seq no diff minure level");
 
+DEFINE_int32(replicator_apply_group_max_updates, 100,
+             "Max number of replicated updates merged into one follower write, 1 means no grouping");
+
+DEFINE_int32(replicator_apply_group_max_bytes, 4 * 1024 * 1024,
+             "Max size of replicated updates merged into one follower write");
+
+DEFINE_bool(replicator_stream_enable, false, "Enable leader pushing updates to follower by thrift stream");
+
+DEFINE_int32(replicator_stream_credits, 64,
+             "Max number of responses a leader can push in one replication stream, also the client buffer size");
+
+DEFINE_int32(replicator_stream_max_unacked_bytes, 16 * 1024 * 1024,
+             "Max size of updates a leader pushes in a replication stream before the follower acks them, 0 means "
+             "unlimited");
+
+DEFINE_int32(replicator_stream_fallback_pulls, 100,
+             "Number of pull requests to send after the replication stream fails before retrying the stream");
+
+DEFINE_int32(replicator_apply_max_pending_bytes, 16 * 1024 * 1024,
+             "Max size of pulled updates waiting to be applied before a follower stops pulling ahead");
+
+DEFINE_string(replicator_compression_type, "none",
+              "Compression type the follower accepts for replicate responses, none, lz4 or zstd");
+
+DEFINE_int32(replicator_wal_tail_ring_max_batches, 0,
+             "Max number of recently written batches a leader keeps in memory for followers, 0 means disabled");
+
+DEFINE_int32(replicator_wal_tail_ring_max_bytes, 4 * 1024 * 1024,
+             "Max size of recently written batches a leader keeps in memory for followers");
+
+DEFINE_int32(replicator_compression_min_bytes, 4 * 1024, "Min size of the updates in a response to compress");
+
+DEFINE_bool(replicator_adaptive_batch_enable, false,
+            "Whether followers adjust the size of each pull by replication lag, latency and apply rate");
+
+DEFINE_int32(replicator_min_size_per_response, 64 * 1024, "Min size of RocksDB updates an adaptive pull asks for");
+
+DEFINE_int32(replicator_adaptive_max_size_per_response, 32 * 1024 * 1024,
+             "Max size of RocksDB updates an adaptive pull asks for, leaders also cap requests with it");
+
+DEFINE_int32(replicator_adaptive_target_latency_ms, 200,
+             "Target time of pulling and applying one response when followers adjust the pull size");
+
+DEFINE_int32(replicator_sync_ack_timeout_ms, 100,
+             "Max wait time for followers to ack a semi-synchronous write before it degrades to asynchronous");
+
 constexpr char REPLICATION_DB_MODULE_NAME[] = "replication_db";
 constexpr char REPLICATION_DB_REPLICATOR_LATENCY[] = "replicator_latency";
 constexpr char REPLICATION_DB_REPLICATOR_PULL_RPC_REQUEST_LATENCY[] = "pull_rpc_request_latency";
@@ -76,10 +134,23 @@ constexpr char REPLICATION_DB_LEADER_INTERVAL_BETWEEN_WRITE_AND_REPLICATE[] = "i
 constexpr char REPLICATION_DB_WRITE_TIME[] = "write_timers";
 constexpr char REPLICATION_DB_WRITE_TIME_WITHOUT_LOCK[] = "write_timers_without_lock";
 constexpr char REPLICATION_DB_READ_TIME[] = "read_timers";
+constexpr char REPLICATION_DB_MULTI_READ_TIME[] = "multi_read_timers";
+constexpr char REPLICATION_DB_REPLICATOR_APPLY_BACKPRESSURE[] = "apply_backpressure";
+constexpr char REPLICATION_DB_REPLICATOR_COMPRESSION_RATIO[] = "compression_ratio";
+constexpr char REPLICATION_DB_REPLICATOR_COMPRESS_TIMERS[] = "compress_timers";
+constexpr char REPLICATION_DB_REPLICATOR_DECOMPRESS_TIMERS[] = "decompress_timers";
+constexpr char REPLICATION_DB_REPLICATOR_PULL_MAX_SIZE[] = "pull_max_size_kb";
+constexpr char REPLICATION_DB_REPLICATOR_RESPONSE_SIZE[] = "response_size_kb";
+constexpr char REPLICATION_DB_REPLICATOR_SYNC_ACK_TIMEOUT[] = "sync_ack_timeout";
+constexpr double REPLICATION_DB_REPLICATOR_SIZE_BUCKET_SIZE = 64.0;
+constexpr double REPLICATION_DB_REPLICATOR_SIZE_MIN = 0.0;
+constexpr double REPLICATION_DB_REPLICATOR_SIZE_MAX = 65536.0;
 constexpr double REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE = 1.0;
 constexpr double REPLICATION_DB_REPLICATOR_TIMER_MIN = 0.0;
 constexpr double REPLICATION_DB_REPLICATOR_TIMER_MAX = 1000.0;
 constexpr char BATCH_INGEST_CONVERT_FILE_SUBFFIX[] = "_sst";
+// rocksdb WriteBatch 头部，8 字节 sequence + 4 字节 count
+constexpr size_t WRITE_BATCH_HEADER_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
 // The magic number to clean table as the default
 constexpr char REPLICATION_DB_REPLICATOR_EMPTY_TABLE_KEY[] = "EMPTY_TABLE_KEY";
 constexpr char REPLICATION_DB_REPLICATOR_EMPTY_TABLE_VALUE[] = "EMPTY_TABLE_VALUE";
@@ -94,6 +165,17 @@ constexpr char ROCKSDB_WRITE_KPS_MIN_1[] = "rocksdb.write_kps_min_1";
 ReplicationDB::ReplicationDB(const std::string& data_dir, const rocksdb::Options& options)
     : data_dir_(data_dir), options_(options) {
   VLOG(3) << "Rocksdb create, data dir:" << data_dir_;
+  if (FLAGS_replicator_wal_tail_ring_max_batches > 0) {
+    wal_tail_ring_ = std::make_shared<WalTailRing>(static_cast<size_t>(FLAGS_replicator_wal_tail_ring_max_batches),
+                                                   static_cast<size_t>(FLAGS_replicator_wal_tail_ring_max_bytes));
+  }
+  if (FLAGS_replicator_adaptive_batch_enable) {
+    batch_sizer_ = std::make_shared<ReplicateBatchSizer>(
+        static_cast<int64_t>(FLAGS_replicator_min_size_per_response),
+        static_cast<int64_t>(FLAGS_replicator_adaptive_max_size_per_response),
+        static_cast<int64_t>(FLAGS_replicator_max_size_per_response),
+        static_cast<int64_t>(FLAGS_replicator_adaptive_target_latency_ms));
+  }
   get_updates_timers_ = metrics::Metrics::getInstance()->buildTimers(
       REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_GET_UPDATES, REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE,
       REPLICATION_DB_REPLICATOR_TIMER_MIN, REPLICATION_DB_REPLICATOR_TIMER_MAX);
@@ -117,8 +199,15 @@ ReplicationDB::ReplicationDB(const std::string& data_dir, const rocksdb::Options
       REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_APPLY_UPDATE_TIMERS,
       REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE, REPLICATION_DB_REPLICATOR_TIMER_MIN,
       REPLICATION_DB_REPLICATOR_TIMER_MAX);
+  replicator_latency_ = metrics::Metrics::getInstance()->buildHistograms(
+      REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_LATENCY, REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE,
+      REPLICATION_DB_REPLICATOR_TIMER_MIN, REPLICATION_DB_REPLICATOR_TIMER_MAX);
   apply_updates_kps_ = metrics::Metrics::getInstance()->buildMeter(REPLICATION_DB_MODULE_NAME,
                                                                    REPLICATION_DB_REPLICATOR_APPLY_UPDATE_KPS);
+  apply_backpressure_ = metrics::Metrics::getInstance()->buildMeter(REPLICATION_DB_MODULE_NAME,
+                                                                    REPLICATION_DB_REPLICATOR_APPLY_BACKPRESSURE);
+  sync_ack_timeout_ = metrics::Metrics::getInstance()->buildMeter(REPLICATION_DB_MODULE_NAME,
+                                                                  REPLICATION_DB_REPLICATOR_SYNC_ACK_TIMEOUT);
   interval_between_write_and_replicate_ = metrics::Metrics::getInstance()->buildHistograms(
       REPLICATION_DB_MODULE_NAME, REPLICATION_DB_LEADER_INTERVAL_BETWEEN_WRITE_AND_REPLICATE,
       REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE, REPLICATION_DB_REPLICATOR_TIMER_MIN,
@@ -132,6 +221,27 @@ ReplicationDB::ReplicationDB(const std::string& data_dir, const rocksdb::Options
   read_timers_ = metrics::Metrics::getInstance()->buildTimers(
       REPLICATION_DB_MODULE_NAME, REPLICATION_DB_READ_TIME, REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE,
       REPLICATION_DB_REPLICATOR_TIMER_MIN, REPLICATION_DB_REPLICATOR_TIMER_MAX);
+  multi_read_timers_ = metrics::Metrics::getInstance()->buildTimers(
+      REPLICATION_DB_MODULE_NAME, REPLICATION_DB_MULTI_READ_TIME, REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE,
+      REPLICATION_DB_REPLICATOR_TIMER_MIN, REPLICATION_DB_REPLICATOR_TIMER_MAX);
+  compression_ratio_ = metrics::Metrics::getInstance()->buildHistograms(
+      REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_COMPRESSION_RATIO,
+      REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE, REPLICATION_DB_REPLICATOR_TIMER_MIN,
+      REPLICATION_DB_REPLICATOR_TIMER_MAX);
+  compress_timers_ = metrics::Metrics::getInstance()->buildTimers(
+      REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_COMPRESS_TIMERS,
+      REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE, REPLICATION_DB_REPLICATOR_TIMER_MIN,
+      REPLICATION_DB_REPLICATOR_TIMER_MAX);
+  decompress_timers_ = metrics::Metrics::getInstance()->buildTimers(
+      REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_DECOMPRESS_TIMERS,
+      REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE, REPLICATION_DB_REPLICATOR_TIMER_MIN,
+      REPLICATION_DB_REPLICATOR_TIMER_MAX);
+  pull_max_size_ = metrics::Metrics::getInstance()->buildHistograms(
+      REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_PULL_MAX_SIZE, REPLICATION_DB_REPLICATOR_SIZE_BUCKET_SIZE,
+      REPLICATION_DB_REPLICATOR_SIZE_MIN, REPLICATION_DB_REPLICATOR_SIZE_MAX);
+  response_size_ = metrics::Metrics::getInstance()->buildHistograms(
+      REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_RESPONSE_SIZE, REPLICATION_DB_REPLICATOR_SIZE_BUCKET_SIZE,
+      REPLICATION_DB_REPLICATOR_SIZE_MIN, REPLICATION_DB_REPLICATOR_SIZE_MAX);
 }
 
 void ReplicationDB::init(folly::EventBase* evb) {
@@ -178,6 +288,7 @@ bool ReplicationDB::open() {
 
   rocksdb::DB* db = nullptr;
   options_.compaction_filter_factory = std::make_shared<ExpireFilterFactory>();
+  options_.merge_operator = std::make_shared<LaserMergeOperator>();
   rocksdb::Status status = rocksdb::DB::Open(options_, data_dir, &db);
   if (!status.ok()) {
     LOG(INFO) << "Create db fail, reason:" << status.ToString();
@@ -201,6 +312,23 @@ bool ReplicationDB::close() {
 
 void ReplicationDB::iterator(IteratorCallback callback) {
   rocksdb::ReadOptions read_options;
+  // 全量扫描和按类型前缀的扫描会跨越多个 key 前缀，不能使用 prefix bloom
+  read_options.total_order_seek = true;
+  read_options.snapshot = db_->GetSnapshot();
+  auto iter = db_->NewIterator(read_options);
+  SCOPE_EXIT { delete iter; };
+  callback(iter);
+  db_->ReleaseSnapshot(read_options.snapshot);
+}
+
+void ReplicationDB::prefixIterator(const LaserSerializer& prefix, IteratorCallback callback) {
+  rocksdb::ReadOptions read_options;
+  if (options_.prefix_extractor) {
+    rocksdb::Slice slice_prefix(prefix.data(), prefix.length());
+    // prefix 无法提取前缀时退化为全序遍历
+    read_options.prefix_same_as_start = options_.prefix_extractor->InDomain(slice_prefix);
+    read_options.total_order_seek = !read_options.prefix_same_as_start;
+  }
   read_options.snapshot = db_->GetSnapshot();
   auto iter = db_->NewIterator(read_options);
   SCOPE_EXIT { delete iter; };
@@ -224,15 +352,23 @@ Status ReplicationDB::delkey(const LaserKeyFormatBase& key) {
   }
 
   RocksDbBatch batch;
-  if (value.getType() == ValueType::SET || value.getType() == ValueType::MAP || value.getType() == ValueType::LIST) {
-    iterator([this, &key, &batch](auto iter) {
-      LaserKeyFormat prefix(key, KeyType::COMPOSITE);
-      rocksdb::Slice slice_key(prefix.data(), prefix.length());
-      for (iter->Seek(slice_key); iter->Valid() && iter->key().starts_with(slice_key); iter->Next()) {
-        LaserKeyFormat delete_key(iter->key().data(), iter->key().size());
-        batch.idelete(delete_key);
-      }
-    });
+  // 同时删除所有版本的 data 行，带版本号的复合类型在 RocksDbEngine::delkey 中只删除 meta
+  if (value.getType() == ValueType::SET || value.getType() == ValueType::MAP || value.getType() == ValueType::LIST ||
+      value.getType() == ValueType::ZSET) {
+    std::vector<KeyType> key_types({KeyType::COMPOSITE});
+    if (value.getType() == ValueType::ZSET) {
+      key_types.push_back(KeyType::ZSET_MEMBER);
+    }
+    for (auto& key_type : key_types) {
+      LaserKeyFormat prefix(key, key_type);
+      prefixIterator(prefix, [&prefix, &batch](auto iter) {
+        rocksdb::Slice slice_key(prefix.data(), prefix.length());
+        for (iter->Seek(slice_key); iter->Valid() && iter->key().starts_with(slice_key); iter->Next()) {
+          LaserKeyFormat delete_key(iter->key().data(), iter->key().size());
+          batch.idelete(delete_key);
+        }
+      });
+    }
   }
 
   batch.idelete(key);
@@ -397,6 +533,10 @@ Status ReplicationDB::innerIngestBaseSst(const std::string& final_ingest_file) {
   if (!status.ok()) {
     LOG(ERROR) << "Error while adding file " << final_ingest_file << " error " << status.ToString();
   }
+  // ingest 的 key 范围未知，直接清空点查缓存
+  if (row_cache_) {
+    row_cache_->clear();
+  }
   return convertRocksDbStatus(status);
 }
 
@@ -464,7 +604,7 @@ Status ReplicationDB::ingestDeltaSst(const std::string& ingest_file, const std::
     }
 
     for (auto& delta : delta_meta_kvs) {
-      ScopedKeyLock guard(std::string((*delta.first).data(), (*delta.first).length()));
+      ScopedKeyLock guard((*delta.first).data(), (*delta.first).length());
       if (Status::OK != delkey(*delta.first)) {
         continue;
       }
@@ -524,6 +664,12 @@ void RocksDbBatch::idelete(const LaserSerializer& key) {
   batch_.Delete(slice_key);
 }
 
+void RocksDbBatch::imerge(const LaserSerializer& key, const LaserSerializer& operand) {
+  rocksdb::Slice slice_key(key.data(), key.length());
+  rocksdb::Slice slice_operand(operand.data(), operand.length());
+  batch_.Merge(slice_key, slice_operand);
+}
+
 Status ReplicationDB::checkpoint(const std::string& checkpoint_path) {
   rocksdb::Checkpoint* checkpoint;
   rocksdb::Status status = rocksdb::Checkpoint::Create(db_.get(), &checkpoint);
@@ -546,6 +692,27 @@ Status ReplicationDB::checkpoint(const std::string& checkpoint_path) {
   return convertRocksDbStatus(status);
 }
 
+thread_local SyncAckCollector* current_sync_ack_collector = nullptr;
+
+SyncAckCollector::Scope::Scope(SyncAckCollector* collector) : prev_(current_sync_ack_collector) {
+  current_sync_ack_collector = collector;
+}
+
+SyncAckCollector::Scope::~Scope() { current_sync_ack_collector = prev_; }
+
+SyncAckCollector* SyncAckCollector::current() { return current_sync_ack_collector; }
+
+void SyncAckCollector::add(folly::SemiFuture<bool>&& future) { futures_.wlock()->push_back(std::move(future)); }
+
+folly::SemiFuture<folly::Unit> SyncAckCollector::wait() {
+  std::vector<folly::SemiFuture<bool>> futures;
+  futures_.withWLock([&futures](auto& pending) { futures.swap(pending); });
+  if (futures.empty()) {
+    return folly::makeSemiFuture();
+  }
+  return folly::collectAll(std::move(futures)).deferValue([](auto&&) {});
+}
+
 Status ReplicationDB::write(RocksDbBatch& batch) {
   if (role_ == DBRole::FOLLOWER) {
     return Status::RS_WRITE_IN_FOLLOWER;
@@ -561,7 +728,119 @@ Status ReplicationDB::write(RocksDbBatch& batch) {
     write_kps_meter_->mark(static_cast<double>(write_batch.Count()));
   }
   int64_t seq_no = 0;
-  return writeWithSeqNumber(write_batch, &seq_no, 0);
+  Status status = writeWithSeqNumber(write_batch, &seq_no, 0);
+  uint32_t sync_replicas = sync_replicas_;
+  if (status != Status::OK || sync_replicas == 0) {
+    return status;
+  }
+
+  // 等待 batch 中最后一条记录的 sequence 被确认，登记到 collector 中由调用方在释放 key 锁后等待
+  auto collector = SyncAckCollector::current();
+  if (collector == nullptr) {
+    return status;
+  }
+  const std::string& rep = write_batch.Data();
+  int64_t last_seq_no = static_cast<int64_t>(folly::Endian::little(folly::loadUnaligned<uint64_t>(rep.data()))) +
+                        static_cast<int64_t>(write_batch.Count()) - 1;
+  collector->add(waitForSyncReplicas(last_seq_no, sync_replicas));
+  return status;
+}
+
+folly::SemiFuture<bool> ReplicationDB::waitForSyncReplicas(int64_t seq_no, uint32_t replicas) {
+  std::pair<int64_t, uint64_t> waiter_key;
+  folly::SemiFuture<bool> future = folly::makeSemiFuture(false);
+  {
+    auto acks = follower_acks_.wlock();
+    if (getAckedSeqNo(*acks, replicas) >= seq_no) {
+      return folly::makeSemiFuture(true);
+    }
+    waiter_key = std::make_pair(seq_no, acks->next_waiter_id++);
+    folly::Promise<bool> promise;
+    future = promise.getSemiFuture();
+    acks->waiters.emplace(waiter_key, std::move(promise));
+  }
+
+  // 超时只记录指标，数据已经写入本地仍然返回成功
+  std::weak_ptr<ReplicationDB> weak_db = shared_from_this();
+  return std::move(future)
+      .within(std::chrono::milliseconds(FLAGS_replicator_sync_ack_timeout_ms))
+      .defer([weak_db, waiter_key](folly::Try<bool>&& t) {
+        if (t.hasValue()) {
+          return t.value();
+        }
+        auto db = weak_db.lock();
+        if (db) {
+          db->follower_acks_.wlock()->waiters.erase(waiter_key);
+          db->sync_ack_timeout_->mark();
+        }
+        return false;
+      });
+}
+
+int64_t ReplicationDB::getAckedSeqNo(const FollowerAcks& acks, uint32_t replicas) {
+  if (replicas == 0 || acks.acked_seq_nos.size() < replicas) {
+    return 0;
+  }
+  std::vector<int64_t> seq_nos;
+  seq_nos.reserve(acks.acked_seq_nos.size());
+  for (auto& acked : acks.acked_seq_nos) {
+    seq_nos.push_back(acked.second);
+  }
+  // 第 replicas 大的 seq 号之前的写入都已经被足够多的 follower 确认
+  std::nth_element(seq_nos.begin(), seq_nos.begin() + replicas - 1, seq_nos.end(), std::greater<int64_t>());
+  return seq_nos[replicas - 1];
+}
+
+void ReplicationDB::updateFollowerAck(const ReplicateRequest& request) {
+  if (role_ == DBRole::FOLLOWER) {
+    return;
+  }
+  uint32_t sync_replicas = sync_replicas_;
+  int64_t ack_seq_no = request.get_ack_seq_no() ? *request.get_ack_seq_no() : request.seq_no;
+
+  // 流式同步的流控也依赖 follower 的确认进度，没有开启半同步时同样记录
+  std::vector<folly::Promise<bool>> ready;
+  {
+    auto acks = follower_acks_.wlock();
+    auto& acked_seq_no = acks->acked_seq_nos[request.node_hash];
+    if (ack_seq_no <= acked_seq_no) {
+      return;
+    }
+    acked_seq_no = ack_seq_no;
+  }
+  if (stream_ack_cond_var_) {
+    stream_ack_cond_var_->notifyAll();
+  }
+  if (sync_replicas == 0) {
+    return;
+  }
+  {
+    auto acks = follower_acks_.wlock();
+    int64_t synced_seq_no = getAckedSeqNo(*acks, sync_replicas);
+    auto iter = acks->waiters.begin();
+    while (iter != acks->waiters.end() && iter->first.first <= synced_seq_no) {
+      ready.push_back(std::move(iter->second));
+      iter = acks->waiters.erase(iter);
+    }
+  }
+  for (auto& promise : ready) {
+    promise.setValue(true);
+  }
+}
+
+void ReplicationDB::clearFollowerAcks() {
+  std::vector<folly::Promise<bool>> waiters;
+  {
+    auto acks = follower_acks_.wlock();
+    acks->acked_seq_nos.clear();
+    for (auto& waiter : acks->waiters) {
+      waiters.push_back(std::move(waiter.second));
+    }
+    acks->waiters.clear();
+  }
+  for (auto& promise : waiters) {
+    promise.setValue(false);
+  }
 }
 
 Status ReplicationDB::writeWithSeqNumber(rocksdb::WriteBatch& write_batch, int64_t* seq_no, int64_t write_ms) {
@@ -571,6 +850,19 @@ Status ReplicationDB::writeWithSeqNumber(rocksdb::WriteBatch& write_batch, int64
   }
   write_batch.PutLogData(rocksdb::Slice(reinterpret_cast<const char*>(&write_ms), sizeof(write_ms)));
   rocksdb::Status status = db_->Write(default_write_options_, &write_batch);
+  // 写入 memtable 时 rocksdb 会把分配的 sequence 写回 batch 的头部
+  if (status.ok() && wal_tail_ring_ && role_ == DBRole::LEADER) {
+    const std::string& rep = write_batch.Data();
+    uint64_t sequence = folly::Endian::little(folly::loadUnaligned<uint64_t>(rep.data()));
+    if (sequence > 0) {
+      wal_tail_ring_->append(sequence, static_cast<uint32_t>(write_batch.Count()), write_ms, rep);
+    }
+  }
+  // 写入 db 之后再使缓存失效，leader 写入和 follower 同步的数据都经过这里
+  if (row_cache_) {
+    RowCacheInvalidator invalidator(row_cache_.get());
+    write_batch.Iterate(&invalidator);
+  }
   if (!status.ok()) {
     VLOG(10) << "Batch write value:" << status.ToString();
   } else {
@@ -587,9 +879,18 @@ Status ReplicationDB::writeWithSeqNumber(rocksdb::WriteBatch& write_batch, int64
 Status ReplicationDB::read(LaserValueFormatBase* value, const LaserSerializer& key) {
   metrics::Timer read_time(read_timers_.get());
   rocksdb::Slice slice_key(key.data(), key.length());
-  rocksdb::Status status = db_->Get(default_read_options_, slice_key, value->getRawBuffer());
-  if (!status.ok()) {
-    VLOG(10) << "Get value:" << status.ToString();
+  rocksdb::Status status;
+  if (!row_cache_ || !row_cache_->lookup(value->getRawBuffer(), slice_key)) {
+    uint64_t fill_token = row_cache_ ? row_cache_->beginFill(slice_key) : 0;
+    status = db_->Get(default_read_options_, slice_key, value->getRawBuffer());
+    if (!status.ok()) {
+      VLOG(10) << "Get value:" << status.ToString();
+      if (row_cache_) {
+        row_cache_->cancelFill(slice_key, fill_token);
+      }
+    } else if (row_cache_) {
+      row_cache_->insert(slice_key, *value->getRawBuffer(), fill_token);
+    }
   }
 
   if (read_bytes_meter_) {
@@ -602,6 +903,80 @@ Status ReplicationDB::read(LaserValueFormatBase* value, const LaserSerializer& k
   return convertRocksDbStatus(status);
 }
 
+void ReplicationDB::multiRead(std::vector<Status>* statuses, const std::vector<LaserValueFormatBase*>& values,
+                              const std::vector<const LaserSerializer*>& keys) {
+  DCHECK_EQ(values.size(), keys.size());
+  size_t key_numbers = keys.size();
+  statuses->assign(key_numbers, Status::RS_NOT_FOUND);
+  if (key_numbers == 0) {
+    return;
+  }
+
+  metrics::Timer read_time(multi_read_timers_.get());
+  uint64_t read_bytes = 0;
+  // 先查点查缓存，只有未命中的 key 需要读取 db
+  std::vector<size_t> sorted_indexes;
+  std::vector<uint64_t> fill_tokens(key_numbers, 0);
+  sorted_indexes.reserve(key_numbers);
+  for (size_t i = 0; i < key_numbers; i++) {
+    if (row_cache_) {
+      rocksdb::Slice slice_key(keys[i]->data(), keys[i]->length());
+      if (row_cache_->lookup(values[i]->getRawBuffer(), slice_key)) {
+        (*statuses)[i] = Status::OK;
+        read_bytes += values[i]->length();
+        continue;
+      }
+      fill_tokens[i] = row_cache_->beginFill(slice_key);
+    }
+    sorted_indexes.push_back(i);
+  }
+  size_t miss_numbers = sorted_indexes.size();
+
+  // 按照 key 排序后 MultiGet 可以跳过内部排序，同一个 block 内的 key 只需要查找一次 block cache
+  std::sort(sorted_indexes.begin(), sorted_indexes.end(), [&keys](size_t left, size_t right) {
+    rocksdb::Slice left_key(keys[left]->data(), keys[left]->length());
+    rocksdb::Slice right_key(keys[right]->data(), keys[right]->length());
+    return left_key.compare(right_key) < 0;
+  });
+
+  std::vector<rocksdb::Slice> slice_keys;
+  slice_keys.reserve(miss_numbers);
+  for (auto index : sorted_indexes) {
+    slice_keys.emplace_back(keys[index]->data(), keys[index]->length());
+  }
+  std::vector<rocksdb::PinnableSlice> slice_values(miss_numbers);
+  std::vector<rocksdb::Status> rocksdb_statuses(miss_numbers);
+  if (miss_numbers > 0) {
+    db_->MultiGet(default_read_options_, db_->DefaultColumnFamily(), miss_numbers, slice_keys.data(),
+                  slice_values.data(), rocksdb_statuses.data(), true);
+  }
+
+  for (size_t i = 0; i < miss_numbers; i++) {
+    size_t index = sorted_indexes[i];
+    if (rocksdb_statuses[i].ok()) {
+      values[index]->getRawBuffer()->assign(slice_values[i].data(), slice_values[i].size());
+      read_bytes += slice_values[i].size();
+      if (row_cache_) {
+        row_cache_->insert(slice_keys[i], slice_values[i], fill_tokens[index]);
+      }
+    } else {
+      VLOG(10) << "Multi get value:" << rocksdb_statuses[i].ToString();
+      if (row_cache_) {
+        row_cache_->cancelFill(slice_keys[i], fill_tokens[index]);
+      }
+    }
+    (*statuses)[index] = convertRocksDbStatus(rocksdb_statuses[i]);
+  }
+
+  if (read_bytes_meter_) {
+    read_bytes_meter_->mark(static_cast<double>(read_bytes));
+  }
+
+  if (read_kps_meter_) {
+    read_kps_meter_->mark(static_cast<double>(key_numbers));
+  }
+}
+
 Status ReplicationDB::exist(bool* result, std::string* value, const LaserSerializer& key) {
   rocksdb::Slice slice_key(key.data(), key.length());
   bool ret;
@@ -621,6 +996,7 @@ void ReplicationDB::startReplicator(uint32_t shard_id, int64_t db_hash, const st
   replicator_service_name_ = service_name;
   executor_ = executor;
   cond_var_ = std::make_shared<ExecutorWithTimeout>(executor_.get());
+  stream_ack_cond_var_ = std::make_shared<ExecutorWithTimeout>(executor_.get());
   version_ = version;
   node_hash_ = node_hash;
   client_address_ = client_address;
@@ -657,11 +1033,19 @@ void ReplicationDB::changeRole(const DBRole& role) {
   }
   LOG(INFO) << "Db " << db_hash_ << " role changed " << role;
   role_ = role;
+  // 角色变化后之前 follower 的确认不再有效
+  clearFollowerAcks();
   if (role_ == DBRole::FOLLOWER) {
     cached_iters_.wlock()->clear();
+    if (wal_tail_ring_) {
+      wal_tail_ring_->clear();
+    }
     pullFromUpstream();
   } else {
     clients_.wlock()->clear();
+    if (batcher_) {
+      batcher_->removeRequest(db_hash_);
+    }
   }
 }
 
@@ -693,91 +1077,148 @@ bool ReplicationDB::reachMaxSeqNoDiffLimit(const laser::ReplicateResponse& respo
 
 void ReplicationDB::applyUpdates(folly::Try<ReplicateResponse>&& try_response) {
   metrics::Timer apply_update_timer(apply_updates_timers_.get());
-  if (force_base_data_replication_) {
-    if (update_version_callback_) {
-      update_version_callback_(db_hash_, version_);
-    }
-    LOG(INFO) << "Db " << db_hash_ << " version " << version_ << " trigger base data replication manually";
+  if (triggerForcedBaseReplication()) {
     return;
   }
 
   bool delay_next_pull = false;
   if (try_response.hasException()) {
     delay_next_pull = true;
-    try {
-      try_response.exception().throw_exception();
-    } catch (const LaserException& ex) {
-      LOG(ERROR) << "Db " << db_hash_ << " laserException: " << ex.get_message();
-      if (ex.get_status() == Status::RP_SOURCE_WAL_LOG_REMOVED) {
-        if (update_version_callback_) {
-          update_version_callback_(db_hash_, version_);
-        }
-        LOG(INFO) << "Db " << db_hash_ << " receive laserException: " << ex.get_message()
-                  << " trigger base data replication";
-        return;
-      }
-    } catch (const std::exception& ex) {
-      LOG(ERROR) << "Db " << db_hash_ << " std::exception: " << ex.what();
+    if (!handleReplicateException(try_response.exception())) {
+      return;
     }
+  } else if (!applyReplicateResponse(&delay_next_pull, try_response.value())) {
+    return;
+  }
+
+  if (delay_next_pull) {
+    delayPullFromUpstream();
   } else {
-    auto& response = try_response.value();
-    auto timestamp_ptr = response.get_timestamp();
-    if (timestamp_ptr) {
-      int64_t response_latency = static_cast<int64_t>(common::currentTimeInMs()) - *timestamp_ptr;
-      if (response_latency < 0) {
-        response_latency = 0;
-      }
-      pull_rpc_response_latency_->addValue(static_cast<double>(response_latency));
-    }
+    pullFromUpstream();
+  }
+}
 
-    if (response.version != version_) {  // base version update
+bool ReplicationDB::triggerForcedBaseReplication() {
+  if (!force_base_data_replication_) {
+    return false;
+  }
+  if (update_version_callback_) {
+    update_version_callback_(db_hash_, version_);
+  }
+  LOG(INFO) << "Db " << db_hash_ << " version " << version_ << " trigger base data replication manually";
+  return true;
+}
+
+bool ReplicationDB::handleReplicateException(const folly::exception_wrapper& ew) {
+  try {
+    ew.throw_exception();
+  } catch (const LaserException& ex) {
+    LOG(ERROR) << "Db " << db_hash_ << " laserException: " << ex.get_message();
+    if (ex.get_status() == Status::RP_SOURCE_WAL_LOG_REMOVED) {
       if (update_version_callback_) {
-        update_version_callback_(db_hash_, response.version);
+        update_version_callback_(db_hash_, version_);
       }
-      LOG(INFO) << "Database db_hash:" << db_hash_ << " base version has update version :" << version_ << " to "
-                << response.version;
-      return;
+      LOG(INFO) << "Db " << db_hash_ << " receive laserException: " << ex.get_message()
+                << " trigger base data replication";
+      return false;
     }
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Db " << db_hash_ << " std::exception: " << ex.what();
+  }
+  return true;
+}
 
-    leader_max_seq_no_ = response.max_seq_no;
-    auto latency_metric = metrics::Metrics::getInstance()->buildHistograms(
-        REPLICATION_DB_MODULE_NAME, REPLICATION_DB_REPLICATOR_LATENCY, REPLICATION_DB_REPLICATOR_TIMER_BUCKET_SIZE,
-        REPLICATION_DB_REPLICATOR_TIMER_MIN, REPLICATION_DB_REPLICATOR_TIMER_MAX);
-    int64_t current_seq_no = 0;
-    apply_updates_numbers_->addValue(static_cast<double>(response.updates.size()));
-    for (auto& update : response.updates) {
-      auto byteRange = update.raw_data.coalesce();
-      rocksdb::WriteBatch write_batch(std::string(reinterpret_cast<const char*>(byteRange.data()), byteRange.size()));
-      int64_t latency = static_cast<uint64_t>(common::currentTimeInMs()) - update.timestamp;
-      if (latency < 0) {
-        latency = 0;
-      }
-      apply_updates_kps_->mark(static_cast<double>(write_batch.Count()));
-      latency_metric->addValue(static_cast<double>(latency));
-      auto status = writeWithSeqNumber(write_batch, &current_seq_no, update.timestamp);
-      if (status != Status::OK) {
-        LOG(ERROR) << "Failed to apply updates to SLAVE " << db_hash_ << " " << status;
-        delay_next_pull = true;
-        break;
-      }
+bool ReplicationDB::applyReplicateResponse(bool* delay_next_pull, ReplicateResponse& response) {
+  auto timestamp_ptr = response.get_timestamp();
+  if (timestamp_ptr) {
+    int64_t response_latency = static_cast<int64_t>(common::currentTimeInMs()) - *timestamp_ptr;
+    if (response_latency < 0) {
+      response_latency = 0;
     }
-    VLOG(5) << "Db " << db_hash_ << " success apply updates, next pull seqno:" << db_->GetLatestSequenceNumber();
+    pull_rpc_response_latency_->addValue(static_cast<double>(response_latency));
+  }
 
-    if (reachMaxSeqNoDiffLimit(response)) {
-      if (update_version_callback_) {
-        update_version_callback_(db_hash_, response.version);
-      }
-      LOG(INFO) << "Db " << db_hash_ << " version " << version_
-                << " reach max seq diff limit, trigger base data replication";
-      return;
+  if (response.version != version_) {  // base version update
+    if (update_version_callback_) {
+      update_version_callback_(db_hash_, response.version);
     }
+    LOG(INFO) << "Database db_hash:" << db_hash_ << " base version has update version :" << version_ << " to "
+              << response.version;
+    return false;
   }
 
-  if (delay_next_pull) {
-    delayPullFromUpstream();
-  } else {
-    pullFromUpstream();
+  leader_max_seq_no_ = response.max_seq_no;
+  std::vector<Update> decompressed_updates;
+  auto* updates = &response.updates;
+  auto compression = response.get_compression();
+  if (compression && *compression != ReplicateCompressionType::NONE) {
+    metrics::Timer decompress_timer(decompress_timers_.get());
+    auto compressed_updates = response.get_compressed_updates();
+    auto uncompressed_size = response.get_uncompressed_size();
+    if (!compressed_updates || !uncompressed_size ||
+        !decompressUpdates(&decompressed_updates, *compression, *compressed_updates, *uncompressed_size)) {
+      LOG(ERROR) << "Db " << db_hash_ << " decompress updates fail, type:" << static_cast<int>(*compression);
+      *delay_next_pull = true;
+      return true;
+    }
+    updates = &decompressed_updates;
+  }
+  int64_t current_seq_no = 0;
+  apply_updates_numbers_->addValue(static_cast<double>(updates->size()));
+  // 连续的 update 合并为一个 WriteBatch 写入，减少 WAL 追加的次数
+  WriteBatchGroup group;
+  int64_t group_timestamp = 0;
+  for (auto& update : *updates) {
+    int64_t latency = static_cast<uint64_t>(common::currentTimeInMs()) - update.timestamp;
+    if (latency < 0) {
+      latency = 0;
+    }
+    replicator_latency_->addValue(static_cast<double>(latency));
+    // sequence 不连续时先写入已经合并的 batch，否则之后记录在本地的 sequence 会与 leader 错开
+    if (!group.follows(update.raw_data) &&
+        applyWriteBatchGroup(&group, &current_seq_no, group_timestamp) != Status::OK) {
+      *delay_next_pull = true;
+      break;
+    }
+    if (!group.append(update.raw_data)) {
+      LOG(ERROR) << "Invalid replicated update of db " << db_hash_ << ", size:" << update.raw_data.length();
+      *delay_next_pull = true;
+      break;
+    }
+    group_timestamp = update.timestamp;
+    if (group.getBatchNumber() < static_cast<uint32_t>(FLAGS_replicator_apply_group_max_updates) &&
+        group.getDataSize() < static_cast<size_t>(FLAGS_replicator_apply_group_max_bytes)) {
+      continue;
+    }
+    if (applyWriteBatchGroup(&group, &current_seq_no, group_timestamp) != Status::OK) {
+      *delay_next_pull = true;
+      break;
+    }
+  }
+  // 中途失败时未写入的 update 会在下次 pull 时重新同步
+  if (!*delay_next_pull && group.getBatchNumber() > 0 &&
+      applyWriteBatchGroup(&group, &current_seq_no, group_timestamp) != Status::OK) {
+    *delay_next_pull = true;
+  }
+  if (!*delay_next_pull) {
+    if (group_timestamp > 0) {
+      last_applied_timestamp_ = group_timestamp;
+    }
+    if (response.next_seq_no > response.max_seq_no) {
+      last_caught_up_ms_ = static_cast<int64_t>(common::currentTimeInMs());
+    }
+  }
+  VLOG(5) << "Db " << db_hash_ << " success apply updates, next pull seqno:" << db_->GetLatestSequenceNumber();
+
+  if (reachMaxSeqNoDiffLimit(response)) {
+    if (update_version_callback_) {
+      update_version_callback_(db_hash_, response.version);
+    }
+    LOG(INFO) << "Db " << db_hash_ << " version " << version_
+              << " reach max seq diff limit, trigger base data replication";
+    return false;
   }
+  return true;
 }
 
 void ReplicationDB::pullFromUpstream() {
@@ -790,26 +1231,59 @@ void ReplicationDB::pullFromUpstream() {
     return;
   }
 
+  if (FLAGS_replicator_stream_enable) {
+    if (stream_fallback_pulls_ <= 0) {
+      streamFromUpstream();
+      return;
+    }
+    stream_fallback_pulls_--;
+  }
+
   ReplicateRequest req;
   getPullRequest(&req, ReplicateType::FORWARD, 0);
+  sendPullRequest(req);
+}
+
+void ReplicationDB::sendPullRequest(const ReplicateRequest& req) {
   auto rpc_options = rpc_options_;
   std::weak_ptr<ReplicationDB> weak_db = shared_from_this();
   VLOG(5) << "Start pull updates from " << db_hash_ << " seq_number:" << req.seq_no;
 
   int64_t request_timestamp = req.timestamp;
-  auto process_request = [weak_db, request_timestamp](folly::Try<ReplicateResponse>&& t) {
+  int64_t seq_no = req.seq_no;
+  uint64_t epoch = apply_epoch_;
+  auto process_request = [weak_db, request_timestamp, seq_no, epoch](folly::Try<ReplicateResponse>&& t) {
     auto db = weak_db.lock();
     if (db == nullptr) {
       return;
     }
-    db->applyUpdates(std::move(t));
-    int64_t whole_latency = static_cast<int64_t>(common::currentTimeInMs()) - request_timestamp;
-    if (whole_latency < 0) {
-      whole_latency = 0;
+    int64_t lag = 0;
+    int64_t response_size = 0;
+    bool adjust_size = db->batch_sizer_ && t.hasValue();
+    if (adjust_size) {
+      db->getResponseProgress(&lag, &response_size, t.value());
+    }
+    // 异步写入时在写入完成之后再统计整体延迟
+    if (db->apply_executor_) {
+      db->pipelineUpdates(std::move(t), seq_no, epoch, [weak_db, request_timestamp, lag, response_size, adjust_size]() {
+        auto applied_db = weak_db.lock();
+        if (applied_db) {
+          applied_db->updateReplicateLatency(request_timestamp, lag, response_size, adjust_size);
+        }
+      });
+    } else {
+      db->applyUpdates(std::move(t));
+      db->updateReplicateLatency(request_timestamp, lag, response_size, adjust_size);
     }
-    db->whole_replication_latency_->addValue(static_cast<double>(whole_latency));
   };
 
+  if (batcher_) {
+    if (!batcher_->addRequest(getClientOption(), req, weak_db, std::move(process_request))) {
+      delayPullFromUpstream();
+    }
+    return;
+  }
+
   auto send_request = [&rpc_options, &req, this, weak_db, process_request = std::move(process_request)](auto client) {
     client->future_replicate(rpc_options, req).via(executor_.get()).then(std::move(process_request));
   };
@@ -820,17 +1294,306 @@ void ReplicationDB::pullFromUpstream() {
   }
 }
 
+void ReplicationDB::updateReplicateLatency(int64_t request_timestamp, int64_t lag, int64_t response_size,
+                                           bool adjust_size) {
+  int64_t whole_latency = static_cast<int64_t>(common::currentTimeInMs()) - request_timestamp;
+  if (whole_latency < 0) {
+    whole_latency = 0;
+  }
+  whole_replication_latency_->addValue(static_cast<double>(whole_latency));
+  if (adjust_size) {
+    batch_sizer_->update(lag, response_size, whole_latency);
+  }
+}
+
+void ReplicationDB::getResponseProgress(int64_t* lag, int64_t* response_size, const ReplicateResponse& response) {
+  auto uncompressed_size = response.get_uncompressed_size();
+  if (uncompressed_size) {
+    *response_size = *uncompressed_size;
+  } else {
+    for (auto& update : response.updates) {
+      *response_size += static_cast<int64_t>(update.raw_data.computeChainDataLength());
+    }
+  }
+  *lag = std::max<int64_t>(response.max_seq_no - response.next_seq_no + 1, 0);
+}
+
+void ReplicationDB::pipelineUpdates(folly::Try<ReplicateResponse>&& try_response, int64_t seq_no, uint64_t epoch,
+                                    folly::Function<void()> on_applied) {
+  // 已经重新同步，之前发出的 pull 返回的数据全部丢弃
+  if (epoch != apply_epoch_ || role_ == DBRole::LEADER) {
+    return;
+  }
+
+  int64_t bytes = 0;
+  if (try_response.hasValue()) {
+    auto& response = try_response.value();
+    for (auto& update : response.updates) {
+      bytes += static_cast<int64_t>(update.raw_data.computeChainDataLength());
+    }
+    auto compressed_updates = response.get_compressed_updates();
+    if (compressed_updates) {
+      bytes += static_cast<int64_t>(compressed_updates->computeChainDataLength());
+    }
+  }
+
+  // leader 返回了下一次 pull 的起点时，写入当前 response 的同时发起下一次 pull，待写入的数据过多时等待写入完成
+  bool prefetched = false;
+  if (bytes > 0 && try_response.value().version == version_ && try_response.value().next_seq_no > seq_no + 1) {
+    if (pending_apply_bytes_ + bytes <= static_cast<int64_t>(FLAGS_replicator_apply_max_pending_bytes)) {
+      ReplicateRequest next_req;
+      getPullRequest(&next_req, ReplicateType::FORWARD, 0);
+      next_req.seq_no = try_response.value().next_seq_no - 1;
+      sendPullRequest(next_req);
+      prefetched = true;
+    } else {
+      apply_backpressure_->mark();
+    }
+  }
+
+  pending_apply_bytes_ += bytes;
+  addApplyTask([this, try_response = std::move(try_response), seq_no, epoch, bytes, prefetched,
+                on_applied = std::move(on_applied)]() mutable {
+    applyPipelinedUpdates(std::move(try_response), seq_no, epoch, prefetched, std::move(on_applied));
+    pending_apply_bytes_ -= bytes;
+  });
+}
+
+void ReplicationDB::applyPipelinedUpdates(folly::Try<ReplicateResponse>&& try_response, int64_t seq_no,
+                                          uint64_t epoch, bool prefetched, folly::Function<void()> on_applied) {
+  if (epoch != apply_epoch_) {
+    return;
+  }
+  SCOPE_EXIT {
+    if (on_applied) {
+      on_applied();
+    }
+  };
+
+  if (try_response.hasValue()) {
+    auto& response = try_response.value();
+    bool has_updates = !response.updates.empty() || response.get_compressed_updates() != nullptr;
+    int64_t latest_seq_no = static_cast<int64_t>(db_->GetLatestSequenceNumber());
+    if (has_updates && response.version == version_ && latest_seq_no != seq_no) {
+      LOG(ERROR) << "Db " << db_hash_ << " replicated updates are not continuous, expected seq_no:" << seq_no
+                 << " latest seq_no:" << latest_seq_no;
+      apply_epoch_++;
+      delayPullFromUpstream();
+      return;
+    }
+  }
+
+  // 没有提前发起 pull 时与串行同步相同，写入后再发起下一次 pull
+  if (!prefetched) {
+    applyUpdates(std::move(try_response));
+    return;
+  }
+
+  metrics::Timer apply_update_timer(apply_updates_timers_.get());
+  bool delay_next_pull = false;
+  if (triggerForcedBaseReplication() || !applyReplicateResponse(&delay_next_pull, try_response.value())) {
+    apply_epoch_++;
+    return;
+  }
+  if (delay_next_pull) {
+    apply_epoch_++;
+    delayPullFromUpstream();
+  }
+}
+
+void ReplicationDB::addApplyTask(folly::Function<void()> task) {
+  bool need_schedule = apply_queue_.withWLock([&task](auto& queue) {
+    queue.tasks.push_back(std::move(task));
+    if (queue.running) {
+      return false;
+    }
+    queue.running = true;
+    return true;
+  });
+  if (!need_schedule) {
+    return;
+  }
+
+  std::weak_ptr<ReplicationDB> weak_db = shared_from_this();
+  apply_executor_->add([weak_db]() {
+    auto db = weak_db.lock();
+    if (db == nullptr) {
+      return;
+    }
+    db->drainApplyTasks();
+  });
+}
+
+void ReplicationDB::drainApplyTasks() {
+  while (true) {
+    folly::Function<void()> task;
+    bool has_task = apply_queue_.withWLock([&task](auto& queue) {
+      if (queue.tasks.empty()) {
+        queue.running = false;
+        return false;
+      }
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return true;
+    });
+    if (!has_task) {
+      return;
+    }
+    task();
+  }
+}
+
+void ReplicationDB::streamFromUpstream() {
+  ReplicateRequest req;
+  getPullRequest(&req, ReplicateType::FORWARD, 0);
+  req.set_stream_credits(FLAGS_replicator_stream_credits);
+  auto rpc_options = rpc_options_;
+  // 客户端缓存的 response 个数与额度一致，follower 处理完 response 后才会向 leader 补充 credit
+  rpc_options.setChunkBufferSize(FLAGS_replicator_stream_credits);
+  std::weak_ptr<ReplicationDB> weak_db = shared_from_this();
+  VLOG(5) << "Start stream updates from " << db_hash_ << " seq_number:" << req.seq_no;
+
+  auto process_stream = [weak_db](folly::Try<apache::thrift::ClientBufferedStream<ReplicateResponse>>&& t) {
+    auto db = weak_db.lock();
+    if (db == nullptr) {
+      return;
+    }
+    if (t.hasException()) {
+      db->fallbackToPull(t.exception());
+      return;
+    }
+
+    // stream 中的 response 在 executor 上按顺序处理，stopped 之后取消订阅，忽略剩余的 response
+    auto subscriber = std::make_shared<folly::Synchronized<ReplicateStreamSubscriber>>();
+    auto stop_subscriber = [](const std::shared_ptr<folly::Synchronized<ReplicateStreamSubscriber>>& subscriber) {
+      auto cancel = subscriber->withWLock([](auto& state) {
+        state.stopped = true;
+        return std::move(state.cancel);
+      });
+      if (cancel) {
+        cancel();
+      }
+    };
+    auto subscription =
+        std::move(t.value())
+            .subscribeExTry(db->executor_.get(), [weak_db, subscriber, stop_subscriber](
+                                                     folly::Try<ReplicateResponse>&& item) {
+              if (subscriber->rlock()->stopped) {
+                return;
+              }
+              auto db = weak_db.lock();
+              bool stopped = db == nullptr;
+              if (db) {
+                db->applyStreamItem(&stopped, std::move(item));
+              }
+              if (stopped) {
+                stop_subscriber(subscriber);
+              }
+            });
+
+    // 订阅返回之前 stream 可能已经停止，此时直接取消
+    auto holder = std::make_shared<decltype(subscription)>(std::move(subscription));
+    folly::Function<void()> cancel = [holder]() {
+      holder->cancel();
+      std::move(*holder).detach();
+    };
+    bool stopped = subscriber->withWLock([&cancel](auto& state) {
+      if (!state.stopped) {
+        state.cancel = std::move(cancel);
+      }
+      return state.stopped;
+    });
+    if (stopped) {
+      cancel();
+    }
+  };
+
+  auto send_request = [&rpc_options, &req, this, process_stream = std::move(process_stream)](auto client) {
+    client->semifuture_replicateStream(rpc_options, req).via(executor_.get()).then(std::move(process_stream));
+  };
+
+  bool ret = service_router::thriftServiceCall<ReplicatorAsyncClient>(getClientOption(), std::move(send_request));
+  if (!ret) {
+    delayPullFromUpstream();
+  }
+}
+
+void ReplicationDB::applyStreamItem(bool* stopped, folly::Try<ReplicateResponse>&& item) {
+  if (role_ == DBRole::LEADER) {
+    *stopped = true;
+    return;
+  }
+
+  if (item.hasValue()) {
+    metrics::Timer apply_update_timer(apply_updates_timers_.get());
+    bool delay_next_pull = false;
+    if (triggerForcedBaseReplication() || !applyReplicateResponse(&delay_next_pull, item.value())) {
+      *stopped = true;
+      return;
+    }
+    auto need_ack = item.value().get_need_ack();
+    if (need_ack && *need_ack) {
+      ReplicateRequest ack_request;
+      getPullRequest(&ack_request, ReplicateType::FORWARD, 0);
+      sendStreamAck(ack_request);
+    }
+    if (delay_next_pull) {
+      *stopped = true;
+      delayPullFromUpstream();
+    }
+    return;
+  }
+
+  *stopped = true;
+  if (item.hasException()) {
+    fallbackToPull(item.exception());
+    return;
+  }
+  // leader 推送完额度内的 response 后正常结束 stream，重新建立 stream 继续同步
+  pullFromUpstream();
+}
+
+void ReplicationDB::sendStreamAck(const ReplicateRequest& request) {
+  auto send_ack = [&request, this](auto client) {
+    client->semifuture_replicateAck(rpc_options_, request)
+        .via(executor_.get())
+        .thenError([db_hash = db_hash_](const folly::exception_wrapper& ew) {
+          VLOG(5) << "Send stream ack to " << db_hash << " fail:" << ew.what();
+        });
+  };
+  // ack 丢失时等待下一次 ack 或者重新建立 stream 时的请求补充确认
+  service_router::thriftServiceCall<ReplicatorAsyncClient>(getClientOption(), std::move(send_ack));
+}
+
+void ReplicationDB::fallbackToPull(const folly::exception_wrapper& ew) {
+  if (!handleReplicateException(ew)) {
+    return;
+  }
+  // leader 不支持 stream 或者 stream 异常时，先退回到 pull 协议同步一段时间
+  stream_fallback_pulls_ = FLAGS_replicator_stream_fallback_pulls;
+  delayPullFromUpstream();
+}
+
 void ReplicationDB::getPullRequest(ReplicateRequest* req, const ReplicateType& type, int64_t max_seq_no) {
   req->seq_no = db_->GetLatestSequenceNumber();
+  req->set_ack_seq_no(req->seq_no);
   req->db_hash = db_hash_;
   req->max_wait_ms = FLAGS_replicator_max_server_wait_time_ms;
   req->max_size = static_cast<int64_t>(FLAGS_replicator_max_size_per_response);
+  if (batch_sizer_) {
+    req->max_size = batch_sizer_->getMaxSize();
+  }
+  pull_max_size_->addValue(static_cast<double>(req->max_size / 1024));
   req->type = type;
   req->client_address = client_address_;
   req->node_hash = node_hash_;
   req->max_seq_no = max_seq_no;
   req->version = version_;
   req->set_timestamp(static_cast<int64_t>(common::currentTimeInMs()));
+  auto compression = stringToReplicateCompressionType(FLAGS_replicator_compression_type);
+  if (compression && *compression != ReplicateCompressionType::NONE) {
+    req->set_compression(*compression);
+  }
 }
 
 void ReplicationDB::delayPullFromUpstream() {
@@ -872,9 +1635,71 @@ void ReplicationDB::getUpdates(ReplicateResponse* response, std::unique_ptr<::la
   std::string& client_address = request->client_address;
   clients_.withWLock(
       [&client_address, node_hash = request->node_hash](auto& clients) { clients[node_hash] = client_address; });
+  // 请求的大小由 follower 动态调整，leader 按配置的上限截断
+  int64_t max_size_limit = std::max(static_cast<int64_t>(FLAGS_replicator_max_size_per_response),
+                                    static_cast<int64_t>(FLAGS_replicator_adaptive_max_size_per_response));
+  if (request->max_size > max_size_limit) {
+    request->max_size = max_size_limit;
+  }
   const auto expected_seq_no = request->seq_no + 1;
+  uint32_t batch_numbers = 0;
+  uint64_t update_size = 0;
+  // 优先从内存中最近写入的 batch 读取，落后太多时再读取 WAL
+  if (!wal_tail_ring_ ||
+      !getUpdatesFromRing(response, &batch_numbers, &update_size, expected_seq_no, request->max_size)) {
+    getUpdatesFromWal(response, &batch_numbers, &update_size, expected_seq_no, *request);
+  }
+
+  auto compression = request->get_compression();
+  if (compression && *compression != ReplicateCompressionType::NONE &&
+      update_size >= static_cast<uint64_t>(FLAGS_replicator_compression_min_bytes)) {
+    compressResponse(response, *compression);
+  }
+  response->max_seq_no = db_->GetLatestSequenceNumber();
+  response->next_seq_no = expected_seq_no + batch_numbers;
+  if (batch_numbers > 0 && sync_replicas_ > 0) {
+    response->set_need_ack(true);
+  }
+  response_size_->addValue(static_cast<double>(update_size / 1024));
+  VLOG(5) << "Db " << db_hash_ << " get updates:" << response->updates.size();
+}
+
+bool ReplicationDB::getUpdatesFromRing(ReplicateResponse* response, uint32_t* batch_numbers, uint64_t* update_size,
+                                       int64_t expected_seq_no, int64_t max_size) {
+  std::vector<WalTailEntry> entries;
+  if (!wal_tail_ring_->read(&entries, static_cast<uint64_t>(expected_seq_no), static_cast<uint64_t>(max_size))) {
+    return false;
+  }
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    auto& entry = entries[i];
+    Update update;
+    update.timestamp = entry.timestamp;
+    if (i == 0 && static_cast<int64_t>(entry.sequence) < expected_seq_no) {
+      std::string rep(reinterpret_cast<const char*>(entry.data.data()), entry.data.length());
+      rocksdb::WriteBatch write_batch(std::move(rep));
+      auto trimmed_batch = trimWriteBatch(&write_batch, expected_seq_no - static_cast<int64_t>(entry.sequence));
+      if (trimmed_batch->Count() == 0) {
+        continue;
+      }
+      *batch_numbers += trimmed_batch->Count();
+      *update_size += trimmed_batch->GetDataSize();
+      wrapWriteBatch(&update.raw_data, std::move(trimmed_batch));
+    } else {
+      *batch_numbers += entry.count;
+      *update_size += entry.data.length();
+      update.raw_data = std::move(entry.data);
+    }
+    response->updates.emplace_back(std::move(update));
+    addReplicateInterval(entry.timestamp);
+  }
+  return true;
+}
+
+void ReplicationDB::getUpdatesFromWal(ReplicateResponse* response, uint32_t* batch_numbers, uint64_t* update_size,
+                                      int64_t expected_seq_no, const ReplicateRequest& request) {
   std::unique_ptr<rocksdb::TransactionLogIterator> iter;
-  auto cache_iter = getCachedIter(expected_seq_no, request->node_hash);
+  auto cache_iter = getCachedIter(expected_seq_no, request.node_hash);
   rocksdb::Status status;
   if (cache_iter == nullptr || !cache_iter->Valid()) {
     status = db_->GetUpdatesSince(expected_seq_no, &iter);
@@ -890,13 +1715,17 @@ void ReplicationDB::getUpdates(ReplicateResponse* response, std::unique_ptr<::la
             << " seq_number:" << expected_seq_no;
   }
 
-  uint32_t batch_numbers = 0;
-  uint64_t update_size = 0;
-  for (int32_t i = 0; update_size < request->max_size && iter && iter->Valid(); ++i, iter->Next()) {
+  for (int32_t i = 0; *update_size < request.max_size && iter && iter->Valid(); ++i, iter->Next()) {
     auto result = iter->GetBatch();
+    // follower 合并写入后 WAL 中 batch 的边界与上游不同，起始的 batch 可能包含已经同步过的操作，需要跳过
+    if (i == 0 && static_cast<int64_t>(result.sequence) < expected_seq_no) {
+      result.writeBatchPtr =
+          trimWriteBatch(result.writeBatchPtr.get(), expected_seq_no - static_cast<int64_t>(result.sequence));
+      if (result.writeBatchPtr->Count() == 0) {
+        continue;
+      }
+    }
     Update update;
-    const auto& str = result.writeBatchPtr->Data();
-    update.raw_data = std::move(*folly::IOBuf::copyBuffer(str.data(), str.size()));
     TimeLogExtractor extractor;
     auto ret = result.writeBatchPtr->Iterate(&extractor);
     if (ret.ok()) {
@@ -904,15 +1733,11 @@ void ReplicationDB::getUpdates(ReplicateResponse* response, std::unique_ptr<::la
     } else {
       update.timestamp = 0;
     }
+    *batch_numbers += result.writeBatchPtr->Count();
+    *update_size += result.writeBatchPtr->GetDataSize();
+    wrapWriteBatch(&update.raw_data, std::move(result.writeBatchPtr));
     response->updates.emplace_back(std::move(update));
-    batch_numbers += result.writeBatchPtr->Count();
-    update_size += result.writeBatchPtr->GetDataSize();
-
-    int64_t latency = static_cast<int64_t>(common::currentTimeInMs()) - extractor.ms;
-    if (latency < 0) {
-      latency = 0;
-    }
-    interval_between_write_and_replicate_->addValue(static_cast<double>(latency));
+    addReplicateInterval(extractor.ms);
   }
 
   // not found 状态证明已经同步完成，属于正常状态
@@ -920,9 +1745,124 @@ void ReplicationDB::getUpdates(ReplicateResponse* response, std::unique_ptr<::la
     throwLaserException(Status::RP_SOURCE_WAL_LOG_REMOVED,
                         folly::to<std::string>("Pull updates from ", db_hash_, " wal log has removed"));
   }
-  response->max_seq_no = db_->GetLatestSequenceNumber();
-  VLOG(5) << "Db " << db_hash_ << " get updates:" << response->updates.size();
-  putCachedIter(expected_seq_no + batch_numbers, request->node_hash, std::move(iter));
+  putCachedIter(expected_seq_no + *batch_numbers, request.node_hash, std::move(iter));
+}
+
+std::unique_ptr<rocksdb::WriteBatch> ReplicationDB::trimWriteBatch(rocksdb::WriteBatch* write_batch, uint64_t skip) {
+  auto trimmed_batch = std::make_unique<rocksdb::WriteBatch>();
+  WriteBatchTrimmer trimmer(trimmed_batch.get(), skip);
+  auto trim_status = write_batch->Iterate(&trimmer);
+  if (!trim_status.ok()) {
+    throwLaserException(Status::RP_SOURCE_READ_ERROR,
+                        folly::to<std::string>("Trim updates from ", db_hash_, " error: ", trim_status.ToString()));
+  }
+  // 裁剪后的 batch 从第 skip 条记录开始，sequence 随之后移，follower 据此判断 batch 是否连续
+  std::string rep = trimmed_batch->Data();
+  uint64_t sequence = folly::Endian::little(folly::loadUnaligned<uint64_t>(write_batch->Data().data())) + skip;
+  folly::storeUnaligned<uint64_t>(&rep[0], folly::Endian::little(sequence));
+  return std::make_unique<rocksdb::WriteBatch>(std::move(rep));
+}
+
+void ReplicationDB::addReplicateInterval(int64_t write_ms) {
+  int64_t latency = static_cast<int64_t>(common::currentTimeInMs()) - write_ms;
+  if (latency < 0) {
+    latency = 0;
+  }
+  interval_between_write_and_replicate_->addValue(static_cast<double>(latency));
+}
+
+void ReplicationDB::compressResponse(ReplicateResponse* response, const ReplicateCompressionType& type) {
+  if (response->updates.empty()) {
+    return;
+  }
+  metrics::Timer compress_timer(compress_timers_.get());
+  folly::IOBuf compressed;
+  int64_t uncompressed_size = 0;
+  if (!compressUpdates(&compressed, &uncompressed_size, type, response->updates)) {
+    LOG(ERROR) << "Db " << db_hash_ << " compress updates fail, type:" << static_cast<int>(type);
+    return;
+  }
+  size_t compressed_size = compressed.computeChainDataLength();
+  // 压缩比为压缩后大小占原始大小的百分比，没有收益时直接发送原始数据
+  compression_ratio_->addValue(static_cast<double>(compressed_size) * 100 / static_cast<double>(uncompressed_size));
+  if (compressed_size >= static_cast<size_t>(uncompressed_size)) {
+    return;
+  }
+  response->updates.clear();
+  response->set_compression(type);
+  response->set_compressed_updates(std::move(compressed));
+  response->set_uncompressed_size(uncompressed_size);
+}
+
+void ReplicationDB::wrapWriteBatch(folly::IOBuf* buf, std::unique_ptr<rocksdb::WriteBatch> write_batch) {
+  // IOBuf 直接引用 WriteBatch 的数据并持有 WriteBatch，最后一个引用释放时删除 WriteBatch
+  const std::string& rep = write_batch->Data();
+  void* data = const_cast<char*>(rep.data());
+  size_t size = rep.size();
+  *buf = folly::IOBuf(folly::IOBuf::TAKE_OWNERSHIP, data, size,
+                      [](void*, void* user_data) { delete static_cast<rocksdb::WriteBatch*>(user_data); },
+                      write_batch.release());
+}
+
+Status ReplicationDB::applyWriteBatchGroup(WriteBatchGroup* group, int64_t* seq_no, int64_t write_ms) {
+  rocksdb::WriteBatch write_batch = group->release();
+  apply_updates_kps_->mark(static_cast<double>(write_batch.Count()));
+  auto status = writeWithSeqNumber(write_batch, seq_no, write_ms);
+  if (status != Status::OK) {
+    LOG(ERROR) << "Failed to apply updates to SLAVE " << db_hash_ << " " << status;
+  }
+  return status;
+}
+
+bool WriteBatchGroup::append(const folly::IOBuf& buf) {
+  size_t size = buf.computeChainDataLength();
+  if (size < WRITE_BATCH_HEADER_SIZE) {
+    return false;
+  }
+
+  // 合并后记录的 sequence 在写入时依次分配，只有紧接在前一个 batch 之后的 batch 才能合并
+  folly::io::Cursor cursor(&buf);
+  uint64_t sequence = cursor.readLE<uint64_t>();
+  uint32_t count = cursor.readLE<uint32_t>();
+  if (batch_number_ > 0 && sequence != next_sequence_) {
+    return false;
+  }
+
+  // 直接从 IOBuf 链中拷贝记录，每个字节只拷贝一次
+  if (rep_.empty()) {
+    rep_.assign(WRITE_BATCH_HEADER_SIZE, '\0');
+  }
+  size_t offset = rep_.size();
+  size_t data_size = size - WRITE_BATCH_HEADER_SIZE;
+  rep_.resize(offset + data_size);
+  cursor.pull(&rep_[offset], data_size);
+  count_ += count;
+  batch_number_++;
+  next_sequence_ = sequence + count;
+  return true;
+}
+
+bool WriteBatchGroup::follows(const folly::IOBuf& buf) const {
+  if (batch_number_ == 0 || buf.computeChainDataLength() < WRITE_BATCH_HEADER_SIZE) {
+    return true;
+  }
+  folly::io::Cursor cursor(&buf);
+  return cursor.readLE<uint64_t>() == next_sequence_;
+}
+
+rocksdb::WriteBatch WriteBatchGroup::release() {
+  if (rep_.empty()) {
+    rep_.assign(WRITE_BATCH_HEADER_SIZE, '\0');
+  }
+  // sequence 由写入时分配，只需要写入合并后的 count
+  uint32_t count = folly::Endian::little(count_);
+  memcpy(&rep_[sizeof(uint64_t)], &count, sizeof(count));
+  rocksdb::WriteBatch write_batch(std::move(rep_));
+  rep_.clear();
+  count_ = 0;
+  batch_number_ = 0;
+  next_sequence_ = 0;
+  return write_batch;
 }
 
 void ReplicationDB::handleReplicateRequest(
@@ -934,6 +1874,7 @@ void ReplicationDB::handleReplicateRequest(
   auto timeout = request->max_wait_ms;
   VLOG(5) << "handle replication request, hash:" << request->db_hash << " from:" << request->client_address
           << " seq_no:" << request->seq_no;
+  updateFollowerAck(*request);
 
   auto response_callback = [request = std::move(request), callback = std::move(callback),
                             weak_db = std::move(weak_db)]() mutable {
@@ -967,6 +1908,170 @@ void ReplicationDB::handleReplicateRequest(
   cond_var_->runIfConditionOrWaitForNotify(std::move(response_callback), std::move(predicate), timeout);
 }
 
+bool ReplicationDB::hasUpdates(const ReplicateRequest& request) {
+  return request.version != version_ || db_->GetLatestSequenceNumber() > static_cast<uint64_t>(request.seq_no);
+}
+
+void ReplicationDB::runOnUpdates(folly::Function<void()> callback, uint64_t timeout_ms) {
+  cond_var_->runIfConditionOrWaitForNotify(std::move(callback), []() { return false; }, timeout_ms);
+}
+
+void ReplicationDB::getReplicateUpdates(ReplicateResponse* response,
+                                        std::unique_ptr<::laser::ReplicateRequest> request) {
+  int64_t replication_rpc_request_latency = static_cast<int64_t>(common::currentTimeInMs()) - request->timestamp;
+  if (replication_rpc_request_latency < 0) {
+    replication_rpc_request_latency = 0;
+  }
+  pull_rpc_request_latency_->addValue(static_cast<double>(replication_rpc_request_latency));
+
+  metrics::Timer metric_time(get_updates_timers_.get());
+  getUpdates(response, std::move(request));
+  response->set_timestamp(static_cast<int64_t>(common::currentTimeInMs()));
+}
+
+void ReplicationDB::getIdleReplicateState(IdleReplicateState* state) {
+  state->max_seq_no = static_cast<int64_t>(db_->GetLatestSequenceNumber());
+  state->timestamp = static_cast<int64_t>(common::currentTimeInMs());
+}
+
+void ReplicationDB::applyIdleReplicateState(const IdleReplicateState& state) {
+  if (role_ != DBRole::FOLLOWER || !db_) {
+    return;
+  }
+  leader_max_seq_no_ = state.max_seq_no;
+  if (state.max_seq_no > static_cast<int64_t>(db_->GetLatestSequenceNumber())) {
+    return;
+  }
+  // leader 在 timestamp 时没有更多的写入，取和本地时间的较小值，避免时钟偏差把延迟算小
+  int64_t caught_up_ms = std::min(state.timestamp, static_cast<int64_t>(common::currentTimeInMs()));
+  if (caught_up_ms > last_caught_up_ms_) {
+    last_caught_up_ms_ = caught_up_ms;
+  }
+}
+
+apache::thrift::ServerStream<ReplicateResponse> ReplicationDB::handleReplicateStreamRequest(
+    std::unique_ptr<::laser::ReplicateRequest> request) {
+  if (role_ == DBRole::FOLLOWER) {
+    throwLaserException(Status::RP_ROLE_ERROR, folly::to<std::string>("Db ", request->db_hash, " role is follower"));
+  }
+  VLOG(5) << "handle replication stream request, hash:" << request->db_hash << " from:" << request->client_address
+          << " seq_no:" << request->seq_no;
+  updateFollowerAck(*request);
+
+  auto cancelled = std::make_shared<std::atomic<bool>>(false);
+  auto stream_and_publisher = apache::thrift::ServerStream<ReplicateResponse>::createPublisher(
+      [cancelled]() { cancelled->store(true); });
+  auto context = std::make_shared<ReplicateStreamContext>(std::move(stream_and_publisher.second), std::move(request),
+                                                          cancelled);
+  pushStreamUpdates(std::move(context));
+  return std::move(stream_and_publisher.first);
+}
+
+void ReplicationDB::pushStreamUpdates(std::shared_ptr<ReplicateStreamContext> context) {
+  std::weak_ptr<ReplicationDB> weak_db = shared_from_this();
+  auto seq_no = static_cast<rocksdb::SequenceNumber>(context->request.seq_no);
+  auto timeout = context->request.max_wait_ms;
+
+  auto push_callback = [context, weak_db]() mutable {
+    if (context->cancelled->load()) {
+      std::move(context->publisher).complete();
+      return;
+    }
+    auto db = weak_db.lock();
+    if (db == nullptr) {
+      std::move(context->publisher)
+          .complete(createLaserException(Status::RP_SOURCE_DB_REMOVED,
+                                         folly::to<std::string>("Db ", context->request.db_hash, " has been removed")));
+      return;
+    }
+
+    // 超时没有新写入时推送空的 response，follower 借此更新 leader 的最大 seq no
+    metrics::Timer metric_time(db->get_updates_timers_.get());
+    ReplicateResponse response;
+    try {
+      db->getUpdates(&response, std::make_unique<ReplicateRequest>(context->request));
+    } catch (const LaserException& ex) {
+      std::move(context->publisher).complete(folly::exception_wrapper(ex));
+      return;
+    }
+    response.set_timestamp(static_cast<int64_t>(common::currentTimeInMs()));
+    bool version_changed = response.version != context->request.version;
+    bool wait_ack = false;
+    if (!response.updates.empty()) {
+      context->request.seq_no = response.next_seq_no - 1;
+      int64_t lag = 0;
+      int64_t response_size = 0;
+      db->getResponseProgress(&lag, &response_size, response);
+      context->unacked_bytes += response_size;
+      // 未确认的数据达到上限时要求 follower 写入后上报 ack，收到 ack 之前不再推送
+      if (FLAGS_replicator_stream_max_unacked_bytes > 0 &&
+          context->unacked_bytes >= static_cast<int64_t>(FLAGS_replicator_stream_max_unacked_bytes)) {
+        response.set_need_ack(true);
+        wait_ack = true;
+      }
+    }
+    context->publisher.next(std::move(response));
+    context->credits--;
+    if (version_changed || context->credits <= 0) {
+      std::move(context->publisher).complete();
+      return;
+    }
+    if (wait_ack) {
+      context->ack_deadline_ms = static_cast<uint64_t>(common::currentTimeInMs()) + context->request.max_wait_ms;
+      db->waitStreamAck(std::move(context));
+      return;
+    }
+    db->pushStreamUpdates(std::move(context));
+  };
+
+  auto predicate = [seq_no, this]() { return db_->GetLatestSequenceNumber() > seq_no; };
+  cond_var_->runIfConditionOrWaitForNotify(std::move(push_callback), std::move(predicate), timeout);
+}
+
+void ReplicationDB::waitStreamAck(std::shared_ptr<ReplicateStreamContext> context) {
+  std::weak_ptr<ReplicationDB> weak_db = shared_from_this();
+  int64_t node_hash = context->request.node_hash;
+  int64_t seq_no = context->request.seq_no;
+  uint64_t now = static_cast<uint64_t>(common::currentTimeInMs());
+  uint64_t timeout = context->ack_deadline_ms > now ? context->ack_deadline_ms - now : 0;
+
+  auto ack_callback = [context, weak_db, node_hash, seq_no]() mutable {
+    if (context->cancelled->load()) {
+      std::move(context->publisher).complete();
+      return;
+    }
+    auto db = weak_db.lock();
+    if (db == nullptr) {
+      std::move(context->publisher)
+          .complete(createLaserException(Status::RP_SOURCE_DB_REMOVED,
+                                         folly::to<std::string>("Db ", context->request.db_hash, " has been removed")));
+      return;
+    }
+
+    if (db->isStreamAcked(node_hash, seq_no)) {
+      context->unacked_bytes = 0;
+      db->pushStreamUpdates(std::move(context));
+      return;
+    }
+    // 其他 follower 的 ack 也会唤醒等待，没有到期时继续等待；到期仍然没有确认时结束 stream，follower 重新建立 stream
+    if (static_cast<uint64_t>(common::currentTimeInMs()) < context->ack_deadline_ms) {
+      db->waitStreamAck(std::move(context));
+      return;
+    }
+    std::move(context->publisher).complete();
+  };
+
+  auto predicate = [node_hash, seq_no, this]() { return isStreamAcked(node_hash, seq_no); };
+  stream_ack_cond_var_->runIfConditionOrWaitForNotify(std::move(ack_callback), std::move(predicate),
+                                                      std::max<uint64_t>(timeout, 1));
+}
+
+bool ReplicationDB::isStreamAcked(int64_t node_hash, int64_t seq_no) {
+  auto acks = follower_acks_.rlock();
+  auto iter = acks->acked_seq_nos.find(node_hash);
+  return iter != acks->acked_seq_nos.end() && iter->second >= seq_no;
+}
+
 void ReplicationDB::handleReplicateWdtRequest(
     std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::ReplicateWdtResponse>>> callback,
     std::unique_ptr<::laser::ReplicateWdtRequest> request) {
@@ -1044,7 +2149,25 @@ void ReplicationDB::getDbMetaInfo(ReplicationDbMetaInfo* info) {
   info->setSeqNo(seq_no);
   if (role_ == DBRole::FOLLOWER) {
     info->setReplicateLag(leader_max_seq_no_ - seq_no);
+    info->setReplicateLagMs(getReplicateLagMs());
+  }
+}
+
+int64_t ReplicationDB::getReplicateLagMs() {
+  if (role_ != DBRole::FOLLOWER || !db_) {
+    return 0;
+  }
+  // 追上 leader 后发出的 pull 在等待期间 leader 有写入会立即返回，等待超时之前认为没有延迟；
+  // 落后时已经同步的最新数据的写入时间之后的写入都可能缺失
+  int64_t fresh_ms = last_caught_up_ms_;
+  if (leader_max_seq_no_ <= static_cast<int64_t>(db_->GetLatestSequenceNumber()) && fresh_ms > 0) {
+    fresh_ms += FLAGS_replicator_max_server_wait_time_ms;
+  }
+  fresh_ms = std::max(fresh_ms, static_cast<int64_t>(last_applied_timestamp_));
+  if (fresh_ms <= 0) {
+    return std::numeric_limits<int64_t>::max();
   }
+  return std::max<int64_t>(static_cast<int64_t>(common::currentTimeInMs()) - fresh_ms, 0);
 }
 
 void ReplicationDB::forceBaseDataReplication() {
@@ -21,16 +21,21 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <fstream>
+#include <map>
 
 #include "folly/Function.h"
 #include "folly/SpinLock.h"
+#include "folly/Synchronized.h"
+#include "folly/futures/Future.h"
 #include "rocksdb/db.h"
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/status.h"
 #include "rocksdb/table.h"
 #include "rocksdb/utilities/checkpoint.h"
+#include "thrift/lib/cpp2/async/ServerPublisherStream.h"
 
 #include "common/laser/format.h"
 #include "common/laser/if/gen-cpp2/Replicator.h"
@@ -43,6 +48,11 @@
 
 namespace laser {
 
+class ReplicateBatchSizer;
+class ReplicateBatcher;
+class RowCache;
+class WalTailRing;
+
 DECLARE_int32(wdt_replicator_abort_timeout_ms);
 
 extern const char ROCKSDB_READ_BYTES_MIN_1[];
@@ -59,6 +69,77 @@ struct TimeLogExtractor : public rocksdb::WriteBatch::Handler {
   uint64_t ms;
 };
 
+// 跳过 WriteBatch 中前 skip 个占用 sequence 的操作，其余操作追加到 batch 中
+class WriteBatchTrimmer : public rocksdb::WriteBatch::Handler {
+ public:
+  WriteBatchTrimmer(rocksdb::WriteBatch* batch, uint64_t skip) : batch_(batch), skip_(skip) {}
+  void Put(const rocksdb::Slice& key, const rocksdb::Slice& value) override {
+    if (!skipOne()) {
+      batch_->Put(key, value);
+    }
+  }
+  void Delete(const rocksdb::Slice& key) override {
+    if (!skipOne()) {
+      batch_->Delete(key);
+    }
+  }
+  void SingleDelete(const rocksdb::Slice& key) override {
+    if (!skipOne()) {
+      batch_->SingleDelete(key);
+    }
+  }
+  void Merge(const rocksdb::Slice& key, const rocksdb::Slice& value) override {
+    if (!skipOne()) {
+      batch_->Merge(key, value);
+    }
+  }
+  rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const rocksdb::Slice& begin_key,
+                                const rocksdb::Slice& end_key) override {
+    if (column_family_id != 0) {
+      return rocksdb::Status::InvalidArgument("Only default column family is supported");
+    }
+    if (!skipOne()) {
+      batch_->DeleteRange(begin_key, end_key);
+    }
+    return rocksdb::Status::OK();
+  }
+  void LogData(const rocksdb::Slice& blob) override { batch_->PutLogData(blob); }
+
+ private:
+  rocksdb::WriteBatch* batch_;
+  uint64_t skip_;
+
+  bool skipOne() {
+    if (skip_ == 0) {
+      return false;
+    }
+    skip_--;
+    return true;
+  }
+};
+
+// 按 rocksdb WriteBatch 的格式（8 字节 sequence + 4 字节 count 的头部，后面是所有记录）拼接多个 WriteBatch，
+// 拼接后的 count 为各个 WriteBatch 之和，一次写入占用的 sequence 与逐个写入相同
+class WriteBatchGroup {
+ public:
+  WriteBatchGroup() = default;
+  ~WriteBatchGroup() = default;
+  // buf 的 sequence 与前一个 batch 不连续时返回 false，需要先 release 已经合并的 batch
+  bool append(const folly::IOBuf& buf);
+  // group 为空或者 buf 紧接在已经合并的 batch 之后
+  bool follows(const folly::IOBuf& buf) const;
+  rocksdb::WriteBatch release();
+  inline uint32_t getBatchNumber() const { return batch_number_; }
+  inline uint32_t getCount() const { return count_; }
+  inline size_t getDataSize() const { return rep_.size(); }
+
+ private:
+  std::string rep_;
+  uint32_t count_{0};
+  uint32_t batch_number_{0};
+  uint64_t next_sequence_{0};
+};
+
 class ExecutorWithTimeout {
  public:
   explicit ExecutorWithTimeout(folly::Executor* executor) : tasks_(), executor_(executor) {}
@@ -73,6 +154,7 @@ class ExecutorWithTimeout {
     auto task = std::make_shared<Task>(std::move(f));
     {
       folly::SpinLockGuard g(spinlock_);
+      removeDoneTasks();
       task->next = std::move(tasks_);
       tasks_ = task;
     }
@@ -106,12 +188,27 @@ class ExecutorWithTimeout {
     template <typename Func>
     explicit Task(Func&& f) : func(std::move(f)), next(), has_done(false) {}
     bool isDone() { return !has_done.exchange(true); }
+    bool hasDone() const { return has_done.load(); }
 
     folly::Function<void()> func;
     std::shared_ptr<Task> next;
     std::atomic<bool> has_done;
   };
 
+  // 超时已经执行过的等待留在链表中，没有写入的 db 上链表会一直增长，注册新的等待时摘除
+  void removeDoneTasks() {
+    while (tasks_ && tasks_->hasDone()) {
+      tasks_ = std::move(tasks_->next);
+    }
+    for (Task* prev = tasks_.get(); prev && prev->next;) {
+      if (prev->next->hasDone()) {
+        prev->next = std::move(prev->next->next);
+      } else {
+        prev = prev->next.get();
+      }
+    }
+  }
+
   void runAllTaskList(std::shared_ptr<Task> tasks) {
     while (tasks) {
       if (tasks->isDone()) {
@@ -127,6 +224,54 @@ class ExecutorWithTimeout {
   folly::SpinLock spinlock_;
 };
 
+// leader 端一个推送 stream 的状态，request 中的 seq_no 随着推送前进
+struct ReplicateStreamContext {
+  ReplicateStreamContext(apache::thrift::ServerStreamPublisher<ReplicateResponse>&& stream_publisher,
+                         std::unique_ptr<ReplicateRequest> stream_request, std::shared_ptr<std::atomic<bool>> stopped)
+      : publisher(std::move(stream_publisher)), request(std::move(*stream_request)), cancelled(std::move(stopped)) {
+    credits = request.get_stream_credits() ? *request.get_stream_credits() : 1;
+  }
+  apache::thrift::ServerStreamPublisher<ReplicateResponse> publisher;
+  ReplicateRequest request;
+  int32_t credits;
+  std::shared_ptr<std::atomic<bool>> cancelled;
+  // publisher 不感知 follower 的消费进度，已经推送但是 follower 还没有确认写入的字节数超过上限时暂停推送
+  int64_t unacked_bytes{0};
+  uint64_t ack_deadline_ms{0};
+};
+
+// follower 端一个 stream 订阅的状态，stopped 之后取消订阅，不再接收剩余的 response
+struct ReplicateStreamSubscriber {
+  bool stopped{false};
+  folly::Function<void()> cancel;
+};
+
+// 半同步写入时 ReplicationDB::write 不在写入线程中等待 follower 确认，只把等待登记到当前线程的 collector 中，
+// 调用方释放 key 锁之后再异步等待。当前线程没有 collector 时写入不等待确认
+class SyncAckCollector {
+ public:
+  SyncAckCollector() = default;
+  ~SyncAckCollector() = default;
+
+  // 作用域内当前线程的写入登记到 collector 中，析构时恢复之前的 collector
+  class Scope {
+   public:
+    explicit Scope(SyncAckCollector* collector);
+    ~Scope();
+
+   private:
+    SyncAckCollector* prev_;
+  };
+
+  static SyncAckCollector* current();
+  void add(folly::SemiFuture<bool>&& future);
+  // 所有登记的写入都被确认或者超时后完成
+  folly::SemiFuture<folly::Unit> wait();
+
+ private:
+  folly::Synchronized<std::vector<folly::SemiFuture<bool>>> futures_;
+};
+
 using IteratorCallback = folly::Function<void(rocksdb::Iterator*)>;
 using UpdateVersionCallback = folly::Function<void(int64_t db_hash, const std::string& version)>;
 class RocksDbBatch {
@@ -135,6 +280,7 @@ class RocksDbBatch {
   ~RocksDbBatch() {}
   void iput(const LaserSerializer& key, const LaserValueFormatBase& data);
   void idelete(const LaserSerializer& key);
+  void imerge(const LaserSerializer& key, const LaserSerializer& operand);
   inline rocksdb::WriteBatch& getBatch() { return batch_; }
 
  private:
@@ -158,6 +304,9 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
   virtual bool open();
   virtual bool close();
   virtual Status read(LaserValueFormatBase* value, const LaserSerializer& key);
+  // 批量读取，statuses 与 values 的顺序和 keys 一致
+  virtual void multiRead(std::vector<Status>* statuses, const std::vector<LaserValueFormatBase*>& values,
+                         const std::vector<const LaserSerializer*>& keys);
   virtual Status write(RocksDbBatch& batch);  // NOLINT
   virtual Status exist(bool* result, std::string* value, const LaserSerializer& key);
   virtual Status delkey(const LaserKeyFormatBase& key);
@@ -167,8 +316,14 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
   virtual Status checkpoint(const std::string& checkpoint_path);
   virtual Status compactRange();
   virtual void iterator(IteratorCallback callback);
+  // 只遍历与 prefix 提取出的前缀相同的 key，配置了前缀提取器时可以使用 prefix bloom 跳过 sst
+  virtual void prefixIterator(const LaserSerializer& prefix, IteratorCallback callback);
   virtual inline void setWriteOption(const rocksdb::WriteOptions& options) { default_write_options_ = options; }
   virtual inline void setReadOption(const rocksdb::ReadOptions& options) { default_read_options_ = options; }
+  // 设置点查缓存，为空时不使用缓存
+  virtual inline void setRowCache(std::shared_ptr<RowCache> row_cache) { row_cache_ = row_cache; }
+  // leader 写入后等待 sync_replicas 个 follower 确认再返回，超时后退化为异步同步
+  virtual inline void setSyncReplicas(uint32_t sync_replicas) { sync_replicas_ = sync_replicas; }
   virtual uint64_t getProperty(const std::string& key);
   static void getPropertyKeys(std::vector<std::string>* keys);
 
@@ -179,6 +334,7 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
                                std::shared_ptr<WdtReplicatorManager> wdt_manager, const std::string& src_dc);
   virtual void changeShardId(uint32_t shard_id);
   virtual void changeRole(const DBRole& role);
+  virtual inline DBRole getRole() const { return role_; }
   virtual void changeSrcDc(const std::string& dc);
   virtual void setUpdateVersionCallback(UpdateVersionCallback callback) {
     update_version_callback_ = std::move(callback);
@@ -186,16 +342,37 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
   virtual void handleReplicateRequest(
       std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::ReplicateResponse>>> callback,
       std::unique_ptr<::laser::ReplicateRequest> request);
+  // 合并同步请求时 leader 使用，没有更新的 partition 不会出现在返回结果中
+  virtual bool hasUpdates(const ReplicateRequest& request);
+  // 有新写入或者等待 timeout_ms 后执行 callback，超时后等待会被摘除
+  virtual void runOnUpdates(folly::Function<void()> callback, uint64_t timeout_ms);
+  virtual void getReplicateUpdates(ReplicateResponse* response, std::unique_ptr<::laser::ReplicateRequest> request);
+  // 合并同步请求中没有更新的 partition，leader 返回当前进度，follower 据此刷新同步延迟
+  virtual void getIdleReplicateState(IdleReplicateState* state);
+  virtual void applyIdleReplicateState(const IdleReplicateState& state);
+  // 记录 follower 已经写入的 seq 号，唤醒已经得到足够确认的半同步写入
+  virtual void updateFollowerAck(const ReplicateRequest& request);
+  // 设置后 follower 在独立的线程池中写入同步的数据，写入的同时发起下一次 pull
+  virtual inline void setApplyExecutor(std::shared_ptr<folly::Executor> executor) { apply_executor_ = executor; }
+  // 设置后 follower 的同步请求交给 batcher 与其他 partition 合并发送
+  virtual inline void setReplicateBatcher(std::shared_ptr<ReplicateBatcher> batcher) { batcher_ = batcher; }
+  virtual apache::thrift::ServerStream<ReplicateResponse> handleReplicateStreamRequest(
+      std::unique_ptr<::laser::ReplicateRequest> request);
   virtual void handleReplicateWdtRequest(
       std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::ReplicateWdtResponse>>> callback,
       std::unique_ptr<::laser::ReplicateWdtRequest> request);
   virtual void getDbMetaInfo(ReplicationDbMetaInfo* info);
+  // follower 可能缺失的写入距今的最长时间，从未同步过时返回 int64_t 最大值
+  virtual int64_t getReplicateLagMs();
   virtual void forceBaseDataReplication();
 
  private:
   std::string data_dir_;
   rocksdb::Options options_;
   std::unique_ptr<rocksdb::DB> db_{nullptr};
+  std::shared_ptr<RowCache> row_cache_;
+  std::shared_ptr<WalTailRing> wal_tail_ring_;
+  std::shared_ptr<ReplicateBatchSizer> batch_sizer_;
 
   rocksdb::WriteOptions default_write_options_;
   rocksdb::ReadOptions default_read_options_;
@@ -206,6 +383,8 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
   std::shared_ptr<folly::IOExecutor> executor_;
   apache::thrift::RpcOptions rpc_options_;
   std::shared_ptr<ExecutorWithTimeout> cond_var_;
+  // follower 上报 ack 时唤醒等待确认的 stream
+  std::shared_ptr<ExecutorWithTimeout> stream_ack_cond_var_;
   std::string version_;
   DBRole role_{DBRole::LEADER};
   int64_t node_hash_;
@@ -213,9 +392,13 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
   std::string client_address_;
   UpdateVersionCallback update_version_callback_;
   std::atomic<int64_t> leader_max_seq_no_{0};
+  // 最近一次写入的 update 在 leader 上的写入时间以及最近一次追上 leader 的本地时间
+  std::atomic<int64_t> last_applied_timestamp_{0};
+  std::atomic<int64_t> last_caught_up_ms_{0};
   folly::Synchronized<std::unordered_map<int64_t, std::string>> clients_;
 
   std::shared_ptr<WdtReplicatorManager> wdt_manager_;
+  std::shared_ptr<ReplicateBatcher> batcher_;
   folly::SpinLock checkpoint_ref_spin_;
   uint32_t checkpoint_ref_count_{0};
   folly::EventBase* evb_;
@@ -224,12 +407,19 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
   std::shared_ptr<metrics::Timers> write_timers_;
   std::shared_ptr<metrics::Timers> write_timers_without_lock_;
   std::shared_ptr<metrics::Timers> read_timers_;
+  std::shared_ptr<metrics::Timers> multi_read_timers_;
   std::shared_ptr<metrics::Histograms> pull_rpc_request_latency_;
   std::shared_ptr<metrics::Histograms> pull_rpc_response_latency_;
   std::shared_ptr<metrics::Histograms> whole_replication_latency_;
   std::shared_ptr<metrics::Histograms> apply_updates_numbers_;
+  std::shared_ptr<metrics::Histograms> replicator_latency_;
   std::shared_ptr<metrics::Timers> apply_updates_timers_;
   std::shared_ptr<metrics::Meter> apply_updates_kps_;
+  std::shared_ptr<metrics::Histograms> compression_ratio_;
+  std::shared_ptr<metrics::Timers> compress_timers_;
+  std::shared_ptr<metrics::Timers> decompress_timers_;
+  std::shared_ptr<metrics::Histograms> pull_max_size_;
+  std::shared_ptr<metrics::Histograms> response_size_;
   std::shared_ptr<metrics::Meter> sequence_no_diff_;
   std::shared_ptr<metrics::Histograms> interval_between_write_and_replicate_;
   std::shared_ptr<metrics::Meter> read_bytes_meter_;
@@ -241,17 +431,76 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
   using TransactionLogIteratorPair = std::pair<std::unique_ptr<rocksdb::TransactionLogIterator>, uint64_t>;
   folly::Synchronized<std::unordered_map<uint64_t, TransactionLogIteratorPair>> cached_iters_;
   std::atomic_bool force_base_data_replication_{false};
+  // 流式同步失败后使用 pull 协议的剩余次数
+  std::atomic<int32_t> stream_fallback_pulls_{0};
+
+  // 半同步写入，waiters 的 key 为写入的最后一个 seq 号和等待者编号
+  struct FollowerAcks {
+    std::unordered_map<int64_t, int64_t> acked_seq_nos;
+    std::map<std::pair<int64_t, uint64_t>, folly::Promise<bool>> waiters;
+    uint64_t next_waiter_id{0};
+  };
+  std::atomic<uint32_t> sync_replicas_{0};
+  folly::Synchronized<FollowerAcks> follower_acks_;
+  std::shared_ptr<metrics::Meter> sync_ack_timeout_;
+
+  // 同一个 partition 的 response 按到达顺序串行写入，不同 partition 之间并行
+  struct ApplyQueue {
+    std::deque<folly::Function<void()>> tasks;
+    bool running{false};
+  };
+  std::shared_ptr<folly::Executor> apply_executor_;
+  folly::Synchronized<ApplyQueue> apply_queue_;
+  // 写入失败或者 sequence 不连续时递增，之前发出的 pull 和待写入的 response 全部丢弃
+  std::atomic<uint64_t> apply_epoch_{0};
+  std::atomic<int64_t> pending_apply_bytes_{0};
+  std::shared_ptr<metrics::Meter> apply_backpressure_;
 
  protected:
   virtual void pullFromUpstream();
   virtual void getPullRequest(ReplicateRequest* req, const ReplicateType& type, int64_t max_seq_no = 0);
+  virtual void sendPullRequest(const ReplicateRequest& req);
+  // 计算 response 的数据大小以及之后还需要同步的 sequence 数量
+  virtual void getResponseProgress(int64_t* lag, int64_t* response_size, const ReplicateResponse& response);
+  // 统计从发起 pull 到写入完成的整体延迟，并据此调整下一次 pull 的大小
+  virtual void updateReplicateLatency(int64_t request_timestamp, int64_t lag, int64_t response_size, bool adjust_size);
+  // on_applied 在 response 写入完成之后调用，已经重新同步而丢弃的 response 不会调用
+  virtual void pipelineUpdates(folly::Try<ReplicateResponse>&& try_response, int64_t seq_no, uint64_t epoch,
+                               folly::Function<void()> on_applied = nullptr);
+  virtual void applyPipelinedUpdates(folly::Try<ReplicateResponse>&& try_response, int64_t seq_no, uint64_t epoch,
+                                     bool prefetched, folly::Function<void()> on_applied = nullptr);
+  virtual void addApplyTask(folly::Function<void()> task);
+  virtual void drainApplyTasks();
   virtual void delayPullFromUpstream();
   virtual void applyUpdates(folly::Try<ReplicateResponse>&& try_response);
+  // 返回 false 表示已经触发全量同步，不再继续增量同步
+  virtual bool applyReplicateResponse(bool* delay_next_pull, ReplicateResponse& response);  // NOLINT
+  virtual bool handleReplicateException(const folly::exception_wrapper& ew);
+  virtual bool triggerForcedBaseReplication();
+  virtual void streamFromUpstream();
+  virtual void applyStreamItem(bool* stopped, folly::Try<ReplicateResponse>&& item);
+  virtual void fallbackToPull(const folly::exception_wrapper& ew);
+  // 流式同步时 stream 是单向的，follower 写入后通过单独的 oneway 请求上报 ack_seq_no
+  virtual void sendStreamAck(const ReplicateRequest& request);
+  virtual void pushStreamUpdates(std::shared_ptr<ReplicateStreamContext> context);
+  // 等待 follower 确认已经推送的数据后继续推送，超时没有确认时结束 stream
+  virtual void waitStreamAck(std::shared_ptr<ReplicateStreamContext> context);
+  virtual bool isStreamAcked(int64_t node_hash, int64_t seq_no);
   virtual bool reachMaxSeqNoDiffLimit(const laser::ReplicateResponse& response);
   virtual void getUpdates(ReplicateResponse* response, std::unique_ptr<::laser::ReplicateRequest> request);
+  virtual bool getUpdatesFromRing(ReplicateResponse* response, uint32_t* batch_numbers, uint64_t* update_size,
+                                  int64_t expected_seq_no, int64_t max_size);
+  virtual void getUpdatesFromWal(ReplicateResponse* response, uint32_t* batch_numbers, uint64_t* update_size,
+                                 int64_t expected_seq_no, const ReplicateRequest& request);
+  virtual std::unique_ptr<rocksdb::WriteBatch> trimWriteBatch(rocksdb::WriteBatch* write_batch, uint64_t skip);
+  virtual void addReplicateInterval(int64_t write_ms);
   virtual const service_router::ClientOption getClientOption();
   virtual const Status convertRocksDbStatus(const rocksdb::Status& status);
   virtual Status writeWithSeqNumber(rocksdb::WriteBatch& write_batch, int64_t* seq_no, int64_t write_ms);  // NOLINT
+  // 结果为 false 表示等待超时或者角色变为 follower
+  virtual folly::SemiFuture<bool> waitForSyncReplicas(int64_t seq_no, uint32_t replicas);
+  virtual int64_t getAckedSeqNo(const FollowerAcks& acks, uint32_t replicas);
+  virtual void clearFollowerAcks();
   virtual int64_t getIterHash(int64_t seq_no, int64_t node_hash);
   virtual std::unique_ptr<rocksdb::TransactionLogIterator> getCachedIter(int64_t seq_no, int64_t node_hash);
   virtual void putCachedIter(int64_t seq_no, int64_t node_hash, std::unique_ptr<rocksdb::TransactionLogIterator> iter);
@@ -262,6 +511,11 @@ class ReplicationDB : public std::enable_shared_from_this<ReplicationDB> {
   virtual bool readInt(uint32_t* result, std::ifstream& fin);
   virtual bool readString(std::string* result, uint32_t* length, uint32_t kv_len, std::ifstream& fin);
   virtual Status innerIngestBaseSst(const std::string& ingest_file);
+  // leader 将 WAL 中的 WriteBatch 零拷贝地放入 IOBuf
+  static void wrapWriteBatch(folly::IOBuf* buf, std::unique_ptr<rocksdb::WriteBatch> write_batch);
+  // 按 follower 接受的压缩方式压缩 response 中的所有 update
+  virtual void compressResponse(ReplicateResponse* response, const ReplicateCompressionType& type);
+  virtual Status applyWriteBatchGroup(WriteBatchGroup* group, int64_t* seq_no, int64_t write_ms);
 };
 
 }  // namespace laser
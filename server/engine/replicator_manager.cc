@@ -18,6 +18,9 @@
  * @author liubang <it.liubang@gmail.com>
  */
 
+#include "folly/Random.h"
+
+#include "common/laser/status.h"
 #include "common/service_router/router.h"
 
 #include "replicator_manager.h"
@@ -26,9 +29,21 @@ namespace laser {
 
 DEFINE_int32(replicator_executor_threads, 16, "The number of replicator executor threads.");
 
+DEFINE_int32(replicator_apply_threads, 0,
+             "The number of threads followers apply replicated updates in, 0 means applying in replicator executor");
+
+DEFINE_bool(replicator_batch_enable, false, "Merge the replicate requests of all partitions to the same leader node");
+
 ReplicatorManager::ReplicatorManager() {
   replicate_thread_pool_ = std::make_shared<folly::IOThreadPoolExecutor>(
       FLAGS_replicator_executor_threads, std::make_shared<folly::NamedThreadFactory>("ReplicatorPool"));
+  if (FLAGS_replicator_batch_enable) {
+    batcher_ = std::make_shared<ReplicateBatcher>(replicate_thread_pool_);
+  }
+  if (FLAGS_replicator_apply_threads > 0) {
+    apply_thread_pool_ = std::make_shared<folly::CPUThreadPoolExecutor>(
+        FLAGS_replicator_apply_threads, std::make_shared<folly::NamedThreadFactory>("ReplicatorApplyPool"));
+  }
 }
 
 ReplicatorManager::~ReplicatorManager() {
@@ -38,6 +53,9 @@ ReplicatorManager::~ReplicatorManager() {
   if (replicate_thread_pool_) {
     replicate_thread_pool_->stop();
   }
+  if (apply_thread_pool_) {
+    apply_thread_pool_->stop();
+  }
 }
 
 void ReplicatorManager::init(const std::string& service_name, const std::string& host, uint32_t port, int64_t node_hash,
@@ -94,6 +112,8 @@ void ReplicatorManager::addDB(const DBRole& role, uint32_t shard_id, int64_t db_
       return;
     }
     std::string client_address = folly::to<std::string>(api_server_.getHost(), ":", api_server_.getPort());
+    replication_db->setReplicateBatcher(batcher_);
+    replication_db->setApplyExecutor(apply_thread_pool_);
     replication_db->startReplicator(shard_id, db_hash, service_name_, replicate_thread_pool_, role, version, node_hash_,
                                     client_address, wdt_manager, src_dc);
     dbs[db_hash] = db;
@@ -120,4 +140,90 @@ folly::Optional<std::weak_ptr<ReplicationDB>> ReplicatorManager::getDB(int64_t d
   });
 }
 
+void ReplicatorManager::handleBatchReplicateRequest(
+    std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::BatchReplicateResponse>>> callback,
+    std::unique_ptr<::laser::BatchReplicateRequest> request) {
+  auto context = std::make_shared<BatchReplicateContext>();
+  context->callback = std::move(callback);
+  context->request = std::move(request);
+  std::weak_ptr<ReplicatorManager> weak_manager = shared_from_this();
+  auto response_callback = [weak_manager, context]() {
+    auto manager = weak_manager.lock();
+    if (manager == nullptr) {
+      return;
+    }
+    manager->responseBatchReplicate(context);
+  };
+
+  // 先注册等待再检查是否已有更新，避免两者之间的写入被错过
+  // 每个 partition 上的等待都带有请求的超时时间，一个 partition 先返回后其余 partition 的等待到期时执行空操作并被摘除，
+  // 空闲 partition 上不会堆积等待
+  int64_t max_wait_ms = context->request->max_wait_ms;
+  bool has_updates = max_wait_ms <= 0;
+  bool has_waiter = false;
+  for (auto& req : context->request->requests) {
+    auto db = getDB(req.db_hash);
+    auto replication_db = db ? db.value().lock() : nullptr;
+    if (!replication_db) {
+      has_updates = true;
+      continue;
+    }
+    replication_db->updateFollowerAck(req);
+    if (max_wait_ms > 0) {
+      replication_db->runOnUpdates(response_callback, static_cast<uint64_t>(max_wait_ms));
+      has_waiter = true;
+    }
+    has_updates = has_updates || replication_db->hasUpdates(req);
+  }
+
+  if (has_updates || !has_waiter) {
+    replicate_thread_pool_->add(response_callback);
+  }
+}
+
+void ReplicatorManager::responseBatchReplicate(std::shared_ptr<BatchReplicateContext> context) {
+  if (context->responded.exchange(true)) {
+    return;
+  }
+
+  BatchReplicateResponse response;
+  std::map<int64_t, IdleReplicateState> idle_states;
+  auto& requests = context->request->requests;
+  int64_t max_size = context->request->max_size;
+  int64_t total_size = 0;
+  // 从随机的 partition 开始，总大小达到上限时避免总是饿死靠后的 partition
+  size_t start = requests.empty() ? 0 : folly::Random::rand32(static_cast<uint32_t>(requests.size()));
+  for (size_t i = 0; i < requests.size() && (max_size <= 0 || total_size < max_size); i++) {
+    auto& req = requests[(start + i) % requests.size()];
+    auto db = getDB(req.db_hash);
+    auto replication_db = db ? db.value().lock() : nullptr;
+    if (!replication_db) {
+      response.exceptions[req.db_hash] = createLaserException(
+          Status::RP_SOURCE_NOT_FOUND, folly::to<std::string>("could not find db ", req.db_hash));
+      continue;
+    }
+    if (!replication_db->hasUpdates(req)) {
+      // 没有更新的 partition 也返回 leader 的进度，follower 不需要等到下一次写入才能刷新同步延迟
+      replication_db->getIdleReplicateState(&idle_states[req.db_hash]);
+      continue;
+    }
+
+    ReplicateResponse db_response;
+    try {
+      replication_db->getReplicateUpdates(&db_response, std::make_unique<ReplicateRequest>(req));
+    } catch (const LaserException& ex) {
+      response.exceptions[req.db_hash] = ex;
+      continue;
+    }
+    for (auto& update : db_response.updates) {
+      total_size += static_cast<int64_t>(update.raw_data.computeChainDataLength());
+    }
+    response.responses[req.db_hash] = std::move(db_response);
+  }
+  if (!idle_states.empty()) {
+    response.set_idle_states(std::move(idle_states));
+  }
+  context->callback->result(std::move(response));
+}
+
 }  // namespace laser
@@ -23,10 +23,17 @@
 
 #include "common/service_router/thrift.h"
 
+#include "replicate_batcher.h"
 #include "replicator_service.h"
 
 namespace laser {
 
+struct BatchReplicateContext {
+  std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::BatchReplicateResponse>>> callback;
+  std::unique_ptr<::laser::BatchReplicateRequest> request;
+  std::atomic<bool> responded{false};
+};
+
 class ReplicatorManager : public std::enable_shared_from_this<ReplicatorManager> {
  public:
   ReplicatorManager();
@@ -40,10 +47,16 @@ class ReplicatorManager : public std::enable_shared_from_this<ReplicatorManager>
   virtual folly::Optional<std::weak_ptr<ReplicationDB>> getDB(int64_t db_hash);
   virtual void setShardList(const std::vector<uint32_t>& leader_shard_list,
                             const std::vector<uint32_t>& follower_shard_list);
+  // 任意一个 partition 有更新或者等待超时后返回所有有更新的 partition
+  virtual void handleBatchReplicateRequest(
+      std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::BatchReplicateResponse>>> callback,
+      std::unique_ptr<::laser::BatchReplicateRequest> request);
 
  private:
   folly::Synchronized<std::unordered_map<int64_t, std::weak_ptr<ReplicationDB>>> dbs_;
   std::shared_ptr<folly::IOThreadPoolExecutor> replicate_thread_pool_;
+  std::shared_ptr<folly::CPUThreadPoolExecutor> apply_thread_pool_;
+  std::shared_ptr<ReplicateBatcher> batcher_;
   std::thread thrift_server_thread_;
   std::shared_ptr<laser::ReplicatorService> handler_;
   service_router::Server api_server_;
@@ -53,6 +66,8 @@ class ReplicatorManager : public std::enable_shared_from_this<ReplicatorManager>
   folly::Synchronized<std::vector<uint32_t>> leader_shard_list_;
   folly::Synchronized<std::vector<uint32_t>> follower_shard_list_;
   folly::SaturatingSemaphore<true> wait_api_server_start_;
+
+  void responseBatchReplicate(std::shared_ptr<BatchReplicateContext> context);
 };
 
 }  // namespace laser
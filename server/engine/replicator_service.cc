@@ -41,6 +41,41 @@ void ReplicatorService::async_tm_replicate(
   db.value()->handleReplicateRequest(std::move(callback), std::move(request));
 }
 
+void ReplicatorService::async_tm_replicateBatch(
+    std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::BatchReplicateResponse>>> callback,
+    std::unique_ptr<::laser::BatchReplicateRequest> request) {
+  VLOG(5) << "batch request, partitions:" << request->requests.size();
+  auto manager = replicator_manager_.lock();
+  if (!manager) {
+    LaserException ex = createLaserException(Status::RP_SOURCE_NOT_FOUND, "replicator manager has been removed");
+    callback->exception(ex);
+    return;
+  }
+
+  manager->handleBatchReplicateRequest(std::move(callback), std::move(request));
+}
+
+apache::thrift::ServerStream<::laser::ReplicateResponse> ReplicatorService::replicateStream(
+    std::unique_ptr<::laser::ReplicateRequest> request) {
+  VLOG(5) << "stream request, db_hash:" << request->db_hash;
+  auto db = getDB(request->db_hash);
+  if (!db) {
+    throwLaserException(Status::RP_SOURCE_NOT_FOUND, folly::to<std::string>("could not find db ", request->db_hash));
+  }
+
+  return db.value()->handleReplicateStreamRequest(std::move(request));
+}
+
+void ReplicatorService::replicateAck(std::unique_ptr<::laser::ReplicateRequest> request) {
+  auto db = getDB(request->db_hash);
+  if (!db) {
+    VLOG(5) << "ack for unknown db, db_hash:" << request->db_hash;
+    return;
+  }
+
+  db.value()->updateFollowerAck(*request);
+}
+
 void ReplicatorService::async_tm_replicateWdt(
     std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::ReplicateWdtResponse>>> callback,
     std::unique_ptr<::laser::ReplicateWdtRequest> request) {
@@ -32,6 +32,12 @@ class ReplicatorService : virtual public ReplicatorSvIf {
   virtual void async_tm_replicate(
       std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::ReplicateResponse>>> callback,
       std::unique_ptr<::laser::ReplicateRequest> request);
+  virtual void async_tm_replicateBatch(
+      std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::BatchReplicateResponse>>> callback,
+      std::unique_ptr<::laser::BatchReplicateRequest> request);
+  virtual apache::thrift::ServerStream<::laser::ReplicateResponse> replicateStream(
+      std::unique_ptr<::laser::ReplicateRequest> request);
+  virtual void replicateAck(std::unique_ptr<::laser::ReplicateRequest> request);
   virtual void async_tm_replicateWdt(
       std::unique_ptr<apache::thrift::HandlerCallback<std::unique_ptr<::laser::ReplicateWdtResponse>>> callback,
       std::unique_ptr<::laser::ReplicateWdtRequest> request);
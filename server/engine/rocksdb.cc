@@ -18,6 +18,9 @@
  */
 
 
+#include <algorithm>
+#include <limits>
+
 #include "boost/filesystem.hpp"
 #include "common/util.h"
 
@@ -26,12 +29,80 @@
 
 namespace laser {
 
+DEFINE_bool(rocksdb_engine_ttl_index, true, "Whether to write ttl index for keys with expire time");
+DEFINE_bool(rocksdb_engine_merge_write, false,
+            "Whether counter and append write merge operands, enable it only after all replicas support merge operator");
+DEFINE_int32(rocksdb_engine_ttl_sweep_backlog_limit, 100000, "Max expired ttl index number counted as sweep backlog");
+DEFINE_int32(rocksdb_engine_ttl_index_bucket_ms, 1000,
+             "Granularity of ttl index time, rewrites of a key inside one bucket share one index entry");
+DEFINE_int32(rocksdb_engine_reclaim_rows_per_key, 1000,
+             "Max stale data rows of one composite key deleted by one ttl sweep, the rest are left to later rounds");
+
 constexpr double LASER_ROCKSDB_ENGINE_TIMER_BUCKET_SIZE = 1.0;
 constexpr double LASER_ROCKSDB_ENGINE_TIMER_MIN = 0.0;
 constexpr double LASER_ROCKSDB_ENGINE_TIMER_MAX = 1000.0;
 
+template <typename T>
+Status RocksDbEngine::readMetaForWrite(T* meta, RocksDbBatch* batch, const LaserKeyFormat& key) {
+  Status status = db_->read(meta, key);
+  if (status != Status::OK && status != Status::RS_NOT_FOUND) {
+    return status;
+  }
+
+  uint64_t old_version = 0;
+  if (status == Status::RS_NOT_FOUND) {
+    // meta 已删除但 data 行还没有回收完，新版本号必须大于旧版本号，不能只依赖本机时钟
+    LaserValueFormatBase dead_version;
+    Status dead_status = db_->read(&dead_version, LaserKeyFormat(key, KeyType::DEAD_VERSION));
+    if (dead_status != Status::OK && dead_status != Status::RS_NOT_FOUND) {
+      return dead_status;
+    }
+    if (dead_status == Status::OK && dead_version.decode()) {
+      old_version = dead_version.getVersion();
+    }
+  } else {
+    if (!meta->decode()) {
+      return Status::RS_INVALID_ARGUMENT;
+    }
+    if (!checkKeyExpire(*meta)) {
+      return Status::OK;
+    }
+    old_version = meta->getVersion();
+    // 旧版本的 data 行写入回收索引，历史格式的 data 行带有过期时间，由 ExpireFilter 回收
+    if (old_version != 0) {
+      addReclaimIndex(batch, key, old_version);
+    }
+  }
+
+  // 新建或者已过期的 key 使用新的版本号，旧版本的 data 行由 TTL 清理回收
+  *meta = T();
+  meta->setVersion(newVersion(old_version));
+  return Status::OK;
+}
+
 Status RocksDbEngine::append(uint32_t* length, const LaserKeyFormat& key, const std::string& data) {
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  if (isBlindMerge()) {
+    LaserValueRawString expire_value;
+    setAutoExpire(expire_value);
+    uint64_t now = static_cast<uint64_t>(common::currentTimeInMs());
+    Status status = mergeWrite(key, LaserMergeOperand(data, now, expire_value.getTimestamp()), 0);
+    if (status != Status::OK || length == nullptr) {
+      return status;
+    }
+    // 写入后再读取，类型不匹配的操作数被 merge operator 忽略，这里返回类型错误
+    LaserValueRawString value;
+    status = db_->read(&value, key);
+    if (status != Status::OK) {
+      return status;
+    }
+    if (!value.decode()) {
+      return Status::RS_INVALID_ARGUMENT;
+    }
+    *length = value.getValue().size();
+    return Status::OK;
+  }
+
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueRawString old_value;
   Status status = db_->read(&old_value, key);
@@ -39,22 +110,34 @@ Status RocksDbEngine::append(uint32_t* length, const LaserKeyFormat& key, const
     return status;
   }
 
-  RocksDbBatch batch;
-  std::string set_data;
+  uint64_t now = static_cast<uint64_t>(common::currentTimeInMs());
+  size_t old_length = 0;
   if (status == Status::OK) {
     if (!old_value.decode()) {
       return Status::RS_INVALID_ARGUMENT;
     }
-    set_data = old_value.getValue() + data;
-  } else {
-    set_data = data;
+    // 和 merge operator 一致，已过期的值按空值处理
+    if (!isExpiredAt(old_value, now)) {
+      old_length = old_value.getValue().size();
+    }
+  }
+
+  if (length) {
+    *length = old_length + data.size();
+  }
+  // 已经在 key 锁内校验过类型，merge 只写入追加的数据，避免重写整个 value
+  if (FLAGS_rocksdb_engine_merge_write) {
+    LaserValueRawString expire_value;
+    setAutoExpire(expire_value);
+    return mergeWrite(key, LaserMergeOperand(data, now, expire_value.getTimestamp()), old_value.getTimestamp());
   }
 
-  *length = set_data.size();
-  LaserValueRawString value(set_data);
+  RocksDbBatch batch;
+  LaserValueRawString value(old_length > 0 ? old_value.getValue() + data : data);
   setAutoExpire(value);
   value.encode();
   batch.iput(key, value);
+  addTtlIndex(batch, key, value.getTimestamp(), old_value.getTimestamp());
   return db_->write(batch);
 }
 
@@ -64,14 +147,16 @@ Status RocksDbEngine::set(const LaserKeyFormat& key, const std::string& data) {
   setAutoExpire(value);
   value.encode();
   batch.iput(key, value);
+  addTtlIndex(batch, key, value.getTimestamp());
   return db_->write(batch);
 }
 
 Status RocksDbEngine::setx(const LaserKeyFormat& key, const std::string& data, const RocksDbEngineSetOptions& options) {
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
   RocksDbBatch batch;
 
   LaserValueRawString value(data);
+  uint64_t old_timestamp = 0;
   if (options.not_exists) {
     LaserValueRawString old_value;
     Status status = db_->read(&old_value, key);
@@ -83,6 +168,7 @@ Status RocksDbEngine::setx(const LaserKeyFormat& key, const std::string& data, c
       if (!old_value.decode()) {
         return Status::RS_INVALID_ARGUMENT;
       }
+      old_timestamp = old_value.getTimestamp();
       // 如果存在并且没有过期则不设置
       if (!checkKeyExpire(old_value)) {
         return Status::RS_KEY_EXISTS;
@@ -97,6 +183,7 @@ Status RocksDbEngine::setx(const LaserKeyFormat& key, const std::string& data, c
   }
   value.encode();
   batch.iput(key, value);
+  addTtlIndex(batch, key, value.getTimestamp(), old_timestamp);
   return db_->write(batch);
 }
 
@@ -122,7 +209,7 @@ Status RocksDbEngine::exist(bool* result, const LaserKeyFormat& key) {
   return status;
 }
 
-Status RocksDbEngine::mset(const std::vector<LaserKeyFormat>& keys, const std::vector<std::string>& datas) {
+Status RocksDbEngine::mset(const std::vector<const LaserKeyFormat*>& keys, const std::vector<std::string>& datas) {
   if (keys.size() != datas.size()) {
     return Status::RS_INVALID_ARGUMENT;
   }
@@ -132,25 +219,32 @@ Status RocksDbEngine::mset(const std::vector<LaserKeyFormat>& keys, const std::v
     LaserValueRawString value(datas[i]);
     setAutoExpire(value);
     value.encode();
-    batch.iput(keys[i], value);
+    batch.iput(*keys[i], value);
+    addTtlIndex(batch, *keys[i], value.getTimestamp());
   }
   return db_->write(batch);
 }
 
-Status RocksDbEngine::msetx(const std::vector<LaserKeyFormat>& keys, const std::vector<std::string>& datas,
+Status RocksDbEngine::msetx(const std::vector<const LaserKeyFormat*>& keys, const std::vector<std::string>& datas,
                             const RocksDbEngineSetOptions& options) {
   if (keys.size() != datas.size()) {
     return Status::RS_INVALID_ARGUMENT;
   }
 
+  std::vector<uint64_t> key_hashes;
+  key_hashes.reserve(keys.size());
+  for (auto& key : keys) {
+    key_hashes.push_back(LockManager::hash(key->data(), key->length()));
+  }
+  ScopedMultiKeyLock key_locks(std::move(key_hashes));
+
   RocksDbBatch batch;
-  std::vector<ScopedKeyLock> key_locks;
   for (size_t i = 0; i < keys.size(); ++i) {
-    key_locks.emplace_back(std::move(ScopedKeyLock(std::string(keys[i].data(), keys[i].length()))));
     LaserValueRawString value(datas[i]);
+    uint64_t old_timestamp = 0;
     if (options.not_exists) {
       LaserValueRawString old_value;
-      Status status = db_->read(&old_value, keys[i]);
+      Status status = db_->read(&old_value, *keys[i]);
       if (status != Status::OK && status != Status::RS_NOT_FOUND) {
         continue;
       }
@@ -159,6 +253,7 @@ Status RocksDbEngine::msetx(const std::vector<LaserKeyFormat>& keys, const std::
         if (!old_value.decode()) {
           continue;
         }
+        old_timestamp = old_value.getTimestamp();
         if (!checkKeyExpire(old_value)) {
           continue;
         }
@@ -171,7 +266,8 @@ Status RocksDbEngine::msetx(const std::vector<LaserKeyFormat>& keys, const std::
       setAutoExpire(value);
     }
     value.encode();
-    batch.iput(keys[i], value);
+    batch.iput(*keys[i], value);
+    addTtlIndex(batch, *keys[i], value.getTimestamp(), old_timestamp);
   }
   return db_->write(batch);
 }
@@ -188,32 +284,104 @@ Status RocksDbEngine::get(LaserValueRawString* value, const LaserKeyFormat& key)
   return status;
 }
 
+Status RocksDbEngine::mget(std::vector<Status>* statuses, std::vector<LaserValueRawString>* values,
+                           const std::vector<const LaserKeyFormat*>& keys) {
+  values->clear();
+  values->resize(keys.size());
+  std::vector<LaserValueFormatBase*> raw_values;
+  raw_values.reserve(keys.size());
+  for (auto& value : *values) {
+    raw_values.push_back(&value);
+  }
+  std::vector<const LaserSerializer*> raw_keys(keys.begin(), keys.end());
+  db_->multiRead(statuses, raw_values, raw_keys);
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    if ((*statuses)[i] != Status::OK) {
+      continue;
+    }
+    if (!(*values)[i].decode()) {
+      (*statuses)[i] = Status::RS_INVALID_ARGUMENT;
+    } else if (checkKeyExpire((*values)[i])) {
+      (*statuses)[i] = Status::RS_KEY_EXPIRE;
+    }
+  }
+  return Status::OK;
+}
+
 Status RocksDbEngine::setCounterByStep(int64_t* result, const LaserKeyFormat& key, int64_t step) {
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
-  RocksDbBatch batch;
+  if (isBlindMerge()) {
+    LaserValueCounter expire_value;
+    setAutoExpire(expire_value);
+    uint64_t now = static_cast<uint64_t>(common::currentTimeInMs());
+    Status status = mergeWrite(key, LaserMergeOperand(step, now, expire_value.getTimestamp()), 0);
+    if (status != Status::OK || result == nullptr) {
+      return status;
+    }
+    // 写入后再读取，并发写入时读到的是包含其他增量的最新值
+    LaserValueCounter counter;
+    status = db_->read(&counter, key);
+    if (status != Status::OK) {
+      return status;
+    }
+    if (!counter.decode()) {
+      return Status::RS_INVALID_ARGUMENT;
+    }
+    *result = counter.getValue();
+    return Status::OK;
+  }
+
+  ScopedKeyLock guard(key.data(), key.length());
   LaserValueCounter old_counter;
   Status status = db_->read(&old_counter, key);
   if (status != Status::OK && status != Status::RS_NOT_FOUND) {
     return status;
   }
 
+  uint64_t now = static_cast<uint64_t>(common::currentTimeInMs());
   int64_t count = 0;
   if (status == Status::OK) {
     if (!old_counter.decode()) {
       return Status::RS_INVALID_ARGUMENT;
     }
-    count = old_counter.getValue();
+    // 和 merge operator 一致，已过期的计数器从 0 开始
+    if (!isExpiredAt(old_counter, now)) {
+      count = old_counter.getValue();
+    }
   }
   count += step;
 
-  *result = count;
+  if (result) {
+    *result = count;
+  }
+  // 已经在 key 锁内校验过类型，返回值和写入的增量一致，merge 只写入增量
+  if (FLAGS_rocksdb_engine_merge_write) {
+    LaserValueCounter expire_value;
+    setAutoExpire(expire_value);
+    return mergeWrite(key, LaserMergeOperand(step, now, expire_value.getTimestamp()), old_counter.getTimestamp());
+  }
+
+  RocksDbBatch batch;
   LaserValueCounter value(count);
   setAutoExpire(value);
   value.encode();
   batch.iput(key, value);
+  addTtlIndex(batch, key, value.getTimestamp(), old_counter.getTimestamp());
+  return db_->write(batch);
+}
+
+Status RocksDbEngine::mergeWrite(const LaserKeyFormat& key, const LaserMergeOperand& operand,
+                                 uint64_t old_timestamp) {
+  RocksDbBatch batch;
+  batch.imerge(key, operand);
+  addTtlIndex(batch, key, operand.getTimestamp(), old_timestamp);
   return db_->write(batch);
 }
 
+bool RocksDbEngine::isBlindMerge() const {
+  return FLAGS_rocksdb_engine_merge_write && options_ && options_->blind_merge;
+}
+
 Status RocksDbEngine::incr(int64_t* value, const LaserKeyFormat& key, uint64_t step) {
   return setCounterByStep(value, key, step);
 }
@@ -224,95 +392,74 @@ Status RocksDbEngine::decr(int64_t* value, const LaserKeyFormat& key, uint64_t s
 
 Status RocksDbEngine::hset(const LaserKeyFormat& key, const std::string& field, const std::string& value) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueMapMeta meta_data;
-  Status status = db_->read(&meta_data, key);
-  if (status != Status::OK && status != Status::RS_NOT_FOUND) {
+  Status status = readMetaForWrite(&meta_data, &batch, key);
+  if (status != Status::OK) {
     return status;
   }
 
-  LaserValueRawString field_value(value);
   LaserKeyFormatMapData map_data_key(key, field);
-  if (status == Status::OK) {
-    // 获取数据
-    LaserValueRawString old_value;
-    Status data_status = db_->read(&old_value, map_data_key);
-    if (data_status != Status::OK && data_status != Status::RS_NOT_FOUND) {
-      return data_status;
-    }
-
-    if (!meta_data.decode()) {
-      return Status::RS_INVALID_ARGUMENT;
-    }
-    if (data_status == Status::RS_NOT_FOUND) {
-      meta_data.incrSize();
-      meta_data.encode();
-      setAutoExpire(meta_data);
-      batch.iput(key, meta_data);
-    }
-    setAutoExpire(field_value);
-    batch.iput(map_data_key, field_value);
-  } else {
+  // 获取数据
+  LaserValueFormatBase old_value;
+  Status data_status = readDataRow(&old_value, map_data_key, meta_data);
+  if (data_status != Status::OK && data_status != Status::RS_NOT_FOUND) {
+    return data_status;
+  }
+  if (data_status == Status::RS_NOT_FOUND) {
     meta_data.incrSize();
-    setAutoExpire(meta_data);
-    meta_data.encode();
-    batch.iput(key, meta_data);
-    batch.iput(map_data_key, field_value);
   }
+  uint64_t old_timestamp = meta_data.getTimestamp();
+  setAutoExpire(meta_data);
+  addTtlIndex(batch, key, meta_data.getTimestamp(), old_timestamp);
+  meta_data.encode();
+  batch.iput(key, meta_data);
 
+  LaserValueRawString field_value(value);
+  setDataVersion(field_value, meta_data);
+  batch.iput(map_data_key, field_value);
   return db_->write(batch);
 }
 
 Status RocksDbEngine::hmset(const LaserKeyFormat& key, const std::map<std::string, std::string>& values) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueMapMeta meta_data;
-  Status status = db_->read(&meta_data, key);
-  if (status != Status::OK && status != Status::RS_NOT_FOUND) {
+  Status status = readMetaForWrite(&meta_data, &batch, key);
+  if (status != Status::OK) {
     return status;
   }
 
-  if (status == Status::OK) {
-    if (!meta_data.decode()) {
-      return Status::RS_INVALID_ARGUMENT;
-    }
-  }
-
-  setAutoExpire(meta_data);
   for (auto& value : values) {
-    LaserValueRawString field_value(value.second);
-    setAutoExpire(field_value);
     LaserKeyFormatMapData map_data_key(key, value.first);
-    if (status == Status::OK) {
-      // 获取数据
-      LaserValueRawString old_value;
-      Status data_status = db_->read(&old_value, map_data_key);
-      if (data_status != Status::OK && data_status != Status::RS_NOT_FOUND) {
-        return data_status;
-      }
-
-      if (data_status == Status::RS_NOT_FOUND) {
-        meta_data.incrSize();
-        meta_data.encode();
-        batch.iput(key, meta_data);
-      }
-      batch.iput(map_data_key, field_value);
-    } else {
+    // 获取数据
+    LaserValueFormatBase old_value;
+    Status data_status = readDataRow(&old_value, map_data_key, meta_data);
+    if (data_status != Status::OK && data_status != Status::RS_NOT_FOUND) {
+      return data_status;
+    }
+    if (data_status == Status::RS_NOT_FOUND) {
       meta_data.incrSize();
-      meta_data.encode();
-      batch.iput(key, meta_data);
-      batch.iput(map_data_key, field_value);
     }
+
+    LaserValueRawString field_value(value.second);
+    setDataVersion(field_value, meta_data);
+    batch.iput(map_data_key, field_value);
   }
 
+  uint64_t old_timestamp = meta_data.getTimestamp();
+  setAutoExpire(meta_data);
+  addTtlIndex(batch, key, meta_data.getTimestamp(), old_timestamp);
+  meta_data.encode();
+  batch.iput(key, meta_data);
   return db_->write(batch);
 }
 
 Status RocksDbEngine::hdel(const LaserKeyFormat& key, const std::string& field) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueMapMeta meta_data;
   Status status = db_->read(&meta_data, key);
@@ -322,11 +469,14 @@ Status RocksDbEngine::hdel(const LaserKeyFormat& key, const std::string& field)
   if (!meta_data.decode()) {
     return Status::RS_INVALID_ARGUMENT;
   }
+  if (checkKeyExpire(meta_data)) {
+    return Status::RS_KEY_EXPIRE;
+  }
 
   LaserKeyFormatMapData map_data_key(key, field);
   // 获取数据
-  LaserValueRawString old_value;
-  Status data_status = db_->read(&old_value, map_data_key);
+  LaserValueFormatBase old_value;
+  Status data_status = readDataRow(&old_value, map_data_key, meta_data);
   if (data_status != Status::OK) {
     return data_status;
   }
@@ -355,11 +505,75 @@ Status RocksDbEngine::hget(LaserValueRawString* value, const LaserKeyFormat& key
     return Status::RS_KEY_EXPIRE;
   }
 
-  Status data_status = db_->read(value, map_data_key);
-  if (data_status == Status::OK && !value->decode()) {
+  return readDataRow(value, map_data_key, meta_data);
+}
+
+Status RocksDbEngine::hmget(std::unordered_map<std::string, LaserValueRawString>* values, const LaserKeyFormat& key,
+                            const std::vector<std::string>& fields) {
+  LaserValueMapMeta map_meta;
+  Status status = db_->read(&map_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
+  if (!map_meta.decode()) {
+    return Status::RS_INVALID_ARGUMENT;
+  }
+  if (checkKeyExpire(map_meta)) {
+    return Status::RS_KEY_EXPIRE;
+  }
+
+  std::vector<LaserKeyFormatMapData> map_data_keys;
+  map_data_keys.reserve(fields.size());
+  for (auto& field : fields) {
+    map_data_keys.emplace_back(key, field);
+  }
+  std::vector<LaserValueRawString> field_values(fields.size());
+  std::vector<const LaserSerializer*> raw_keys;
+  std::vector<LaserValueFormatBase*> raw_values;
+  raw_keys.reserve(fields.size());
+  raw_values.reserve(fields.size());
+  for (size_t i = 0; i < fields.size(); i++) {
+    raw_keys.push_back(&map_data_keys[i]);
+    raw_values.push_back(&field_values[i]);
+  }
+
+  std::vector<Status> statuses;
+  db_->multiRead(&statuses, raw_values, raw_keys);
+  for (size_t i = 0; i < fields.size(); i++) {
+    if (statuses[i] == Status::RS_NOT_FOUND) {
+      continue;
+    }
+    if (statuses[i] != Status::OK) {
+      return statuses[i];
+    }
+    if (!field_values[i].decode()) {
+      return Status::RS_INVALID_ARGUMENT;
+    }
+    if (field_values[i].getVersion() != map_meta.getVersion()) {
+      continue;
+    }
+    (*values)[fields[i]] = field_values[i];
+  }
+
+  return Status::OK;
+}
+
+Status RocksDbEngine::hexists(const LaserKeyFormat& key, const std::string& field) {
+  LaserValueMapMeta meta_data;
+  Status status = db_->read(&meta_data, key);
+  if (status != Status::OK) {
+    return status;
+  }
+  if (!meta_data.decode()) {
     return Status::RS_INVALID_ARGUMENT;
   }
-  return data_status;
+  if (checkKeyExpire(meta_data)) {
+    return Status::RS_KEY_EXPIRE;
+  }
+
+  LaserKeyFormatMapData map_data_key(key, field);
+  LaserValueFormatBase value;
+  return readDataRow(&value, map_data_key, meta_data);
 }
 
 Status RocksDbEngine::hlen(LaserValueMapMeta* value, const LaserKeyFormat& key) {
@@ -387,11 +601,15 @@ Status RocksDbEngine::hkeys(std::vector<LaserKeyFormatMapData>* keys, const Lase
     return Status::RS_KEY_EXPIRE;
   }
 
-  db_->iterator([this, &key, keys, &status](auto iter) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, keys, &status, &map_meta](auto iter) {
     LaserKeyFormatMapData prefix(key);
     rocksdb::Slice slice_key(prefix.data(), prefix.length());
 
     for (iter->Seek(slice_key); iter->Valid() && iter->key().starts_with(slice_key); iter->Next()) {
+      if (!isDataRowVisible(iter->value(), map_meta.getVersion())) {
+        continue;
+      }
       LaserKeyFormatMapData map_data_key(iter->key().data(), iter->key().size());
       if (!map_data_key.decode()) {
         status = Status::RS_INVALID_ARGUMENT;
@@ -417,7 +635,8 @@ Status RocksDbEngine::hgetall(std::unordered_map<std::string, LaserValueRawStrin
     return Status::RS_KEY_EXPIRE;
   }
 
-  db_->iterator([this, &key, values](auto iter) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, values, &map_meta](auto iter) {
     LaserKeyFormatMapData prefix(key);
     rocksdb::Slice slice_key(prefix.data(), prefix.length());
 
@@ -427,7 +646,7 @@ Status RocksDbEngine::hgetall(std::unordered_map<std::string, LaserValueRawStrin
         continue;
       }
       LaserValueRawString map_value(iter->value().data(), iter->value().size());
-      if (!map_value.decode()) {
+      if (!map_value.decode() || map_value.getVersion() != map_meta.getVersion()) {
         continue;
       }
 
@@ -464,20 +683,16 @@ Status RocksDbEngine::lindex(LaserValueRawString* value, const LaserKeyFormat& k
     return Status::RS_KEY_EXPIRE;
   }
   int64_t target_index = index >= 0 ? (list_meta.getStart() + index + 1) : (list_meta.getEnd() + index);
-  LaserKeyFormatListData list_data_key(key, target_index);
-  status = db_->read(value, list_data_key);
-  if (status != Status::OK) {
-    return status;
-  }
-  if (!value->decode()) {
-    return Status::RS_INVALID_ARGUMENT;
+  if (target_index <= list_meta.getStart() || target_index >= list_meta.getEnd()) {
+    return Status::RS_NOT_FOUND;
   }
-  return Status::OK;
+  LaserKeyFormatListData list_data_key(key, target_index);
+  return readDataRow(value, list_data_key, list_meta);
 }
 
 Status RocksDbEngine::listPop(LaserValueRawString* value, const LaserKeyFormat& key, bool is_left) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueListMeta meta_data;
   Status status = db_->read(&meta_data, key);
@@ -499,13 +714,10 @@ Status RocksDbEngine::listPop(LaserValueRawString* value, const LaserKeyFormat&
   batch.iput(key, meta_data);
 
   LaserKeyFormatListData list_data_key(key, index);
-  status = db_->read(value, list_data_key);
+  status = readDataRow(value, list_data_key, meta_data);
   if (status != Status::OK) {
     return status;
   }
-  if (!value->decode()) {
-    return Status::RS_INVALID_ARGUMENT;
-  }
 
   batch.idelete(list_data_key);
   return db_->write(batch);
@@ -534,8 +746,8 @@ Status RocksDbEngine::get(LaserValueListMeta* value, const LaserKeyFormat& key)
   return Status::OK;
 }
 
-Status RocksDbEngine::lrange(std::vector<LaserValueRawString>* values, const LaserKeyFormat& key, uint64_t start,
-                             uint64_t end) {
+Status RocksDbEngine::lrange(std::vector<LaserValueRawString>* values, const LaserKeyFormat& key, int64_t start,
+                             int64_t end) {
   LaserValueListMeta list_meta;
   Status status = db_->read(&list_meta, key);
   if (status != Status::OK) {
@@ -548,61 +760,97 @@ Status RocksDbEngine::lrange(std::vector<LaserValueRawString>* values, const Las
   if (checkKeyExpire(list_meta)) {
     return Status::RS_KEY_EXPIRE;
   }
-  int64_t target_index_start = list_meta.getStart() + start + 1;
-  int64_t target_index_end = list_meta.getEnd() - 1;
 
-  if (end > 0) {  // 用户指定 start end index
-    if (end <= start) {
+  int64_t size = list_meta.getSize();
+  bool from_tail = start < 0;
+  int64_t start_pos = start < 0 ? size + start : start;
+  int64_t end_pos = size;
+  if (end != 0) {  // 用户指定 start end index
+    end_pos = end < 0 ? size + end : end;
+    if (end_pos <= start_pos) {
       return Status::RS_INVALID_ARGUMENT;
     }
-    target_index_end = list_meta.getStart() + end;
   }
-  if (target_index_start > list_meta.getEnd() || target_index_end > list_meta.getEnd()) {
+  if (start_pos < 0 || start_pos > size || end_pos > size) {
     return Status::RS_INVALID_ARGUMENT;
   }
+  int64_t target_index_start = list_meta.getStart() + start_pos + 1;
+  int64_t target_index_end = list_meta.getStart() + end_pos;
+
+  uint64_t version = list_meta.getVersion();
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, values, target_index_start, target_index_end, from_tail,
+                                      version](auto iter) {
+    // index 是有符号大端编码，负数 index 的 key 排在非负 index 之后，需要按符号拆成两段分别 seek
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+    if (target_index_start < 0) {
+      ranges.emplace_back(target_index_start, std::min<int64_t>(target_index_end, -1));
+    }
+    if (target_index_end >= 0) {
+      ranges.emplace_back(std::max<int64_t>(target_index_start, 0), target_index_end);
+    }
 
-  db_->iterator([this, &key, values, target_index_start, target_index_end](auto iter) {
-    LaserKeyFormatListData prefix(key);
-    rocksdb::Slice slice_key(prefix.data(), prefix.length());
-
-    for (iter->Seek(slice_key); iter->Valid() && iter->key().starts_with(slice_key); iter->Next()) {
-      LaserKeyFormatListData list_data_key(iter->key().data(), iter->key().size());
-      if (!list_data_key.decode()) {
-        continue;
-      }
-      int64_t index = list_data_key.getIndex();
-      if (index < target_index_start) {
-        continue;
+    if (!from_tail) {
+      for (auto& range : ranges) {
+        listRangeScan(values, iter, key, range.first, range.second, version, false);
       }
+      return;
+    }
 
-      if (index > target_index_end) {
-        continue;
-      }
-      LaserValueRawString list_value(iter->value().data(), iter->value().size());
-      if (!list_value.decode()) {
-        continue;
-      }
-      values->push_back(list_value);
+    // 读取尾部数据时从后往前扫描，最后再恢复正序
+    size_t offset = values->size();
+    for (auto it = ranges.rbegin(); it != ranges.rend(); ++it) {
+      listRangeScan(values, iter, key, it->first, it->second, version, true);
     }
+    std::reverse(values->begin() + offset, values->end());
   });
 
   return status;
 }
 
+void RocksDbEngine::listRangeScan(std::vector<LaserValueRawString>* values, rocksdb::Iterator* iter,
+                                  const LaserKeyFormat& key, int64_t index_start, int64_t index_end, uint64_t version,
+                                  bool reverse) {
+  LaserKeyFormatListData prefix(key);
+  rocksdb::Slice slice_prefix(prefix.data(), prefix.length());
+  LaserKeyFormatListData seek_key(key, reverse ? index_end : index_start);
+  rocksdb::Slice slice_seek(seek_key.data(), seek_key.length());
+
+  if (reverse) {
+    iter->SeekForPrev(slice_seek);
+  } else {
+    iter->Seek(slice_seek);
+  }
+  for (; iter->Valid() && iter->key().starts_with(slice_prefix); reverse ? iter->Prev() : iter->Next()) {
+    LaserKeyFormatListData list_data_key(iter->key().data(), iter->key().size());
+    if (!list_data_key.decode()) {
+      continue;
+    }
+    int64_t index = list_data_key.getIndex();
+    if (index < index_start || index > index_end) {
+      break;
+    }
+    LaserValueRawString list_value(iter->value().data(), iter->value().size());
+    if (!list_value.decode() || list_value.getVersion() != version) {
+      continue;
+    }
+    values->push_back(list_value);
+  }
+}
+
 Status RocksDbEngine::listPush(const LaserKeyFormat& key, const std::string& value, bool is_left) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueListMeta meta_data;
-  Status status = db_->read(&meta_data, key);
-  if (status != Status::OK && status != Status::RS_NOT_FOUND) {
+  Status status = readMetaForWrite(&meta_data, &batch, key);
+  if (status != Status::OK) {
     return status;
   }
-  if (status == Status::OK && !meta_data.decode()) {
-    return Status::RS_INVALID_ARGUMENT;
-  }
 
+  uint64_t old_timestamp = meta_data.getTimestamp();
   setAutoExpire(meta_data);
+  addTtlIndex(batch, key, meta_data.getTimestamp(), old_timestamp);
 
   int64_t index = is_left ? meta_data.pushFront() : meta_data.pushBack();
   meta_data.encode();
@@ -611,7 +859,7 @@ Status RocksDbEngine::listPush(const LaserKeyFormat& key, const std::string& val
   LaserValueRawString item_value(value);
   LaserKeyFormatListData list_data_key(key, index);
 
-  setAutoExpire(item_value);
+  setDataVersion(item_value, meta_data);
   batch.iput(list_data_key, item_value);
   return db_->write(batch);
 }
@@ -626,42 +874,33 @@ Status RocksDbEngine::pushBack(const LaserKeyFormat& key, const std::string& val
 
 Status RocksDbEngine::sadd(const LaserKeyFormat& key, const std::string& member) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueSetMeta meta_data;
-  Status status = db_->read(&meta_data, key);
-  if (status != Status::OK && status != Status::RS_NOT_FOUND) {
+  Status status = readMetaForWrite(&meta_data, &batch, key);
+  if (status != Status::OK) {
     return status;
   }
 
   LaserKeyFormatSetData set_data_member(key, member);
-  LaserValueRawString null_value;
-  if (status == Status::OK) {
-    // 获取数据
-    Status data_status = db_->read(&null_value, set_data_member);
-    if (data_status != Status::OK && data_status != Status::RS_NOT_FOUND) {
-      return data_status;
-    }
-
-    if (!meta_data.decode()) {
-      return Status::RS_INVALID_ARGUMENT;
-    }
-    if (data_status == Status::RS_NOT_FOUND) {
-      meta_data.incrSize();
-      meta_data.encode();
-      batch.iput(key, meta_data);
-      setAutoExpire(null_value);
-      batch.iput(set_data_member, null_value);
-    }
-  } else {
+  // 获取数据
+  LaserValueFormatBase old_value;
+  Status data_status = readDataRow(&old_value, set_data_member, meta_data);
+  if (data_status != Status::OK && data_status != Status::RS_NOT_FOUND) {
+    return data_status;
+  }
+  if (data_status == Status::RS_NOT_FOUND) {
     meta_data.incrSize();
-    setAutoExpire(meta_data);
-    meta_data.encode();
-    batch.iput(key, meta_data);
-    setAutoExpire(null_value);
+    LaserValueRawString null_value;
+    setDataVersion(null_value, meta_data);
     batch.iput(set_data_member, null_value);
   }
 
+  uint64_t old_timestamp = meta_data.getTimestamp();
+  setAutoExpire(meta_data);
+  addTtlIndex(batch, key, meta_data.getTimestamp(), old_timestamp);
+  meta_data.encode();
+  batch.iput(key, meta_data);
   return db_->write(batch);
 }
 
@@ -679,8 +918,8 @@ Status RocksDbEngine::hasMember(const LaserKeyFormat& key, const std::string& me
   }
 
   LaserKeyFormatSetData set_data_member(key, member);
-  LaserValueRawString null_value;
-  return db_->read(&null_value, set_data_member);
+  LaserValueFormatBase null_value;
+  return readDataRow(&null_value, set_data_member, meta_data);
 }
 
 Status RocksDbEngine::get(LaserValueSetMeta* value, const LaserKeyFormat& key) {
@@ -697,24 +936,27 @@ Status RocksDbEngine::get(LaserValueSetMeta* value, const LaserKeyFormat& key) {
 
 Status RocksDbEngine::sdel(const LaserKeyFormat& key, const std::string& member) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueSetMeta meta_data;
   Status status = db_->read(&meta_data, key);
   if (status != Status::OK) {
     return status;
   }
+  if (!meta_data.decode()) {
+    return Status::RS_INVALID_ARGUMENT;
+  }
+  if (checkKeyExpire(meta_data)) {
+    return Status::RS_KEY_EXPIRE;
+  }
 
   LaserKeyFormatSetData set_data_member(key, member);
-  LaserValueRawString null_value;
-  Status data_status = db_->read(&null_value, set_data_member);
+  LaserValueFormatBase null_value;
+  Status data_status = readDataRow(&null_value, set_data_member, meta_data);
   if (data_status != Status::OK) {
     return data_status;
   }
 
-  if (!meta_data.decode()) {
-    return Status::RS_INVALID_ARGUMENT;
-  }
   meta_data.decrSize();
   meta_data.encode();
   batch.iput(key, meta_data);
@@ -736,11 +978,15 @@ Status RocksDbEngine::members(std::vector<LaserKeyFormatSetData>* members, const
     return Status::RS_KEY_EXPIRE;
   }
 
-  db_->iterator([this, &key, members](auto iter) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, members, &set_meta](auto iter) {
     LaserKeyFormatSetData prefix(key);
     rocksdb::Slice slice_key(prefix.data(), prefix.length());
 
     for (iter->Seek(slice_key); iter->Valid() && iter->key().starts_with(slice_key); iter->Next()) {
+      if (!isDataRowVisible(iter->value(), set_meta.getVersion())) {
+        continue;
+      }
       LaserKeyFormatSetData set_data_member(iter->key().data(), iter->key().size());
       if (!set_data_member.decode()) {
         continue;
@@ -752,102 +998,332 @@ Status RocksDbEngine::members(std::vector<LaserKeyFormatSetData>* members, const
   return status;
 }
 
-// !注意ZSet目前只支持key_socre维度的唯一，不支持key_memebr的唯一性,zset_meta中size为key_score的个数
+// 每个 member 在 LaserKeyFormatZSetMember 下保存一行 member -> score 的反查索引，与 score 行在同一个 batch 中写入，
+// zset_meta 中 size 为 member 的个数
 Status RocksDbEngine::zadd(const LaserKeyFormat& key, const std::map<std::string, int64_t>& member_scores) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueZSetMeta zset_meta;
-  Status status = db_->read(&zset_meta, key);
-  if (status != Status::OK && status != Status::RS_NOT_FOUND) {
+  Status status = readMetaForWrite(&zset_meta, &batch, key);
+  if (status != Status::OK) {
+    return status;
+  }
+  status = migrateLegacyZSet(&zset_meta, key);
+  if (status != Status::OK) {
     return status;
   }
+  uint64_t old_timestamp = zset_meta.getTimestamp();
+  setAutoExpire(zset_meta);
+  addTtlIndex(batch, key, zset_meta.getTimestamp(), old_timestamp);
 
+  ZSetScoreRows score_rows;
   for (auto& member_score : member_scores) {
-    LaserValueZSet members_value;
-    LaserKeyFormatZSetData zset_data_key(key, member_score.second);
-    if (status == Status::OK) {
-      // 读取members
-      Status data_status = db_->read(&members_value, zset_data_key);
-      if (data_status != Status::OK && data_status != Status::RS_NOT_FOUND) {
-        return data_status;
-      }
+    const std::string& member = member_score.first;
+    int64_t score = member_score.second;
+    LaserKeyFormatZSetMember member_key(key, member);
+    LaserValueZSetScore old_score;
+    Status member_status = readDataRow(&old_score, member_key, zset_meta);
+    if (member_status != Status::OK && member_status != Status::RS_NOT_FOUND) {
+      return member_status;
+    }
 
-      if (!zset_meta.decode()) {
-        return Status::RS_INVALID_ARGUMENT;
+    if (member_status == Status::OK) {
+      if (old_score.getScore() == score) {
+        continue;
       }
 
-      if (data_status == Status::OK) {
-        members_value.decode();
-        auto members = members_value.getMembers();
-        bool member_exist = false;
-        for (auto& member : members) {
-          if (!member.compare(member_score.first)) {
-            member_exist = true;
-            break;
-          }
-        }
-        if (member_exist) {
-          // update the expire time
-          setAutoExpire(zset_meta);
-          zset_meta.encode();
-          batch.iput(key, zset_meta);
+      // member 的 score 发生变化，需要从旧的 score 行中移除
+      status = loadZSetScoreRow(&score_rows, key, old_score.getScore(), zset_meta.getVersion());
+      if (status != Status::OK) {
+        return status;
+      }
+      auto& old_members = score_rows[old_score.getScore()];
+      old_members.erase(std::remove(old_members.begin(), old_members.end(), member), old_members.end());
+    }
 
-          continue;
-        }
-
-        members_value.addMember(member_score.first);
-      }
+    status = loadZSetScoreRow(&score_rows, key, score, zset_meta.getVersion());
+    if (status != Status::OK) {
+      return status;
     }
-    // when members_value not contains any member, then it is a new key_score/member
-    if (members_value.getMembers().size() == 0) {
-      members_value.addMember(member_score.first);
+    score_rows[score].push_back(member);
+    if (member_status == Status::RS_NOT_FOUND) {
       zset_meta.incrSize();
     }
 
-    // update the zset_meta
-    setAutoExpire(zset_meta);
-    zset_meta.encode();
-    batch.iput(key, zset_meta);
-
-    // set members
-    setAutoExpire(members_value);
-    members_value.encode();
-    batch.iput(zset_data_key, members_value);
+    LaserValueZSetScore score_value(score);
+    setDataVersion(score_value, zset_meta);
+    batch.iput(member_key, score_value);
   }
 
+  writeZSetScoreRows(batch, key, score_rows, zset_meta.getVersion());
+  zset_meta.encode();
+  batch.iput(key, zset_meta);
+
   return db_->write(batch);
 }
 
-Status RocksDbEngine::zrangeByScore(std::vector<LaserScoreMember>* score_members, const LaserKeyFormat& key,
-                                    int64_t min, int64_t max) {
-  if (min > max) {
+Status RocksDbEngine::zscore(int64_t* score, const LaserKeyFormat& key, const std::string& member) {
+  LaserValueZSetMeta zset_meta;
+  Status status = readZSetMeta(&zset_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
+
+  // follower 上无法迁移，仍按历史格式读取
+  if (zset_meta.getVersion() == 0) {
+    ZSetScoreRows score_rows;
+    std::map<std::string, int64_t> member_scores;
+    loadLegacyZSet(&score_rows, &member_scores, key);
+    auto it = member_scores.find(member);
+    if (it == member_scores.end()) {
+      return Status::RS_NOT_FOUND;
+    }
+    *score = it->second;
     return Status::OK;
   }
 
+  LaserKeyFormatZSetMember member_key(key, member);
+  LaserValueZSetScore score_value;
+  status = readDataRow(&score_value, member_key, zset_meta);
+  if (status != Status::OK) {
+    return status;
+  }
+
+  *score = score_value.getScore();
+  return Status::OK;
+}
+
+Status RocksDbEngine::zrem(const LaserKeyFormat& key, const std::string& member) {
+  RocksDbBatch batch;
+  ScopedKeyLock guard(key.data(), key.length());
+
   LaserValueZSetMeta zset_meta;
   Status status = db_->read(&zset_meta, key);
   if (status != Status::OK) {
     return status;
   }
-
   if (!zset_meta.decode()) {
     return Status::RS_INVALID_ARGUMENT;
   }
-
   if (checkKeyExpire(zset_meta)) {
     return Status::RS_KEY_EXPIRE;
   }
+  status = migrateLegacyZSet(&zset_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
+
+  LaserKeyFormatZSetMember member_key(key, member);
+  LaserValueZSetScore score_value;
+  status = readDataRow(&score_value, member_key, zset_meta);
+  if (status != Status::OK) {
+    return status;
+  }
+
+  ZSetScoreRows score_rows;
+  status = loadZSetScoreRow(&score_rows, key, score_value.getScore(), zset_meta.getVersion());
+  if (status != Status::OK) {
+    return status;
+  }
+  auto& members = score_rows[score_value.getScore()];
+  members.erase(std::remove(members.begin(), members.end(), member), members.end());
+  writeZSetScoreRows(batch, key, score_rows, zset_meta.getVersion());
+  batch.idelete(member_key);
+
+  if (zset_meta.getSize() > 0) {
+    zset_meta.decrSize();
+  }
+  if (zset_meta.getSize() == 0) {
+    batch.idelete(key);
+  } else {
+    zset_meta.encode();
+    batch.iput(key, zset_meta);
+  }
+
+  return db_->write(batch);
+}
+
+Status RocksDbEngine::get(LaserValueZSetMeta* value, const LaserKeyFormat& key) {
+  Status status = readZSetMeta(value, key);
+  if (status == Status::RS_NOT_FOUND) {
+    return Status::OK;
+  }
+  if (status != Status::OK) {
+    return status;
+  }
+
+  // 没有迁移的历史 zset 的 size 为 score 行的个数，需要按 member 重新计数
+  if (value->getVersion() == 0) {
+    ZSetScoreRows score_rows;
+    std::map<std::string, int64_t> member_scores;
+    loadLegacyZSet(&score_rows, &member_scores, key);
+    value->setSize(static_cast<uint32_t>(member_scores.size()));
+  }
+  return Status::OK;
+}
+
+Status RocksDbEngine::zrank(int64_t* rank, const LaserKeyFormat& key, const std::string& member) {
+  LaserValueZSetMeta zset_meta;
+  Status status = readZSetMeta(&zset_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
 
-  db_->iterator([this, &min, &max, &key, score_members](auto iter) {
-    this->rangeZset(min, max, key, iter, [score_members](auto iter) {
+  // follower 上无法迁移，仍按历史格式读取
+  if (zset_meta.getVersion() == 0) {
+    ZSetScoreRows score_rows;
+    std::map<std::string, int64_t> member_scores;
+    loadLegacyZSet(&score_rows, &member_scores, key);
+    auto it = member_scores.find(member);
+    if (it == member_scores.end()) {
+      return Status::RS_NOT_FOUND;
+    }
+    *rank = 0;
+    for (auto& score_row : score_rows) {
+      if (score_row.first < it->second) {
+        *rank += score_row.second.size();
+        continue;
+      }
+      auto& members = score_row.second;
+      *rank += std::find(members.begin(), members.end(), member) - members.begin();
+      break;
+    }
+    return Status::OK;
+  }
+
+  LaserKeyFormatZSetMember member_key(key, member);
+  LaserValueZSetScore score_value;
+  status = readDataRow(&score_value, member_key, zset_meta);
+  if (status != Status::OK) {
+    return status;
+  }
+
+  *rank = 0;
+  bool found = false;
+  int64_t score = score_value.getScore();
+  uint64_t version = zset_meta.getVersion();
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, rank, score, version, &found, &key, &member](auto iter) {
+    this->rangeZset(std::numeric_limits<int64_t>::min(), score, key, iter,
+                    [rank, score, version, &found, &member](auto iter) {
+                      LaserKeyFormatZSetData zset_data_key(iter->key().data(), iter->key().size());
+                      if (!zset_data_key.decode()) {
+                        return;
+                      }
+                      LaserValueZSet zset_value(iter->value().data(), iter->value().size());
+                      if (!zset_value.decode() || zset_value.getVersion() != version) {
+                        return;
+                      }
+
+                      auto& members = zset_value.getMembers();
+                      if (zset_data_key.getScore() < score) {
+                        *rank += members.size();
+                        return;
+                      }
+                      auto it = std::find(members.begin(), members.end(), member);
+                      if (it != members.end()) {
+                        *rank += it - members.begin();
+                        found = true;
+                      }
+                    });
+  });
+
+  return found ? Status::OK : Status::RS_NOT_FOUND;
+}
+
+Status RocksDbEngine::zrange(std::vector<LaserScoreMember>* score_members, const LaserKeyFormat& key, int64_t start,
+                             int64_t stop) {
+  LaserValueZSetMeta zset_meta;
+  Status status = readZSetMeta(&zset_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
+
+  int64_t size = zset_meta.getSize();
+  ZSetScoreRows legacy_rows;
+  // follower 上无法迁移，仍按历史格式读取
+  if (zset_meta.getVersion() == 0) {
+    std::map<std::string, int64_t> member_scores;
+    loadLegacyZSet(&legacy_rows, &member_scores, key);
+    size = static_cast<int64_t>(member_scores.size());
+  }
+  start = start < 0 ? std::max<int64_t>(size + start, 0) : start;
+  stop = stop < 0 ? size + stop : std::min<int64_t>(stop, size - 1);
+  if (start > stop) {
+    return Status::OK;
+  }
+
+  int64_t position = 0;
+  if (zset_meta.getVersion() == 0) {
+    for (auto& score_row : legacy_rows) {
+      LaserScoreMember score_member;
+      score_member.set_score(score_row.first);
+      for (auto& member : score_row.second) {
+        if (position >= start && position <= stop) {
+          score_member.set_member(member);
+          score_members->emplace_back(score_member);
+        }
+        position++;
+      }
+    }
+    return Status::OK;
+  }
+
+  uint64_t version = zset_meta.getVersion();
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, score_members, start, stop, version, &position, &key](auto iter) {
+    this->rangeZset(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), key, iter,
+                    [score_members, start, stop, version, &position](auto iter) {
+                      if (position > stop) {
+                        return;
+                      }
+                      LaserKeyFormatZSetData zset_data_key(iter->key().data(), iter->key().size());
+                      if (!zset_data_key.decode()) {
+                        return;
+                      }
+                      LaserValueZSet zset_value(iter->value().data(), iter->value().size());
+                      if (!zset_value.decode() || zset_value.getVersion() != version) {
+                        return;
+                      }
+
+                      LaserScoreMember score_member;
+                      score_member.set_score(zset_data_key.getScore());
+                      for (auto& member : zset_value.getMembers()) {
+                        if (position >= start && position <= stop) {
+                          score_member.set_member(member);
+                          score_members->emplace_back(score_member);
+                        }
+                        position++;
+                      }
+                    });
+  });
+
+  return Status::OK;
+}
+
+Status RocksDbEngine::zrangeByScore(std::vector<LaserScoreMember>* score_members, const LaserKeyFormat& key,
+                                    int64_t min, int64_t max) {
+  if (min > max) {
+    return Status::OK;
+  }
+
+  LaserValueZSetMeta zset_meta;
+  Status status = readZSetMeta(&zset_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
+
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &min, &max, &key, score_members, &zset_meta](auto iter) {
+    this->rangeZset(min, max, key, iter, [score_members, &zset_meta](auto iter) {
       LaserKeyFormatZSetData zset_data_key(iter->key().data(), iter->key().size());
       if (!zset_data_key.decode()) {
         return;
       }
 
       LaserValueZSet zset_value(iter->value().data(), iter->value().size());
-      if (!zset_value.decode()) {
+      if (!zset_value.decode() || zset_value.getVersion() != zset_meta.getVersion()) {
         return;
       }
 
@@ -871,7 +1347,7 @@ Status RocksDbEngine::zremRangeByScore(int64_t* number, const LaserKeyFormat& ke
   }
 
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueZSetMeta zset_meta;
   Status status = db_->read(&zset_meta, key);
@@ -886,16 +1362,32 @@ Status RocksDbEngine::zremRangeByScore(int64_t* number, const LaserKeyFormat& ke
   if (checkKeyExpire(zset_meta)) {
     return Status::RS_KEY_EXPIRE;
   }
+  status = migrateLegacyZSet(&zset_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
 
-  db_->iterator([this, &key, &min, &max, &number, &batch, &zset_meta](auto iter) {
-    this->rangeZset(min, max, key, iter, [&number, &batch, &zset_meta](auto iter) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, &min, &max, &number, &batch, &zset_meta](auto iter) {
+    this->rangeZset(min, max, key, iter, [&key, &number, &batch, &zset_meta](auto iter) {
       LaserKeyFormatZSetData zset_data_key(iter->key().data(), iter->key().size());
       if (!zset_data_key.decode()) {
         return;
       }
+      LaserValueZSet zset_value(iter->value().data(), iter->value().size());
+      if (!zset_value.decode() || zset_value.getVersion() != zset_meta.getVersion()) {
+        return;
+      }
       batch.idelete(zset_data_key);
-      zset_meta.decrSize();
       (*number)++;
+
+      for (auto& member : zset_value.getMembers()) {
+        LaserKeyFormatZSetMember member_key(key, member);
+        batch.idelete(member_key);
+        if (zset_meta.getSize() > 0) {
+          zset_meta.decrSize();
+        }
+      }
     });
   });
 
@@ -911,8 +1403,25 @@ Status RocksDbEngine::zremRangeByScore(int64_t* number, const LaserKeyFormat& ke
 }
 
 Status RocksDbEngine::delkey(const LaserKeyFormat& key) {
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
-  return db_->delkey(key);
+  ScopedKeyLock guard(key.data(), key.length());
+  LaserValueFormatBase value;
+  Status status = db_->read(&value, key);
+  if (status != Status::OK) {
+    return status == Status::RS_NOT_FOUND ? Status::OK : status;
+  }
+  if (!value.decode()) {
+    return Status::RS_IO_ERROR;
+  }
+  if (!isCompositeMeta(value) || value.getVersion() == 0) {
+    return db_->delkey(key);
+  }
+
+  // 带版本号的复合类型只删除 meta，data 行由 TTL 清理分批回收
+  RocksDbBatch batch;
+  batch.idelete(key);
+  putDeadVersion(&batch, key, value.getVersion());
+  addReclaimIndex(&batch, key, value.getVersion());
+  return db_->write(batch);
 }
 
 Status RocksDbEngine::expire(const LaserKeyFormat& key, uint64_t time) {
@@ -922,7 +1431,7 @@ Status RocksDbEngine::expire(const LaserKeyFormat& key, uint64_t time) {
 
 Status RocksDbEngine::expireAt(const LaserKeyFormat& key, uint64_t timestamp) {
   RocksDbBatch batch;
-  ScopedKeyLock guard(std::string(key.data(), key.length()));
+  ScopedKeyLock guard(key.data(), key.length());
 
   LaserValueFormatBase value;
   Status status = db_->read(&value, key);
@@ -933,7 +1442,7 @@ Status RocksDbEngine::expireAt(const LaserKeyFormat& key, uint64_t timestamp) {
     return Status::RS_INVALID_ARGUMENT;
   }
 
-  // 设置 value 的 timestamp
+  // 设置 value 的 timestamp，带版本号的复合类型 data 行不保存过期时间，只需要更新 meta
   switch (value.getType()) {
     case ValueType::RAW_STRING: {
       LaserValueRawString string_value(value.data(), value.length());
@@ -957,7 +1466,9 @@ Status RocksDbEngine::expireAt(const LaserKeyFormat& key, uint64_t timestamp) {
       map.setTimestamp(timestamp);
       map.encode();
       batch.iput(key, map);
-      setMapExpire(batch, key, timestamp);
+      if (map.getVersion() == 0) {
+        setMapExpire(batch, key, timestamp);
+      }
       break;
     }
     case ValueType::LIST: {
@@ -966,7 +1477,9 @@ Status RocksDbEngine::expireAt(const LaserKeyFormat& key, uint64_t timestamp) {
       list.setTimestamp(timestamp);
       list.encode();
       batch.iput(key, list);
-      setListExpire(batch, key, timestamp);
+      if (list.getVersion() == 0) {
+        setListExpire(batch, key, timestamp);
+      }
       break;
     }
     case ValueType::SET: {
@@ -975,7 +1488,9 @@ Status RocksDbEngine::expireAt(const LaserKeyFormat& key, uint64_t timestamp) {
       set.setTimestamp(timestamp);
       set.encode();
       batch.iput(key, set);
-      setSetExpire(batch, key, timestamp);
+      if (set.getVersion() == 0) {
+        setSetExpire(batch, key, timestamp);
+      }
       break;
     }
     case ValueType::ZSET: {
@@ -984,12 +1499,15 @@ Status RocksDbEngine::expireAt(const LaserKeyFormat& key, uint64_t timestamp) {
       zset.setTimestamp(timestamp);
       zset.encode();
       batch.iput(key, zset);
-      zsetSetExpire(batch, key, timestamp);
+      if (zset.getVersion() == 0) {
+        zsetSetExpire(batch, key, timestamp);
+      }
       break;
     }
     default:
       LOG(ERROR) << "Invalid value type.";
   }
+  addTtlIndex(batch, key, timestamp, value.getTimestamp());
   return db_->write(batch);
 }
 
@@ -1014,6 +1532,165 @@ Status RocksDbEngine::ttl(int64_t* ttl, const LaserKeyFormat& key) {
   return Status::OK;
 }
 
+Status RocksDbEngine::sweepExpiredKeys(uint32_t* deleted, uint32_t* backlog, uint32_t max_keys) {
+  *deleted = 0;
+  *backlog = 0;
+  // 索引按过期时间有序，从上一轮处理到的时间开始扫描到当前时间为止
+  uint64_t now = static_cast<uint64_t>(common::currentTimeInMs());
+  LaserKeyFormatTtl lower_bound(LaserKeyFormat(), ttl_sweep_start_ms_);
+  LaserKeyFormatTtl upper_bound(LaserKeyFormat(), now);
+  std::vector<LaserKeyFormatTtl> ttl_keys;
+  std::vector<uint64_t> reclaim_versions;
+  db_->iterator([&lower_bound, &upper_bound, &ttl_keys, &reclaim_versions, backlog, max_keys](auto iter) {
+    rocksdb::Slice slice_lower(lower_bound.data(), lower_bound.length());
+    rocksdb::Slice slice_upper(upper_bound.data(), upper_bound.length());
+    for (iter->Seek(slice_lower); iter->Valid() && iter->key().compare(slice_upper) < 0; iter->Next()) {
+      if (ttl_keys.size() < max_keys) {
+        ttl_keys.emplace_back(iter->key().data(), iter->key().size());
+        LaserValueFormatBase ttl_value(iter->value().data(), iter->value().size());
+        reclaim_versions.push_back(ttl_value.decode() ? ttl_value.getVersion() : 0);
+        continue;
+      }
+      (*backlog)++;
+      if (*backlog >= static_cast<uint32_t>(FLAGS_rocksdb_engine_ttl_sweep_backlog_limit)) {
+        break;
+      }
+    }
+  });
+
+  std::shared_ptr<rocksdb::RateLimiter> rate_limiter = options_ ? options_->sweep_rate_limiter : nullptr;
+  for (size_t i = 0; i < ttl_keys.size(); i++) {
+    auto& ttl_key = ttl_keys[i];
+    if (!ttl_key.decode()) {
+      continue;
+    }
+    if (rate_limiter) {
+      int64_t bytes = static_cast<int64_t>(ttl_key.length() + ttl_key.getKey().length());
+      rate_limiter->Request(std::min(bytes, rate_limiter->GetSingleBurstBytes()), rocksdb::Env::IO_LOW, nullptr,
+                            rocksdb::RateLimiter::OpType::kWrite);
+    }
+
+    bool key_deleted = false;
+    int64_t reclaimed_bytes = 0;
+    Status status = deleteExpiredKey(&key_deleted, &reclaimed_bytes, ttl_key, reclaim_versions[i]);
+    if (status != Status::OK) {
+      return status;
+    }
+    if (key_deleted) {
+      (*deleted)++;
+      sweep_delete_meter_->mark();
+    }
+    if (rate_limiter && reclaimed_bytes > 0) {
+      rate_limiter->Request(std::min(reclaimed_bytes, rate_limiter->GetSingleBurstBytes()), rocksdb::Env::IO_LOW,
+                            nullptr, rocksdb::RateLimiter::OpType::kWrite);
+    }
+  }
+
+  // 写入的索引时间不早于写入时的当前时间，起点回退一个时间桶，覆盖扫描时还没有落盘的写入
+  uint64_t next_start = now;
+  if (ttl_keys.size() >= max_keys && !ttl_keys.empty()) {
+    next_start = ttl_keys.back().getTimestamp();
+  }
+  uint64_t bucket_ms = static_cast<uint64_t>(std::max(FLAGS_rocksdb_engine_ttl_index_bucket_ms, 1));
+  next_start = std::min(next_start, now > bucket_ms ? now - bucket_ms : 0);
+  if (next_start > ttl_sweep_start_ms_) {
+    ttl_sweep_start_ms_ = next_start;
+  }
+  return Status::OK;
+}
+
+Status RocksDbEngine::deleteExpiredKey(bool* deleted, int64_t* reclaimed_bytes, const LaserKeyFormatTtl& ttl_key,
+                                       uint64_t reclaim_version) {
+  const LaserKeyFormat& key = ttl_key.getKey();
+  ScopedKeyLock guard(key.data(), key.length());
+
+  RocksDbBatch batch;
+  batch.idelete(ttl_key);
+  *deleted = false;
+
+  // 重新设置过期时间或者覆盖写入后旧的索引会失效，只删除索引
+  LaserValueFormatBase value;
+  Status status = db_->read(&value, key);
+  if (status != Status::OK && status != Status::RS_NOT_FOUND) {
+    return status;
+  }
+  bool has_meta = status == Status::OK && value.decode();
+  bool is_composite = has_meta && isCompositeMeta(value);
+  // 回收索引的 value 中记录了失效的版本号，过期索引为 0
+  bool need_reclaim = reclaim_version != 0 && (!has_meta || is_composite);
+  if (has_meta && checkKeyExpire(value)) {
+    batch.idelete(key);
+    has_meta = false;
+    // 历史格式的 data 行带有过期时间，由 ExpireFilter 回收
+    if (is_composite && value.getVersion() != 0) {
+      need_reclaim = true;
+      putDeadVersion(&batch, key, value.getVersion());
+    }
+    *deleted = true;
+  }
+
+  // 不使用范围删除，避免行缓存被整体清空；一次只删除有限的行数，剩余的行写入新的回收索引等待下一轮
+  if (need_reclaim) {
+    uint32_t reclaimed = 0;
+    bool finished = reclaimDataRows(&reclaimed, reclaimed_bytes, batch, key, has_meta, value.getVersion());
+    if (finished) {
+      // 旧版本的 data 行已经全部删除，不再需要保留已删除的版本号
+      batch.idelete(LaserKeyFormat(key, KeyType::DEAD_VERSION));
+    } else {
+      addReclaimIndex(&batch, key, std::max(value.getVersion(), reclaim_version));
+    }
+    reclaim_delete_meter_->mark(static_cast<double>(reclaimed));
+  }
+  return db_->write(batch);
+}
+
+bool RocksDbEngine::reclaimDataRows(uint32_t* reclaimed, int64_t* reclaimed_bytes, RocksDbBatch& batch,
+                                    const LaserKeyFormat& key, bool has_meta, uint64_t version) {
+  uint32_t max_rows = static_cast<uint32_t>(std::max(FLAGS_rocksdb_engine_reclaim_rows_per_key, 1));
+  bool finished = true;
+  for (auto key_type : {KeyType::COMPOSITE, KeyType::ZSET_MEMBER}) {
+    LaserKeyFormat prefix(key, key_type);
+    db_->prefixIterator(prefix, [&](auto iter) {
+      rocksdb::Slice slice_key(prefix.data(), prefix.length());
+      for (iter->Seek(slice_key); iter->Valid() && iter->key().starts_with(slice_key); iter->Next()) {
+        // 与当前 meta 版本号一致的行仍然有效
+        if (has_meta && isDataRowVisible(iter->value(), version)) {
+          continue;
+        }
+        if (*reclaimed >= max_rows) {
+          finished = false;
+          return;
+        }
+        batch.idelete(LaserSerializer(iter->key().data(), iter->key().size()));
+        (*reclaimed)++;
+        *reclaimed_bytes += static_cast<int64_t>(iter->key().size());
+      }
+    });
+    if (!finished) {
+      break;
+    }
+  }
+  return finished;
+}
+
+void RocksDbEngine::putDeadVersion(RocksDbBatch* batch, const LaserKeyFormat& key, uint64_t version) {
+  LaserValueFormatBase dead_version(ValueType::RAW_STRING);
+  dead_version.setVersion(version);
+  dead_version.encode();
+  batch->iput(LaserKeyFormat(key, KeyType::DEAD_VERSION), dead_version);
+}
+
+void RocksDbEngine::addReclaimIndex(RocksDbBatch* batch, const LaserKeyFormat& key, uint64_t version) {
+  // 回收索引写在下一个时间桶，和过期索引一样由 TTL 清理按时间顺序处理
+  uint64_t now = static_cast<uint64_t>(common::currentTimeInMs());
+  uint64_t bucket_ms = static_cast<uint64_t>(std::max(FLAGS_rocksdb_engine_ttl_index_bucket_ms, 1));
+  LaserKeyFormatTtl ttl_key(key, getTtlIndexTime(now + bucket_ms, now));
+  LaserValueFormatBase ttl_value(ValueType::RAW_STRING);
+  ttl_value.setVersion(version);
+  ttl_value.encode();
+  batch->iput(ttl_key, ttl_value);
+}
+
 Status RocksDbEngine::ingestBaseSst(const std::string& ingest_file) { return db_->ingestBaseSst(ingest_file); }
 
 Status RocksDbEngine::ingestDeltaSst(const std::string& ingest_file, const std::string& tempdb_path) {
@@ -1037,17 +1714,41 @@ void RocksDbEngine::setExpire(LaserValueFormatBase& value, uint64_t ttl) {
   value.setTimestamp(timestamp);
 }
 
-bool RocksDbEngine::checkKeyExpire(const LaserValueFormatBase& value) {
-  uint64_t timestamp = value.getTimestamp();
-  if (timestamp != 0 && timestamp < static_cast<uint64_t>(common::currentTimeInMs())) {
-    return true;
+void RocksDbEngine::addTtlIndex(RocksDbBatch& batch, const LaserKeyFormat& key, uint64_t timestamp,
+                                uint64_t old_timestamp) {
+  if (timestamp == 0 || !FLAGS_rocksdb_engine_ttl_index) {
+    return;
+  }
+  uint64_t now = static_cast<uint64_t>(common::currentTimeInMs());
+  uint64_t index_time = getTtlIndexTime(timestamp, now);
+  if (old_timestamp != 0 && getTtlIndexTime(old_timestamp, 0) == index_time) {
+    return;
   }
+  LaserKeyFormatTtl ttl_key(key, index_time);
+  LaserValueFormatBase ttl_value(ValueType::RAW_STRING);
+  ttl_value.encode();
+  batch.iput(ttl_key, ttl_value);
+}
 
-  return false;
+uint64_t RocksDbEngine::getTtlIndexTime(uint64_t timestamp, uint64_t now) {
+  // 索引时间向上取整到时间桶，处理到索引时 key 一定已经过期；不早于当前时间，避免写到已经扫描过的位置
+  uint64_t bucket_ms = static_cast<uint64_t>(std::max(FLAGS_rocksdb_engine_ttl_index_bucket_ms, 1));
+  uint64_t time = std::max(timestamp, now);
+  return (time + bucket_ms - 1) / bucket_ms * bucket_ms;
+}
+
+bool RocksDbEngine::checkKeyExpire(const LaserValueFormatBase& value) {
+  return isExpiredAt(value, static_cast<uint64_t>(common::currentTimeInMs()));
+}
+
+bool RocksDbEngine::isExpiredAt(const LaserValueFormatBase& value, uint64_t time_ms) {
+  uint64_t timestamp = value.getTimestamp();
+  return timestamp != 0 && timestamp < time_ms;
 }
 
 void RocksDbEngine::setMapExpire(RocksDbBatch& batch, const LaserKeyFormat& key, uint64_t timestamp) {
-  db_->iterator([this, &key, &batch, timestamp](auto iter) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, &batch, timestamp](auto iter) {
     LaserKeyFormatMapData prefix(key);
     rocksdb::Slice slice_key(prefix.data(), prefix.length());
 
@@ -1068,7 +1769,8 @@ void RocksDbEngine::setMapExpire(RocksDbBatch& batch, const LaserKeyFormat& key,
 }
 
 void RocksDbEngine::setListExpire(RocksDbBatch& batch, const LaserKeyFormat& key, uint64_t timestamp) {
-  db_->iterator([this, &key, &batch, timestamp](auto iter) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, &batch, timestamp](auto iter) {
     LaserKeyFormatListData prefix(key);
     rocksdb::Slice slice_key(prefix.data(), prefix.length());
 
@@ -1089,7 +1791,8 @@ void RocksDbEngine::setListExpire(RocksDbBatch& batch, const LaserKeyFormat& key
 }
 
 void RocksDbEngine::setSetExpire(RocksDbBatch& batch, const LaserKeyFormat& key, uint64_t timestamp) {
-  db_->iterator([this, &key, &batch, timestamp](auto iter) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, &batch, timestamp](auto iter) {
     LaserKeyFormatSetData prefix(key);
     rocksdb::Slice slice_key(prefix.data(), prefix.length());
 
@@ -1110,7 +1813,8 @@ void RocksDbEngine::setSetExpire(RocksDbBatch& batch, const LaserKeyFormat& key,
 }
 
 void RocksDbEngine::zsetSetExpire(RocksDbBatch& batch, const LaserKeyFormat& key, uint64_t timestamp) {
-  db_->iterator([this, &key, &batch, timestamp](auto iter) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, &key, &batch, timestamp](auto iter) {
     LaserKeyFormatZSetData prefix(key);
     rocksdb::Slice slice_key(prefix.data(), prefix.length());
 
@@ -1127,6 +1831,20 @@ void RocksDbEngine::zsetSetExpire(RocksDbBatch& batch, const LaserKeyFormat& key
       zset_value.encode();
       batch.iput(zset_data_key, zset_value);
     }
+
+    LaserKeyFormatZSetMember member_prefix(key);
+    rocksdb::Slice slice_member_prefix(member_prefix.data(), member_prefix.length());
+    for (iter->Seek(slice_member_prefix); iter->Valid() && iter->key().starts_with(slice_member_prefix);
+         iter->Next()) {
+      LaserKeyFormatZSetMember member_key(iter->key().data(), iter->key().size());
+      LaserValueZSetScore score_value(iter->value().data(), iter->value().size());
+      if (!score_value.decode()) {
+        continue;
+      }
+      score_value.setTimestamp(timestamp);
+      score_value.encode();
+      batch.iput(member_key, score_value);
+    }
   });
 }
 
@@ -1161,7 +1879,10 @@ void RocksDbEngine::rangeZset(int64_t min, int64_t max, const LaserKeyFormat& ke
       callback(iter);
     }
   } else if (min < 0 && max >= 0) {
-    for (iter->Seek(slice_key_min); iter->Valid() && iter->key().compare(slice_key_min) >= 0; iter->Next()) {
+    // 负数 score 排在非负 score 之后，需要限制在当前 zset 的前缀内
+    LaserKeyFormatZSetData prefix(key);
+    rocksdb::Slice slice_prefix(prefix.data(), prefix.length());
+    for (iter->Seek(slice_key_min); iter->Valid() && iter->key().starts_with(slice_prefix); iter->Next()) {
       callback(iter);
     }
 
@@ -1179,4 +1900,169 @@ void RocksDbEngine::rangeZset(int64_t min, int64_t max, const LaserKeyFormat& ke
   }
 }
 
+Status RocksDbEngine::loadZSetScoreRow(ZSetScoreRows* score_rows, const LaserKeyFormat& key, int64_t score,
+                                       uint64_t version) {
+  if (score_rows->find(score) != score_rows->end()) {
+    return Status::OK;
+  }
+
+  LaserKeyFormatZSetData zset_data_key(key, score);
+  LaserValueZSet members_value;
+  Status status = db_->read(&members_value, zset_data_key);
+  if (status != Status::OK && status != Status::RS_NOT_FOUND) {
+    return status;
+  }
+  if (status == Status::OK && !members_value.decode()) {
+    return Status::RS_INVALID_ARGUMENT;
+  }
+
+  // 旧版本的 score 行视为空
+  if (status == Status::OK && members_value.getVersion() == version) {
+    (*score_rows)[score] = members_value.getMembers();
+  } else {
+    (*score_rows)[score] = {};
+  }
+  return Status::OK;
+}
+
+void RocksDbEngine::writeZSetScoreRows(RocksDbBatch& batch, const LaserKeyFormat& key,
+                                       const ZSetScoreRows& score_rows, uint64_t version) {
+  for (auto& score_row : score_rows) {
+    LaserKeyFormatZSetData zset_data_key(key, score_row.first);
+    if (score_row.second.empty()) {
+      batch.idelete(zset_data_key);
+      continue;
+    }
+    LaserValueZSet members_value(score_row.second);
+    members_value.setVersion(version);
+    members_value.encode();
+    batch.iput(zset_data_key, members_value);
+  }
+}
+
+void RocksDbEngine::loadLegacyZSet(ZSetScoreRows* score_rows, std::map<std::string, int64_t>* member_scores,
+                                   const LaserKeyFormat& key) {
+  LaserKeyFormat composite_key(key, KeyType::COMPOSITE);
+  db_->prefixIterator(composite_key, [this, score_rows, member_scores, &key](auto iter) {
+    this->rangeZset(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), key, iter,
+                    [score_rows, member_scores](auto iter) {
+                      LaserKeyFormatZSetData zset_data_key(iter->key().data(), iter->key().size());
+                      if (!zset_data_key.decode()) {
+                        return;
+                      }
+                      LaserValueZSet zset_value(iter->value().data(), iter->value().size());
+                      if (!zset_value.decode() || zset_value.getVersion() != 0) {
+                        return;
+                      }
+
+                      // score 从小到大遍历，重复的 member 已经出现在更小的 score 行中
+                      auto& members = (*score_rows)[zset_data_key.getScore()];
+                      for (auto& member : zset_value.getMembers()) {
+                        if (member_scores->emplace(member, zset_data_key.getScore()).second) {
+                          members.push_back(member);
+                        }
+                      }
+                    });
+  });
+}
+
+Status RocksDbEngine::migrateLegacyZSet(LaserValueZSetMeta* zset_meta, const LaserKeyFormat& key) {
+  if (zset_meta->getVersion() != 0) {
+    return Status::OK;
+  }
+
+  ZSetScoreRows score_rows;
+  std::map<std::string, int64_t> member_scores;
+  loadLegacyZSet(&score_rows, &member_scores, key);
+
+  // 新版本号下的 score 行覆盖历史的 score 行，只有重复 member 的 score 行被删除
+  RocksDbBatch batch;
+  zset_meta->setVersion(newVersion(0));
+  zset_meta->setSize(static_cast<uint32_t>(member_scores.size()));
+  writeZSetScoreRows(batch, key, score_rows, zset_meta->getVersion());
+  for (auto& member_score : member_scores) {
+    LaserKeyFormatZSetMember member_key(key, member_score.first);
+    LaserValueZSetScore score_value(member_score.second);
+    setDataVersion(score_value, *zset_meta);
+    batch.iput(member_key, score_value);
+  }
+  zset_meta->encode();
+  batch.iput(key, *zset_meta);
+  return db_->write(batch);
+}
+
+Status RocksDbEngine::readZSetMeta(LaserValueZSetMeta* zset_meta, const LaserKeyFormat& key) {
+  Status status = db_->read(zset_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
+  if (!zset_meta->decode()) {
+    return Status::RS_INVALID_ARGUMENT;
+  }
+  if (checkKeyExpire(*zset_meta)) {
+    return Status::RS_KEY_EXPIRE;
+  }
+  if (zset_meta->getVersion() != 0 || db_->getRole() == DBRole::FOLLOWER) {
+    return Status::OK;
+  }
+
+  // 加锁后重新读取，其他请求可能已经完成迁移
+  ScopedKeyLock guard(key.data(), key.length());
+  status = db_->read(zset_meta, key);
+  if (status != Status::OK) {
+    return status;
+  }
+  if (!zset_meta->decode()) {
+    return Status::RS_INVALID_ARGUMENT;
+  }
+  if (checkKeyExpire(*zset_meta)) {
+    return Status::RS_KEY_EXPIRE;
+  }
+  LaserValueZSetMeta migrated_meta = *zset_meta;
+  if (migrated_meta.getVersion() == 0 && migrateLegacyZSet(&migrated_meta, key) == Status::OK) {
+    *zset_meta = migrated_meta;
+  }
+  return Status::OK;
+}
+
+Status RocksDbEngine::readDataRow(LaserValueFormatBase* value, const LaserSerializer& key,
+                                  const LaserValueFormatBase& meta) {
+  Status status = db_->read(value, key);
+  if (status != Status::OK) {
+    return status;
+  }
+  // 历史的 set data 行 value 为空，按版本号 0 处理
+  if (value->length() == 0) {
+    return meta.getVersion() == 0 ? Status::OK : Status::RS_NOT_FOUND;
+  }
+  if (!value->decode()) {
+    return Status::RS_INVALID_ARGUMENT;
+  }
+  return value->getVersion() == meta.getVersion() ? Status::OK : Status::RS_NOT_FOUND;
+}
+
+void RocksDbEngine::setDataVersion(LaserValueFormatBase& value, const LaserValueFormatBase& meta) {
+  // data 行不再保存过期时间，有效期由 meta 决定
+  value.setVersion(meta.getVersion());
+  value.encode();
+}
+
+uint64_t RocksDbEngine::newVersion(uint64_t old_version) {
+  uint64_t version = static_cast<uint64_t>(common::currentTimeInNs() / 1000);
+  return std::max(version, old_version + 1);
+}
+
+bool RocksDbEngine::isCompositeMeta(const LaserValueFormatBase& value) {
+  return value.getType() == ValueType::MAP || value.getType() == ValueType::LIST ||
+         value.getType() == ValueType::SET || value.getType() == ValueType::ZSET;
+}
+
+bool RocksDbEngine::isDataRowVisible(const rocksdb::Slice& value, uint64_t version) {
+  if (value.empty()) {
+    return version == 0;
+  }
+  LaserValueFormatBase row(value.data(), value.size());
+  return row.decode() && row.getVersion() == version;
+}
+
 }  // namespace laser
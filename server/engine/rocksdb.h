@@ -19,7 +19,10 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "folly/io/IOBuf.h"
+#include "rocksdb/rate_limiter.h"
 
 #include "common/laser/laser_entity.h"
 #include "common/laser/format.h"
@@ -30,8 +33,15 @@ namespace laser {
 
 inline constexpr char LASER_ROCKSDB_ENGINE_MODULE_NAME[] = "rocksdb_engine";
 
+inline constexpr char LASER_ROCKSDB_ENGINE_TTL_SWEEP_DELETE[] = "ttl_sweep_delete";
+inline constexpr char LASER_ROCKSDB_ENGINE_RECLAIM_DELETE[] = "stale_version_delete";
+
 struct RocksDbEngineOptions {
   uint64_t ttl;
+  // 过期 key 清理的限速器，为空时不限速
+  std::shared_ptr<rocksdb::RateLimiter> sweep_rate_limiter{nullptr};
+  // counter 和 append 不加锁也不读旧值，直接写入 merge 操作数，需要开启 rocksdb_engine_merge_write
+  bool blind_merge{false};
 };
 
 struct RocksDbEngineSetOptions {
@@ -48,6 +58,11 @@ class RocksDbEngine : public std::enable_shared_from_this<RocksDbEngine> {
     } else {
       ttl_ = options_->ttl;
     }
+    std::unordered_map<std::string, std::string> tags;
+    sweep_delete_meter_ = metrics::Metrics::getInstance()->buildMeter(LASER_ROCKSDB_ENGINE_MODULE_NAME,
+                                                                      LASER_ROCKSDB_ENGINE_TTL_SWEEP_DELETE, tags);
+    reclaim_delete_meter_ = metrics::Metrics::getInstance()->buildMeter(LASER_ROCKSDB_ENGINE_MODULE_NAME,
+                                                                        LASER_ROCKSDB_ENGINE_RECLAIM_DELETE, tags);
   }
 
   virtual ~RocksDbEngine() = default;
@@ -62,18 +77,25 @@ class RocksDbEngine : public std::enable_shared_from_this<RocksDbEngine> {
   virtual Status expireAt(const LaserKeyFormat& key, uint64_t time_at);
   // 过期返回 0，没有设置过期时间返回 -1
   virtual Status ttl(int64_t* ttl, const LaserKeyFormat& key);
+  // 按 TTL 索引删除已经过期的 key，每次最多处理 max_keys 个索引，backlog 返回剩余的过期索引数
+  virtual Status sweepExpiredKeys(uint32_t* deleted, uint32_t* backlog, uint32_t max_keys);
 
-  // string
+  // string，在 key 锁内校验类型并计算追加后的长度，开启 merge 写入时只写入追加的数据；
+  // 表开启 blind merge 时不加锁直接写入，类型和过期由 merge operator 处理，length 非空时写入后再读取
   virtual Status append(uint32_t* length, const LaserKeyFormat& key, const std::string& data);
   virtual Status set(const LaserKeyFormat& key, const std::string& data);
   virtual Status setx(const LaserKeyFormat& key, const std::string& data, const RocksDbEngineSetOptions& options);
-  virtual Status mset(const std::vector<LaserKeyFormat>& keys, const std::vector<std::string>& datas);
-  virtual Status msetx(const std::vector<LaserKeyFormat>& keys, const std::vector<std::string>& datas,
+  virtual Status mset(const std::vector<const LaserKeyFormat*>& keys, const std::vector<std::string>& datas);
+  virtual Status msetx(const std::vector<const LaserKeyFormat*>& keys, const std::vector<std::string>& datas,
                        const RocksDbEngineSetOptions& options);
   virtual Status get(LaserValueRawString* value, const LaserKeyFormat& key);
+  // 批量获取，每个 key 的获取结果保存在 statuses 中
+  virtual Status mget(std::vector<Status>* statuses, std::vector<LaserValueRawString>* values,
+                      const std::vector<const LaserKeyFormat*>& keys);
   virtual Status exist(bool* result, const LaserKeyFormat& key);
 
-  // counter
+  // counter，在 key 锁内校验类型并计算新值，开启 merge 写入时只写入增量；
+  // 表开启 blind merge 时不加锁直接写入增量，value 非空时写入后再读取，读到的值可能包含并发写入的增量
   virtual Status decr(int64_t* value, const LaserKeyFormat& key, uint64_t step = 1);
   virtual Status incr(int64_t* value, const LaserKeyFormat& key, uint64_t step = 1);
 
@@ -82,6 +104,10 @@ class RocksDbEngine : public std::enable_shared_from_this<RocksDbEngine> {
   virtual Status hmset(const LaserKeyFormat& key, const std::map<std::string, std::string>& values);
   virtual Status hdel(const LaserKeyFormat& key, const std::string& field);
   virtual Status hget(LaserValueRawString* value, const LaserKeyFormat& key, const std::string& field);
+  // 仅点查指定的 field，不存在的 field 不会出现在 values 中
+  virtual Status hmget(std::unordered_map<std::string, LaserValueRawString>* values, const LaserKeyFormat& key,
+                       const std::vector<std::string>& fields);
+  virtual Status hexists(const LaserKeyFormat& key, const std::string& field);
   virtual Status hlen(LaserValueMapMeta* value, const LaserKeyFormat& key);
   virtual Status hkeys(std::vector<LaserKeyFormatMapData>* keys, const LaserKeyFormat& key);
   virtual Status hgetall(std::unordered_map<std::string, LaserValueRawString>* values, const LaserKeyFormat& key);
@@ -94,8 +120,9 @@ class RocksDbEngine : public std::enable_shared_from_this<RocksDbEngine> {
   virtual Status popFront(LaserValueRawString* value, const LaserKeyFormat& key);
   virtual Status popBack(LaserValueRawString* value, const LaserKeyFormat& key);
   virtual Status get(LaserValueListMeta* value, const LaserKeyFormat& key);
-  virtual Status lrange(std::vector<LaserValueRawString>* values, const LaserKeyFormat& key, uint64_t start = 0,
-                        uint64_t end = 0);
+  // start/end 为负数时表示从尾部计算位置，如 start = -10 表示最后 10 个元素，end 不包含在结果中
+  virtual Status lrange(std::vector<LaserValueRawString>* values, const LaserKeyFormat& key, int64_t start = 0,
+                        int64_t end = 0);
 
   // set
   virtual Status sadd(const LaserKeyFormat& key, const std::string& member);
@@ -109,6 +136,13 @@ class RocksDbEngine : public std::enable_shared_from_this<RocksDbEngine> {
   virtual Status zrangeByScore(std::vector<LaserScoreMember>* score_members, const LaserKeyFormat& key, int64_t min,
                                int64_t max);
   virtual Status zremRangeByScore(int64_t* number, const LaserKeyFormat& key, int64_t min, int64_t max);
+  virtual Status zscore(int64_t* score, const LaserKeyFormat& key, const std::string& member);
+  virtual Status zrem(const LaserKeyFormat& key, const std::string& member);
+  virtual Status get(LaserValueZSetMeta* value, const LaserKeyFormat& key);
+  virtual Status zrank(int64_t* rank, const LaserKeyFormat& key, const std::string& member);
+  // start/stop 为闭区间，负数表示从尾部计算位置
+  virtual Status zrange(std::vector<LaserScoreMember>* score_members, const LaserKeyFormat& key, int64_t start,
+                        int64_t stop);
 
   // db opt
   virtual Status ingestBaseSst(const std::string& ingest_file);
@@ -119,11 +153,35 @@ class RocksDbEngine : public std::enable_shared_from_this<RocksDbEngine> {
  private:
   std::shared_ptr<ReplicationDB> db_;
   Status setCounterByStep(int64_t* result, const LaserKeyFormat& key, int64_t step);
+  // 持有 key 锁时 old_timestamp 为旧值的过期时间，blind merge 时为 0
+  Status mergeWrite(const LaserKeyFormat& key, const LaserMergeOperand& operand, uint64_t old_timestamp);
+  bool isBlindMerge() const;
   uint64_t ttl_;
   std::shared_ptr<RocksDbEngineOptions> options_;
+  std::shared_ptr<metrics::Meter> sweep_delete_meter_;
+  std::shared_ptr<metrics::Meter> reclaim_delete_meter_;
+  // 之前的索引都已经处理过，下一轮清理从这里开始 seek，避免每轮都扫过已删除索引留下的 tombstone
+  std::atomic<uint64_t> ttl_sweep_start_ms_{0};
   Status listPop(LaserValueRawString* value, const LaserKeyFormat& key, bool is_left);
   Status listPush(const LaserKeyFormat& key, const std::string& value, bool is_left);
+  void listRangeScan(std::vector<LaserValueRawString>* values, rocksdb::Iterator* iter, const LaserKeyFormat& key,
+                     int64_t index_start, int64_t index_end, uint64_t version, bool reverse);
   bool checkKeyExpire(const LaserValueFormatBase& value);
+  bool isExpiredAt(const LaserValueFormatBase& value, uint64_t time_ms);
+  // old_timestamp 为已有值的过期时间，两者在同一个索引时间桶内时索引已经存在，不再重复写入
+  void addTtlIndex(RocksDbBatch& batch, const LaserKeyFormat& key, uint64_t timestamp,  // NOLINT
+                   uint64_t old_timestamp = 0);
+  uint64_t getTtlIndexTime(uint64_t timestamp, uint64_t now);
+  // reclaim_version 不为 0 时索引为回收索引，回收 key 下与当前 meta 版本号不一致的 data 行
+  Status deleteExpiredKey(bool* deleted, int64_t* reclaimed_bytes, const LaserKeyFormatTtl& ttl_key,
+                          uint64_t reclaim_version);
+  // 删除不可见的 data 行，超过单次回收的行数时返回 false
+  bool reclaimDataRows(uint32_t* reclaimed, int64_t* reclaimed_bytes, RocksDbBatch& batch,  // NOLINT
+                       const LaserKeyFormat& key, bool has_meta, uint64_t version);
+  // 复合类型的 meta 被删除或者过期后重写时写入回收索引，version 为失效的版本号
+  void addReclaimIndex(RocksDbBatch* batch, const LaserKeyFormat& key, uint64_t version);
+  // 删除带版本号的 meta 时保存版本号，保证重新创建的 key 版本号递增
+  void putDeadVersion(RocksDbBatch* batch, const LaserKeyFormat& key, uint64_t version);
   void setAutoExpire(LaserValueFormatBase& value);                                         // NOLINT
   void setExpire(LaserValueFormatBase& value, uint64_t ttl);                               // NOLINT
   void setMapExpire(RocksDbBatch& batch, const LaserKeyFormat& key, uint64_t timestamp);   // NOLINT
@@ -132,6 +190,29 @@ class RocksDbEngine : public std::enable_shared_from_this<RocksDbEngine> {
   void zsetSetExpire(RocksDbBatch& batch, const LaserKeyFormat& key, uint64_t timestamp);   // NOLINT
   void rangeZset(int64_t min, int64_t max, const LaserKeyFormat& key, rocksdb::Iterator* iter,
                  IteratorCallback callback);
+  // score -> members，zset 写操作中被修改的 score 行
+  using ZSetScoreRows = std::map<int64_t, std::vector<std::string>>;
+  Status loadZSetScoreRow(ZSetScoreRows* score_rows, const LaserKeyFormat& key, int64_t score, uint64_t version);
+  void writeZSetScoreRows(RocksDbBatch& batch, const LaserKeyFormat& key, const ZSetScoreRows& score_rows,  // NOLINT
+                          uint64_t version);
+  // meta 版本号为 0 的历史 zset 没有 member 反查索引，size 为 score 行的个数，读操作读出全部 score 行处理，
+  // 同一个 member 出现在多个 score 行时只保留最小的 score
+  void loadLegacyZSet(ZSetScoreRows* score_rows, std::map<std::string, int64_t>* member_scores,
+                      const LaserKeyFormat& key);
+  // 历史 zset 在第一次写入时迁移为新格式：使用新版本号重写 score 行并补齐 member 反查索引
+  Status migrateLegacyZSet(LaserValueZSetMeta* zset_meta, const LaserKeyFormat& key);
+  // 读取并校验 zset meta，历史 zset 在 leader 上第一次读取时加 key 锁迁移，迁移失败时仍返回历史格式的 meta
+  Status readZSetMeta(LaserValueZSetMeta* zset_meta, const LaserKeyFormat& key);
+
+  // 复合类型的 meta 带有版本号，data 行只有版本号与 meta 一致时才有效，
+  // 因此 expire、delkey 只需要修改 meta，旧版本的 data 行由 TTL 清理按回收索引分批删除
+  template <typename T>
+  Status readMetaForWrite(T* meta, RocksDbBatch* batch, const LaserKeyFormat& key);
+  Status readDataRow(LaserValueFormatBase* value, const LaserSerializer& key, const LaserValueFormatBase& meta);
+  void setDataVersion(LaserValueFormatBase& value, const LaserValueFormatBase& meta);  // NOLINT
+  uint64_t newVersion(uint64_t old_version);
+  static bool isCompositeMeta(const LaserValueFormatBase& value);
+  static bool isDataRowVisible(const rocksdb::Slice& value, uint64_t version);
 };
 
 }  // namespace laser
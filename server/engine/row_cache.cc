@@ -0,0 +1,191 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#include "city.h"
+
+#include "row_cache.h"
+
+namespace laser {
+
+RowCache::RowCache(uint64_t capacity, uint32_t num_shard_bits)
+    : capacity_(capacity), num_shard_bits_(num_shard_bits) {
+  size_t shard_number = static_cast<size_t>(1) << num_shard_bits_;
+  shard_capacity_ = capacity_ / shard_number;
+  shards_.reserve(shard_number);
+  for (size_t i = 0; i < shard_number; i++) {
+    shards_.push_back(std::make_unique<Shard>());
+  }
+
+  auto metrics = metrics::Metrics::getInstance();
+  hit_meter_ = metrics->buildMeter(LASER_ROW_CACHE_MODULE_NAME, LASER_ROW_CACHE_HIT);
+  miss_meter_ = metrics->buildMeter(LASER_ROW_CACHE_MODULE_NAME, LASER_ROW_CACHE_MISS);
+  eviction_meter_ = metrics->buildMeter(LASER_ROW_CACHE_MODULE_NAME, LASER_ROW_CACHE_EVICTION);
+}
+
+RowCache::Shard* RowCache::getShard(const rocksdb::Slice& key) {
+  if (num_shard_bits_ == 0) {
+    return shards_[0].get();
+  }
+  uint64_t hash = CityHash64(key.data(), key.size());
+  return shards_[hash >> (64 - num_shard_bits_)].get();
+}
+
+bool RowCache::lookup(std::string* value, const rocksdb::Slice& key) {
+  Shard* shard = getShard(key);
+  {
+    folly::SharedMutex::ReadHolder guard(shard->mutex);
+    auto found = shard->index.find(folly::StringPiece(key.data(), key.size()));
+    if (found != shard->index.end()) {
+      auto& entry = shard->slots[found->second];
+      entry->referenced.store(true, std::memory_order_relaxed);
+      value->assign(entry->value);
+      hit_meter_->mark();
+      return true;
+    }
+  }
+  miss_meter_->mark();
+  return false;
+}
+
+uint64_t RowCache::beginFill(const rocksdb::Slice& key) {
+  Shard* shard = getShard(key);
+  folly::SharedMutex::WriteHolder guard(shard->mutex);
+  // 同一个 key 并发读取时共用占位，读到的都是同一次写入之后的值
+  auto result = shard->fills.emplace(std::string(key.data(), key.size()), shard->next_token);
+  if (result.second) {
+    shard->next_token++;
+  }
+  return result.first->second;
+}
+
+void RowCache::cancelFill(const rocksdb::Slice& key, uint64_t token) {
+  Shard* shard = getShard(key);
+  folly::SharedMutex::WriteHolder guard(shard->mutex);
+  auto found = shard->fills.find(std::string(key.data(), key.size()));
+  if (found != shard->fills.end() && found->second == token) {
+    shard->fills.erase(found);
+  }
+}
+
+void RowCache::insert(const rocksdb::Slice& key, const rocksdb::Slice& value, uint64_t token) {
+  Shard* shard = getShard(key);
+  folly::SharedMutex::WriteHolder guard(shard->mutex);
+  auto fill = shard->fills.find(std::string(key.data(), key.size()));
+  if (fill == shard->fills.end() || fill->second != token) {
+    return;
+  }
+  shard->fills.erase(fill);
+
+  uint64_t charge = key.size() + value.size() + sizeof(RowCacheEntry);
+  if (charge > shard_capacity_) {
+    return;
+  }
+
+  folly::StringPiece index_key(key.data(), key.size());
+  auto found = shard->index.find(index_key);
+  if (found != shard->index.end()) {
+    removeSlot(shard, found->second);
+  }
+  while (shard->usage + charge > shard_capacity_) {
+    if (!evictOne(shard)) {
+      return;
+    }
+    eviction_meter_->mark();
+  }
+
+  auto entry = std::make_unique<RowCacheEntry>();
+  entry->key.assign(key.data(), key.size());
+  entry->value.assign(value.data(), value.size());
+  size_t slot;
+  if (!shard->free_slots.empty()) {
+    slot = shard->free_slots.back();
+    shard->free_slots.pop_back();
+    shard->slots[slot] = std::move(entry);
+  } else {
+    slot = shard->slots.size();
+    shard->slots.push_back(std::move(entry));
+  }
+  // index 的 key 指向 entry 自身保存的 key，entry 在堆上分配，slots 扩容时不会失效
+  shard->index.emplace(folly::StringPiece(shard->slots[slot]->key), slot);
+  shard->usage += charge;
+}
+
+void RowCache::erase(const rocksdb::Slice& key) {
+  Shard* shard = getShard(key);
+  folly::SharedMutex::WriteHolder guard(shard->mutex);
+  // 删除填充占位，避免写入之前开始的读取将旧值写回缓存
+  shard->fills.erase(std::string(key.data(), key.size()));
+  auto found = shard->index.find(folly::StringPiece(key.data(), key.size()));
+  if (found != shard->index.end()) {
+    removeSlot(shard, found->second);
+  }
+}
+
+void RowCache::clear() {
+  for (auto& shard : shards_) {
+    folly::SharedMutex::WriteHolder guard(shard->mutex);
+    shard->fills.clear();
+    shard->index.clear();
+    shard->slots.clear();
+    shard->free_slots.clear();
+    shard->hand = 0;
+    shard->usage = 0;
+  }
+}
+
+uint64_t RowCache::getUsage() {
+  uint64_t usage = 0;
+  for (auto& shard : shards_) {
+    folly::SharedMutex::ReadHolder guard(shard->mutex);
+    usage += shard->usage;
+  }
+  return usage;
+}
+
+void RowCache::removeSlot(Shard* shard, size_t slot) {
+  auto& entry = shard->slots[slot];
+  shard->index.erase(folly::StringPiece(entry->key));
+  shard->usage -= entry->key.size() + entry->value.size() + sizeof(RowCacheEntry);
+  entry.reset();
+  shard->free_slots.push_back(slot);
+}
+
+bool RowCache::evictOne(Shard* shard) {
+  size_t slot_number = shard->slots.size();
+  if (shard->index.empty() || slot_number == 0) {
+    return false;
+  }
+
+  // 最多扫描两轮，第一轮清除访问标记，第二轮一定能找到可以淘汰的 entry
+  for (size_t i = 0; i < slot_number * 2; i++) {
+    size_t slot = shard->hand;
+    shard->hand = (shard->hand + 1) % slot_number;
+    auto& entry = shard->slots[slot];
+    if (!entry) {
+      continue;
+    }
+    if (entry->referenced.exchange(false, std::memory_order_relaxed)) {
+      continue;
+    }
+    removeSlot(shard, slot);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace laser
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "folly/Range.h"
+#include "folly/SharedMutex.h"
+#include "folly/container/F14Map.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/write_batch.h"
+
+#include "common/metrics/metrics.h"
+
+namespace laser {
+
+inline constexpr char LASER_ROW_CACHE_MODULE_NAME[] = "row_cache";
+inline constexpr char LASER_ROW_CACHE_HIT[] = "hit";
+inline constexpr char LASER_ROW_CACHE_MISS[] = "miss";
+inline constexpr char LASER_ROW_CACHE_EVICTION[] = "eviction";
+
+struct RowCacheEntry {
+  std::string key;
+  std::string value;
+  std::atomic<bool> referenced{false};
+};
+
+// 缓存点查得到的原始 value，按 key hash 分片，分片内使用 CLOCK 淘汰，命中时只需要读锁
+class RowCache {
+ public:
+  RowCache(uint64_t capacity, uint32_t num_shard_bits);
+  ~RowCache() = default;
+
+  bool lookup(std::string* value, const rocksdb::Slice& key);
+  // 读取 db 前为 key 登记一个填充占位并返回令牌，期间 key 有写入时占位被删除，插入时校验令牌失败放弃插入
+  uint64_t beginFill(const rocksdb::Slice& key);
+  void insert(const rocksdb::Slice& key, const rocksdb::Slice& value, uint64_t token);
+  // 读取失败或者 key 不存在时删除占位
+  void cancelFill(const rocksdb::Slice& key, uint64_t token);
+  void erase(const rocksdb::Slice& key);
+  void clear();
+  uint64_t getUsage();
+  uint64_t getCapacity() const { return capacity_; }
+
+ private:
+  struct Shard {
+    folly::SharedMutex mutex;
+    folly::F14FastMap<folly::StringPiece, size_t> index;
+    std::vector<std::unique_ptr<RowCacheEntry>> slots;
+    std::vector<size_t> free_slots;
+    size_t hand{0};
+    uint64_t usage{0};
+    // 正在从 db 读取的 key 和对应的令牌，只影响同一个 key 的填充
+    folly::F14FastMap<std::string, uint64_t> fills;
+    uint64_t next_token{1};
+  };
+
+  uint64_t capacity_;
+  uint64_t shard_capacity_;
+  uint32_t num_shard_bits_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::shared_ptr<metrics::Meter> hit_meter_;
+  std::shared_ptr<metrics::Meter> miss_meter_;
+  std::shared_ptr<metrics::Meter> eviction_meter_;
+
+  Shard* getShard(const rocksdb::Slice& key);
+  void removeSlot(Shard* shard, size_t slot);
+  bool evictOne(Shard* shard);
+};
+
+// 遍历 WriteBatch 使其中涉及的 key 失效，范围删除时清空整个缓存
+class RowCacheInvalidator : public rocksdb::WriteBatch::Handler {
+ public:
+  explicit RowCacheInvalidator(RowCache* cache) : cache_(cache) {}
+  void Put(const rocksdb::Slice& key, const rocksdb::Slice&) override { cache_->erase(key); }
+  void Delete(const rocksdb::Slice& key) override { cache_->erase(key); }
+  void SingleDelete(const rocksdb::Slice& key) override { cache_->erase(key); }
+  void Merge(const rocksdb::Slice& key, const rocksdb::Slice&) override { cache_->erase(key); }
+  rocksdb::Status DeleteRangeCF(uint32_t, const rocksdb::Slice&, const rocksdb::Slice&) override {
+    cache_->clear();
+    return rocksdb::Status::OK();
+  }
+  void LogData(const rocksdb::Slice&) override {}
+
+ private:
+  RowCache* cache_;
+};
+
+}  // namespace laser
@@ -16,6 +16,8 @@
  * @author ZhongXiu Hao <nmred.hao@gmail.com>
  */
 
+#include <algorithm>
+
 #include "folly/portability/GFlags.h"
 #include "folly/Singleton.h"
 
@@ -24,67 +26,101 @@
 namespace laser {
 
 DEFINE_int32(lock_bucket_numbers, 1024, "Lock bucket numbers");
-DEFINE_int32(lock_bucket_max_lock_number, 10000, "Each lock bucket numbers allow locks number");
+DEFINE_int32(lock_bucket_max_lock_number, 10000, "Deprecated, lock bucket no longer limits locks number");
 
-folly::Singleton<LockManager> global_key_lock_manager;
+// 不随 SingletonVault 销毁，缓存的裸指针在进程退出前一直有效
+folly::LeakySingleton<LockManager> global_key_lock_manager;
 
-std::shared_ptr<LockManager> LockManager::getInstance() { return global_key_lock_manager.try_get(); }
+LockManager* LockManager::getInstance() {
+  static LockManager* instance = &global_key_lock_manager.get();
+  return instance;
+}
 
 LockManager::LockManager() {
   for (int i = 0; i < FLAGS_lock_bucket_numbers; i++) {
-    buckets_.push_back(std::make_shared<LockBucket>(FLAGS_lock_bucket_max_lock_number));
+    buckets_.push_back(std::make_unique<LockBucket>());
   }
 }
 
-Status LockManager::tryLock(const std::string& key) { return getBucket(key)->tryLock(key); }
+void LockManager::lock(KeyLockNode* node) { getBucket(node->key_hash)->lock(node); }
 
-void LockManager::unLock(const std::string& key) { return getBucket(key)->unLock(key); }
+void LockManager::unLock(KeyLockNode* node) { getBucket(node->key_hash)->unLock(node); }
 
-std::shared_ptr<LockBucket> LockManager::getBucket(const std::string& key) {
+LockBucket* LockManager::getBucket(uint64_t key_hash) {
   DCHECK(buckets_.size() == FLAGS_lock_bucket_numbers);
-  return buckets_.at(CityHash64(key.c_str(), key.size()) % FLAGS_lock_bucket_numbers);
+  return buckets_[key_hash % buckets_.size()].get();
 }
 
-Status LockBucket::tryLock(const std::string& key) {
-  bucket_mutex_.lock();
-
-  VLOG(10) << "start lock";
-  Status result = acquireLocked(key);
-  if (result != Status::OK) {
-    do {
-      std::unique_lock<std::mutex> lock(bucket_mutex_, std::adopt_lock);
-      bucket_cv_.wait(lock);
-
-      // 确保 unique_lock 和 bucket mutex 去掉关联关系
-      lock.release();
+void LockBucket::lock(KeyLockNode* node) {
+  std::unique_lock<std::mutex> lock(bucket_mutex_);
+  KeyLockNode* holder = holders_;
+  while (holder && holder->key_hash != node->key_hash) {
+    holder = holder->next;
+  }
 
-      result = acquireLocked(key);
-    } while (result != Status::OK);
+  if (!holder) {
+    node->granted = true;
+    node->next = holders_;
+    holders_ = node;
+    return;
   }
-  VLOG(10) << "lock success";
 
-  bucket_mutex_.unlock();
-  return result;
+  // 加入持有者的等待队列，解锁时直接把锁交给队头，只唤醒这一个等待者
+  node->granted = false;
+  node->next_waiter = nullptr;
+  if (holder->waiter_tail) {
+    holder->waiter_tail->next_waiter = node;
+  } else {
+    holder->waiter_head = node;
+  }
+  holder->waiter_tail = node;
+  VLOG(10) << "wait for key lock";
+  node->cv.wait(lock, [node]() { return node->granted; });
 }
 
-void LockBucket::unLock(const std::string& key) {
-  bucket_mutex_.lock();
-  auto iter = keys_.find(key);
-  if (iter != keys_.end()) {
-    keys_.erase(iter);
+void LockBucket::unLock(KeyLockNode* node) {
+  std::lock_guard<std::mutex> lock(bucket_mutex_);
+  KeyLockNode** prev = &holders_;
+  while (*prev && *prev != node) {
+    prev = &(*prev)->next;
+  }
+  if (!*prev) {
+    return;
   }
+  *prev = node->next;
+  node->next = nullptr;
 
-  bucket_mutex_.unlock();
-  bucket_cv_.notify_all();
+  KeyLockNode* waiter = node->waiter_head;
+  if (!waiter) {
+    return;
+  }
+  waiter->waiter_head = waiter->next_waiter;
+  waiter->waiter_tail = waiter->waiter_head ? node->waiter_tail : nullptr;
+  waiter->next_waiter = nullptr;
+  waiter->granted = true;
+  waiter->next = holders_;
+  holders_ = waiter;
+  node->waiter_head = nullptr;
+  node->waiter_tail = nullptr;
+  // 必须在持有 bucket 锁时通知，否则等待者可能已经返回并销毁了节点
+  waiter->cv.notify_one();
 }
 
-Status LockBucket::acquireLocked(const std::string& key) {
-  if (keys_.find(key) != keys_.end()) {
-    return Status::RS_BUSY;
+ScopedMultiKeyLock::ScopedMultiKeyLock(std::vector<uint64_t> key_hashes) : manager_(LockManager::getInstance()) {
+  std::sort(key_hashes.begin(), key_hashes.end());
+  key_hashes.erase(std::unique(key_hashes.begin(), key_hashes.end()), key_hashes.end());
+  size_ = key_hashes.size();
+  nodes_ = std::make_unique<KeyLockNode[]>(size_);
+  for (size_t i = 0; i < size_; i++) {
+    nodes_[i].key_hash = key_hashes[i];
+    manager_->lock(&nodes_[i]);
   }
+}
 
-  keys_.insert(key);
-  return Status::OK;
+ScopedMultiKeyLock::~ScopedMultiKeyLock() {
+  for (size_t i = size_; i > 0; i--) {
+    manager_->unLock(&nodes_[i - 1]);
+  }
 }
 
 }  // namespace laser
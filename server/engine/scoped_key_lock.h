@@ -19,6 +19,8 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
+#include <vector>
 #include <mutex> // NOLINT
 #include <condition_variable> // NOLINT
 
@@ -31,40 +33,74 @@
 
 namespace laser {
 
+// 加锁节点保存在 ScopedKeyLock 自身中，bucket 通过侵入式链表记录持有者和等待者，加锁过程中不需要分配内存
+struct KeyLockNode {
+  uint64_t key_hash{0};
+  bool granted{false};
+  std::condition_variable cv;
+  // bucket 中持有锁的链表
+  KeyLockNode* next{nullptr};
+  // 等待同一个 key 的 FIFO 队列，只在持有者节点上维护队头和队尾
+  KeyLockNode* waiter_head{nullptr};
+  KeyLockNode* waiter_tail{nullptr};
+  KeyLockNode* next_waiter{nullptr};
+};
+
 class LockBucket {
  public:
-  explicit LockBucket(int max_locks) : max_locks_(max_locks) {}
-  Status tryLock(const std::string& key);
-  void unLock(const std::string& key);
+  LockBucket() = default;
+  void lock(KeyLockNode* node);
+  void unLock(KeyLockNode* node);
 
  private:
-  int max_locks_{1024};
   std::mutex bucket_mutex_;
-  std::condition_variable bucket_cv_;
-  std::unordered_set<std::string> keys_;
-  Status acquireLocked(const std::string& key);
+  KeyLockNode* holders_{nullptr};
 };
 
 class LockManager {
  public:
-  static std::shared_ptr<LockManager> getInstance();
+  // 锁管理器创建后不会销毁，返回缓存的指针，加解锁时不需要复制 shared_ptr
+  static LockManager* getInstance();
+  static inline uint64_t hash(const char* data, size_t size) { return CityHash64(data, size); }
   LockManager();
   ~LockManager() = default;
-  Status tryLock(const std::string& key);
-  void unLock(const std::string& key);
+  void lock(KeyLockNode* node);
+  void unLock(KeyLockNode* node);
 
  private:
-  std::shared_ptr<LockBucket> getBucket(const std::string& key);
-  std::vector<std::shared_ptr<LockBucket>> buckets_;
+  LockBucket* getBucket(uint64_t key_hash);
+  std::vector<std::unique_ptr<LockBucket>> buckets_;
 };
 
+// 同一个 key 的锁按 key 的 64 位 hash 区分，hash 冲突的 key 会串行执行
 class ScopedKeyLock {
  public:
-  explicit ScopedKeyLock(const std::string& key) : key_(key) { LockManager::getInstance()->tryLock(key_); }
-  ~ScopedKeyLock() { LockManager::getInstance()->unLock(key_); }
+  ScopedKeyLock(const char* data, size_t size) : manager_(LockManager::getInstance()) {
+    node_.key_hash = LockManager::hash(data, size);
+    manager_->lock(&node_);
+  }
+  explicit ScopedKeyLock(const std::string& key) : ScopedKeyLock(key.data(), key.size()) {}
+  ~ScopedKeyLock() { manager_->unLock(&node_); }
+  ScopedKeyLock(const ScopedKeyLock&) = delete;
+  ScopedKeyLock& operator=(const ScopedKeyLock&) = delete;
+
+ private:
+  LockManager* manager_;
+  KeyLockNode node_;
+};
+
+// 批量操作加锁，按 key hash 排序去重后依次加锁，避免并发的批量操作之间死锁
+class ScopedMultiKeyLock {
+ public:
+  explicit ScopedMultiKeyLock(std::vector<uint64_t> key_hashes);
+  ~ScopedMultiKeyLock();
+  ScopedMultiKeyLock(const ScopedMultiKeyLock&) = delete;
+  ScopedMultiKeyLock& operator=(const ScopedMultiKeyLock&) = delete;
 
  private:
-  std::string key_;
+  LockManager* manager_;
+  std::unique_ptr<KeyLockNode[]> nodes_;
+  size_t size_{0};
 };
 
 }  // namespace laser
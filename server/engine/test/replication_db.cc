@@ -18,13 +18,23 @@
  * @author liubang <it.liubang@gmail.com>
  */
 
+#include <atomic>
+#include <limits>
+
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 #include "boost/filesystem.hpp"
 
 #include "folly/Singleton.h"
+#include "folly/executors/CPUThreadPoolExecutor.h"
+#include "folly/io/async/ScopedEventBaseThread.h"
+#include "folly/lang/Bits.h"
+#include "folly/synchronization/Baton.h"
 #include "folly/Random.h"
+#include "laser/server/engine/replicate_batch_sizer.h"
 #include "laser/server/engine/rocksdb.h"
+#include "laser/server/engine/row_cache.h"
+#include "laser/server/engine/wal_tail_ring.h"
 
 DECLARE_string(vmodule);
 
@@ -48,12 +58,28 @@ class MockReplicationDB : public laser::ReplicationDB {
     laser::ReplicationDB::getUpdates(response, std::move(request));
   }
 
+  using laser::ReplicationDB::wrapWriteBatch;
+  using laser::ReplicationDB::applyReplicateResponse;
+  using laser::ReplicationDB::pipelineUpdates;
+  using laser::ReplicationDB::applyStreamItem;
+
   MOCK_METHOD0(pullFromUpstream, void());
+  MOCK_METHOD1(sendPullRequest, void(const laser::ReplicateRequest&));
+  MOCK_METHOD1(sendStreamAck, void(const laser::ReplicateRequest&));
 };
 
 namespace laser {
 DECLARE_int32(replicator_pull_delay_on_error_ms);
 DECLARE_int32(replicator_max_updates_per_response);
+DECLARE_int32(replicator_apply_group_max_updates);
+DECLARE_string(replicator_compression_type);
+DECLARE_int32(replicator_compression_min_bytes);
+DECLARE_int32(replicator_wal_tail_ring_max_batches);
+DECLARE_int32(replicator_apply_max_pending_bytes);
+DECLARE_int32(replicator_max_size_per_response);
+DECLARE_int32(replicator_adaptive_max_size_per_response);
+DECLARE_int32(replicator_sync_ack_timeout_ms);
+DECLARE_int32(replicator_stream_max_unacked_bytes);
 }
 class ReplicationDBTest : public ::testing::Test {
  public:
@@ -307,3 +333,587 @@ TEST_F(ReplicationDBTest, replicateBatchSuccess) {
 
   checkReadData(follower_db, data_prefix, number_batch);
 }
+
+// leader 的 IOBuf 直接引用 WAL 中的 WriteBatch，follower 将分段的 IOBuf 合并为一个 WriteBatch
+TEST_F(ReplicationDBTest, zeroCopyUpdates) {
+  auto write_batch = std::make_unique<rocksdb::WriteBatch>();
+  write_batch->Put("key1", "value1");
+  write_batch->Delete("key2");
+  std::string rep = write_batch->Data();
+  const char* rep_data = write_batch->Data().data();
+
+  folly::IOBuf buf;
+  MockReplicationDB::wrapWriteBatch(&buf, std::move(write_batch));
+  EXPECT_EQ(reinterpret_cast<const uint8_t*>(rep_data), buf.data());
+
+  // 模拟 thrift 反序列化得到的 IOBuf 链，sequence 紧接在前一个 batch 之后
+  uint64_t next_sequence = folly::Endian::little(static_cast<uint64_t>(2));
+  memcpy(&rep[0], &next_sequence, sizeof(next_sequence));
+  size_t split = rep.size() / 2;
+  auto chain = folly::IOBuf::copyBuffer(rep.data(), split);
+  chain->prependChain(folly::IOBuf::copyBuffer(rep.data() + split, rep.size() - split));
+  EXPECT_TRUE(chain->isChained());
+
+  laser::WriteBatchGroup group;
+  EXPECT_TRUE(group.follows(buf));
+  EXPECT_TRUE(group.append(buf));
+  EXPECT_TRUE(group.follows(*chain));
+  EXPECT_TRUE(group.append(*chain));
+  EXPECT_FALSE(group.append(*folly::IOBuf::copyBuffer("short")));
+  // sequence 不连续的 batch 不能合并
+  EXPECT_FALSE(group.follows(buf));
+  EXPECT_FALSE(group.append(buf));
+  EXPECT_EQ(2, group.getBatchNumber());
+  EXPECT_EQ(4, group.getCount());
+  rocksdb::WriteBatch restored = group.release();
+  EXPECT_EQ(4, restored.Count());
+  EXPECT_EQ(0, group.getBatchNumber());
+  EXPECT_EQ(rep.size() * 2 - 12, restored.GetDataSize());
+}
+
+// follower 合并写入后 WAL 的边界与 leader 不同，切换为 leader 后其他 follower 仍然可以从中间的 sequence 同步
+TEST_F(ReplicationDBTest, groupedApplyAndTrim) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto grouped_db = createDb(laser::DBRole::FOLLOWER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+
+  writeBatchData(leader_db, "first", 5);
+  int64_t next_seq_no = 0;
+  replicateForward(&next_seq_no, leader_db, follower_db);
+  checkSeqNo(leader_db, follower_db);
+
+  writeBatchData(leader_db, "second", 5);
+  replicateForward(&next_seq_no, leader_db, grouped_db);
+  checkSeqNo(leader_db, grouped_db);
+  checkReadData(grouped_db, "first", 5);
+  checkReadData(grouped_db, "second", 5);
+
+  grouped_db->changeRole(laser::DBRole::LEADER);
+  replicateForward(&next_seq_no, grouped_db, follower_db);
+  checkSeqNo(grouped_db, follower_db);
+  checkReadData(follower_db, "first", 5);
+  checkReadData(follower_db, "second", 5);
+
+  // 不合并时逐个写入
+  laser::FLAGS_replicator_apply_group_max_updates = 1;
+  auto single_db = createDb(laser::DBRole::FOLLOWER);
+  replicateForward(&next_seq_no, leader_db, single_db);
+  checkSeqNo(leader_db, single_db);
+  laser::FLAGS_replicator_apply_group_max_updates = 100;
+}
+
+// 流式同步时 leader 按 next_seq_no 推进，follower 逐个处理推送的 response
+TEST_F(ReplicationDBTest, streamResponses) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  writeBatchData(leader_db, "stream", 20);
+
+  laser::ReplicateRequest request;
+  follower_db->getPullRequest(&request, laser::ReplicateType::FORWARD, 0);
+  request.max_size = 1;
+  uint32_t response_number = 0;
+  while (true) {
+    laser::ReplicateResponse response;
+    leader_db->getUpdates(&response, std::make_unique<laser::ReplicateRequest>(request));
+    if (response.updates.empty()) {
+      break;
+    }
+    EXPECT_EQ(request.seq_no + 2, response.next_seq_no);
+    request.seq_no = response.next_seq_no - 1;
+    bool delay_next_pull = false;
+    EXPECT_TRUE(follower_db->applyReplicateResponse(&delay_next_pull, response));
+    EXPECT_FALSE(delay_next_pull);
+    response_number++;
+  }
+  EXPECT_EQ(20, response_number);
+  checkSeqNo(leader_db, follower_db);
+  checkReadData(follower_db, "stream", 20);
+
+  // 版本变化时停止增量同步
+  laser::ReplicateResponse changed_response;
+  changed_response.version = "base_version2";
+  bool delay_next_pull = false;
+  EXPECT_FALSE(follower_db->applyReplicateResponse(&delay_next_pull, changed_response));
+}
+
+// 打开 leader 的推送 stream，follower 逐个写入推送的 response；未确认的数据达到上限后 leader 等待 follower 的 ack
+TEST_F(ReplicationDBTest, streamPushAndAck) {
+  laser::FLAGS_replicator_stream_max_unacked_bytes = 1;
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  writeBatchData(leader_db, "stream_push", 10);
+
+  folly::ScopedEventBaseThread evb_thread("StreamTestEvb");
+  auto consume_stream = [this, &leader_db, &follower_db, &evb_thread](int32_t max_wait_ms) {
+    laser::ReplicateRequest request;
+    follower_db->getPullRequest(&request, laser::ReplicateType::FORWARD, 0);
+    request.max_size = 1;
+    request.max_wait_ms = max_wait_ms;
+    request.set_stream_credits(5);
+    auto stream = leader_db->handleReplicateStreamRequest(std::make_unique<laser::ReplicateRequest>(request));
+
+    uint32_t item_number = 0;
+    bool stopped = false;
+    auto on_item = [&item_number, &stopped, &follower_db](folly::Try<laser::ReplicateResponse>&& item) {
+      if (item.hasValue()) {
+        item_number++;
+      }
+      if (!stopped) {
+        follower_db->applyStreamItem(&stopped, std::move(item));
+      }
+    };
+    auto subscription = std::move(stream)
+                            .toClientStreamUnsafeDoNotUse(evb_thread.getEventBase())
+                            .subscribeExTry(replicate_thread_pool_.get(), std::move(on_item));
+    std::move(subscription).join();
+    return item_number;
+  };
+
+  // follower 的 ack 直接交给 leader，每个 response 确认后 leader 继续推送，额度用完后结束 stream
+  EXPECT_CALL(*follower_db, sendStreamAck(::testing::_))
+      .Times(5)
+      .WillRepeatedly(::testing::Invoke(
+          [&leader_db](const laser::ReplicateRequest& request) { leader_db->updateFollowerAck(request); }));
+  EXPECT_CALL(*follower_db, pullFromUpstream()).Times(2);
+  EXPECT_EQ(5, consume_stream(10000));
+  checkReadData(follower_db, "stream_push", 5);
+
+  // follower 没有上报 ack 时 leader 只推送一个 response，到期后结束 stream
+  EXPECT_CALL(*follower_db, sendStreamAck(::testing::_)).Times(1);
+  EXPECT_EQ(1, consume_stream(50));
+  checkReadData(follower_db, "stream_push", 6);
+  laser::FLAGS_replicator_stream_max_unacked_bytes = 16 * 1024 * 1024;
+}
+
+// 合并同步时 leader 只返回有更新的 partition，写入后唤醒等待的请求
+TEST_F(ReplicationDBTest, batchReplicateUpdates) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+
+  laser::ReplicateRequest request;
+  follower_db->getPullRequest(&request, laser::ReplicateType::FORWARD, 0);
+  EXPECT_FALSE(leader_db->hasUpdates(request));
+  folly::Baton<> baton;
+  leader_db->runOnUpdates([&baton]() { baton.post(); }, 10000);
+
+  writeBatchData(leader_db, "batch", 10);
+  EXPECT_TRUE(baton.try_wait_for(std::chrono::seconds(1)));
+
+  // 没有写入时等待到期执行，之后的写入不会再次执行
+  std::atomic<int> timeout_count{0};
+  folly::Baton<> timeout_baton;
+  leader_db->runOnUpdates([&timeout_count, &timeout_baton]() {
+    timeout_count++;
+    timeout_baton.post();
+  }, 10);
+  EXPECT_TRUE(timeout_baton.try_wait_for(std::chrono::seconds(1)));
+  folly::Baton<> write_baton;
+  leader_db->runOnUpdates([&write_baton]() { write_baton.post(); }, 10000);
+  writeBatchData(leader_db, "batch_timeout", 1);
+  EXPECT_TRUE(write_baton.try_wait_for(std::chrono::seconds(1)));
+  EXPECT_EQ(1, timeout_count.load());
+  EXPECT_TRUE(leader_db->hasUpdates(request));
+
+  laser::ReplicateResponse response;
+  leader_db->getReplicateUpdates(&response, std::make_unique<laser::ReplicateRequest>(request));
+  EXPECT_TRUE(response.get_timestamp() != nullptr);
+  bool delay_next_pull = false;
+  EXPECT_TRUE(follower_db->applyReplicateResponse(&delay_next_pull, response));
+  checkSeqNo(leader_db, follower_db);
+  checkReadData(follower_db, "batch", 10);
+
+  // base 版本不同时也需要返回，follower 借此触发全量同步
+  request.version = "base_version2";
+  request.seq_no = response.next_seq_no - 1;
+  EXPECT_TRUE(leader_db->hasUpdates(request));
+}
+
+// 合并同步中没有更新的 partition 用 leader 返回的进度刷新同步延迟
+TEST_F(ReplicationDBTest, idleReplicateState) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  EXPECT_EQ(std::numeric_limits<int64_t>::max(), follower_db->getReplicateLagMs());
+
+  laser::IdleReplicateState state;
+  leader_db->getIdleReplicateState(&state);
+  follower_db->applyIdleReplicateState(state);
+  EXPECT_EQ(0, follower_db->getReplicateLagMs());
+
+  // leader 有 follower 没有的写入时不认为追上
+  auto lagged_db = createDb(laser::DBRole::FOLLOWER);
+  writeBatchData(leader_db, "idle", 1);
+  leader_db->getIdleReplicateState(&state);
+  lagged_db->applyIdleReplicateState(state);
+  EXPECT_EQ(std::numeric_limits<int64_t>::max(), lagged_db->getReplicateLagMs());
+}
+
+// follower 声明可以接受的压缩方式后，leader 整体压缩 response 中的 update
+TEST_F(ReplicationDBTest, compressedUpdates) {
+  laser::FLAGS_replicator_compression_min_bytes = 0;
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  for (auto& type : {"lz4", "zstd"}) {
+    laser::FLAGS_replicator_compression_type = type;
+    auto follower_db = createDb(laser::DBRole::FOLLOWER);
+    writeBatchData(leader_db, folly::to<std::string>(type, "_compressed_value_"), 20);
+
+    laser::ReplicateRequest request;
+    follower_db->getPullRequest(&request, laser::ReplicateType::FORWARD, 0);
+    ASSERT_TRUE(request.get_compression() != nullptr);
+    laser::ReplicateResponse response;
+    leader_db->getUpdates(&response, std::make_unique<laser::ReplicateRequest>(request));
+    ASSERT_TRUE(response.get_compression() != nullptr);
+    EXPECT_TRUE(response.updates.empty());
+
+    bool delay_next_pull = false;
+    EXPECT_TRUE(follower_db->applyReplicateResponse(&delay_next_pull, response));
+    EXPECT_FALSE(delay_next_pull);
+    checkSeqNo(leader_db, follower_db);
+    checkReadData(follower_db, folly::to<std::string>(type, "_compressed_value_"), 20);
+  }
+
+  // 不声明压缩方式时返回原始数据
+  laser::FLAGS_replicator_compression_type = "none";
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  laser::ReplicateRequest request;
+  follower_db->getPullRequest(&request, laser::ReplicateType::FORWARD, 0);
+  laser::ReplicateResponse response;
+  leader_db->getUpdates(&response, std::make_unique<laser::ReplicateRequest>(request));
+  EXPECT_TRUE(response.get_compression() == nullptr);
+  EXPECT_FALSE(response.updates.empty());
+  laser::FLAGS_replicator_compression_min_bytes = 4 * 1024;
+}
+
+// leader 开启内存中的 WAL 尾部后，follower 从内存读取最近的写入，落后太多时回退到 WAL
+TEST_F(ReplicationDBTest, walTailRing) {
+  laser::FLAGS_replicator_wal_tail_ring_max_batches = 8;
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  laser::FLAGS_replicator_wal_tail_ring_max_batches = 0;
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  auto lagged_db = createDb(laser::DBRole::FOLLOWER);
+
+  writeBatchData(leader_db, "ring", 20);
+  int64_t next_seq_no = 0;
+  replicateForward(&next_seq_no, leader_db, follower_db);
+  checkSeqNo(leader_db, follower_db);
+
+  writeBatchDataEach(leader_db, "ring_each", 20, 4);
+  replicateForward(&next_seq_no, leader_db, follower_db);
+  checkSeqNo(leader_db, follower_db);
+  checkReadData(follower_db, "ring_each", 20);
+  replicateForward(&next_seq_no, leader_db, lagged_db);
+  checkSeqNo(leader_db, lagged_db);
+  checkReadData(lagged_db, "ring", 20);
+
+  // 并发写入完成的顺序可能与 sequence 不同，中间缺失时只返回连续的部分
+  laser::WalTailRing ring(4, 1024);
+  ring.append(3, 2, 0, std::string(16, 'b'));
+  ring.append(1, 2, 0, std::string(16, 'a'));
+  ring.append(7, 1, 0, std::string(16, 'd'));
+  std::vector<laser::WalTailEntry> entries;
+  EXPECT_TRUE(ring.read(&entries, 2, 1024));
+  ASSERT_EQ(2, entries.size());
+  EXPECT_EQ(1, entries[0].sequence);
+  EXPECT_EQ(3, entries[1].sequence);
+  entries.clear();
+  EXPECT_FALSE(ring.read(&entries, 5, 1024));
+  EXPECT_TRUE(ring.read(&entries, 8, 1024));
+  EXPECT_TRUE(entries.empty());
+  ring.append(5, 2, 0, std::string(16, 'c'));
+  ring.append(8, 1, 0, std::string(16, 'e'));
+  EXPECT_FALSE(ring.read(&entries, 1, 1024));
+  EXPECT_TRUE(ring.read(&entries, 5, 1024));
+  EXPECT_EQ(3, entries.size());
+}
+
+// follower 的数据延迟，从未同步过时为最大值，落后时按已同步数据的写入时间计算，追上后为 0
+TEST_F(ReplicationDBTest, replicateLagMs) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  EXPECT_EQ(std::numeric_limits<int64_t>::max(), follower_db->getReplicateLagMs());
+  EXPECT_EQ(0, leader_db->getReplicateLagMs());
+
+  writeBatchData(leader_db, "lag", 10);
+  int64_t next_seq_no = 0;
+  laser::FLAGS_replicator_max_size_per_response = 1;
+  replicateForward(&next_seq_no, leader_db, follower_db);
+  int64_t lag_ms = follower_db->getReplicateLagMs();
+  EXPECT_GE(lag_ms, 0);
+  EXPECT_LT(lag_ms, 10 * 1000);
+
+  laser::FLAGS_replicator_max_size_per_response = 1024 * 1024;
+  replicateForward(&next_seq_no, leader_db, follower_db);
+  checkSeqNo(leader_db, follower_db);
+  EXPECT_EQ(0, follower_db->getReplicateLagMs());
+  laser::ReplicationDbMetaInfo info;
+  follower_db->getDbMetaInfo(&info);
+  EXPECT_EQ(0, info.getReplicateLagMs());
+}
+
+// 落后时在目标耗时内按写入速度增大 pull 的大小，耗时过长或追上后缩小，leader 按上限截断请求
+TEST_F(ReplicationDBTest, adaptiveBatchSize) {
+  laser::ReplicateBatchSizer sizer(1024, 64 * 1024, 4096, 100);
+  EXPECT_EQ(4096, sizer.getMaxSize());
+  sizer.update(1000, 4096, 10);
+  EXPECT_EQ(8192, sizer.getMaxSize());
+  sizer.update(1000, 8192, 80);
+  EXPECT_EQ(10240, sizer.getMaxSize());
+  sizer.update(1000, 1024, 10);
+  EXPECT_EQ(10240, sizer.getMaxSize());
+  sizer.update(1000, 10240, 300);
+  EXPECT_EQ(5120, sizer.getMaxSize());
+  for (int i = 0; i < 10; i++) {
+    sizer.update(1000, sizer.getMaxSize(), 1);
+  }
+  EXPECT_EQ(64 * 1024, sizer.getMaxSize());
+  for (int i = 0; i < 30; i++) {
+    sizer.update(0, 0, 1);
+  }
+  EXPECT_EQ(1024, sizer.getMaxSize());
+
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  writeBatchData(leader_db, "adaptive", 20);
+  int32_t max_size_limit = laser::FLAGS_replicator_adaptive_max_size_per_response;
+  laser::FLAGS_replicator_adaptive_max_size_per_response = 1;
+  laser::ReplicateRequest request;
+  request.seq_no = 0;
+  request.version = "base_version1";
+  request.max_size = 1024 * 1024 * 1024;
+  laser::ReplicateResponse response;
+  leader_db->getUpdates(&response, std::make_unique<laser::ReplicateRequest>(request));
+  EXPECT_EQ(20, response.updates.size());
+  laser::FLAGS_replicator_max_size_per_response = 1;
+  laser::ReplicateResponse limited_response;
+  leader_db->getUpdates(&limited_response, std::make_unique<laser::ReplicateRequest>(request));
+  EXPECT_EQ(1, limited_response.updates.size());
+  laser::FLAGS_replicator_max_size_per_response = 1024 * 1024;
+  laser::FLAGS_replicator_adaptive_max_size_per_response = max_size_limit;
+}
+
+// 开启独立的写入线程池后，写入当前 response 的同时从 next_seq_no 发起下一次 pull
+TEST_F(ReplicationDBTest, pipelinedApply) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  auto apply_executor = std::make_shared<folly::CPUThreadPoolExecutor>(2);
+  follower_db->setApplyExecutor(apply_executor);
+  writeBatchData(leader_db, "pipeline", 3);
+
+  auto get_response = [&leader_db](int64_t seq_no) {
+    laser::ReplicateRequest request;
+    request.seq_no = seq_no;
+    request.version = "base_version1";
+    request.max_size = 1;
+    laser::ReplicateResponse response;
+    leader_db->getUpdates(&response, std::make_unique<laser::ReplicateRequest>(request));
+    return response;
+  };
+  auto wait_seq_no = [&follower_db](uint64_t seq_no) {
+    for (int i = 0; i < 100; i++) {
+      laser::ReplicationDbMetaInfo info;
+      follower_db->getDbMetaInfo(&info);
+      if (info.getSeqNo() == seq_no) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+  };
+
+  EXPECT_CALL(*follower_db, sendPullRequest(::testing::Field(&laser::ReplicateRequest::seq_no, 1))).Times(1);
+  EXPECT_CALL(*follower_db, sendPullRequest(::testing::Field(&laser::ReplicateRequest::seq_no, 2))).Times(1);
+  follower_db->pipelineUpdates(folly::Try<laser::ReplicateResponse>(get_response(0)), 0, 0);
+  follower_db->pipelineUpdates(folly::Try<laser::ReplicateResponse>(get_response(1)), 1, 0);
+  EXPECT_TRUE(wait_seq_no(2));
+
+  // 待写入的数据超过上限时不提前 pull，写入完成后再发起，写入完成之后才调用 on_applied
+  laser::FLAGS_replicator_apply_max_pending_bytes = 0;
+  EXPECT_CALL(*follower_db, pullFromUpstream()).Times(1);
+  std::atomic<int64_t> applied_seq_no{-1};
+  follower_db->pipelineUpdates(folly::Try<laser::ReplicateResponse>(get_response(2)), 2, 0,
+                               [&follower_db, &applied_seq_no]() {
+                                 laser::ReplicationDbMetaInfo info;
+                                 follower_db->getDbMetaInfo(&info);
+                                 applied_seq_no = static_cast<int64_t>(info.getSeqNo());
+                               });
+  EXPECT_TRUE(wait_seq_no(3));
+  checkReadData(follower_db, "pipeline", 3);
+  laser::FLAGS_replicator_apply_max_pending_bytes = 16 * 1024 * 1024;
+  apply_executor->join();
+  EXPECT_EQ(3, applied_seq_no);
+}
+
+// 半同步写入只登记等待，调用方释放锁之后等待 follower 确认，没有确认时超时退化为异步写入
+TEST_F(ReplicationDBTest, semiSyncWrite) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  leader_db->setSyncReplicas(1);
+  laser::FLAGS_replicator_sync_ack_timeout_ms = 50;
+  // 没有 collector 的写入不等待确认
+  int64_t start_ms = static_cast<int64_t>(common::currentTimeInMs());
+  writeBatchData(leader_db, "async", 1);
+  EXPECT_LT(static_cast<int64_t>(common::currentTimeInMs()) - start_ms, 50);
+
+  laser::SyncAckCollector timeout_collector;
+  {
+    laser::SyncAckCollector::Scope scope(&timeout_collector);
+    writeBatchData(leader_db, "sync", 1);
+  }
+  EXPECT_LT(static_cast<int64_t>(common::currentTimeInMs()) - start_ms, 50);
+  timeout_collector.wait().get();
+  EXPECT_GE(static_cast<int64_t>(common::currentTimeInMs()) - start_ms, 50);
+
+  // seq_no 已经超过 ack_seq_no 的提前 pull 不能确认写入
+  laser::FLAGS_replicator_sync_ack_timeout_ms = 10 * 1000;
+  laser::ReplicateRequest request;
+  request.node_hash = node_hash_;
+  request.seq_no = 3;
+  request.set_ack_seq_no(2);
+  leader_db->updateFollowerAck(request);
+
+  laser::SyncAckCollector collector;
+  {
+    laser::SyncAckCollector::Scope scope(&collector);
+    writeBatchData(leader_db, "sync_ack", 1);
+  }
+  auto future = collector.wait().via(replicate_thread_pool_.get());
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(future.isReady());
+  request.set_ack_seq_no(3);
+  leader_db->updateFollowerAck(request);
+  EXPECT_TRUE(future.wait(std::chrono::seconds(1)).isReady());
+
+  // 已经确认过的 seq 号不会回退
+  request.set_ack_seq_no(1);
+  leader_db->updateFollowerAck(request);
+  leader_db->setSyncReplicas(0);
+  laser::FLAGS_replicator_sync_ack_timeout_ms = 100;
+}
+
+// 流式同步时 follower 写入 leader 标记需要确认的 response 后上报 ack，leader 据此确认半同步写入
+TEST_F(ReplicationDBTest, semiSyncStreamAck) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  laser::FLAGS_replicator_sync_ack_timeout_ms = 10 * 1000;
+  leader_db->setSyncReplicas(1);
+
+  laser::ReplicateRequest request;
+  follower_db->getPullRequest(&request, laser::ReplicateType::FORWARD, 0);
+  laser::SyncAckCollector collector;
+  {
+    laser::SyncAckCollector::Scope scope(&collector);
+    writeBatchData(leader_db, "stream_ack", 1);
+  }
+  auto future = collector.wait().via(replicate_thread_pool_.get());
+
+  laser::ReplicateResponse response;
+  leader_db->getUpdates(&response, std::make_unique<laser::ReplicateRequest>(request));
+  ASSERT_TRUE(response.get_need_ack() != nullptr);
+  EXPECT_TRUE(*response.get_need_ack());
+
+  laser::ReplicateRequest ack_request;
+  EXPECT_CALL(*follower_db, sendStreamAck(::testing::_)).Times(1).WillOnce(::testing::SaveArg<0>(&ack_request));
+  bool stopped = false;
+  follower_db->applyStreamItem(&stopped, folly::Try<laser::ReplicateResponse>(std::move(response)));
+  EXPECT_FALSE(stopped);
+  ASSERT_TRUE(ack_request.get_ack_seq_no() != nullptr);
+  EXPECT_EQ(request.seq_no + 1, *ack_request.get_ack_seq_no());
+
+  // leader 收到 replicateAck 之后等待的写入完成
+  EXPECT_FALSE(future.isReady());
+  leader_db->updateFollowerAck(ack_request);
+  EXPECT_TRUE(future.wait(std::chrono::seconds(1)).isReady());
+
+  // 没有半同步写入时 response 不需要确认
+  leader_db->setSyncReplicas(0);
+  writeBatchData(leader_db, "stream_no_ack", 1);
+  laser::ReplicateResponse no_ack_response;
+  leader_db->getUpdates(&no_ack_response, std::make_unique<laser::ReplicateRequest>(ack_request));
+  EXPECT_TRUE(no_ack_response.get_need_ack() == nullptr);
+  laser::FLAGS_replicator_sync_ack_timeout_ms = 100;
+}
+
+// 开启点查缓存后，leader 写入和 follower 同步都需要使缓存失效
+TEST_F(ReplicationDBTest, rowCacheInvalidation) {
+  auto leader_db = createDb(laser::DBRole::LEADER);
+  auto follower_db = createDb(laser::DBRole::FOLLOWER);
+  auto leader_cache = std::make_shared<laser::RowCache>(1024 * 1024, 2);
+  auto follower_cache = std::make_shared<laser::RowCache>(1024 * 1024, 2);
+  leader_db->setRowCache(leader_cache);
+  follower_db->setRowCache(follower_cache);
+
+  std::string data_prefix = "test";
+  uint32_t number = 10;
+  writeBatchData(leader_db, data_prefix, number);
+  EXPECT_LT(0, leader_cache->getUsage());
+  int64_t next_seq_no = 0;
+  replicateForward(&next_seq_no, leader_db, follower_db);
+  checkReadData(follower_db, data_prefix, number);
+  EXPECT_LT(0, follower_cache->getUsage());
+
+  laser::RocksDbBatch update_batch;
+  for (uint32_t i = 0; i < number; i++) {
+    laser::LaserValueRawString value(folly::to<std::string>("new", i));
+    update_batch.iput(createLaserKey(folly::to<std::string>(data_prefix, i)), value);
+  }
+  update_batch.idelete(createLaserKey(folly::to<std::string>(data_prefix, 0)));
+  EXPECT_EQ(laser::Status::OK, leader_db->write(update_batch));
+  replicateForward(&next_seq_no, leader_db, follower_db);
+  checkSeqNo(leader_db, follower_db);
+
+  for (auto& db : {leader_db, follower_db}) {
+    laser::LaserValueRawString deleted_value;
+    EXPECT_EQ(laser::Status::RS_NOT_FOUND, db->read(&deleted_value, createLaserKey("test0")));
+    for (uint32_t i = 1; i < number; i++) {
+      laser::LaserValueRawString value;
+      EXPECT_EQ(laser::Status::OK, db->read(&value, createLaserKey(folly::to<std::string>(data_prefix, i))));
+      value.decode();
+      EXPECT_EQ(folly::to<std::string>("new", i), value.getValue());
+    }
+  }
+
+  // 批量读取命中缓存和未命中缓存的 key 混合
+  std::vector<laser::LaserKeyFormat> keys;
+  for (uint32_t i = 0; i < number + 2; i++) {
+    keys.push_back(createLaserKey(folly::to<std::string>(data_prefix, i)));
+  }
+  std::vector<laser::LaserValueRawString> values(keys.size());
+  std::vector<laser::LaserValueFormatBase*> value_ptrs;
+  std::vector<const laser::LaserSerializer*> key_ptrs;
+  for (size_t i = 0; i < keys.size(); i++) {
+    value_ptrs.push_back(&values[i]);
+    key_ptrs.push_back(&keys[i]);
+  }
+  std::vector<laser::Status> statuses;
+  leader_db->multiRead(&statuses, value_ptrs, key_ptrs);
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, statuses[0]);
+  for (uint32_t i = 1; i < number; i++) {
+    EXPECT_EQ(laser::Status::OK, statuses[i]);
+    values[i].decode();
+    EXPECT_EQ(folly::to<std::string>("new", i), values[i].getValue());
+  }
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, statuses[number]);
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, statuses[number + 1]);
+
+  // 容量不足时按 CLOCK 淘汰，使用量不超过容量
+  laser::RowCache small_cache(1024, 0);
+  for (uint32_t i = 0; i < 100; i++) {
+    std::string key = folly::to<std::string>("key", i);
+    small_cache.insert(key, std::string(16, 'v'), small_cache.beginFill(key));
+  }
+  EXPECT_GE(1024, small_cache.getUsage());
+  std::string cached;
+  EXPECT_TRUE(small_cache.lookup(&cached, "key99"));
+  // 登记占位之后 key 有写入，插入被放弃
+  uint64_t token = small_cache.beginFill("key100");
+  small_cache.erase("key100");
+  small_cache.insert("key100", "value", token);
+  EXPECT_FALSE(small_cache.lookup(&cached, "key100"));
+  // 其他 key 的写入不影响填充
+  token = small_cache.beginFill("key101");
+  small_cache.erase("key102");
+  small_cache.insert("key101", "value", token);
+  EXPECT_TRUE(small_cache.lookup(&cached, "key101"));
+  // 占位被取消后不能再插入
+  token = small_cache.beginFill("key103");
+  small_cache.cancelFill("key103", token);
+  small_cache.insert("key103", "value", token);
+  EXPECT_FALSE(small_cache.lookup(&cached, "key103"));
+}
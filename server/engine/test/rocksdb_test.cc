@@ -16,9 +16,13 @@
  * @author ZhongXiu Hao <nmred.hao@gmail.com>
  */
 
+#include <set>
+
 #include "laser/server/engine/rocksdb.h"
+#include "laser/common/laser/key_prefix_extractor.h"
 
 #include "boost/filesystem.hpp"
+#include "gflags/gflags.h"
 
 #include "folly/Singleton.h"
 #include "folly/portability/GTest.h"
@@ -27,6 +31,9 @@
 namespace laser {
 
 DECLARE_bool(batch_ingest_format_is_sst);
+DECLARE_bool(rocksdb_engine_merge_write);
+DECLARE_int32(rocksdb_engine_ttl_index_bucket_ms);
+DECLARE_int32(rocksdb_engine_reclaim_rows_per_key);
 
 namespace test {
 
@@ -53,9 +60,9 @@ class RocksdbTest : public ::testing::Test {
     }
   }
 
-  bool opendb() {
+  bool opendb(std::shared_ptr<laser::RocksDbEngineOptions> engine_options = nullptr) {
     auto db = std::make_shared<laser::ReplicationDB>(path_, options_);
-    db_ = std::make_shared<laser::RocksDbEngine>(db);
+    db_ = std::make_shared<laser::RocksDbEngine>(db, engine_options);
     return db_->open();
   }
 
@@ -217,6 +224,51 @@ TEST_F(RocksdbTest, set) {
   EXPECT_EQ("111", value.getValue());
 }
 
+TEST_F(RocksdbTest, mget) {
+  EXPECT_TRUE(opendb());
+
+  std::string value_prefix = "xxxx";
+  std::vector<LaserKeyFormat> keys;
+  for (uint32_t i = 0; i < 100; i++) {
+    std::vector<std::string> primary_keys({"uid", folly::to<std::string>(i)});
+    std::vector<std::string> column_names({"age"});
+    keys.emplace_back(primary_keys, column_names);
+  }
+  // 逆序写入偶数 key, 奇数 key 不存在
+  for (int i = keys.size() - 1; i >= 0; i -= 2) {
+    laser::Status s = db_->set(keys[i - 1], folly::to<std::string>(value_prefix, i - 1));
+    EXPECT_EQ(laser::Status::OK, s);
+  }
+
+  std::vector<const LaserKeyFormat*> batch_keys;
+  for (auto& key : keys) {
+    batch_keys.push_back(&key);
+  }
+  std::vector<laser::Status> statuses;
+  std::vector<LaserValueRawString> values;
+  laser::Status s = db_->mget(&statuses, &values, batch_keys);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(keys.size(), statuses.size());
+  EXPECT_EQ(keys.size(), values.size());
+  for (uint32_t i = 0; i < keys.size(); i++) {
+    if (i % 2 == 0) {
+      EXPECT_EQ(laser::Status::OK, statuses[i]);
+      EXPECT_EQ(folly::to<std::string>(value_prefix, i), values[i].getValue());
+    } else {
+      EXPECT_EQ(laser::Status::RS_NOT_FOUND, statuses[i]);
+    }
+  }
+
+  // 类型不对
+  int64_t counter = 0;
+  s = db_->incr(&counter, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  s = db_->mget(&statuses, &values, {&key_, &keys[0]});
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(laser::Status::RS_INVALID_ARGUMENT, statuses[0]);
+  EXPECT_EQ(laser::Status::OK, statuses[1]);
+}
+
 TEST_F(RocksdbTest, incrAndDecr) {
   EXPECT_TRUE(opendb());
   std::vector<std::string> primary_keys({"uid", "xx"});
@@ -240,6 +292,142 @@ TEST_F(RocksdbTest, incrAndDecr) {
   EXPECT_EQ(-2000, value);
 }
 
+TEST_F(RocksdbTest, mergeCounter) {
+  gflags::FlagSaver saver;
+  FLAGS_rocksdb_engine_merge_write = true;
+  EXPECT_TRUE(opendb());
+
+  // 并发 incr 返回的值各不相同
+  std::vector<std::thread> threads;
+  std::vector<std::vector<int64_t>> results(8);
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([this, &results, i]() {
+      for (int j = 0; j < 1000; j++) {
+        int64_t value = 0;
+        EXPECT_EQ(laser::Status::OK, db_->incr(&value, key_));
+        results[i].push_back(value);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::set<int64_t> values;
+  for (auto& result : results) {
+    values.insert(result.begin(), result.end());
+  }
+  EXPECT_EQ(8000, values.size());
+  EXPECT_EQ(8000, *values.rbegin());
+
+  int64_t value = 0;
+  laser::Status s = db_->incr(&value, key_, 0);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(8000, value);
+
+  // 类型不一致时返回错误，不写入操作数
+  uint32_t length = 0;
+  s = db_->append(&length, key_, "data");
+  EXPECT_EQ(laser::Status::RS_INVALID_ARGUMENT, s);
+  s = db_->incr(&value, key_, 0);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(8000, value);
+
+  // 过期后从 0 开始计数
+  s = db_->expireAt(key_, static_cast<uint64_t>(common::currentTimeInMs()) - 1);
+  EXPECT_EQ(laser::Status::OK, s);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  s = db_->incr(&value, key_, 5);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(5, value);
+  int64_t ttl = 0;
+  s = db_->ttl(&ttl, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(-1, ttl);
+}
+
+TEST_F(RocksdbTest, mergeWrongType) {
+  gflags::FlagSaver saver;
+  FLAGS_rocksdb_engine_merge_write = true;
+  EXPECT_TRUE(opendb());
+
+  laser::Status s = db_->set(key_, "data");
+  EXPECT_EQ(laser::Status::OK, s);
+  int64_t value = 0;
+  s = db_->incr(&value, key_);
+  EXPECT_EQ(laser::Status::RS_INVALID_ARGUMENT, s);
+  s = db_->incr(nullptr, key_);
+  EXPECT_EQ(laser::Status::RS_INVALID_ARGUMENT, s);
+
+  uint32_t length = 0;
+  s = db_->append(&length, key_, "_append");
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(11, length);
+  LaserValueRawString raw_value;
+  s = db_->get(&raw_value, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ("data_append", raw_value.getValue());
+}
+
+TEST_F(RocksdbTest, blindMerge) {
+  gflags::FlagSaver saver;
+  FLAGS_rocksdb_engine_merge_write = true;
+  auto engine_options = std::make_shared<laser::RocksDbEngineOptions>();
+  engine_options->ttl = 0;
+  engine_options->blind_merge = true;
+  EXPECT_TRUE(opendb(engine_options));
+
+  // 不加锁并发写入，增量不会丢失
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([this]() {
+      for (int j = 0; j < 1000; j++) {
+        EXPECT_EQ(laser::Status::OK, db_->incr(nullptr, key_));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  int64_t value = 0;
+  laser::Status s = db_->incr(&value, key_, 2);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(8002, value);
+  s = db_->decr(&value, key_, 3);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(7999, value);
+
+  // 类型不一致的操作数被 merge operator 忽略，需要返回值时报错
+  uint32_t length = 0;
+  s = db_->append(&length, key_, "data");
+  EXPECT_EQ(laser::Status::RS_INVALID_ARGUMENT, s);
+  s = db_->incr(&value, key_, 0);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(7999, value);
+
+  std::vector<std::string> primary_keys({"uid", "blind"});
+  std::vector<std::string> column_names({"name"});
+  LaserKeyFormat string_key(primary_keys, column_names);
+  s = db_->append(&length, string_key, "data");
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(4, length);
+  s = db_->append(nullptr, string_key, "_append");
+  EXPECT_EQ(laser::Status::OK, s);
+  s = db_->incr(&value, string_key);
+  EXPECT_EQ(laser::Status::RS_INVALID_ARGUMENT, s);
+  LaserValueRawString raw_value;
+  s = db_->get(&raw_value, string_key);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ("data_append", raw_value.getValue());
+
+  // 过期后从 0 开始计数
+  s = db_->expireAt(key_, static_cast<uint64_t>(common::currentTimeInMs()) - 1);
+  EXPECT_EQ(laser::Status::OK, s);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  s = db_->incr(&value, key_, 5);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(5, value);
+}
+
 TEST_F(RocksdbTest, hset) {
   EXPECT_TRUE(opendb());
   std::string field = "test1";
@@ -403,6 +591,33 @@ TEST_F(RocksdbTest, hgetall) {
   }
 }
 
+TEST_F(RocksdbTest, hmget) {
+  EXPECT_TRUE(opendb());
+
+  std::vector<std::string> fields({"test10", "test99", "not_exists"});
+  std::unordered_map<std::string, LaserValueRawString> values;
+  laser::Status s = db_->hmget(&values, key_, fields);
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, s);
+
+  std::string field_prefix = "test";
+  std::string value_prefix = "xxxx";
+  for (int i = 0; i < 100; i++) {
+    s = db_->hset(key_, folly::to<std::string>(field_prefix, i), folly::to<std::string>(value_prefix, i));
+    EXPECT_EQ(laser::Status::OK, s);
+  }
+
+  s = db_->hmget(&values, key_, fields);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(2, values.size());
+  EXPECT_EQ("xxxx10", values["test10"].getValue());
+  EXPECT_EQ("xxxx99", values["test99"].getValue());
+
+  s = db_->hexists(key_, "test50");
+  EXPECT_EQ(laser::Status::OK, s);
+  s = db_->hexists(key_, "not_exists");
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, s);
+}
+
 TEST_F(RocksdbTest, pushFront) {
   EXPECT_TRUE(opendb());
 
@@ -581,6 +796,57 @@ TEST_F(RocksdbTest, lrange) {
   values.clear();
   status = db_->lrange(&values, key_, 100, 200);
   EXPECT_EQ(laser::Status::RS_INVALID_ARGUMENT, status);
+
+  values.clear();
+  status = db_->lrange(&values, key_, -10);
+  EXPECT_EQ(laser::Status::OK, status);
+  EXPECT_EQ(10, values.size());
+  for (int i = 90; i < 100; i++) {
+    EXPECT_EQ(folly::to<std::string>(value_prefix, i), values[i - 90].getValue());
+  }
+
+  values.clear();
+  status = db_->lrange(&values, key_, -10, -5);
+  EXPECT_EQ(laser::Status::OK, status);
+  EXPECT_EQ(5, values.size());
+  for (int i = 90; i < 95; i++) {
+    EXPECT_EQ(folly::to<std::string>(value_prefix, i), values[i - 90].getValue());
+  }
+
+  values.clear();
+  status = db_->lrange(&values, key_, -101);
+  EXPECT_EQ(laser::Status::RS_INVALID_ARGUMENT, status);
+}
+
+TEST_F(RocksdbTest, lrangeMixedIndex) {
+  EXPECT_TRUE(opendb());
+
+  // pushFront 产生负数 index，pushBack 产生非负 index
+  std::string value_prefix = "xxxx";
+  for (int i = 0; i < 50; i++) {
+    laser::Status status = db_->pushFront(key_, folly::to<std::string>(value_prefix, 49 - i));
+    EXPECT_EQ(laser::Status::OK, status);
+  }
+  for (int i = 50; i < 100; i++) {
+    laser::Status status = db_->pushBack(key_, folly::to<std::string>(value_prefix, i));
+    EXPECT_EQ(laser::Status::OK, status);
+  }
+
+  std::vector<LaserValueRawString> values;
+  laser::Status status = db_->lrange(&values, key_);
+  EXPECT_EQ(laser::Status::OK, status);
+  EXPECT_EQ(100, values.size());
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(folly::to<std::string>(value_prefix, i), values[i].getValue());
+  }
+
+  values.clear();
+  status = db_->lrange(&values, key_, -60, -40);
+  EXPECT_EQ(laser::Status::OK, status);
+  EXPECT_EQ(20, values.size());
+  for (int i = 40; i < 60; i++) {
+    EXPECT_EQ(folly::to<std::string>(value_prefix, i), values[i - 40].getValue());
+  }
 }
 
 TEST_F(RocksdbTest, sadd) {
@@ -707,6 +973,149 @@ TEST_F(RocksdbTest, zset) {
   EXPECT_EQ(laser::Status::RS_KEY_EXPIRE, s);
 }
 
+TEST_F(RocksdbTest, zsetMemberIndex) {
+  EXPECT_TRUE(opendb());
+
+  std::map<std::string, int64_t> member_scores({{"one", 1}, {"two", 2}, {"three", 3}, {"negative", -1}});
+  laser::Status s = db_->zadd(key_, member_scores);
+  EXPECT_EQ(laser::Status::OK, s);
+
+  LaserValueZSetMeta zset_meta;
+  s = db_->get(&zset_meta, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(4, zset_meta.getSize());
+
+  int64_t score = 0;
+  s = db_->zscore(&score, key_, "two");
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(2, score);
+  s = db_->zscore(&score, key_, "not_exists");
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, s);
+
+  // member 的 score 变化后，旧的 score 行中不再包含该 member
+  s = db_->zadd(key_, {{"two", 10}});
+  EXPECT_EQ(laser::Status::OK, s);
+  s = db_->zscore(&score, key_, "two");
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(10, score);
+  zset_meta.reset();
+  s = db_->get(&zset_meta, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(4, zset_meta.getSize());
+
+  std::vector<LaserScoreMember> members;
+  s = db_->zrangeByScore(&members, key_, 2, 2);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(0, members.size());
+
+  int64_t rank = 0;
+  s = db_->zrank(&rank, key_, "negative");
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(0, rank);
+  s = db_->zrank(&rank, key_, "two");
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(3, rank);
+
+  members.clear();
+  s = db_->zrange(&members, key_, 0, -1);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(4, members.size());
+  EXPECT_EQ("negative", members[0].get_member());
+  EXPECT_EQ("one", members[1].get_member());
+  EXPECT_EQ("three", members[2].get_member());
+  EXPECT_EQ("two", members[3].get_member());
+
+  members.clear();
+  s = db_->zrange(&members, key_, -2, -1);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(2, members.size());
+  EXPECT_EQ("three", members[0].get_member());
+  EXPECT_EQ("two", members[1].get_member());
+
+  s = db_->zrem(key_, "one");
+  EXPECT_EQ(laser::Status::OK, s);
+  s = db_->zscore(&score, key_, "one");
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, s);
+  s = db_->zrem(key_, "one");
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, s);
+  zset_meta.reset();
+  s = db_->get(&zset_meta, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(3, zset_meta.getSize());
+}
+
+// 没有 member 反查索引的历史 zset，第一次读写时迁移为新格式
+TEST_F(RocksdbTest, zsetLegacyFormat) {
+  EXPECT_TRUE(opendb());
+  // 历史格式的 meta size 为 score 行的个数，member a 同时出现在两个 score 行中
+  auto write_legacy_zset = [this](const LaserKeyFormat& key) {
+    RocksDbBatch batch;
+    batch.iput(key, LaserValueZSetMeta(3));
+    batch.iput(LaserKeyFormatZSetData(key, -1), LaserValueZSet(std::vector<std::string>({"d"})));
+    batch.iput(LaserKeyFormatZSetData(key, 1), LaserValueZSet(std::vector<std::string>({"a", "b"})));
+    batch.iput(LaserKeyFormatZSetData(key, 2), LaserValueZSet(std::vector<std::string>({"c", "a"})));
+    return db_->getReplicationDB().lock()->write(batch);
+  };
+
+  EXPECT_EQ(laser::Status::OK, write_legacy_zset(key_));
+  LaserValueZSetMeta zset_meta;
+  EXPECT_EQ(laser::Status::OK, db_->get(&zset_meta, key_));
+  EXPECT_EQ(4, zset_meta.getSize());
+  EXPECT_NE(0, zset_meta.getVersion());
+  int64_t score = 0;
+  EXPECT_EQ(laser::Status::OK, db_->zscore(&score, key_, "a"));
+  EXPECT_EQ(1, score);
+  EXPECT_EQ(laser::Status::OK, db_->zscore(&score, key_, "c"));
+  EXPECT_EQ(2, score);
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, db_->zscore(&score, key_, "not_exists"));
+  int64_t rank = 0;
+  EXPECT_EQ(laser::Status::OK, db_->zrank(&rank, key_, "c"));
+  EXPECT_EQ(3, rank);
+  std::vector<LaserScoreMember> members;
+  EXPECT_EQ(laser::Status::OK, db_->zrange(&members, key_, 0, -1));
+  EXPECT_EQ(4, members.size());
+  EXPECT_EQ("d", members[0].get_member());
+  EXPECT_EQ("a", members[1].get_member());
+  EXPECT_EQ("b", members[2].get_member());
+  EXPECT_EQ("c", members[3].get_member());
+
+  // 已有的 member 不会重复插入，score 变化的 member 从旧的 score 行中移除
+  EXPECT_EQ(laser::Status::OK, db_->zadd(key_, {{"a", 1}, {"b", 5}, {"e", 1}}));
+  zset_meta.reset();
+  EXPECT_EQ(laser::Status::OK, db_->get(&zset_meta, key_));
+  EXPECT_EQ(5, zset_meta.getSize());
+  EXPECT_EQ(laser::Status::OK, db_->zscore(&score, key_, "b"));
+  EXPECT_EQ(5, score);
+  members.clear();
+  EXPECT_EQ(laser::Status::OK, db_->zrangeByScore(&members, key_, 1, 2));
+  EXPECT_EQ(3, members.size());
+  EXPECT_EQ("a", members[0].get_member());
+  EXPECT_EQ("e", members[1].get_member());
+  EXPECT_EQ("c", members[2].get_member());
+
+  LaserKeyFormat rem_key({"uid", "legacy_rem"}, {"age"});
+  EXPECT_EQ(laser::Status::OK, write_legacy_zset(rem_key));
+  EXPECT_EQ(laser::Status::OK, db_->zrem(rem_key, "a"));
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, db_->zscore(&score, rem_key, "a"));
+  zset_meta.reset();
+  EXPECT_EQ(laser::Status::OK, db_->get(&zset_meta, rem_key));
+  EXPECT_EQ(3, zset_meta.getSize());
+
+  LaserKeyFormat rem_range_key({"uid", "legacy_rem_range"}, {"age"});
+  EXPECT_EQ(laser::Status::OK, write_legacy_zset(rem_range_key));
+  int64_t number = 0;
+  EXPECT_EQ(laser::Status::OK, db_->zremRangeByScore(&number, rem_range_key, 1, 1));
+  EXPECT_EQ(1, number);
+  zset_meta.reset();
+  EXPECT_EQ(laser::Status::OK, db_->get(&zset_meta, rem_range_key));
+  EXPECT_EQ(2, zset_meta.getSize());
+  members.clear();
+  EXPECT_EQ(laser::Status::OK, db_->zrange(&members, rem_range_key, 0, -1));
+  EXPECT_EQ(2, members.size());
+  EXPECT_EQ("d", members[0].get_member());
+  EXPECT_EQ("c", members[1].get_member());
+}
+
 TEST_F(RocksdbTest, type_error) {
   EXPECT_TRUE(opendb());
   std::vector<std::string> primary_keys({"uid", "xx"});
@@ -746,6 +1155,140 @@ TEST_F(RocksdbTest, delkey) {
   EXPECT_EQ(laser::Status::RS_NOT_FOUND, status);
 }
 
+TEST_F(RocksdbTest, versionedMeta) {
+  EXPECT_TRUE(opendb());
+
+  for (int i = 0; i < 10; i++) {
+    laser::Status s = db_->hset(key_, folly::to<std::string>("old", i), "xxxx");
+    EXPECT_EQ(laser::Status::OK, s);
+  }
+  LaserValueMapMeta map_meta;
+  laser::Status s = db_->get(&map_meta, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  uint64_t version = map_meta.getVersion();
+  EXPECT_NE(0, version);
+
+  // 设置未来的过期时间不影响 data 行
+  s = db_->expireAt(key_, 30000 + static_cast<uint64_t>(common::currentTimeInMs()));
+  EXPECT_EQ(laser::Status::OK, s);
+  std::unordered_map<std::string, LaserValueRawString> values;
+  s = db_->hgetall(&values, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(10, values.size());
+
+  // 过期后重新写入，旧版本的 field 不可见
+  s = db_->expireAt(key_, static_cast<uint64_t>(common::currentTimeInMs()) - 1);
+  EXPECT_EQ(laser::Status::OK, s);
+  s = db_->hset(key_, "new", "yyyy");
+  EXPECT_EQ(laser::Status::OK, s);
+  s = db_->get(&map_meta, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(1, map_meta.getSize());
+  EXPECT_LT(version, map_meta.getVersion());
+
+  values.clear();
+  s = db_->hgetall(&values, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(1, values.size());
+  EXPECT_EQ("yyyy", values["new"].getValue());
+  s = db_->hexists(key_, "old0");
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, s);
+
+  // 删除后重新写入
+  s = db_->delkey(key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  s = db_->hset(key_, "again", "zzzz");
+  EXPECT_EQ(laser::Status::OK, s);
+  std::vector<LaserKeyFormatMapData> keys;
+  s = db_->hkeys(&keys, key_);
+  EXPECT_EQ(laser::Status::OK, s);
+  EXPECT_EQ(1, keys.size());
+  EXPECT_EQ("again", keys[0].getField());
+}
+
+// 旧版本的 data 行由 TTL 清理按回收索引分批删除，compaction 不会删除带版本号的过期 meta
+TEST_F(RocksdbTest, reclaimStaleDataRows) {
+  gflags::FlagSaver saver;
+  laser::FLAGS_rocksdb_engine_ttl_index_bucket_ms = 1;
+  laser::FLAGS_rocksdb_engine_reclaim_rows_per_key = 4;
+  auto replication_db = std::make_shared<laser::ReplicationDB>(path_, options_);
+  auto db = std::make_shared<laser::RocksDbEngine>(replication_db);
+  EXPECT_TRUE(db->open());
+  auto count_data_rows = [replication_db]() {
+    uint32_t rows = 0;
+    replication_db->iterator([&rows](rocksdb::Iterator* iter) {
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        if (static_cast<uint8_t>(iter->key()[0]) == static_cast<uint8_t>(KeyType::COMPOSITE)) {
+          rows++;
+        }
+      }
+    });
+    return rows;
+  };
+  auto sweep = [db]() {
+    for (int i = 0; i < 5; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      uint32_t deleted = 0;
+      uint32_t backlog = 0;
+      EXPECT_EQ(laser::Status::OK, db->sweepExpiredKeys(&deleted, &backlog, 100));
+    }
+  };
+
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(laser::Status::OK, db->hset(key_, folly::to<std::string>("old", i), "xxxx"));
+  }
+  // 没有回收索引的 data 行不会被删除
+  std::vector<std::string> orphan_pk({"uid", "orphan"});
+  std::vector<std::string> column_names({"age"});
+  LaserKeyFormat orphan_key(orphan_pk, column_names);
+  RocksDbBatch batch;
+  batch.iput(LaserKeyFormatMapData(orphan_key, "field"), LaserValueRawString("yyyy"));
+  EXPECT_EQ(laser::Status::OK, replication_db->write(batch));
+
+  // 过期的 meta 在 compaction 后仍然保留版本号，重新写入时旧版本的 data 行分多轮回收
+  EXPECT_EQ(laser::Status::OK, db->expireAt(key_, static_cast<uint64_t>(common::currentTimeInMs()) - 1));
+  EXPECT_EQ(laser::Status::OK, replication_db->compactRange());
+  LaserValueMapMeta map_meta;
+  EXPECT_EQ(laser::Status::OK, replication_db->read(&map_meta, key_));
+  EXPECT_EQ(laser::Status::OK, db->hset(key_, "new", "zzzz"));
+  sweep();
+  EXPECT_EQ(2, count_data_rows());
+
+  std::unordered_map<std::string, LaserValueRawString> values;
+  EXPECT_EQ(laser::Status::OK, db->hgetall(&values, key_));
+  EXPECT_EQ(1, values.size());
+  EXPECT_EQ("zzzz", values["new"].getValue());
+
+  // delkey 只删除 meta，data 行同样由回收索引删除
+  EXPECT_EQ(laser::Status::OK, db->delkey(key_));
+  sweep();
+  EXPECT_EQ(1, count_data_rows());
+}
+
+// 删除后重新创建的 key 版本号大于已删除的版本号，不依赖本机时钟，模拟切换到时钟落后的节点
+TEST_F(RocksdbTest, deadVersionAfterDelete) {
+  EXPECT_TRUE(opendb());
+  uint64_t future_version = static_cast<uint64_t>(common::currentTimeInNs() / 1000) + 3600000000;
+  LaserValueMapMeta old_meta(1);
+  old_meta.setVersion(future_version);
+  old_meta.encode();
+  LaserValueRawString old_field(std::string("xxxx"));
+  old_field.setVersion(future_version);
+  old_field.encode();
+  RocksDbBatch batch;
+  batch.iput(key_, old_meta);
+  batch.iput(LaserKeyFormatMapData(key_, "old"), old_field);
+  EXPECT_EQ(laser::Status::OK, db_->getReplicationDB().lock()->write(batch));
+
+  EXPECT_EQ(laser::Status::OK, db_->delkey(key_));
+  EXPECT_EQ(laser::Status::OK, db_->hset(key_, "new", "yyyy"));
+  LaserValueMapMeta map_meta;
+  EXPECT_EQ(laser::Status::OK, db_->hlen(&map_meta, key_));
+  EXPECT_LT(future_version, map_meta.getVersion());
+  EXPECT_EQ(1, map_meta.getSize());
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, db_->hexists(key_, "old"));
+}
+
 TEST_F(RocksdbTest, ingestDeltaData) {
   EXPECT_TRUE(opendb());
 
@@ -831,6 +1374,144 @@ TEST_F(RocksdbTest, expire) {
   }
 }
 
+TEST_F(RocksdbTest, sweepExpiredKeys) {
+  gflags::FlagSaver saver;
+  laser::FLAGS_rocksdb_engine_ttl_index_bucket_ms = 1;
+  EXPECT_TRUE(opendb());
+
+  std::vector<std::string> pk({"uid", "0"});
+  std::vector<std::string> column_names({"age"});
+  laser::RocksDbEngineSetOptions options;
+  options.ttl = 1;
+  for (uint32_t key_index = 0; key_index < 10; key_index++) {
+    pk[1] = folly::to<std::string>("string", key_index);
+    laser::Status status = db_->setx(LaserKeyFormat(pk, column_names), "xxxx", options);
+    EXPECT_EQ(laser::Status::OK, status);
+  }
+
+  // 覆盖写入后旧的索引失效
+  pk[1] = "rewrite";
+  LaserKeyFormat rewrite_key(pk, column_names);
+  EXPECT_EQ(laser::Status::OK, db_->setx(rewrite_key, "xxxx", options));
+  EXPECT_EQ(laser::Status::OK, db_->set(rewrite_key, "yyyy"));
+
+  EXPECT_EQ(laser::Status::OK, db_->hset(key_, "field", "xxxx"));
+  EXPECT_EQ(laser::Status::OK, db_->expireAt(key_, static_cast<uint64_t>(common::currentTimeInMs()) - 1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  uint32_t deleted = 0;
+  uint32_t backlog = 0;
+  laser::Status status = db_->sweepExpiredKeys(&deleted, &backlog, 4);
+  EXPECT_EQ(laser::Status::OK, status);
+  EXPECT_EQ(8, backlog);
+  uint32_t total_deleted = deleted;
+
+  status = db_->sweepExpiredKeys(&deleted, &backlog, 100);
+  EXPECT_EQ(laser::Status::OK, status);
+  EXPECT_EQ(0, backlog);
+  total_deleted += deleted;
+  EXPECT_EQ(11, total_deleted);
+
+  for (uint32_t key_index = 0; key_index < 10; key_index++) {
+    pk[1] = folly::to<std::string>("string", key_index);
+    LaserValueRawString data;
+    status = db_->get(&data, LaserKeyFormat(pk, column_names));
+    EXPECT_EQ(laser::Status::RS_NOT_FOUND, status);
+  }
+  LaserValueRawString data;
+  status = db_->get(&data, rewrite_key);
+  EXPECT_EQ(laser::Status::OK, status);
+  EXPECT_EQ("yyyy", data.getValue());
+
+  LaserValueMapMeta map_meta;
+  status = db_->hlen(&map_meta, key_);
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, status);
+}
+
+// 过期时间在同一个索引时间桶内时不重复写索引，清理从上一轮的位置继续，之后写入的已过期 key 仍然会被清理
+TEST_F(RocksdbTest, ttlIndexBucketAndSweepStart) {
+  gflags::FlagSaver saver;
+  laser::FLAGS_rocksdb_engine_ttl_index_bucket_ms = 1000;
+  EXPECT_TRUE(opendb());
+  auto count_ttl_index = [this]() {
+    uint32_t count = 0;
+    LaserKeyFormatTypePrefix prefix(KeyType::TTL_SORT);
+    db_->getReplicationDB().lock()->iterator([&prefix, &count](auto iter) {
+      rocksdb::Slice slice_prefix(prefix.data(), prefix.length());
+      for (iter->Seek(slice_prefix); iter->Valid() && iter->key().starts_with(slice_prefix); iter->Next()) {
+        count++;
+      }
+    });
+    return count;
+  };
+
+  uint64_t expire_time = (static_cast<uint64_t>(common::currentTimeInMs()) / 1000 + 100) * 1000 + 1;
+  EXPECT_EQ(laser::Status::OK, db_->set(key_, "xxxx"));
+  EXPECT_EQ(laser::Status::OK, db_->expireAt(key_, expire_time));
+  EXPECT_EQ(laser::Status::OK, db_->expireAt(key_, expire_time + 10));
+  EXPECT_EQ(laser::Status::OK, db_->incr(nullptr, LaserKeyFormat({"uid", "counter"}, {"age"}), 1));
+  EXPECT_EQ(1, count_ttl_index());
+  EXPECT_EQ(laser::Status::OK, db_->expireAt(key_, expire_time + 1000));
+  EXPECT_EQ(2, count_ttl_index());
+
+  laser::FLAGS_rocksdb_engine_ttl_index_bucket_ms = 1;
+  uint32_t deleted = 0;
+  uint32_t backlog = 0;
+  EXPECT_EQ(laser::Status::OK, db_->sweepExpiredKeys(&deleted, &backlog, 100));
+  EXPECT_EQ(0, deleted);
+  EXPECT_EQ(laser::Status::OK, db_->expireAt(key_, static_cast<uint64_t>(common::currentTimeInMs()) - 1000));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(laser::Status::OK, db_->sweepExpiredKeys(&deleted, &backlog, 100));
+  EXPECT_EQ(1, deleted);
+  LaserValueRawString data;
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, db_->get(&data, key_));
+}
+
+// 开启前缀提取器后，复合类型的 seek 只遍历自身的前缀，按类型前缀的全序扫描不受影响
+TEST_F(RocksdbTest, prefixExtractor) {
+  options_.prefix_extractor = std::make_shared<laser::LaserKeyPrefixExtractor>();
+  options_.memtable_prefix_bloom_size_ratio = 0.1;
+  rocksdb::BlockBasedTableOptions table_options;
+  table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, false));
+  options_.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_options));
+  EXPECT_TRUE(opendb());
+
+  std::vector<std::string> pk({"uid", "0"});
+  std::vector<std::string> column_names({"age"});
+  for (uint32_t key_index = 0; key_index < 10; key_index++) {
+    pk[1] = folly::to<std::string>(key_index);
+    std::map<std::string, std::string> data;
+    for (uint32_t field_index = 0; field_index <= key_index; field_index++) {
+      data[folly::to<std::string>("field", field_index)] = folly::to<std::string>(key_index);
+    }
+    EXPECT_EQ(laser::Status::OK, db_->hmset(LaserKeyFormat(pk, column_names), data));
+    EXPECT_EQ(laser::Status::OK, db_->zadd(LaserKeyFormat(pk, {"zset"}), {{"member", key_index}}));
+  }
+
+  for (uint32_t key_index = 0; key_index < 10; key_index++) {
+    pk[1] = folly::to<std::string>(key_index);
+    std::unordered_map<std::string, LaserValueRawString> values;
+    EXPECT_EQ(laser::Status::OK, db_->hgetall(&values, LaserKeyFormat(pk, column_names)));
+    EXPECT_EQ(key_index + 1, values.size());
+    std::vector<laser::LaserScoreMember> members;
+    EXPECT_EQ(laser::Status::OK, db_->zrangeByScore(&members, LaserKeyFormat(pk, {"zset"}), -100, 100));
+    EXPECT_EQ(1, members.size());
+  }
+
+  pk[1] = "not_exists";
+  std::unordered_map<std::string, LaserValueRawString> values;
+  EXPECT_EQ(laser::Status::RS_NOT_FOUND, db_->hgetall(&values, LaserKeyFormat(pk, column_names)));
+
+  pk[1] = "0";
+  EXPECT_EQ(laser::Status::OK,
+            db_->expireAt(LaserKeyFormat(pk, column_names), static_cast<uint64_t>(common::currentTimeInMs()) - 1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  uint32_t deleted = 0;
+  uint32_t backlog = 0;
+  EXPECT_EQ(laser::Status::OK, db_->sweepExpiredKeys(&deleted, &backlog, 100));
+  EXPECT_EQ(1, deleted);
+}
+
 TEST_F(RocksdbTest, deleteExpireKeysAndAutoExpire) {
   std::string test_path = folly::to<std::string>(path_, "/", folly::Random::secureRand32());
   auto replication_db = std::make_shared<laser::ReplicationDB>(test_path, options_);
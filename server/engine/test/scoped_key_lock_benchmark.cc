@@ -0,0 +1,94 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#include <thread> // NOLINT
+
+#include "folly/Benchmark.h"
+#include "folly/Conv.h"
+#include "folly/Singleton.h"
+#include "folly/init/Init.h"
+#include "gflags/gflags.h"
+#include "laser/server/engine/scoped_key_lock.h"
+
+DEFINE_int32(benchmark_threads, 16, "Benchmark thread number");
+
+// 多个线程对 key_number 个 key 加锁，key_number 越小竞争越激烈
+void runKeyLock(uint32_t iters, uint32_t key_number) {
+  std::vector<std::string> keys;
+  folly::BenchmarkSuspender suspender;
+  for (uint32_t i = 0; i < key_number; i++) {
+    keys.push_back(folly::to<std::string>("benchmark_key", i));
+  }
+  std::vector<uint64_t> counters(key_number, 0);
+  std::vector<std::thread> threads;
+  suspender.dismiss();
+
+  for (int i = 0; i < FLAGS_benchmark_threads; i++) {
+    threads.emplace_back([&keys, &counters, iters, key_number, i]() {
+      for (uint32_t j = 0; j < iters; j++) {
+        uint32_t index = (i + j) % key_number;
+        laser::ScopedKeyLock lock(keys[index]);
+        counters[index]++;
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void runMultiKeyLock(uint32_t iters, uint32_t batch_size) {
+  std::vector<std::vector<uint64_t>> batches;
+  folly::BenchmarkSuspender suspender;
+  for (int i = 0; i < FLAGS_benchmark_threads; i++) {
+    std::vector<uint64_t> key_hashes;
+    for (uint32_t j = 0; j < batch_size; j++) {
+      // 每个线程使用不同的 key 顺序
+      std::string key = folly::to<std::string>("benchmark_key", (i + j) % batch_size);
+      key_hashes.push_back(laser::LockManager::hash(key.data(), key.size()));
+    }
+    batches.push_back(std::move(key_hashes));
+  }
+  std::vector<std::thread> threads;
+  suspender.dismiss();
+
+  for (int i = 0; i < FLAGS_benchmark_threads; i++) {
+    threads.emplace_back([&batches, iters, i]() {
+      for (uint32_t j = 0; j < iters; j++) {
+        laser::ScopedMultiKeyLock lock(batches[i]);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+BENCHMARK_PARAM(runKeyLock, 1);
+BENCHMARK_PARAM(runKeyLock, 16);
+BENCHMARK_PARAM(runKeyLock, 1024);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(runMultiKeyLock, 4);
+BENCHMARK_PARAM(runMultiKeyLock, 32);
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::SingletonVault::singleton()->registrationComplete();
+  folly::runBenchmarks();
+  return 0;
+}
@@ -16,6 +16,7 @@
  * @author ZhongXiu Hao <nmred.hao@gmail.com>
  */
 
+#include <algorithm>
 #include <thread> // NOLINT
 
 #include "gtest/gtest.h"
@@ -102,3 +103,44 @@ TEST(ScopedKeyLock, multiKeyLock) {
   }
   EXPECT_EQ(160000, sum);
 }
+
+TEST(ScopedKeyLock, sortedMultiKeyLock) {
+  std::vector<std::unique_ptr<std::thread>> cal_threads;
+
+  folly::SingletonVault::singleton()->registrationComplete();
+
+  std::vector<std::string> keys({"test0", "test1", "test2", "test3"});
+  std::unordered_map<std::string, int> count;
+  for (auto& key : keys) {
+    count[key] = 0;
+  }
+
+  for (int i = 0; i < 16; i++) {
+    cal_threads.push_back(std::make_unique<std::thread>([&count, &keys, i]() {
+      // 不同线程使用不同的加锁顺序，并且包含重复的 key
+      std::vector<std::string> lock_keys(keys);
+      std::rotate(lock_keys.begin(), lock_keys.begin() + i % lock_keys.size(), lock_keys.end());
+      lock_keys.push_back(lock_keys.front());
+      std::vector<uint64_t> key_hashes;
+      for (auto& key : lock_keys) {
+        key_hashes.push_back(laser::LockManager::hash(key.data(), key.size()));
+      }
+
+      for (int j = 0; j < 10000; j++) {
+        laser::ScopedMultiKeyLock lock(key_hashes);
+        for (auto& key : keys) {
+          int val = count[key];
+          val++;
+          count[key] = val;
+        }
+      }
+    }));
+  }
+
+  for (auto& t : cal_threads) {
+    t->join();
+  }
+  for (auto& key : keys) {
+    EXPECT_EQ(160000, count[key]);
+  }
+}
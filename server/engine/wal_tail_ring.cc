@@ -0,0 +1,98 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+
+#include <algorithm>
+
+#include "wal_tail_ring.h"
+
+namespace laser {
+
+WalTailRing::WalTailRing(size_t max_batches, size_t max_bytes) : max_batches_(max_batches), max_bytes_(max_bytes) {
+  auto metrics = metrics::Metrics::getInstance();
+  hit_meter_ = metrics->buildMeter(LASER_WAL_TAIL_RING_MODULE_NAME, LASER_WAL_TAIL_RING_HIT);
+  miss_meter_ = metrics->buildMeter(LASER_WAL_TAIL_RING_MODULE_NAME, LASER_WAL_TAIL_RING_MISS);
+}
+
+void WalTailRing::append(uint64_t sequence, uint32_t count, int64_t timestamp, const std::string& data) {
+  if (data.size() > max_bytes_) {
+    return;
+  }
+  // 拷贝在锁外完成
+  WalTailEntry entry{sequence, count, timestamp, folly::IOBuf(folly::IOBuf::COPY_BUFFER, data.data(), data.size())};
+
+  folly::SharedMutex::WriteHolder guard(mutex_);
+  // 并发写入时完成的顺序与 sequence 的顺序可能不同，从尾部向前找到插入位置
+  auto pos = entries_.end();
+  while (pos != entries_.begin() && std::prev(pos)->sequence > sequence) {
+    pos--;
+  }
+  if (pos != entries_.begin() && std::prev(pos)->sequence == sequence) {
+    return;
+  }
+  if (pos == entries_.begin() && !entries_.empty() && entries_.size() >= max_batches_) {
+    return;
+  }
+  entries_.insert(pos, std::move(entry));
+  bytes_ += data.size();
+  while (entries_.size() > max_batches_ || bytes_ > max_bytes_) {
+    bytes_ -= entries_.front().data.length();
+    entries_.pop_front();
+  }
+}
+
+bool WalTailRing::read(std::vector<WalTailEntry>* entries, uint64_t sequence, uint64_t max_size) {
+  folly::SharedMutex::ReadHolder guard(mutex_);
+  auto found = std::upper_bound(entries_.begin(), entries_.end(), sequence,
+                                [](uint64_t seq, const WalTailEntry& entry) { return seq < entry.sequence; });
+  if (found == entries_.begin()) {
+    miss_meter_->mark();
+    return false;
+  }
+  found--;
+  uint64_t next_sequence = found->sequence + found->count;
+  if (sequence >= next_sequence) {
+    // 已经同步到环中最新的数据，不需要再读取 WAL
+    if (std::next(found) == entries_.end() && sequence == next_sequence) {
+      hit_meter_->mark();
+      return true;
+    }
+    miss_meter_->mark();
+    return false;
+  }
+
+  uint64_t size = 0;
+  for (auto iter = found; iter != entries_.end() && size < max_size; iter++) {
+    if (iter != found && iter->sequence != next_sequence) {
+      break;
+    }
+    entries->push_back(WalTailEntry{iter->sequence, iter->count, iter->timestamp, iter->data.cloneAsValue()});
+    size += iter->data.length();
+    next_sequence = iter->sequence + iter->count;
+  }
+  hit_meter_->mark();
+  return true;
+}
+
+void WalTailRing::clear() {
+  folly::SharedMutex::WriteHolder guard(mutex_);
+  entries_.clear();
+  bytes_ = 0;
+}
+
+}  // namespace laser
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "folly/SharedMutex.h"
+#include "folly/io/IOBuf.h"
+
+#include "common/metrics/metrics.h"
+
+namespace laser {
+
+inline constexpr char LASER_WAL_TAIL_RING_MODULE_NAME[] = "wal_tail_ring";
+inline constexpr char LASER_WAL_TAIL_RING_HIT[] = "hit";
+inline constexpr char LASER_WAL_TAIL_RING_MISS[] = "miss";
+
+struct WalTailEntry {
+  uint64_t sequence;
+  uint32_t count;
+  int64_t timestamp;
+  folly::IOBuf data;
+};
+
+// leader 在内存中保留最近写入的 WriteBatch，按 sequence 排序，
+// 多个 follower 同步最近的数据时直接共享同一份 IOBuf，不需要各自读取并解析 WAL
+class WalTailRing {
+ public:
+  WalTailRing(size_t max_batches, size_t max_bytes);
+  ~WalTailRing() = default;
+
+  void append(uint64_t sequence, uint32_t count, int64_t timestamp, const std::string& data);
+  // 从包含 sequence 的 batch 开始读取 sequence 连续的 batch，第一个 batch 可能从 sequence 之前开始，
+  // sequence 不在环中时返回 false，需要从 WAL 中读取
+  bool read(std::vector<WalTailEntry>* entries, uint64_t sequence, uint64_t max_size);
+  void clear();
+
+ private:
+  size_t max_batches_;
+  size_t max_bytes_;
+  folly::SharedMutex mutex_;
+  std::deque<WalTailEntry> entries_;
+  size_t bytes_{0};
+  std::shared_ptr<metrics::Meter> hit_meter_;
+  std::shared_ptr<metrics::Meter> miss_meter_;
+};
+
+}  // namespace laser
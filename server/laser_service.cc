@@ -19,135 +19,170 @@
  */
 
 #include <list>
+#include "folly/ScopeGuard.h"
 #include "common/laser/status.h"
 
 #include "laser_service.h"
 
 namespace laser {
 
+DEFINE_int32(laser_service_point_threads, 16,
+             "The number of threads running point requests, 0 means running in thrift worker threads");
+DEFINE_int32(laser_service_scan_threads, 4,
+             "The number of threads running scan and batch requests, 0 means running in thrift worker threads");
+DEFINE_int32(laser_service_point_max_queue_size, 0, "Max pending point requests, 0 means unlimited");
+DEFINE_int32(laser_service_scan_max_queue_size, 1024,
+             "Max pending scan and batch requests, requests beyond it fail with RS_BUSY, 0 means unlimited");
+DEFINE_int32(laser_service_fanout_threads, 8,
+             "The number of threads running the partition groups of a batch request, 0 means running them serially");
+DEFINE_int32(laser_service_fanout_max_queue_size, 1024,
+             "Max pending partition groups, groups beyond it run in the request thread");
+DEFINE_int32(laser_service_fanout_min_keys, 64, "Batch requests with fewer keys run the partition groups serially");
+
 constexpr char SERVICE_NAME[] = "laser_service";
+constexpr char POINT_EXECUTOR_NAME[] = "LaserPointPool";
+constexpr char SCAN_EXECUTOR_NAME[] = "LaserScanPool";
+constexpr char FANOUT_EXECUTOR_NAME[] = "LaserFanoutPool";
 constexpr char TIME_CONSUMING[] = "metric_rpc_times";
+constexpr char TRAFFIC_THROTTLED[] = "traffic_throttled";
 constexpr int TIMER_BUCKET_SCALE = 1;
 constexpr int TIMER_MIN = 0;
 constexpr int TIMER_MAX = 1000;
 
+// 当前线程正在执行的请求的 client id，由 runRequest 设置
+thread_local std::string current_client_id;
+
+// 令牌桶只按 string 类型的 value 计算写入字节数
+static uint64_t getValueBytes(const LaserValue& value) {
+  if (value.getType() != LaserValue::Type::string_value) {
+    return 0;
+  }
+  return value.get_string_value().size();
+}
+
 LaserService::LaserService(std::shared_ptr<ConfigManager> config_manager,
                            std::shared_ptr<DatabaseManager> database_manager)
     : config_manager_(config_manager),
       database_manager_(database_manager),
       traffic_restriction_config_(std::make_shared<TableTrafficRestrictionMap>()),
-      second_traffic_restriction_config_(nullptr) {
+      traffic_limiters_(std::make_shared<TableTrafficLimiterMap>()) {
   folly::SingletonVault::singleton()->registrationComplete();
   auto metrics = metrics::Metrics::getInstance();
   laser_service_timers_ = metrics->buildTimers(SERVICE_NAME, TIME_CONSUMING, TIMER_BUCKET_SCALE, TIMER_MIN, TIMER_MAX);
+  throttled_meter_ = metrics->buildMeter(SERVICE_NAME, TRAFFIC_THROTTLED);
+  point_executor_ = std::make_shared<ServiceExecutor>(POINT_EXECUTOR_NAME, FLAGS_laser_service_point_threads,
+                                                      FLAGS_laser_service_point_max_queue_size);
+  scan_executor_ = std::make_shared<ServiceExecutor>(SCAN_EXECUTOR_NAME, FLAGS_laser_service_scan_threads,
+                                                     FLAGS_laser_service_scan_max_queue_size);
+  fanout_executor_ = std::make_shared<ServiceExecutor>(FANOUT_EXECUTOR_NAME, FLAGS_laser_service_fanout_threads,
+                                                       FLAGS_laser_service_fanout_max_queue_size);
   config_manager_->subscribeTrafficRestrictionConfig(
       std::bind(&LaserService::updateTrafficRestrictionConfig, this, std::placeholders::_1));
   auto got_config = config_manager_->getTrafficRestrictionConfig();
   if (got_config != nullptr) {
-    second_traffic_restriction_config_ = traffic_restriction_config_;
-    traffic_restriction_config_ = got_config;
+    updateTrafficRestrictionConfig(*got_config);
   }
 }
 
-void LaserService::getDatabaseEngine(std::shared_ptr<RocksDbEngine>* db, const std::unique_ptr<LaserKey>& key,
-                                     std::shared_ptr<LaserKeyFormat> format_key) {
-  const std::string& database_name = key->get_database_name();
-  const std::string& table_name = key->get_table_name();
-  auto partition_id = PartitionManager::getPartitionId(config_manager_, database_name, table_name, *format_key);
-  if (!partition_id) {
+void LaserService::getDatabaseEngine(std::shared_ptr<RocksDbEngine>* db, const LaserKey& key,
+                                     const LaserKeyFormat& format_key) {
+  const std::string& database_name = key.get_database_name();
+  const std::string& table_name = key.get_table_name();
+  auto table_routes = database_manager_->getTableRoutes();
+  auto route = table_routes->find(config_manager_->getTableSchemaHash(database_name, table_name));
+  if (route == table_routes->end()) {
     throwLaserException(Status::SERVICE_NOT_EXISTS_PARTITION, "get partition id fail");
   }
 
-  auto partition = std::make_shared<Partition>(database_name, table_name, partition_id.value());
-  auto db_engine = database_manager_->getDatabaseHandler(partition);
-  if (!db_engine) {
+  uint32_t partition_id =
+      PartitionManager::getPartitionId(database_name, table_name, format_key, route->second.partition_number);
+  auto& handler = route->second.handlers[partition_id];
+  if (!handler) {
     throwLaserException(Status::SERVICE_NOT_EXISTS_PARTITION,
-                        folly::to<std::string>("get partition db engine fail, partition:", partition->describe()));
+                        folly::to<std::string>("get partition db engine fail, partition:", database_name, ".",
+                                               table_name, ".", partition_id));
   }
 
-  auto engine = db_engine.value().lock();
+  auto engine = handler->getDatabase().lock();
   if (!engine) {
     throwLaserException(Status::SERVICE_NOT_EXISTS_PARTITION,
                         folly::to<std::string>("get partition db engine fail, engine object has free, partition:",
-                                               partition->describe()));
+                                               handler->getPartition()->describe()));
   }
 
   *db = engine;
 }
 
-std::shared_ptr<LaserKeyFormat> LaserService::getFormatKey(const std::unique_ptr<LaserKey>& key) {
-  const std::vector<std::string>& primary_keys = key->get_primary_keys();
-  const std::vector<std::string>& column_keys = key->get_column_keys();
-  return std::make_shared<LaserKeyFormat>(primary_keys, column_keys);
-}
-
 void LaserService::commonCallEngine(std::unique_ptr<LaserKey> key, LaserServiceCallbackFunc func,
-                                    const std::string& command_name) {
+                                    const std::string& command_name, uint64_t value_bytes) {
   metrics::Timer metric_time(laser_service_timers_.get());
   auto table_hash = config_manager_->getTableSchemaHash(key->get_database_name(), key->get_table_name());
-  auto table_restriction = traffic_restriction_config_->find(table_hash);
-  if (table_restriction != traffic_restriction_config_->end()) {
-    if (table_restriction->second->getDenyAll()) {
-      throwLaserException(Status::RS_OPERATION_DENIED, "request is denied in commonCallEngine,");
-    }
-    auto command_restriction = table_restriction->second->getSingleOperationLimits().find(command_name);
-    if (command_restriction != table_restriction->second->getSingleOperationLimits().end()) {
-      uint32_t random_value = folly::Random::rand32(1, 101);
-      if (random_value > command_restriction->second) {
-        throwLaserException(Status::RS_TRAFFIC_RESTRICTION, "request is denied in commonCallEngine,");
-      }
-    } else {
-      throwLaserException(Status::RS_OPERATION_DENIED, "request is denied in commonCallEngine,");
-    }
+  auto traffic_restriction_config = traffic_restriction_config_.load();
+  auto table_restriction = traffic_restriction_config->find(table_hash);
+  if (table_restriction != traffic_restriction_config->end() && table_restriction->second->getDenyAll()) {
+    throwLaserException(Status::RS_OPERATION_DENIED, "request is denied in commonCallEngine,");
+  }
+  // 请求对象由当前调用独占，直接接管其中的 key 避免复制
+  LaserKeyFormat format_key(std::move(key->primary_keys), std::move(key->column_keys));
+  if (!consumeTrafficTokens(table_hash, command_name, 1, format_key.length() + value_bytes)) {
+    throwLaserException(Status::RS_THROTTLED, "request is throttled in commonCallEngine,");
   }
   std::shared_ptr<RocksDbEngine> engine;
-  auto format_key = getFormatKey(key);
-  getDatabaseEngine(&engine, key, format_key);
-  func(engine, format_key);
+  getDatabaseEngine(&engine, *key, format_key);
+  func(engine, &format_key);
 }
 
 void LaserService::dispatchRequest(const std::vector<LaserKey>& keys, LaserServiceMultiDispatch func,
-                                   const std::string& command_name) {
+                                   const std::string& command_name, const std::vector<LaserValue>* values) {
   metrics::Timer metric_time(laser_service_timers_.get());
-  // 多个 key 的情况，从第一个 key 里获取 DatabaseName 和 TableName
-  bool need_restrict_by_kps = false;
-  std::string database_name = "";
-  std::string table_name = "";
-  if (!keys.empty()) {
-    database_name = keys.begin()->get_database_name();
-    table_name = keys.begin()->get_table_name();
+  // 预留好空间，dispatch_keys 中保存的指针在 func 执行期间保持有效
+  std::vector<LaserKeyFormat> format_keys;
+  format_keys.reserve(keys.size());
+  for (auto& key : keys) {
+    format_keys.emplace_back(key.get_primary_keys(), key.get_column_keys());
   }
-  auto table_hash = config_manager_->getTableSchemaHash(database_name, table_name);
-  auto table_restriction = traffic_restriction_config_->find(table_hash);
-  if (table_restriction != traffic_restriction_config_->end()) {
-    if (table_restriction->second->getDenyAll()) {
-      throwLaserException(Status::RS_OPERATION_DENIED, "request is denied in dispatchRequest,");
+
+  // 批量请求中的 key 可能属于不同的表，按表汇总 key 数和字节数，任意一张表拒绝时整个请求失败
+  std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> table_usages;
+  for (size_t i = 0; i < keys.size(); i++) {
+    auto& usage = table_usages[config_manager_->getTableSchemaHash(keys[i].get_database_name(),
+                                                                   keys[i].get_table_name())];
+    usage.first++;
+    usage.second += format_keys[i].length();
+    if (values != nullptr && i < values->size()) {
+      usage.second += getValueBytes((*values)[i]);
     }
-    auto command_restriction = table_restriction->second->getMultipleOperationLimits().find(command_name);
-    if (command_restriction != table_restriction->second->getMultipleOperationLimits().end()) {
-      if (laser::TrafficRestrictionType::QPS == command_restriction->second.getType()) {
-        uint32_t random_value = folly::Random::rand32(1, 101);
-        if (random_value > command_restriction->second.getLimit()) {
-          throwLaserException(Status::RS_TRAFFIC_RESTRICTION, "request is denied in dispatchRequest,");
-        }
-      } else {
-        need_restrict_by_kps = true;
-      }
-    } else {
+  }
+
+  auto traffic_restriction_config = traffic_restriction_config_.load();
+  for (auto& usage : table_usages) {
+    auto table_restriction = traffic_restriction_config->find(usage.first);
+    if (table_restriction != traffic_restriction_config->end() && table_restriction->second->getDenyAll()) {
       throwLaserException(Status::RS_OPERATION_DENIED, "request is denied in dispatchRequest,");
     }
   }
+  std::vector<uint64_t> consumed_tables;
+  for (auto& usage : table_usages) {
+    if (consumeTrafficTokens(usage.first, command_name, usage.second.first, usage.second.second)) {
+      consumed_tables.push_back(usage.first);
+      continue;
+    }
+    // 归还其他表已经扣减的令牌
+    for (auto consumed_table : consumed_tables) {
+      auto& consumed_usage = table_usages[consumed_table];
+      refundTrafficTokens(consumed_table, command_name, consumed_usage.first, consumed_usage.second);
+    }
+    throwLaserException(Status::RS_THROTTLED, "request is throttled in dispatchRequest,");
+  }
 
   std::vector<std::shared_ptr<RocksDbEngine>> engines;
   std::unordered_map<RocksDbEngine*, std::vector<DispatchRequestItem>> dispatch_keys;
-
   uint32_t index = 0;
-  for (auto& key : keys) {
-    std::unique_ptr<LaserKey> pkey = std::make_unique<LaserKey>(key);
+  for (size_t i = 0; i < keys.size(); i++) {
     std::shared_ptr<RocksDbEngine> engine;
-    auto format_key = getFormatKey(pkey);
+    const LaserKeyFormat* format_key = &format_keys[i];
     try {
-      getDatabaseEngine(&engine, pkey, format_key);
+      getDatabaseEngine(&engine, keys[i], *format_key);
       if (engine.get() == nullptr) {
         continue;
       }
@@ -157,16 +192,6 @@ void LaserService::dispatchRequest(const std::vector<LaserKey>& keys, LaserServi
         dispatch_keys[engine.get()] = std::vector<DispatchRequestItem>({});
       }
       DispatchRequestItem item;
-      if (need_restrict_by_kps) {
-        uint32_t random_value = folly::Random::rand32(1, 101);
-        auto command_restriction = table_restriction->second->getMultipleOperationLimits().find(command_name);
-        if (random_value > command_restriction->second.getLimit()) {
-          item.deny_by_traffic_restriction = true;
-          item.index = index++;
-          dispatch_keys[engine.get()].push_back(item);
-          continue;
-        }
-      }
       item.key = format_key;
       item.index = index;
       dispatch_keys[engine.get()].push_back(item);
@@ -179,14 +204,118 @@ void LaserService::dispatchRequest(const std::vector<LaserKey>& keys, LaserServi
   func(dispatch_keys);
 }
 
+void LaserService::runDispatchTasks(
+    const std::unordered_map<RocksDbEngine*, std::vector<DispatchRequestItem>>& dispatch_keys,
+    LaserServiceDispatchTask task) {
+  size_t key_number = 0;
+  for (auto& dispatch : dispatch_keys) {
+    key_number += dispatch.second.size();
+  }
+  if (!fanout_executor_->isAsync() || dispatch_keys.size() < 2 ||
+      key_number < static_cast<size_t>(FLAGS_laser_service_fanout_min_keys)) {
+    for (auto& dispatch : dispatch_keys) {
+      task(dispatch.first, dispatch.second);
+    }
+    return;
+  }
+
+  // 第一个 partition 在当前线程执行，其余的交给 fanout 线程池，所有 partition 执行完之后才能返回
+  std::vector<const std::pair<RocksDbEngine* const, std::vector<DispatchRequestItem>>*> async_dispatches;
+  std::vector<folly::SemiFuture<folly::Unit>> futures;
+  auto collector = SyncAckCollector::current();
+  for (auto iter = std::next(dispatch_keys.begin()); iter != dispatch_keys.end(); ++iter) {
+    auto dispatch = &(*iter);
+    async_dispatches.push_back(dispatch);
+    futures.push_back(fanout_executor_->runTask([&task, dispatch, collector]() {
+      SyncAckCollector::Scope scope(collector);
+      task(dispatch->first, dispatch->second);
+    }));
+  }
+  auto first = dispatch_keys.begin();
+  auto first_result = folly::makeTryWith([&task, first]() { task(first->first, first->second); });
+
+  // 队列已满的 partition 在当前线程补充执行
+  auto results = folly::collectAll(std::move(futures)).get();
+  for (size_t i = 0; i < results.size(); i++) {
+    if (results[i].hasException<folly::QueueFullException>()) {
+      task(async_dispatches[i]->first, async_dispatches[i]->second);
+    } else {
+      results[i].throwIfFailed();
+    }
+  }
+  first_result.throwIfFailed();
+}
+
+bool LaserService::consumeTrafficTokens(uint64_t table_hash, const std::string& command_name, uint64_t key_number,
+                                        uint64_t bytes) {
+  auto traffic_limiters = traffic_limiters_.load();
+  auto limiter = traffic_limiters->find(table_hash);
+  if (limiter == traffic_limiters->end()) {
+    return true;
+  }
+  if (limiter->second->consume(TableTrafficLimiter::getOperationType(command_name), current_client_id, key_number,
+                               bytes)) {
+    return true;
+  }
+  throttled_meter_->mark();
+  return false;
+}
+
+void LaserService::refundTrafficTokens(uint64_t table_hash, const std::string& command_name, uint64_t key_number,
+                                       uint64_t bytes) {
+  auto traffic_limiters = traffic_limiters_.load();
+  auto limiter = traffic_limiters->find(table_hash);
+  if (limiter != traffic_limiters->end()) {
+    limiter->second->refund(TableTrafficLimiter::getOperationType(command_name), current_client_id, key_number, bytes);
+  }
+}
+
+LaserResponseFuture LaserService::runRequest(const std::shared_ptr<ServiceExecutor>& executor,
+                                             ServiceExecutorFunc func) {
+  std::string client_id;
+  auto context = getConnectionContext();
+  if (context != nullptr && context->getHeader() != nullptr) {
+    auto& headers = context->getHeader()->getHeaders();
+    auto header = headers.find(LASER_CLIENT_ID_HEADER);
+    if (header != headers.end()) {
+      client_id = header->second;
+    }
+  }
+  // 半同步写入在 func 返回、key 锁释放之后再等待 follower 确认，不占用 executor 线程
+  auto collector = std::make_shared<SyncAckCollector>();
+  return executor
+      ->run([func = std::move(func), client_id = std::move(client_id), collector](LaserResponse& response) mutable {
+        current_client_id = client_id;
+        SCOPE_EXIT { current_client_id.clear(); };
+        SyncAckCollector::Scope scope(collector.get());
+        func(response);
+      })
+      .deferValue([collector](std::unique_ptr<LaserResponse> response) {
+        return collector->wait().deferValue(
+            [response = std::move(response)](folly::Unit) mutable { return std::move(response); });
+      });
+}
+
 void LaserService::updateTrafficRestrictionConfig(const TableTrafficRestrictionMap& traffic_restrictions) {
   auto temp_map = std::make_shared<TableTrafficRestrictionMap>();
+  auto old_limiters = traffic_limiters_.load();
+  auto limiters = std::make_shared<TableTrafficLimiterMap>();
   for (auto& iter : traffic_restrictions) {
     auto table_traffic_restriction = std::make_shared<TableTrafficRestrictionConfig>(*iter.second);
     temp_map->insert(std::make_pair(iter.first, table_traffic_restriction));
+    if (table_traffic_restriction->getTokenBuckets().empty()) {
+      continue;
+    }
+    std::shared_ptr<TableTrafficLimiter> old_limiter;
+    auto old = old_limiters->find(iter.first);
+    if (old != old_limiters->end()) {
+      old_limiter = old->second;
+    }
+    limiters->insert(
+        std::make_pair(iter.first, std::make_shared<TableTrafficLimiter>(*table_traffic_restriction, old_limiter)));
   }
-  second_traffic_restriction_config_ = traffic_restriction_config_;
-  traffic_restriction_config_ = temp_map;
+  traffic_limiters_.store(limiters);
+  traffic_restriction_config_.store(temp_map);
 }
 
 void LaserService::delkey(LaserResponse& response, std::unique_ptr<LaserKey> key) {
@@ -260,7 +389,7 @@ void LaserService::append(LaserResponse& response, std::unique_ptr<LaserKey> key
 
                      response.set_int_data(length);
                    },
-                   "append");
+                   "append", value->size());
 }
 
 void LaserService::sset(LaserResponse& response, std::unique_ptr<LaserKV> kv) {
@@ -277,7 +406,7 @@ void LaserService::sset(LaserResponse& response, std::unique_ptr<LaserKV> kv) {
                      }
                      response.set_int_data(value->get_string_value().size());
                    },
-                   "set");
+                   "set", getValueBytes(*value));
 }
 
 void LaserService::setx(LaserResponse& response, std::unique_ptr<LaserKV> kv, std::unique_ptr<LaserSetOption> option) {
@@ -297,7 +426,7 @@ void LaserService::setx(LaserResponse& response, std::unique_ptr<LaserKV> kv, st
                      }
                      response.set_int_data(value->get_string_value().size());
                    },
-                   "setx");
+                   "setx", getValueBytes(*value));
 }
 
 // 获取失败或者不存在 db 都返回 null
@@ -313,23 +442,26 @@ void LaserService::mget(LaserResponse& response, std::unique_ptr<LaserKeys> keys
                       values.push_back(std::move(value));
                     }
 
-                    for (auto task : dispatch_keys) {
-                      for (auto& item_key : task.second) {
-                        LaserValue value;
-                        if (item_key.deny_by_traffic_restriction) {
-                          value.set_null_value(true);
-                        } else {
-                          laser::LaserValueRawString value_str;
-                          Status status = task.first->get(&value_str, *(item_key.key));
-                          if (status != Status::OK) {
-                            value.set_null_value(true);
-                          } else {
-                            value.set_string_value(value_str.getValue());
-                          }
+                    runDispatchTasks(dispatch_keys, [&values](auto engine, auto& items) {
+                      std::vector<const LaserKeyFormat*> batch_keys;
+                      std::vector<uint32_t> pass_indexes;
+                      for (auto& item_key : items) {
+                        batch_keys.push_back(item_key.key);
+                        pass_indexes.push_back(item_key.index);
+                      }
+
+                      std::vector<Status> statuses;
+                      std::vector<LaserValueRawString> batch_values;
+                      Status status = engine->mget(&statuses, &batch_values, batch_keys);
+                      if (status != Status::OK) {
+                        return;
+                      }
+                      for (size_t i = 0; i < pass_indexes.size(); i++) {
+                        if (statuses[i] == Status::OK) {
+                          values[pass_indexes[i]].set_string_value(batch_values[i].getValue());
                         }
-                        values[item_key.index] = std::move(value);
                       }
-                    }
+                    });
                     response.set_list_value_data(std::move(values));
                   },
                   "mget");
@@ -352,25 +484,29 @@ void LaserService::mgetDetail(LaserResponse& response, std::unique_ptr<LaserKeys
                       value.set_entry_value(entry_value);
                       values.push_back(std::move(value));
                     }
-                    for (auto task : dispatch_keys) {
-                      for (auto& item_key : task.second) {
+                    runDispatchTasks(dispatch_keys, [&values](auto engine, auto& items) {
+                      std::vector<const LaserKeyFormat*> batch_keys;
+                      std::vector<uint32_t> pass_indexes;
+                      for (auto& item_key : items) {
+                        batch_keys.push_back(item_key.key);
+                        pass_indexes.push_back(item_key.index);
+                      }
+
+                      std::vector<Status> statuses;
+                      std::vector<LaserValueRawString> batch_values;
+                      Status batch_status = engine->mget(&statuses, &batch_values, batch_keys);
+                      for (size_t i = 0; i < pass_indexes.size(); i++) {
                         LaserValue value;
                         EntryValue entry_value;
-                        Status status;
-                        if (item_key.deny_by_traffic_restriction) {
-                          status = Status::RS_TRAFFIC_RESTRICTION;
-                        } else {
-                          laser::LaserValueRawString value_str;
-                          status = task.first->get(&value_str, *(item_key.key));
-                          if (status == Status::OK) {
-                            entry_value.set_string_value(value_str.getValue());
-                          }
+                        Status status = (batch_status == Status::OK) ? statuses[i] : batch_status;
+                        if (status == Status::OK) {
+                          entry_value.set_string_value(batch_values[i].getValue());
                         }
                         entry_value.set_status(status);
                         value.set_entry_value(entry_value);
-                        values[item_key.index] = std::move(value);
+                        values[pass_indexes[i]] = std::move(value);
                       }
-                    }
+                    });
                     response.set_list_value_data(std::move(values));
                   },
                   "mgetDetail");
@@ -388,20 +524,16 @@ void LaserService::mset(LaserResponse& response, std::unique_ptr<LaserKVs> value
   dispatchRequest(keys,
                   [this, &response, &vec_values](auto dispatch_keys) {
                     std::vector<int64_t> result(vec_values.size(), -1);
-                    for (auto task : dispatch_keys) {
-                      std::vector<LaserKeyFormat> batch_keys;
+                    runDispatchTasks(dispatch_keys, [&vec_values, &result](auto engine, auto& items) {
+                      std::vector<const LaserKeyFormat*> batch_keys;
                       std::vector<std::string> data;
                       std::vector<uint32_t> pass_indexes;
-                      for (auto& item_key : task.second) {
-                        if (item_key.deny_by_traffic_restriction) {
-                          result[item_key.index] = -1;
-                        } else {
-                          data.push_back(vec_values[item_key.index].get_string_value());
-                          batch_keys.push_back(*(item_key.key));
-                          pass_indexes.push_back(item_key.index);
-                        }
+                      for (auto& item_key : items) {
+                        data.push_back(vec_values[item_key.index].get_string_value());
+                        batch_keys.push_back(item_key.key);
+                        pass_indexes.push_back(item_key.index);
                       }
-                      Status status = task.first->mset(batch_keys, data);
+                      Status status = engine->mset(batch_keys, data);
                       for (auto& index : pass_indexes) {
                         if (status != Status::OK) {
                           result[index] = -1;
@@ -409,10 +541,10 @@ void LaserService::mset(LaserResponse& response, std::unique_ptr<LaserKVs> value
                           result[index] = index;
                         }
                       }
-                    }
+                    });
                     response.set_list_int_data(std::move(result));
                   },
-                  "mset");
+                  "mset", &vec_values);
 }
 
 void LaserService::msetDetail(LaserResponse& response, std::unique_ptr<LaserKVs> values,
@@ -438,24 +570,17 @@ void LaserService::msetDetail(LaserResponse& response, std::unique_ptr<LaserKVs>
                       value.set_entry_value(entry_value);
                       values.push_back(std::move(value));
                     }
-                    for (auto task : dispatch_keys) {
-                      std::vector<LaserKeyFormat> batch_keys;
+                    runDispatchTasks(dispatch_keys, [&vec_values, &values,
+                                                     &rocksdb_set_option](auto engine, auto& items) {
+                      std::vector<const LaserKeyFormat*> batch_keys;
                       std::vector<std::string> data;
                       std::vector<uint32_t> pass_indexes;
-                      for (auto& item_key : task.second) {
-                        if (item_key.deny_by_traffic_restriction) {
-                          LaserValue value;
-                          EntryValue entry_value;
-                          entry_value.set_status(Status::RS_TRAFFIC_RESTRICTION);
-                          value.set_entry_value(entry_value);
-                          values[item_key.index] = std::move(value);
-                        } else {
-                          data.push_back(vec_values[item_key.index].get_string_value());
-                          batch_keys.push_back(*(item_key.key));
-                          pass_indexes.push_back(item_key.index);
-                        }
+                      for (auto& item_key : items) {
+                        data.push_back(vec_values[item_key.index].get_string_value());
+                        batch_keys.push_back(item_key.key);
+                        pass_indexes.push_back(item_key.index);
                       }
-                      Status status = task.first->msetx(batch_keys, data, rocksdb_set_option);
+                      Status status = engine->msetx(batch_keys, data, rocksdb_set_option);
                       for (auto index : pass_indexes) {
                         LaserValue value;
                         EntryValue entry_value;
@@ -463,10 +588,10 @@ void LaserService::msetDetail(LaserResponse& response, std::unique_ptr<LaserKVs>
                         value.set_entry_value(entry_value);
                         values[index] = std::move(value);
                       }
-                    }
+                    });
                     response.set_list_value_data(std::move(values));
                   },
-                  "msetDetail");
+                  "msetDetail", &vec_values);
 }
 
 void LaserService::mdel(LaserResponse& response, std::unique_ptr<LaserKeys> keys) {
@@ -481,21 +606,16 @@ void LaserService::mdel(LaserResponse& response, std::unique_ptr<LaserKeys> keys
                       value.set_entry_value(entry_value);
                       values.push_back(std::move(value));
                     }
-                    for (auto task : dispatch_keys) {
-                      for (auto& item_key : task.second) {
+                    runDispatchTasks(dispatch_keys, [&values](auto engine, auto& items) {
+                      for (auto& item_key : items) {
                         LaserValue value;
                         EntryValue entry_value;
-                        Status status;
-                        if (item_key.deny_by_traffic_restriction) {
-                          status = Status::RS_TRAFFIC_RESTRICTION;
-                        } else {
-                          status = task.first->delkey(*(item_key.key));
-                        }
+                        Status status = engine->delkey(*(item_key.key));
                         entry_value.set_status(status);
                         value.set_entry_value(entry_value);
                         values[item_key.index] = std::move(value);
                       }
-                    }
+                    });
                     response.set_list_value_data(std::move(values));
                   },
                   "mdel");
@@ -538,16 +658,14 @@ void LaserService::hmget(LaserResponse& response, std::unique_ptr<LaserKey> key,
   commonCallEngine(std::move(key),
                    [this, &response, &fields](auto engine, auto format_key) {
                      std::unordered_map<std::string, LaserValueRawString> values;
-                     Status status = engine->hgetall(&values, *format_key);
+                     Status status = engine->hmget(&values, *format_key, *fields);
                      if (status != Status::OK) {
-                       throwLaserException(status, "get hmget all hash value fail,");
+                       throwLaserException(status, "get hmget hash value fail,");
                      }
 
                      std::map<std::string, std::string> map_string_data;
-                     for (auto& field : *fields) {
-                       if (values.find(field) != values.end()) {
-                         map_string_data.insert(std::pair<std::string, std::string>(field, values[field].getValue()));
-                       }
+                     for (auto& value : values) {
+                       map_string_data.insert(std::pair<std::string, std::string>(value.first, value.second.getValue()));
                      }
                      response.set_map_string_data(map_string_data);
                    },
@@ -584,9 +702,7 @@ void LaserService::hlen(LaserResponse& response, std::unique_ptr<LaserKey> key)
 void LaserService::hexists(LaserResponse& response, std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> field) {
   commonCallEngine(std::move(key),
                    [this, &response, &field](auto engine, auto format_key) {
-                     laser::LaserValueRawString value;
-
-                     Status status = engine->hget(&value, *format_key, *field);
+                     Status status = engine->hexists(*format_key, *field);
                      if (status != Status::OK) {
                        throwLaserException(status, "get hexists value fail,");
                      }
@@ -635,7 +751,7 @@ void LaserService::hset(LaserResponse& response, std::unique_ptr<LaserKey> key,
                      }
                      response.set_int_data(1);
                    },
-                   "hset");
+                   "hset", value->size());
 }
 
 void LaserService::hmset(LaserResponse& response, std::unique_ptr<LaserKey> key, std::unique_ptr<LaserValue> values) {
@@ -701,7 +817,7 @@ void LaserService::lpush(LaserResponse&, std::unique_ptr<LaserKey> key, std::uni
                        throwLaserException(status, "lpush value fail,");
                      }
                    },
-                   "lpush");
+                   "lpush", value->size());
 }
 
 void LaserService::rpop(LaserResponse& response, std::unique_ptr<LaserKey> key) {
@@ -725,7 +841,7 @@ void LaserService::rpush(LaserResponse&, std::unique_ptr<LaserKey> key, std::uni
                        throwLaserException(status, "rpush value fail,");
                      }
                    },
-                   "rpush");
+                   "rpush", value->size());
 }
 
 void LaserService::lrange(LaserResponse& response, std::unique_ptr<LaserKey> key, int32_t start, int32_t end) {
@@ -748,7 +864,7 @@ void LaserService::lrange(LaserResponse& response, std::unique_ptr<LaserKey> key
 void LaserService::decrBy(LaserResponse& response, std::unique_ptr<LaserKey> key, int64_t step) {
   commonCallEngine(std::move(key),
                    [this, &response, step](auto engine, auto format_key) {
-                     int64_t value;
+                     int64_t value = 0;
                      Status status = engine->decr(&value, *format_key, step);
                      if (status != Status::OK) {
                        throwLaserException(status, "decrBy fail,");
@@ -761,7 +877,7 @@ void LaserService::decrBy(LaserResponse& response, std::unique_ptr<LaserKey> key
 void LaserService::incrBy(LaserResponse& response, std::unique_ptr<LaserKey> key, int64_t step) {
   commonCallEngine(std::move(key),
                    [this, &response, step](auto engine, auto format_key) {
-                     int64_t value;
+                     int64_t value = 0;
                      Status status = engine->incr(&value, *format_key, step);
                      if (status != Status::OK) {
                        throwLaserException(status, "incrBy fail,");
@@ -783,7 +899,7 @@ void LaserService::sadd(LaserResponse&, std::unique_ptr<LaserKey> key, std::uniq
                        throwLaserException(status, "sadd fail,");
                      }
                    },
-                   "sadd");
+                   "sadd", member->size());
 }
 
 void LaserService::sismember(LaserResponse&, std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) {
@@ -867,4 +983,371 @@ void LaserService::zremRangeByScore(LaserResponse& response, std::unique_ptr<Las
                    "zremRangeByScore");
 }
 
+void LaserService::zcard(LaserResponse& response, std::unique_ptr<LaserKey> key) {
+  commonCallEngine(std::move(key),
+                   [this, &response](auto engine, auto format_key) {
+                     LaserValueZSetMeta value;
+                     Status status = engine->get(&value, *format_key);
+                     if (status != Status::OK) {
+                       throwLaserException(status, "zcard fail,");
+                     }
+                     response.set_int_data(value.getSize());
+                   },
+                   "zcard");
+}
+
+void LaserService::zscore(LaserResponse& response, std::unique_ptr<LaserKey> key,
+                          std::unique_ptr<std::string> member) {
+  commonCallEngine(std::move(key),
+                   [this, &response, &member](auto engine, auto format_key) {
+                     int64_t score = 0;
+                     Status status = engine->zscore(&score, *format_key, *member);
+                     if (status != Status::OK) {
+                       throwLaserException(status, "zscore fail,");
+                     }
+                     response.set_int_data(score);
+                   },
+                   "zscore");
+}
+
+void LaserService::zrem(LaserResponse& response, std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) {
+  commonCallEngine(std::move(key),
+                   [this, &response, &member](auto engine, auto format_key) {
+                     Status status = engine->zrem(*format_key, *member);
+                     if (status != Status::OK) {
+                       throwLaserException(status, "zrem fail,");
+                     }
+                     response.set_int_data(1);
+                   },
+                   "zrem");
+}
+
+void LaserService::zrank(LaserResponse& response, std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) {
+  commonCallEngine(std::move(key),
+                   [this, &response, &member](auto engine, auto format_key) {
+                     int64_t rank = 0;
+                     Status status = engine->zrank(&rank, *format_key, *member);
+                     if (status != Status::OK) {
+                       throwLaserException(status, "zrank fail,");
+                     }
+                     response.set_int_data(rank);
+                   },
+                   "zrank");
+}
+
+void LaserService::zrange(LaserResponse& response, std::unique_ptr<LaserKey> key, int64_t start, int64_t stop) {
+  commonCallEngine(std::move(key),
+                   [this, &response, start, stop](auto engine, auto format_key) {
+                     std::vector<LaserScoreMember> score_member_data_list;
+                     Status status = engine->zrange(&score_member_data_list, *format_key, start, stop);
+                     if (status != Status::OK) {
+                       throwLaserException(status, "zrange fail,");
+                     }
+                     response.set_list_score_member_data(score_member_data_list);
+                   },
+                   "zrange");
+}
+
+LaserResponseFuture LaserService::semifuture_delkey(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    delkey(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_expire(std::unique_ptr<LaserKey> key, int64_t time) {
+  return runRequest(scan_executor_, [this, key = std::move(key), time](LaserResponse& response) mutable {
+    expire(response, std::move(key), time);
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_expireAt(std::unique_ptr<LaserKey> key, int64_t time_at) {
+  return runRequest(scan_executor_, [this, key = std::move(key), time_at](LaserResponse& response) mutable {
+    expireAt(response, std::move(key), time_at);
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_ttl(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    ttl(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_get(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    get(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_append(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> value) {
+  return runRequest(point_executor_,
+                    [this, key = std::move(key), value = std::move(value)](LaserResponse& response) mutable {
+                      append(response, std::move(key), std::move(value));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_sset(std::unique_ptr<LaserKV> kv) {
+  return runRequest(point_executor_, [this, kv = std::move(kv)](LaserResponse& response) mutable {
+    sset(response, std::move(kv));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_setx(std::unique_ptr<LaserKV> kv, std::unique_ptr<LaserSetOption> option) {
+  return runRequest(point_executor_,
+                    [this, kv = std::move(kv), option = std::move(option)](LaserResponse& response) mutable {
+                      setx(response, std::move(kv), std::move(option));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_mget(std::unique_ptr<LaserKeys> keys) {
+  return runRequest(scan_executor_, [this, keys = std::move(keys)](LaserResponse& response) mutable {
+    mget(response, std::move(keys));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_mgetDetail(std::unique_ptr<LaserKeys> keys) {
+  return runRequest(scan_executor_, [this, keys = std::move(keys)](LaserResponse& response) mutable {
+    mgetDetail(response, std::move(keys));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_mset(std::unique_ptr<LaserKVs> values) {
+  return runRequest(scan_executor_, [this, values = std::move(values)](LaserResponse& response) mutable {
+    mset(response, std::move(values));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_msetDetail(std::unique_ptr<LaserKVs> values,
+                                                        std::unique_ptr<LaserSetOption> option) {
+  return runRequest(scan_executor_, [this, values = std::move(values),
+                              option = std::move(option)](LaserResponse& response) mutable {
+    msetDetail(response, std::move(values), std::move(option));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_mdel(std::unique_ptr<LaserKeys> keys) {
+  return runRequest(scan_executor_, [this, keys = std::move(keys)](LaserResponse& response) mutable {
+    mdel(response, std::move(keys));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_exist(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    exist(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_hget(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> field) {
+  return runRequest(point_executor_,
+                    [this, key = std::move(key), field = std::move(field)](LaserResponse& response) mutable {
+                      hget(response, std::move(key), std::move(field));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_hgetall(std::unique_ptr<LaserKey> key) {
+  return runRequest(scan_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    hgetall(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_hexists(std::unique_ptr<LaserKey> key,
+                                                     std::unique_ptr<std::string> field) {
+  return runRequest(point_executor_,
+                    [this, key = std::move(key), field = std::move(field)](LaserResponse& response) mutable {
+                      hexists(response, std::move(key), std::move(field));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_hkeys(std::unique_ptr<LaserKey> key) {
+  return runRequest(scan_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    hkeys(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_hlen(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    hlen(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_hmget(std::unique_ptr<LaserKey> key,
+                                                   std::unique_ptr<std::vector<std::string>> fields) {
+  return runRequest(scan_executor_,
+                    [this, key = std::move(key), fields = std::move(fields)](LaserResponse& response) mutable {
+                      hmget(response, std::move(key), std::move(fields));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_hset(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> field,
+                                                  std::unique_ptr<std::string> value) {
+  return runRequest(point_executor_, [this, key = std::move(key), field = std::move(field),
+                               value = std::move(value)](LaserResponse& response) mutable {
+    hset(response, std::move(key), std::move(field), std::move(value));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_hmset(std::unique_ptr<LaserKey> key, std::unique_ptr<LaserValue> values) {
+  return runRequest(scan_executor_,
+                    [this, key = std::move(key), values = std::move(values)](LaserResponse& response) mutable {
+                      hmset(response, std::move(key), std::move(values));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_hdel(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> field) {
+  return runRequest(point_executor_,
+                    [this, key = std::move(key), field = std::move(field)](LaserResponse& response) mutable {
+                      hdel(response, std::move(key), std::move(field));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_decr(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    decr(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_incr(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    incr(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_decrBy(std::unique_ptr<LaserKey> key, int64_t step) {
+  return runRequest(point_executor_, [this, key = std::move(key), step](LaserResponse& response) mutable {
+    decrBy(response, std::move(key), step);
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_incrBy(std::unique_ptr<LaserKey> key, int64_t step) {
+  return runRequest(point_executor_, [this, key = std::move(key), step](LaserResponse& response) mutable {
+    incrBy(response, std::move(key), step);
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_lindex(std::unique_ptr<LaserKey> key, int32_t index) {
+  return runRequest(point_executor_, [this, key = std::move(key), index](LaserResponse& response) mutable {
+    lindex(response, std::move(key), index);
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_llen(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    llen(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_lpop(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    lpop(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_lpush(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> value) {
+  return runRequest(point_executor_,
+                    [this, key = std::move(key), value = std::move(value)](LaserResponse& response) mutable {
+                      lpush(response, std::move(key), std::move(value));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_lrange(std::unique_ptr<LaserKey> key, int32_t start, int32_t end) {
+  return runRequest(scan_executor_, [this, key = std::move(key), start, end](LaserResponse& response) mutable {
+    lrange(response, std::move(key), start, end);
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_rpop(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    rpop(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_rpush(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> value) {
+  return runRequest(point_executor_,
+                    [this, key = std::move(key), value = std::move(value)](LaserResponse& response) mutable {
+                      rpush(response, std::move(key), std::move(value));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_sadd(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) {
+  return runRequest(point_executor_, [this, key = std::move(key),
+                               member = std::move(member)](LaserResponse& response) mutable {
+    sadd(response, std::move(key), std::move(member));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_sismember(std::unique_ptr<LaserKey> key,
+                                                       std::unique_ptr<std::string> member) {
+  return runRequest(point_executor_, [this, key = std::move(key),
+                               member = std::move(member)](LaserResponse& response) mutable {
+    sismember(response, std::move(key), std::move(member));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_sremove(std::unique_ptr<LaserKey> key,
+                                                     std::unique_ptr<std::string> member) {
+  return runRequest(point_executor_, [this, key = std::move(key),
+                               member = std::move(member)](LaserResponse& response) mutable {
+    sremove(response, std::move(key), std::move(member));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_smembers(std::unique_ptr<LaserKey> key) {
+  return runRequest(scan_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    smembers(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_zadd(std::unique_ptr<LaserKey> key,
+                                                  std::unique_ptr<LaserValue> member_scores) {
+  return runRequest(scan_executor_, [this, key = std::move(key),
+                              member_scores = std::move(member_scores)](LaserResponse& response) mutable {
+    zadd(response, std::move(key), std::move(member_scores));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_zrangeByScore(std::unique_ptr<LaserKey> key, int64_t min, int64_t max) {
+  return runRequest(scan_executor_, [this, key = std::move(key), min, max](LaserResponse& response) mutable {
+    zrangeByScore(response, std::move(key), min, max);
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_zremRangeByScore(std::unique_ptr<LaserKey> key, int64_t min, int64_t max) {
+  return runRequest(scan_executor_, [this, key = std::move(key), min, max](LaserResponse& response) mutable {
+    zremRangeByScore(response, std::move(key), min, max);
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_zcard(std::unique_ptr<LaserKey> key) {
+  return runRequest(point_executor_, [this, key = std::move(key)](LaserResponse& response) mutable {
+    zcard(response, std::move(key));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_zscore(std::unique_ptr<LaserKey> key,
+                                                    std::unique_ptr<std::string> member) {
+  return runRequest(point_executor_, [this, key = std::move(key),
+                               member = std::move(member)](LaserResponse& response) mutable {
+    zscore(response, std::move(key), std::move(member));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_zrem(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) {
+  return runRequest(point_executor_, [this, key = std::move(key),
+                               member = std::move(member)](LaserResponse& response) mutable {
+    zrem(response, std::move(key), std::move(member));
+  });
+}
+
+LaserResponseFuture LaserService::semifuture_zrank(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) {
+  return runRequest(scan_executor_,
+                    [this, key = std::move(key), member = std::move(member)](LaserResponse& response) mutable {
+                      zrank(response, std::move(key), std::move(member));
+                    });
+}
+
+LaserResponseFuture LaserService::semifuture_zrange(std::unique_ptr<LaserKey> key, int64_t start, int64_t stop) {
+  return runRequest(scan_executor_, [this, key = std::move(key), start, stop](LaserResponse& response) mutable {
+    zrange(response, std::move(key), start, stop);
+  });
+}
+
 }  // namespace laser
@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include "folly/concurrency/AtomicSharedPtr.h"
+
 #include "common/laser/if/gen-cpp2/LaserService.h"
 #include "common/metrics/metrics.h"
 #include "common/laser/config_manager.h"
@@ -28,17 +30,21 @@
 
 #include "engine/rocksdb.h"
 #include "database_manager.h"
+#include "service_executor.h"
+#include "traffic_limiter.h"
 
 namespace laser {
 
-using LaserServiceCallbackFunc = folly::Function<void(std::shared_ptr<RocksDbEngine>, std::shared_ptr<LaserKeyFormat>)>;
+// format key 只在回调执行期间有效
+using LaserServiceCallbackFunc = folly::Function<void(std::shared_ptr<RocksDbEngine>, const LaserKeyFormat*)>;
 struct DispatchRequestItem {
-  std::shared_ptr<LaserKeyFormat> key;
+  const LaserKeyFormat* key = nullptr;
   uint32_t index;
-  bool deny_by_traffic_restriction = false;
 };
+using LaserResponseFuture = folly::SemiFuture<std::unique_ptr<LaserResponse>>;
 using LaserServiceMultiDispatch =
     folly::Function<void(const std::unordered_map<RocksDbEngine*, std::vector<DispatchRequestItem>>&)>;
+using LaserServiceDispatchTask = folly::Function<void(RocksDbEngine*, const std::vector<DispatchRequestItem>&) const>;
 
 class LaserService : virtual public LaserServiceSvIf {
  public:
@@ -99,22 +105,95 @@ class LaserService : virtual public LaserServiceSvIf {
   void zadd(LaserResponse& response, std::unique_ptr<LaserKey> key, std::unique_ptr<LaserValue> member_scores) override;
   void zrangeByScore(LaserResponse& response, std::unique_ptr<LaserKey> key, int64_t min, int64_t max) override;
   void zremRangeByScore(LaserResponse& response, std::unique_ptr<LaserKey> key, int64_t min, int64_t max) override;
+  void zcard(LaserResponse& response, std::unique_ptr<LaserKey> key) override;
+  void zscore(LaserResponse& response, std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  void zrem(LaserResponse& response, std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  void zrank(LaserResponse& response, std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  void zrange(LaserResponse& response, std::unique_ptr<LaserKey> key, int64_t start, int64_t stop) override;
+
+  // 异步接口，点查类请求在 point 线程池中执行，遍历和批量请求在有界的 scan 线程池中执行，避免阻塞 thrift worker
+  LaserResponseFuture semifuture_delkey(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_expire(std::unique_ptr<LaserKey> key, int64_t time) override;
+  LaserResponseFuture semifuture_expireAt(std::unique_ptr<LaserKey> key, int64_t time_at) override;
+  LaserResponseFuture semifuture_ttl(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_get(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_append(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> value) override;
+  LaserResponseFuture semifuture_sset(std::unique_ptr<LaserKV> kv) override;
+  LaserResponseFuture semifuture_setx(std::unique_ptr<LaserKV> kv, std::unique_ptr<LaserSetOption> option) override;
+  LaserResponseFuture semifuture_mget(std::unique_ptr<LaserKeys> keys) override;
+  LaserResponseFuture semifuture_mgetDetail(std::unique_ptr<LaserKeys> keys) override;
+  LaserResponseFuture semifuture_mset(std::unique_ptr<LaserKVs> values) override;
+  LaserResponseFuture semifuture_msetDetail(std::unique_ptr<LaserKVs> values,
+                                            std::unique_ptr<LaserSetOption> option) override;
+  LaserResponseFuture semifuture_mdel(std::unique_ptr<LaserKeys> keys) override;
+  LaserResponseFuture semifuture_exist(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_hget(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> field) override;
+  LaserResponseFuture semifuture_hgetall(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_hexists(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> field) override;
+  LaserResponseFuture semifuture_hkeys(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_hlen(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_hmget(std::unique_ptr<LaserKey> key,
+                                       std::unique_ptr<std::vector<std::string>> fields) override;
+  LaserResponseFuture semifuture_hset(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> field,
+                                      std::unique_ptr<std::string> value) override;
+  LaserResponseFuture semifuture_hmset(std::unique_ptr<LaserKey> key, std::unique_ptr<LaserValue> values) override;
+  LaserResponseFuture semifuture_hdel(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> field) override;
+  LaserResponseFuture semifuture_decr(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_incr(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_decrBy(std::unique_ptr<LaserKey> key, int64_t step) override;
+  LaserResponseFuture semifuture_incrBy(std::unique_ptr<LaserKey> key, int64_t step) override;
+  LaserResponseFuture semifuture_lindex(std::unique_ptr<LaserKey> key, int32_t index) override;
+  LaserResponseFuture semifuture_llen(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_lpop(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_lpush(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> value) override;
+  LaserResponseFuture semifuture_lrange(std::unique_ptr<LaserKey> key, int32_t start, int32_t end) override;
+  LaserResponseFuture semifuture_rpop(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_rpush(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> value) override;
+  LaserResponseFuture semifuture_sadd(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  LaserResponseFuture semifuture_sismember(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  LaserResponseFuture semifuture_sremove(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  LaserResponseFuture semifuture_smembers(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_zadd(std::unique_ptr<LaserKey> key,
+                                      std::unique_ptr<LaserValue> member_scores) override;
+  LaserResponseFuture semifuture_zrangeByScore(std::unique_ptr<LaserKey> key, int64_t min, int64_t max) override;
+  LaserResponseFuture semifuture_zremRangeByScore(std::unique_ptr<LaserKey> key, int64_t min, int64_t max) override;
+  LaserResponseFuture semifuture_zcard(std::unique_ptr<LaserKey> key) override;
+  LaserResponseFuture semifuture_zscore(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  LaserResponseFuture semifuture_zrem(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  LaserResponseFuture semifuture_zrank(std::unique_ptr<LaserKey> key, std::unique_ptr<std::string> member) override;
+  LaserResponseFuture semifuture_zrange(std::unique_ptr<LaserKey> key, int64_t start, int64_t stop) override;
 
  private:
   std::shared_ptr<metrics::Timers> laser_service_timers_;
   std::shared_ptr<ConfigManager> config_manager_;
   std::shared_ptr<DatabaseManager> database_manager_;
-  std::shared_ptr<TableTrafficRestrictionMap> traffic_restriction_config_;
-  std::shared_ptr<TableTrafficRestrictionMap> second_traffic_restriction_config_;
+  // 配置更新时整体替换，请求中先取出快照再使用
+  folly::atomic_shared_ptr<TableTrafficRestrictionMap> traffic_restriction_config_;
+  // 配置了令牌桶的表，配置更新时继承旧令牌桶的剩余令牌
+  folly::atomic_shared_ptr<TableTrafficLimiterMap> traffic_limiters_;
+  std::shared_ptr<metrics::Meter> throttled_meter_;
+  std::shared_ptr<ServiceExecutor> point_executor_;
+  std::shared_ptr<ServiceExecutor> scan_executor_;
+  std::shared_ptr<ServiceExecutor> fanout_executor_;
 
-  void commonCallEngine(std::unique_ptr<LaserKey> key, LaserServiceCallbackFunc func, const std::string& command_name);
+  // value_bytes 为写入的 value 大小，和 key 的大小一起计入令牌桶的字节数
+  void commonCallEngine(std::unique_ptr<LaserKey> key, LaserServiceCallbackFunc func, const std::string& command_name,
+                        uint64_t value_bytes = 0);
   void dispatchRequest(const std::vector<LaserKey>& keys, LaserServiceMultiDispatch func,
-                       const std::string& command_name);
+                       const std::string& command_name, const std::vector<LaserValue>* values = nullptr);
+  // 在 thrift 线程中取出请求的 client id，传递给线程池中执行的请求
+  LaserResponseFuture runRequest(const std::shared_ptr<ServiceExecutor>& executor, ServiceExecutorFunc func);
+  // 表上没有令牌桶或令牌充足时返回 true
+  bool consumeTrafficTokens(uint64_t table_hash, const std::string& command_name, uint64_t key_number,
+                            uint64_t bytes);
+  void refundTrafficTokens(uint64_t table_hash, const std::string& command_name, uint64_t key_number, uint64_t bytes);
+  // 按 partition 并行执行批量请求，task 只能写入各自 key 对应位置的结果
+  void runDispatchTasks(const std::unordered_map<RocksDbEngine*, std::vector<DispatchRequestItem>>& dispatch_keys,
+                        LaserServiceDispatchTask task);
   void updateTrafficRestrictionConfig(const TableTrafficRestrictionMap& traffic_restrictions);
 
-  virtual void getDatabaseEngine(std::shared_ptr<RocksDbEngine>* db, const std::unique_ptr<LaserKey>& key,
-                                 std::shared_ptr<LaserKeyFormat> format_key);
-  virtual std::shared_ptr<LaserKeyFormat> getFormatKey(const std::unique_ptr<LaserKey>& key);
+  virtual void getDatabaseEngine(std::shared_ptr<RocksDbEngine>* db, const LaserKey& key,
+                                 const LaserKeyFormat& format_key);
 };
 
 }  // namespace laser
@@ -18,12 +18,16 @@
  * @author liubang <it.liubang@gmail.com>
  */
 
+#include <limits>
+
 #include "boost/filesystem.hpp"
+#include "folly/ScopeGuard.h"
 
 #include "common/laser/if/gen-cpp2/ReplicatorAsyncClient.h"
 #include "common/laser/status.h"
 
 #include "database_manager.h"
+#include "engine/row_cache.h"
 #include "partition_handler.h"
 
 namespace laser {
@@ -34,9 +38,13 @@ DEFINE_int32(rocksdb_options_check_interval_ms, 5000, "Rocksdb option check inte
 DEFINE_int32(rocksdb_engine_destory_wait_interval_ms, 10, "Rocksdb engine destory wait interval");
 DEFINE_int32(finish_rocksdb_processing_operation_time_ms, 5,
              "Time wait for rocksdb finishing processing operations before closing");
+DEFINE_int32(ttl_sweep_max_keys_per_round, 1000, "Max expired keys deleted by one ttl sweep round of a partition");
+DEFINE_int32(row_cache_num_shard_bits, 4, "Number of shard bits of the partition row cache");
 
 uint32_t PartitionHandler::PARTITION_HANDLER_BASE_MAX_QUEUE_SIZE = 10;
 constexpr static char PARTITION_SIZE_PROPERTY[] = "rocksdb.live-sst-files-size";
+constexpr static char PARTITION_TTL_SWEEP_DELETED_PROPERTY[] = "laser.ttl-sweep-deleted";
+constexpr static char PARTITION_TTL_SWEEP_BACKLOG_PROPERTY[] = "laser.ttl-sweep-backlog";
 
 PartitionHandler::PartitionHandler(std::shared_ptr<Partition> partition, DatabaseManager* database_manager,
                                    DatabaseMetaInfo* database_meta_info, ReplicatorManager* replicator_manager,
@@ -316,6 +324,12 @@ bool PartitionHandler::createRocksDbEngine(std::shared_ptr<RocksDbEngine>* resul
     replication_db->init(self_hold_metrics_evb_);
   }
   setUpdateVersionCallback(replication_db);
+  // 每个版本的 db 使用独立的点查缓存，base 数据切换时旧缓存随旧 db 一起释放
+  uint64_t row_cache_capacity = versioned_options_.getRowCacheCapacity();
+  if (row_cache_capacity > 0) {
+    replication_db->setRowCache(std::make_shared<RowCache>(row_cache_capacity, FLAGS_row_cache_num_shard_bits));
+  }
+  replication_db->setSyncReplicas(versioned_options_.getSyncReplicas());
 
   auto db = std::make_shared<laser::RocksDbEngine>(replication_db, engine_options_);
   if (!db->open()) {
@@ -527,9 +541,34 @@ void PartitionHandler::getPartitionMetaInfo(PartitionMetaInfo* info) {
   }
 }
 
-void PartitionHandler::getPropertyKeys(std::vector<std::string>* keys) { ReplicationDB::getPropertyKeys(keys); }
+int64_t PartitionHandler::getReplicateLagMs() {
+  std::shared_ptr<ReplicationDB> replication_db;
+  {
+    folly::SpinLockGuard g(spinlock_);
+    if (db_) {
+      replication_db = db_->getReplicationDB().lock();
+    }
+  }
+  if (!replication_db) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return replication_db->getReplicateLagMs();
+}
+
+void PartitionHandler::getPropertyKeys(std::vector<std::string>* keys) {
+  ReplicationDB::getPropertyKeys(keys);
+  keys->push_back(PARTITION_TTL_SWEEP_DELETED_PROPERTY);
+  keys->push_back(PARTITION_TTL_SWEEP_BACKLOG_PROPERTY);
+}
 
 uint64_t PartitionHandler::getProperty(const std::string& key) {
+  if (key == PARTITION_TTL_SWEEP_DELETED_PROPERTY) {
+    return ttl_sweep_deleted_;
+  }
+  if (key == PARTITION_TTL_SWEEP_BACKLOG_PROPERTY) {
+    return ttl_sweep_backlog_;
+  }
+
   std::shared_ptr<ReplicationDB> replication_db;
   folly::SpinLockGuard g(spinlock_);
   if (db_) {
@@ -551,6 +590,46 @@ void PartitionHandler::forceBaseDataReplication() {
   }
 }
 
+void PartitionHandler::sweepExpiredKeys() {
+  std::shared_ptr<RocksDbEngine> db;
+  {
+    folly::SpinLockGuard g(spinlock_);
+    // follower 的过期 key 由 leader 的删除同步过来
+    if (partition_->getRole() != DBRole::LEADER) {
+      return;
+    }
+    db = db_;
+  }
+  if (!db) {
+    return;
+  }
+
+  uint32_t deleted = 0;
+  uint32_t backlog = 0;
+  Status status = db->sweepExpiredKeys(&deleted, &backlog, FLAGS_ttl_sweep_max_keys_per_round);
+  if (status != Status::OK) {
+    FB_LOG_EVERY_MS(ERROR, 1000) << "Sweep expired keys fail, partition:" << *partition_ << " status:" << status;
+  }
+  ttl_sweep_deleted_ = deleted;
+  ttl_sweep_backlog_ = backlog;
+}
+
+void PartitionHandler::scheduleSweepExpiredKeys(folly::Executor* executor) {
+  if (!executor || ttl_sweep_scheduled_.exchange(true)) {
+    return;
+  }
+
+  std::weak_ptr<PartitionHandler> handler = shared_from_this();
+  executor->add([handler]() {
+    auto partition_handler = handler.lock();
+    if (!partition_handler) {
+      return;
+    }
+    SCOPE_EXIT { partition_handler->ttl_sweep_scheduled_ = false; };
+    partition_handler->sweepExpiredKeys();
+  });
+}
+
 bool PartitionHandler::updateRocksdbOptions() {
   folly::SpinLockGuard g(spinlock_);
   bool has_changed = database_manager_->getRocksdbConfigFactory()->hasOptionsChanged(
@@ -105,9 +105,15 @@ class PartitionHandler : public std::enable_shared_from_this<PartitionHandler> {
     partition_ = partition;
   }
   virtual void getPartitionMetaInfo(PartitionMetaInfo* info);
+  // follower 的数据延迟，数据还没有加载时返回 int64_t 最大值
+  virtual int64_t getReplicateLagMs();
   virtual uint64_t getProperty(const std::string& key);
   static void getPropertyKeys(std::vector<std::string>* keys);
   virtual void forceBaseDataReplication();
+  // leader 按 TTL 索引清理一批已经过期的 key
+  virtual void sweepExpiredKeys();
+  // 提交一次清理任务到 executor，上一次任务没有执行完时跳过
+  virtual void scheduleSweepExpiredKeys(folly::Executor* executor);
 
  private:
   static uint32_t PARTITION_HANDLER_BASE_MAX_QUEUE_SIZE;
@@ -133,6 +139,9 @@ class PartitionHandler : public std::enable_shared_from_this<PartitionHandler> {
   // 会不断出发 wdt 全量同步，该标志是为了仅触发一次
   std::atomic_flag base_data_wdt_replicating_ = ATOMIC_FLAG_INIT;
   std::atomic_flag has_delay_wdt_replication_ = ATOMIC_FLAG_INIT;
+  std::atomic<uint64_t> ttl_sweep_deleted_{0};
+  std::atomic<uint64_t> ttl_sweep_backlog_{0};
+  std::atomic<bool> ttl_sweep_scheduled_{false};
 
  protected:
   virtual void triggerLoadData();
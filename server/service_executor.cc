@@ -0,0 +1,122 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#include "folly/executors/task_queue/LifoSemMPMCQueue.h"
+#include "folly/executors/task_queue/UnboundedBlockingQueue.h"
+#include "folly/executors/thread_factory/NamedThreadFactory.h"
+
+#include "common/laser/status.h"
+#include "common/util.h"
+
+#include "service_executor.h"
+
+namespace laser {
+
+constexpr char SERVICE_EXECUTOR_MODULE_NAME[] = "laser_service_executor";
+constexpr char SERVICE_EXECUTOR_TAG_POOL_NAME[] = "pool";
+constexpr char SERVICE_EXECUTOR_PENDING_TASKS[] = "pending_tasks";
+constexpr char SERVICE_EXECUTOR_QUEUE_WAIT_MS[] = "queue_wait_ms";
+constexpr char SERVICE_EXECUTOR_REJECTED[] = "rejected";
+constexpr uint32_t SERVICE_EXECUTOR_GAUGE_INTERVAL_MS = 1000;
+constexpr double SERVICE_EXECUTOR_TIMER_BUCKET_SIZE = 1.0;
+constexpr double SERVICE_EXECUTOR_TIMER_MIN = 0.0;
+constexpr double SERVICE_EXECUTOR_TIMER_MAX = 1000.0;
+
+ServiceExecutor::ServiceExecutor(const std::string& name, uint32_t thread_nums, uint32_t max_queue_size)
+    : name_(name) {
+  if (thread_nums == 0) {
+    return;
+  }
+
+  using CPUTask = folly::CPUThreadPoolExecutor::CPUTask;
+  std::unique_ptr<folly::BlockingQueue<CPUTask>> task_queue;
+  if (max_queue_size > 0) {
+    task_queue = std::make_unique<folly::LifoSemMPMCQueue<CPUTask, folly::QueueBehaviorIfFull::THROW>>(max_queue_size);
+  } else {
+    task_queue = std::make_unique<folly::UnboundedBlockingQueue<CPUTask>>();
+  }
+  thread_pool_ = std::make_shared<folly::CPUThreadPoolExecutor>(
+      thread_nums, std::move(task_queue), std::make_shared<folly::NamedThreadFactory>(name_));
+
+  std::unordered_map<std::string, std::string> tags = {{SERVICE_EXECUTOR_TAG_POOL_NAME, name_}};
+  auto metrics = metrics::Metrics::getInstance();
+  std::weak_ptr<folly::CPUThreadPoolExecutor> weak_pool = thread_pool_;
+  metrics->buildGauges(SERVICE_EXECUTOR_MODULE_NAME, SERVICE_EXECUTOR_PENDING_TASKS, SERVICE_EXECUTOR_GAUGE_INTERVAL_MS,
+                       [weak_pool]() {
+                         auto pool = weak_pool.lock();
+                         if (!pool) {
+                           return 0.0;
+                         }
+                         return static_cast<double>(pool->getTaskQueueSize());
+                       },
+                       tags);
+  queue_wait_ms_ = metrics->buildHistograms(SERVICE_EXECUTOR_MODULE_NAME, SERVICE_EXECUTOR_QUEUE_WAIT_MS,
+                                            SERVICE_EXECUTOR_TIMER_BUCKET_SIZE, SERVICE_EXECUTOR_TIMER_MIN,
+                                            SERVICE_EXECUTOR_TIMER_MAX, tags);
+  rejected_ = metrics->buildMeter(SERVICE_EXECUTOR_MODULE_NAME, SERVICE_EXECUTOR_REJECTED, tags);
+}
+
+ServiceExecutor::~ServiceExecutor() { stop(); }
+
+void ServiceExecutor::stop() {
+  if (thread_pool_) {
+    thread_pool_->stop();
+  }
+}
+
+uint64_t ServiceExecutor::getPendingTaskCount() {
+  if (!thread_pool_) {
+    return 0;
+  }
+  return thread_pool_->getTaskQueueSize();
+}
+
+folly::SemiFuture<std::unique_ptr<LaserResponse>> ServiceExecutor::run(ServiceExecutorFunc func) {
+  auto response = std::make_unique<LaserResponse>();
+  LaserResponse* response_ptr = response.get();
+  return runTask([func = std::move(func), response_ptr]() mutable { func(*response_ptr); })
+      .deferValue([response = std::move(response)](folly::Unit) mutable { return std::move(response); })
+      .deferError(folly::tag_t<folly::QueueFullException>{},
+                  [name = name_](const folly::QueueFullException&) -> std::unique_ptr<LaserResponse> {
+                    throw createLaserException(Status::RS_BUSY,
+                                               folly::to<std::string>("Service executor ", name, " is busy"));
+                  });
+}
+
+folly::SemiFuture<folly::Unit> ServiceExecutor::runTask(folly::Function<void()> func) {
+  if (!thread_pool_) {
+    return folly::makeSemiFutureWith(std::move(func));
+  }
+
+  folly::Promise<folly::Unit> promise;
+  auto future = promise.getSemiFuture();
+  int64_t enqueue_ms = static_cast<int64_t>(common::currentTimeInMs());
+  try {
+    thread_pool_->add([this, promise = std::move(promise), func = std::move(func), enqueue_ms]() mutable {
+      int64_t wait_ms = static_cast<int64_t>(common::currentTimeInMs()) - enqueue_ms;
+      queue_wait_ms_->addValue(static_cast<double>(std::max(wait_ms, static_cast<int64_t>(0))));
+      promise.setWith(std::move(func));
+    });
+  } catch (const folly::QueueFullException& ex) {
+    rejected_->mark();
+    return folly::makeSemiFuture<folly::Unit>(ex);
+  }
+  return future;
+}
+
+}  // namespace laser
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#pragma once
+
+#include "folly/Function.h"
+#include "folly/executors/CPUThreadPoolExecutor.h"
+#include "folly/futures/Future.h"
+
+#include "common/laser/if/gen-cpp2/laser_types.h"
+#include "common/metrics/metrics.h"
+
+namespace laser {
+
+using ServiceExecutorFunc = folly::Function<void(LaserResponse&)>;
+
+// LaserService 访问 engine 的线程池，thrift worker 只负责把请求投递到线程池，队列满时直接返回 RS_BUSY
+class ServiceExecutor {
+ public:
+  // thread_nums 为 0 时在调用线程中同步执行，max_queue_size 为 0 时队列不限长度
+  ServiceExecutor(const std::string& name, uint32_t thread_nums, uint32_t max_queue_size);
+  virtual ~ServiceExecutor();
+
+  virtual folly::SemiFuture<std::unique_ptr<LaserResponse>> run(ServiceExecutorFunc func);
+  // 队列满时返回 folly::QueueFullException，由调用方决定失败还是在当前线程执行
+  virtual folly::SemiFuture<folly::Unit> runTask(folly::Function<void()> func);
+  bool isAsync() const { return thread_pool_ != nullptr; }
+  virtual void stop();
+  uint64_t getPendingTaskCount();
+
+ private:
+  std::string name_;
+  std::shared_ptr<folly::CPUThreadPoolExecutor> thread_pool_;
+  std::shared_ptr<metrics::Histograms> queue_wait_ms_;
+  std::shared_ptr<metrics::Meter> rejected_;
+};
+
+}  // namespace laser
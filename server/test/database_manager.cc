@@ -28,6 +28,7 @@
 class MockConfigManager : public laser::ConfigManager {
  public:
   explicit MockConfigManager(const std::shared_ptr<service_router::Router> router) : laser::ConfigManager(router) {}
+  MOCK_CONST_METHOD0(getTableSchemas, std::shared_ptr<laser::TableSchemasMap>());
 };
 
 class MockRouter : public service_router::Router {
@@ -94,9 +95,9 @@ class MockTableMonitor : public laser::TableMonitor {
   laser::NotifyPartitionLoadBaseData load_callback_;
 };
 
-class MockDatabaseManager : public laser::DatabaseManager {
+class MockDatabaseManagerBase : public laser::DatabaseManager {
  public:
-  MockDatabaseManager(std::shared_ptr<MockConfigManager> config, const std::string& group_name, uint32_t node_id)
+  MockDatabaseManagerBase(std::shared_ptr<MockConfigManager> config, const std::string& group_name, uint32_t node_id)
       : laser::DatabaseManager(config, group_name, node_id, "default") {
     config_ = config;
   }
@@ -105,14 +106,29 @@ class MockDatabaseManager : public laser::DatabaseManager {
   MOCK_METHOD2(getOrCreateTableMonitor, std::shared_ptr<laser::TableMonitor>(const std::string&, const std::string&));
   MOCK_METHOD0(createReplicatorManager, std::shared_ptr<laser::ReplicatorManager>());
   MOCK_METHOD0(createRocksDbConfigFactory, std::shared_ptr<laser::RocksDbConfigFactory>());
-  MOCK_METHOD1(getOrCreatePartitionHandler,
-               std::shared_ptr<laser::PartitionHandler>(const std::shared_ptr<laser::Partition>&));
   MOCK_METHOD0(createDatabaseMetaInfo, std::shared_ptr<laser::DatabaseMetaInfo>());
 
  private:
   std::shared_ptr<MockConfigManager> config_;
 };
 
+class MockDatabaseManager : public MockDatabaseManagerBase {
+ public:
+  MockDatabaseManager(std::shared_ptr<MockConfigManager> config, const std::string& group_name, uint32_t node_id)
+      : MockDatabaseManagerBase(config, group_name, node_id) {}
+  MOCK_METHOD1(getOrCreatePartitionHandler,
+               std::shared_ptr<laser::PartitionHandler>(const std::shared_ptr<laser::Partition>&));
+};
+
+// 只 mock handler 的创建，partition handler 的管理和路由表的重建走真实逻辑
+class MockRouteDatabaseManager : public MockDatabaseManagerBase {
+ public:
+  MockRouteDatabaseManager(std::shared_ptr<MockConfigManager> config, const std::string& group_name, uint32_t node_id)
+      : MockDatabaseManagerBase(config, group_name, node_id) {}
+  MOCK_METHOD1(createPartitionHandler,
+               std::shared_ptr<laser::PartitionHandler>(const std::shared_ptr<laser::Partition>&));
+};
+
 class DatabaseManagerTest : public ::testing::Test {
  public:
   DatabaseManagerTest() {
@@ -126,17 +142,20 @@ class DatabaseManagerTest : public ::testing::Test {
   virtual void TearDown() {}
   virtual void SetUp() { database_manager_ = std::make_shared<MockDatabaseManager>(config_, "test_group", 1); }
 
-  void initTest() {
+  void initTest() { initTest(database_manager_); }
+
+  template <typename T>
+  void initTest(const std::shared_ptr<T>& database_manager) {
     rocksdb_config_factory_ = std::make_shared<MockRocksDbConfigFactory>();
     EXPECT_CALL(*rocksdb_config_factory_, getDefaultOptions()).WillRepeatedly(::testing::Return(rocksdb::Options()));
-    EXPECT_CALL(*database_manager_, createRocksDbConfigFactory())
+    EXPECT_CALL(*database_manager, createRocksDbConfigFactory())
         .Times(1)
         .WillOnce(::testing::Return(rocksdb_config_factory_));
 
     partition_manager_ = std::make_shared<MockPartitionManager>(config_);
     auto replicator_manager_ = std::make_shared<MockReplicatorManager>();
-    EXPECT_CALL(*database_manager_, createPartitionManager()).Times(1).WillOnce(::testing::Return(partition_manager_));
-    EXPECT_CALL(*database_manager_, createReplicatorManager())
+    EXPECT_CALL(*database_manager, createPartitionManager()).Times(1).WillOnce(::testing::Return(partition_manager_));
+    EXPECT_CALL(*database_manager, createReplicatorManager())
         .Times(1)
         .WillOnce(::testing::Return(replicator_manager_));
 
@@ -146,7 +165,7 @@ class DatabaseManagerTest : public ::testing::Test {
     EXPECT_CALL(*replicator_manager_,
                 init(::testing::Eq(replicator_name), ::testing::Eq(host_name), ::testing::Eq(port), ::testing::_, ::testing::_))
         .Times(1);
-    database_manager_->init(1, replicator_name, host_name, port);
+    database_manager->init(1, replicator_name, host_name, port);
   }
 
  protected:
@@ -296,3 +315,67 @@ TEST_F(DatabaseManagerTest, trigger) {
 
   database_manager_->triggerBase(database_name, table_name, version);
 }
+
+TEST_F(DatabaseManagerTest, tableRoutes) {
+  auto database_manager = std::make_shared<MockRouteDatabaseManager>(config_, "test_group", 1);
+  initTest(database_manager);
+  std::string database_name = "test";
+  std::string table_name = "user_info";
+  auto monitor = std::make_shared<MockTableMonitor>(hdfs_monitor_manager_);
+  EXPECT_CALL(*database_manager, getOrCreateTableMonitor(::testing::_)).WillRepeatedly(::testing::Return(monitor));
+  EXPECT_CALL(*monitor, addPartition(::testing::_)).Times(::testing::AnyNumber());
+  EXPECT_CALL(*monitor, removePartition(::testing::_)).Times(::testing::AnyNumber());
+
+  laser::TableSchema table;
+  table.setDatabaseName(database_name);
+  table.setTableName(table_name);
+  table.setPartitionNumber(4);
+  auto table_schemas = std::make_shared<laser::TableSchemasMap>();
+  uint64_t table_hash = config_->getTableSchemaHash(database_name, table_name);
+  (*table_schemas)[table_hash] = std::make_shared<laser::TableSchema>(table);
+  EXPECT_CALL(*config_, getTableSchemas()).WillRepeatedly(::testing::Return(table_schemas));
+
+  std::unordered_map<uint32_t, std::shared_ptr<MockPartitionHandler>> created_handlers;
+  EXPECT_CALL(*database_manager, createPartitionHandler(::testing::_))
+      .Times(2)
+      .WillRepeatedly(::testing::Invoke([&created_handlers](const std::shared_ptr<laser::Partition>& partition) {
+        auto handler = std::make_shared<MockPartitionHandler>(partition);
+        EXPECT_CALL(*handler, getPartition()).WillRepeatedly(::testing::Return(partition));
+        created_handlers[partition->getPartitionId()] = handler;
+        return handler;
+      }));
+
+  EXPECT_CALL(*partition_manager_, getLeaderShardList())
+      .WillRepeatedly(::testing::Return(std::vector<uint32_t>({0, 1, 2, 3})));
+  EXPECT_CALL(*partition_manager_, getFollowerShardList()).WillRepeatedly(::testing::Return(std::vector<uint32_t>()));
+  auto meta_info = std::make_shared<MockDatabaseMetaInfo>();
+  EXPECT_CALL(*database_manager, createDatabaseMetaInfo()).Times(1).WillOnce(::testing::Return(meta_info));
+  EXPECT_CALL(*meta_info, init(::testing::_)).Times(1).WillOnce(::testing::Return(true));
+
+  auto part0 = std::make_shared<laser::Partition>(database_name, table_name, 0);
+  auto part2 = std::make_shared<laser::Partition>(database_name, table_name, 2);
+  database_manager->updatePartitions(laser::PartitionPtrSet({part0, part2}), laser::PartitionPtrSet());
+
+  auto routes = database_manager->getTableRoutes();
+  auto route = routes->find(table_hash);
+  ASSERT_NE(routes->end(), route);
+  EXPECT_EQ(4u, route->second.partition_number);
+  ASSERT_EQ(4u, route->second.handlers.size());
+  EXPECT_EQ(created_handlers[0], route->second.handlers[0]);
+  EXPECT_EQ(nullptr, route->second.handlers[1]);
+  EXPECT_EQ(created_handlers[2], route->second.handlers[2]);
+  EXPECT_EQ(nullptr, route->second.handlers[3]);
+
+  // 卸载 partition 后重新发布路由，旧的路由快照保持不变
+  database_manager->updatePartitions(laser::PartitionPtrSet(), laser::PartitionPtrSet({part2}));
+  auto new_routes = database_manager->getTableRoutes();
+  EXPECT_EQ(created_handlers[0], new_routes->at(table_hash).handlers[0]);
+  EXPECT_EQ(nullptr, new_routes->at(table_hash).handlers[2]);
+  EXPECT_EQ(created_handlers[2], route->second.handlers[2]);
+
+  // 表的 schema 删除后路由随之删除
+  EXPECT_CALL(*config_, getTableSchemas())
+      .WillRepeatedly(::testing::Return(std::make_shared<laser::TableSchemasMap>()));
+  database_manager->updatePartitions(laser::PartitionPtrSet(), laser::PartitionPtrSet());
+  EXPECT_EQ(database_manager->getTableRoutes()->end(), database_manager->getTableRoutes()->find(table_hash));
+}
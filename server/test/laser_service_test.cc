@@ -20,9 +20,13 @@
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include "folly/synchronization/Baton.h"
 #include "laser/server/laser_service.h"
 
 DECLARE_string(vmodule);
+namespace laser {
+DECLARE_int32(laser_service_fanout_min_keys);
+}
 class MockRocksDbEngine : public laser::RocksDbEngine {
  public:
   MockRocksDbEngine() : laser::RocksDbEngine(nullptr) {}
@@ -30,13 +34,17 @@ class MockRocksDbEngine : public laser::RocksDbEngine {
   MOCK_METHOD2(get, laser::Status(laser::LaserValueCounter* value, const laser::LaserKeyFormat& key));
   MOCK_METHOD2(get, laser::Status(laser::LaserValueListMeta* value, const laser::LaserKeyFormat& key));
   MOCK_METHOD2(get, laser::Status(laser::LaserValueSetMeta* value, const laser::LaserKeyFormat& key));
+  MOCK_METHOD3(mget, laser::Status(std::vector<laser::Status>* statuses, std::vector<laser::LaserValueRawString>* values,
+                                   const std::vector<const laser::LaserKeyFormat*>& keys));
   MOCK_METHOD2(set, laser::Status(const laser::LaserKeyFormat& key, const std::string& data));
-  MOCK_METHOD2(mset,
-               laser::Status(const std::vector<laser::LaserKeyFormat>& keys, const std::vector<std::string>& data));
+  MOCK_METHOD2(mset, laser::Status(const std::vector<const laser::LaserKeyFormat*>& keys,
+                                   const std::vector<std::string>& data));
   MOCK_METHOD3(hget, laser::Status(laser::LaserValueRawString* value, const laser::LaserKeyFormat& key,
                                    const std::string& field));
   MOCK_METHOD2(hgetall, laser::Status(std::unordered_map<std::string, laser::LaserValueRawString>* values,
                                       const laser::LaserKeyFormat& key));
+  MOCK_METHOD3(hmget, laser::Status(std::unordered_map<std::string, laser::LaserValueRawString>* values,
+                                    const laser::LaserKeyFormat& key, const std::vector<std::string>& fields));
   MOCK_METHOD3(decr, laser::Status(int64_t* value, const laser::LaserKeyFormat& key, uint64_t step));
   MOCK_METHOD3(incr, laser::Status(int64_t* value, const laser::LaserKeyFormat& key, uint64_t step));
   MOCK_METHOD2(hexists, laser::Status(const laser::LaserKeyFormat& key, const std::string& field));
@@ -48,7 +56,7 @@ class MockRocksDbEngine : public laser::RocksDbEngine {
                laser::Status(laser::LaserValueRawString* value, const laser::LaserKeyFormat& key, int64_t index));
   MOCK_METHOD2(llen, laser::Status(laser::LaserValueListMeta* value, const laser::LaserKeyFormat& key));
   MOCK_METHOD4(lrange, laser::Status(std::vector<laser::LaserValueRawString>* values, const laser::LaserKeyFormat& key,
-                                     uint64_t start, uint64_t end));
+                                     int64_t start, int64_t end));
   MOCK_METHOD2(sadd, laser::Status(const laser::LaserKeyFormat& key, const std::string& member));
   MOCK_METHOD2(hasMember, laser::Status(const laser::LaserKeyFormat& key, const std::string& member));
   MOCK_METHOD2(sdel, laser::Status(const laser::LaserKeyFormat& key, const std::string& member));
@@ -60,6 +68,12 @@ class MockRocksDbEngine : public laser::RocksDbEngine {
                                             const laser::LaserKeyFormat& key, int64_t min, int64_t max));
   MOCK_METHOD4(zremRangeByScore,
                laser::Status(int64_t* number, const laser::LaserKeyFormat& key, int64_t min, int64_t max));
+  MOCK_METHOD3(zscore, laser::Status(int64_t* score, const laser::LaserKeyFormat& key, const std::string& member));
+  MOCK_METHOD2(zrem, laser::Status(const laser::LaserKeyFormat& key, const std::string& member));
+  MOCK_METHOD2(get, laser::Status(laser::LaserValueZSetMeta* value, const laser::LaserKeyFormat& key));
+  MOCK_METHOD3(zrank, laser::Status(int64_t* rank, const laser::LaserKeyFormat& key, const std::string& member));
+  MOCK_METHOD4(zrange, laser::Status(std::vector<laser::LaserScoreMember>* score_members,
+                                     const laser::LaserKeyFormat& key, int64_t start, int64_t stop));
 };
 
 class MockConfigManager : public laser::ConfigManager {
@@ -73,8 +87,22 @@ class MockLaserService : public laser::LaserService {
  public:
   explicit MockLaserService(std::shared_ptr<laser::ConfigManager> config_manager)
       : laser::LaserService(config_manager, nullptr) {}
-  MOCK_METHOD3(getDatabaseEngine, void(std::shared_ptr<laser::RocksDbEngine>*, const std::unique_ptr<laser::LaserKey>&,
-                                       std::shared_ptr<laser::LaserKeyFormat>));
+  MOCK_METHOD3(getDatabaseEngine,
+               void(std::shared_ptr<laser::RocksDbEngine>*, const laser::LaserKey&, const laser::LaserKeyFormat&));
+};
+
+class MockRoutePartitionHandler : public laser::PartitionHandler {
+ public:
+  explicit MockRoutePartitionHandler(std::shared_ptr<laser::Partition> part)
+      : laser::PartitionHandler(part, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr) {}
+  MOCK_METHOD0(getDatabase, std::weak_ptr<laser::RocksDbEngine>());
+};
+
+class MockRouteDatabaseManager : public laser::DatabaseManager {
+ public:
+  explicit MockRouteDatabaseManager(std::shared_ptr<laser::ConfigManager> config_manager)
+      : laser::DatabaseManager(config_manager, "test_group", 1, "default") {}
+  MOCK_METHOD0(getTableRoutes, std::shared_ptr<const laser::TableRouteMap>());
 };
 
 class LaserServiceTest : public ::testing::Test {
@@ -124,9 +152,7 @@ class LaserServiceTest : public ::testing::Test {
 };
 
 TEST_F(LaserServiceTest, get) {
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(2)
       .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
 
@@ -140,10 +166,94 @@ TEST_F(LaserServiceTest, get) {
   EXPECT_THROW({ service_->get(response, createLaserKey()); }, laser::LaserException);
 }
 
+// 异步接口在线程池中执行，engine 返回的错误通过 future 传递
+TEST_F(LaserServiceTest, semifutureGet) {
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
+      .Times(2)
+      .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
+
+  laser::LaserValueRawString value("foo");
+  EXPECT_CALL(*db_engine_, get(::testing::Matcher<laser::LaserValueRawString*>(::testing::_), ::testing::_))
+      .Times(2)
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(value), ::testing::Return(laser::Status::OK)))
+      .WillOnce(::testing::Return(laser::Status::RS_NOT_FOUND));
+
+  auto response = service_->semifuture_get(createLaserKey()).get();
+  EXPECT_EQ("foo", response->get_string_data());
+  EXPECT_THROW({ service_->semifuture_get(createLaserKey()).get(); }, laser::LaserException);
+}
+
+// 不 mock getDatabaseEngine，按真实的路由表查找 partition 对应的 engine
+TEST_F(LaserServiceTest, tableRoutes) {
+  auto database_manager = std::make_shared<MockRouteDatabaseManager>(config_manager_);
+  laser::LaserService service(config_manager_, database_manager);
+
+  auto key = createLaserKey();
+  laser::LaserKeyFormat format_key(key->get_primary_keys(), key->get_column_keys());
+  uint32_t partition_number = 4;
+  uint32_t partition_id =
+      laser::PartitionManager::getPartitionId(database_name_, table_name_, format_key, partition_number);
+  auto partition = std::make_shared<laser::Partition>(database_name_, table_name_, partition_id);
+  auto handler = std::make_shared<MockRoutePartitionHandler>(partition);
+  EXPECT_CALL(*handler, getDatabase()).WillRepeatedly(::testing::Return(db_engine_));
+
+  auto routes = std::make_shared<laser::TableRouteMap>();
+  auto& route = (*routes)[0];
+  route.partition_number = partition_number;
+  route.handlers.resize(partition_number);
+  route.handlers[partition_id] = handler;
+  auto empty_routes = std::make_shared<laser::TableRouteMap>();
+  (*empty_routes)[0] = laser::TableRoute{partition_number, std::vector<std::shared_ptr<laser::PartitionHandler>>(
+                                                               partition_number)};
+  EXPECT_CALL(*database_manager, getTableRoutes())
+      .Times(3)
+      .WillOnce(::testing::Return(routes))
+      .WillOnce(::testing::Return(empty_routes))
+      .WillOnce(::testing::Return(std::make_shared<laser::TableRouteMap>()));
+
+  laser::LaserValueRawString value("foo");
+  EXPECT_CALL(*db_engine_, get(::testing::Matcher<laser::LaserValueRawString*>(::testing::_), ::testing::_))
+      .Times(1)
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(value), ::testing::Return(laser::Status::OK)));
+
+  laser::LaserResponse response;
+  service.get(response, createLaserKey());
+  EXPECT_EQ("foo", response.get_string_data());
+
+  // partition 没有挂载或表没有路由时都返回 SERVICE_NOT_EXISTS_PARTITION
+  for (int i = 0; i < 2; i++) {
+    try {
+      service.get(response, createLaserKey());
+      FAIL();
+    } catch (const laser::LaserException& e) {
+      EXPECT_EQ(laser::Status::SERVICE_NOT_EXISTS_PARTITION, e.get_status());
+    }
+  }
+}
+
+// 队列已满时直接返回 RS_BUSY，不在调用线程中执行
+TEST(ServiceExecutorTest, rejectWhenQueueFull) {
+  folly::SingletonVault::singleton()->registrationComplete();
+  laser::ServiceExecutor executor("TestPool", 1, 1);
+  folly::Baton<> running;
+  folly::Baton<> release;
+  auto first = executor.run([&running, &release](laser::LaserResponse&) {
+    running.post();
+    release.wait();
+  });
+  running.wait();
+  auto second = executor.run([](laser::LaserResponse& response) { response.set_int_data(1); });
+  auto third = executor.run([](laser::LaserResponse&) {});
+  auto result = std::move(third).getTry();
+  EXPECT_TRUE(result.hasException<laser::LaserException>());
+  EXPECT_EQ(laser::Status::RS_BUSY, result.exception().get_exception<laser::LaserException>()->get_status());
+  release.post();
+  std::move(first).get();
+  EXPECT_EQ(1, std::move(second).get()->get_int_data());
+}
+
 TEST_F(LaserServiceTest, sset) {
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(2)
       .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
   EXPECT_CALL(*db_engine_, set(::testing::_, ::testing::_))
@@ -158,17 +268,19 @@ TEST_F(LaserServiceTest, sset) {
 }
 
 TEST_F(LaserServiceTest, mget) {
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(4)
       .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
 
+  std::vector<laser::Status> statuses(
+      {laser::Status::RS_NOT_FOUND, laser::Status::OK, laser::Status::OK, laser::Status::OK});
   laser::LaserValueRawString raw_string(value_);
-  EXPECT_CALL(*db_engine_, get(::testing::Matcher<laser::LaserValueRawString*>(::testing::_), ::testing::_))
-      .Times(4)
-      .WillOnce(::testing::Return(laser::Status::RS_NOT_FOUND))
-      .WillRepeatedly(::testing::DoAll(::testing::SetArgPointee<0>(raw_string), ::testing::Return(laser::Status::OK)));
+  raw_string.decode();
+  std::vector<laser::LaserValueRawString> raw_values(4, raw_string);
+  EXPECT_CALL(*db_engine_, mget(::testing::_, ::testing::_, ::testing::SizeIs(4)))
+      .Times(1)
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(statuses), ::testing::SetArgPointee<1>(raw_values),
+                                 ::testing::Return(laser::Status::OK)));
 
   laser::LaserResponse response;
   std::unique_ptr<laser::LaserKeys> keys = std::make_unique<laser::LaserKeys>();
@@ -190,10 +302,49 @@ TEST_F(LaserServiceTest, mget) {
   }
 }
 
+// 多个 partition 的批量请求并行执行，结果按 key 的顺序返回
+TEST_F(LaserServiceTest, mgetFanout) {
+  laser::FLAGS_laser_service_fanout_min_keys = 1;
+  auto other_engine = std::make_shared<MockRocksDbEngine>();
+  std::shared_ptr<laser::RocksDbEngine> first_engine = db_engine_;
+  std::shared_ptr<laser::RocksDbEngine> second_engine = other_engine;
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
+      .Times(4)
+      .WillOnce(::testing::SetArgPointee<0>(first_engine))
+      .WillOnce(::testing::SetArgPointee<0>(second_engine))
+      .WillOnce(::testing::SetArgPointee<0>(first_engine))
+      .WillOnce(::testing::SetArgPointee<0>(second_engine));
+
+  std::vector<laser::Status> statuses({laser::Status::OK, laser::Status::OK});
+  laser::LaserValueRawString first_value("first");
+  laser::LaserValueRawString second_value("second");
+  std::vector<laser::LaserValueRawString> first_values(2, first_value);
+  std::vector<laser::LaserValueRawString> second_values(2, second_value);
+  EXPECT_CALL(*db_engine_, mget(::testing::_, ::testing::_, ::testing::SizeIs(2)))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(statuses), ::testing::SetArgPointee<1>(first_values),
+                                 ::testing::Return(laser::Status::OK)));
+  EXPECT_CALL(*other_engine, mget(::testing::_, ::testing::_, ::testing::SizeIs(2)))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(statuses), ::testing::SetArgPointee<1>(second_values),
+                                 ::testing::Return(laser::Status::OK)));
+
+  laser::LaserResponse response;
+  std::unique_ptr<laser::LaserKeys> keys = std::make_unique<laser::LaserKeys>();
+  std::vector<laser::LaserKey> vector_key;
+  for (auto i = 0; i < 4; i++) {
+    vector_key.push_back(*createLaserKey());
+  }
+  keys->set_keys(std::move(vector_key));
+  service_->mget(response, std::move(keys));
+  auto result_list = response.get_list_value_data();
+  ASSERT_EQ(4, result_list.size());
+  for (size_t i = 0; i < result_list.size(); i++) {
+    EXPECT_EQ(i % 2 == 0 ? "first" : "second", result_list[i].get_string_value());
+  }
+  laser::FLAGS_laser_service_fanout_min_keys = 64;
+}
+
 TEST_F(LaserServiceTest, mset) {
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(4)
       .WillOnce(::testing::SetArgPointee<0>(nullptr))
       .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
@@ -219,9 +370,7 @@ TEST_F(LaserServiceTest, mset) {
 }
 
 TEST_F(LaserServiceTest, hget) {
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(2)
       .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
   EXPECT_CALL(*db_engine_,
@@ -245,9 +394,7 @@ TEST_F(LaserServiceTest, hgetall) {
     values[folly::to<std::string>(field_prefix, i)] = value;
   }
 
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(2)
       .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
 
@@ -264,9 +411,7 @@ TEST_F(LaserServiceTest, hgetall) {
 }
 
 TEST_F(LaserServiceTest, zadd) {
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(1)
       .WillOnce(::testing::SetArgPointee<0>(db_engine_));
 
@@ -292,9 +437,7 @@ TEST_F(LaserServiceTest, zrangeByScore) {
   score_member.set_score(2);
   score_member.set_member("two");
   score_members.push_back(score_member);
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(2)
       .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
 
@@ -321,9 +464,7 @@ TEST_F(LaserServiceTest, zrangeByScore) {
 
 TEST_F(LaserServiceTest, zremRangeByScore) {
   int64_t number = 3;
-  EXPECT_CALL(*service_,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(2)
       .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
 
@@ -342,6 +483,40 @@ TEST_F(LaserServiceTest, zremRangeByScore) {
   EXPECT_EQ(3, response.get_int_data());
 }
 
+TEST_F(LaserServiceTest, zscore) {
+  int64_t score = 10;
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
+      .Times(2)
+      .WillRepeatedly(::testing::SetArgPointee<0>(db_engine_));
+
+  EXPECT_CALL(*db_engine_, zscore(::testing::_, ::testing::_, ::testing::_))
+      .Times(2)
+      .WillOnce(::testing::Return(laser::Status::RS_NOT_FOUND))
+      .WillRepeatedly(::testing::DoAll(::testing::SetArgPointee<0>(score), ::testing::Return(laser::Status::OK)));
+
+  laser::LaserResponse response;
+  EXPECT_THROW(service_->zscore(response, createLaserKey(), std::make_unique<std::string>("one")),
+               laser::LaserException);
+  service_->zscore(response, createLaserKey(), std::make_unique<std::string>("one"));
+  EXPECT_EQ(10, response.get_int_data());
+}
+
+TEST_F(LaserServiceTest, zcard) {
+  EXPECT_CALL(*service_, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
+      .Times(1)
+      .WillOnce(::testing::SetArgPointee<0>(db_engine_));
+
+  EXPECT_CALL(*db_engine_,
+              get(::testing::Matcher<laser::LaserValueZSetMeta*>(::testing::_), ::testing::_))
+      .Times(1)
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(laser::LaserValueZSetMeta(3)),
+                                 ::testing::Return(laser::Status::OK)));
+
+  laser::LaserResponse response;
+  EXPECT_NO_THROW(service_->zcard(response, createLaserKey()));
+  EXPECT_EQ(3, response.get_int_data());
+}
+
 /*
 TEST(LaserService, decr) {
   MockLaserService service;
@@ -351,9 +526,7 @@ TEST(LaserService, decr) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -404,9 +577,7 @@ TEST(LaserService, counter_incr) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -457,9 +628,7 @@ TEST(LaserService, hexists) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -517,9 +686,7 @@ TEST(LaserService, hset) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -585,9 +752,7 @@ TEST(LaserService, hkeys) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -639,9 +804,7 @@ TEST(LaserService, hlen) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -692,9 +855,7 @@ TEST(LaserService, lindex) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -748,9 +909,7 @@ TEST(LaserService, llen) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -801,9 +960,7 @@ TEST(LaserService, lrange) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -857,9 +1014,7 @@ TEST(LaserService, sadd) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -912,9 +1067,7 @@ TEST(LaserService, sismember) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -967,9 +1120,7 @@ TEST(LaserService, sdel) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -1022,9 +1173,7 @@ TEST(LaserService, smembers) {
   std::string database_name = "test";
   std::string table_name = "user";
 
-  EXPECT_CALL(service,
-              getDatabaseEngine(::testing::_, ::testing::Matcher<const std::unique_ptr<laser::LaserKey>&>(::testing::_),
-                                ::testing::_))
+  EXPECT_CALL(service, getDatabaseEngine(::testing::_, ::testing::_, ::testing::_))
       .Times(3)
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(true)))
       .WillOnce(::testing::DoAll(::testing::SetArgPointee<0>(db_engine), ::testing::Return(false)))
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#include "gtest/gtest.h"
+
+#include "laser/server/traffic_limiter.h"
+
+static laser::TrafficTokenBucketConfig makeBucketConfig(const laser::TrafficOperationType& type,
+                                                        const std::string& client_id, uint32_t keys_per_second,
+                                                        uint32_t keys_burst) {
+  laser::TrafficTokenBucketConfig config;
+  config.setOperationType(type);
+  config.setClientId(client_id);
+  config.setKeysPerSecond(keys_per_second);
+  config.setKeysBurst(keys_burst);
+  return config;
+}
+
+TEST(TrafficTokenBucket, burstAndRefill) {
+  auto config = makeBucketConfig(laser::TrafficOperationType::READ, "", 10, 20);
+  config.setBytesPerSecond(1000);
+  laser::TrafficTokenBucket bucket(config);
+
+  double now = 100.0;
+  EXPECT_TRUE(bucket.consume(20, 100, now));
+  EXPECT_FALSE(bucket.consume(1, 0, now));
+  // 半秒之后补充 5 个 key
+  EXPECT_FALSE(bucket.consume(6, 0, now + 0.5));
+  EXPECT_TRUE(bucket.consume(5, 0, now + 0.5));
+  // 超过 burst 的批量请求在令牌桶满时可以通过
+  EXPECT_TRUE(bucket.consume(100, 0, now + 10));
+
+  // 字节数不足时不扣减 key 的令牌
+  EXPECT_TRUE(bucket.consume(1, 950, now + 20));
+  EXPECT_FALSE(bucket.consume(19, 100, now + 20));
+  EXPECT_TRUE(bucket.consume(19, 50, now + 20));
+  EXPECT_FALSE(bucket.consume(1, 0, now + 20));
+
+  bucket.refund(1, 0);
+  EXPECT_TRUE(bucket.consume(1, 0, now + 20));
+}
+
+TEST(TableTrafficLimiter, matchOperationAndClient) {
+  laser::TableTrafficRestrictionConfig config;
+  config.setTokenBuckets({makeBucketConfig(laser::TrafficOperationType::WRITE, "", 1, 10),
+                          makeBucketConfig(laser::TrafficOperationType::READ, "client_a", 1, 5)});
+  laser::TableTrafficLimiter limiter(config, nullptr);
+  EXPECT_FALSE(limiter.empty());
+
+  // 读请求只受 client_a 的令牌桶限制
+  EXPECT_TRUE(limiter.consume(laser::TrafficOperationType::READ, "client_b", 100, 0));
+  EXPECT_TRUE(limiter.consume(laser::TrafficOperationType::READ, "client_a", 5, 0));
+  EXPECT_FALSE(limiter.consume(laser::TrafficOperationType::READ, "client_a", 5, 0));
+
+  // 所有客户端共享写令牌桶，被拒绝的请求不扣减令牌
+  EXPECT_TRUE(limiter.consume(laser::TrafficOperationType::WRITE, "client_a", 6, 0));
+  EXPECT_FALSE(limiter.consume(laser::TrafficOperationType::WRITE, "client_b", 6, 0));
+  EXPECT_TRUE(limiter.consume(laser::TrafficOperationType::WRITE, "client_b", 4, 0));
+}
+
+TEST(TableTrafficLimiter, keepTokensOnReload) {
+  laser::TableTrafficRestrictionConfig config;
+  config.setTokenBuckets({makeBucketConfig(laser::TrafficOperationType::WRITE, "", 1, 10)});
+  auto limiter = std::make_shared<laser::TableTrafficLimiter>(config, nullptr);
+  EXPECT_TRUE(limiter->consume(laser::TrafficOperationType::WRITE, "", 10, 0));
+
+  // 相同的令牌桶继承剩余令牌，新增的令牌桶是满的
+  config.setTokenBuckets({makeBucketConfig(laser::TrafficOperationType::WRITE, "", 1, 20),
+                          makeBucketConfig(laser::TrafficOperationType::READ, "", 1, 10)});
+  laser::TableTrafficLimiter reloaded(config, limiter);
+  EXPECT_FALSE(reloaded.consume(laser::TrafficOperationType::WRITE, "", 5, 0));
+  EXPECT_TRUE(reloaded.consume(laser::TrafficOperationType::READ, "", 10, 0));
+}
+
+TEST(TableTrafficLimiter, refundOnReject) {
+  laser::TableTrafficRestrictionConfig config;
+  config.setTokenBuckets({makeBucketConfig(laser::TrafficOperationType::WRITE, "", 1, 10),
+                          makeBucketConfig(laser::TrafficOperationType::WRITE, "client_a", 1, 5)});
+  laser::TableTrafficLimiter limiter(config, nullptr);
+
+  // client_a 的令牌桶拒绝时归还共享令牌桶中已经扣减的令牌
+  EXPECT_FALSE(limiter.consume(laser::TrafficOperationType::WRITE, "client_a", 6, 0));
+  EXPECT_TRUE(limiter.consume(laser::TrafficOperationType::WRITE, "client_b", 10, 0));
+
+  limiter.refund(laser::TrafficOperationType::WRITE, "client_b", 10, 0);
+  EXPECT_TRUE(limiter.consume(laser::TrafficOperationType::WRITE, "client_a", 5, 0));
+}
+
+TEST(TableTrafficLimiter, getOperationType) {
+  EXPECT_EQ(laser::TrafficOperationType::READ, laser::TableTrafficLimiter::getOperationType("get"));
+  EXPECT_EQ(laser::TrafficOperationType::READ, laser::TableTrafficLimiter::getOperationType("mgetDetail"));
+  EXPECT_EQ(laser::TrafficOperationType::WRITE, laser::TableTrafficLimiter::getOperationType("set"));
+  EXPECT_EQ(laser::TrafficOperationType::WRITE, laser::TableTrafficLimiter::getOperationType("mdel"));
+}
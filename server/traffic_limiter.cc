@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "traffic_limiter.h"
+
+namespace laser {
+
+// burst 未配置时使用一秒的速率作为 burst
+static double getBurst(uint64_t burst, uint64_t rate) { return static_cast<double>(burst > 0 ? burst : rate); }
+
+// 超过 burst 的批量请求只要求令牌桶是满的，避免大批量请求永远无法通过
+static double getTokens(uint64_t number, double burst) { return std::min(static_cast<double>(number), burst); }
+
+bool TrafficTokenBucket::match(const TrafficOperationType& type, const std::string& client_id) const {
+  if (config_.getOperationType() != type) {
+    return false;
+  }
+  return config_.getClientId().empty() || config_.getClientId() == client_id;
+}
+
+bool TrafficTokenBucket::consume(uint64_t key_number, uint64_t bytes, double now) {
+  uint64_t keys_rate = config_.getKeysPerSecond();
+  double keys_tokens = 0;
+  if (keys_rate > 0 && key_number > 0) {
+    double burst = getBurst(config_.getKeysBurst(), keys_rate);
+    keys_tokens = getTokens(key_number, burst);
+    if (!keys_bucket_.consume(keys_tokens, keys_rate, burst, now)) {
+      return false;
+    }
+  }
+
+  uint64_t bytes_rate = config_.getBytesPerSecond();
+  if (bytes_rate > 0 && bytes > 0) {
+    double burst = getBurst(config_.getBytesBurst(), bytes_rate);
+    if (!bytes_bucket_.consume(getTokens(bytes, burst), bytes_rate, burst, now)) {
+      if (keys_tokens > 0) {
+        keys_bucket_.returnTokens(keys_tokens, keys_rate);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+void TrafficTokenBucket::refund(uint64_t key_number, uint64_t bytes) {
+  uint64_t keys_rate = config_.getKeysPerSecond();
+  if (keys_rate > 0 && key_number > 0) {
+    keys_bucket_.returnTokens(getTokens(key_number, getBurst(config_.getKeysBurst(), keys_rate)), keys_rate);
+  }
+  uint64_t bytes_rate = config_.getBytesPerSecond();
+  if (bytes_rate > 0 && bytes > 0) {
+    bytes_bucket_.returnTokens(getTokens(bytes, getBurst(config_.getBytesBurst(), bytes_rate)), bytes_rate);
+  }
+}
+
+TableTrafficLimiter::TableTrafficLimiter(const TableTrafficRestrictionConfig& config,
+                                         const std::shared_ptr<TableTrafficLimiter>& old) {
+  for (auto& bucket_config : config.getTokenBuckets()) {
+    const TrafficTokenBucket* old_bucket = nullptr;
+    if (old) {
+      for (auto& bucket : old->buckets_) {
+        if (bucket->getConfig().getOperationType() == bucket_config.getOperationType() &&
+            bucket->getConfig().getClientId() == bucket_config.getClientId()) {
+          old_bucket = bucket.get();
+          break;
+        }
+      }
+    }
+
+    if (old_bucket) {
+      buckets_.push_back(std::make_unique<TrafficTokenBucket>(bucket_config, *old_bucket));
+    } else {
+      buckets_.push_back(std::make_unique<TrafficTokenBucket>(bucket_config));
+    }
+  }
+}
+
+bool TableTrafficLimiter::consume(const TrafficOperationType& type, const std::string& client_id,
+                                  uint64_t key_number, uint64_t bytes) {
+  double now = folly::DynamicTokenBucket::defaultClockNow();
+  // 每个令牌桶原子地扣减，某个令牌桶令牌不足时归还之前已经扣减的令牌
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    if (!buckets_[i]->match(type, client_id) || buckets_[i]->consume(key_number, bytes, now)) {
+      continue;
+    }
+    for (size_t j = 0; j < i; j++) {
+      if (buckets_[j]->match(type, client_id)) {
+        buckets_[j]->refund(key_number, bytes);
+      }
+    }
+    return false;
+  }
+  return true;
+}
+
+void TableTrafficLimiter::refund(const TrafficOperationType& type, const std::string& client_id, uint64_t key_number,
+                                 uint64_t bytes) {
+  for (auto& bucket : buckets_) {
+    if (bucket->match(type, client_id)) {
+      bucket->refund(key_number, bytes);
+    }
+  }
+}
+
+TrafficOperationType TableTrafficLimiter::getOperationType(const std::string& command_name) {
+  // 读操作，其余操作均按写操作限流
+  static const std::unordered_set<std::string> read_commands = {
+      "exist", "get", "hexists", "hget", "hgetall", "hkeys", "hlen", "hmget", "lindex", "llen", "lrange",
+      "mget", "mgetDetail", "sismember", "smembers", "ttl", "zcard", "zrange", "zrangeByScore", "zrank", "zscore"};
+  if (read_commands.find(command_name) != read_commands.end()) {
+    return TrafficOperationType::READ;
+  }
+  return TrafficOperationType::WRITE;
+}
+
+}  // namespace laser
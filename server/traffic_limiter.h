@@ -0,0 +1,69 @@
+/*
+ * Copyright 2020 Weibo Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @author ZhongXiu Hao <nmred.hao@gmail.com>
+ */
+
+#pragma once
+
+#include "folly/TokenBucket.h"
+
+#include "common/laser/laser_entity.h"
+
+namespace laser {
+
+// 单个令牌桶，key 数和字节数分别计费，速率为 0 的维度不限制
+class TrafficTokenBucket {
+ public:
+  explicit TrafficTokenBucket(const TrafficTokenBucketConfig& config) : config_(config) {}
+  // 配置更新时继承旧桶中剩余的令牌
+  TrafficTokenBucket(const TrafficTokenBucketConfig& config, const TrafficTokenBucket& old)
+      : config_(config), keys_bucket_(old.keys_bucket_), bytes_bucket_(old.bytes_bucket_) {}
+  ~TrafficTokenBucket() = default;
+
+  const TrafficTokenBucketConfig& getConfig() const { return config_; }
+  bool match(const TrafficOperationType& type, const std::string& client_id) const;
+  // 令牌不足时不扣减任何令牌，返回 false
+  bool consume(uint64_t key_number, uint64_t bytes, double now);
+  // 归还 consume 扣减的令牌
+  void refund(uint64_t key_number, uint64_t bytes);
+
+ private:
+  TrafficTokenBucketConfig config_;
+  folly::DynamicTokenBucket keys_bucket_;
+  folly::DynamicTokenBucket bytes_bucket_;
+};
+
+// 一张表上配置的所有令牌桶，请求需要同时满足所有匹配的令牌桶
+class TableTrafficLimiter {
+ public:
+  // old 为配置更新前的限流器，相同操作类型和客户端的令牌桶保留剩余令牌
+  TableTrafficLimiter(const TableTrafficRestrictionConfig& config, const std::shared_ptr<TableTrafficLimiter>& old);
+  ~TableTrafficLimiter() = default;
+
+  bool empty() const { return buckets_.empty(); }
+  // 令牌不足时不扣减任何令牌，返回 false
+  bool consume(const TrafficOperationType& type, const std::string& client_id, uint64_t key_number, uint64_t bytes);
+  // 归还 consume 成功扣减的令牌，用于批量请求中其他表被限流的情况
+  void refund(const TrafficOperationType& type, const std::string& client_id, uint64_t key_number, uint64_t bytes);
+  static TrafficOperationType getOperationType(const std::string& command_name);
+
+ private:
+  std::vector<std::unique_ptr<TrafficTokenBucket>> buckets_;
+};
+
+using TableTrafficLimiterMap = std::unordered_map<uint64_t, std::shared_ptr<TableTrafficLimiter>>;
+
+}  // namespace laser